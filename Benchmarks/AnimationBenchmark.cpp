@@ -0,0 +1,88 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "ClientRender/Animation.h"
+#include "ClientRender/Bone.h"
+#include "ClientRender/NodeComponents/AnimationComponent.h"
+
+using namespace clientrender;
+
+namespace teleport
+{
+	namespace benchmarks
+	{
+		// A crowd of characters sharing one clip, with a skeleton of a typical humanoid.
+		static const size_t animationCharacterCount = 200;
+		static const size_t animationBoneCount = 64;
+		static const float animationLengthS = 10.0f;
+		static const float animationKeyframesPerS = 30.0f;
+		static const float animationFrameRate = 90.0f;
+
+		static std::shared_ptr<Animation> MakeAnimation()
+		{
+			std::vector<BoneKeyframeList> tracks(animationBoneCount);
+			size_t keyframeCount = (size_t)(animationLengthS * animationKeyframesPerS) + 1;
+			for (size_t b = 0; b < animationBoneCount; b++)
+			{
+				BoneKeyframeList& track = tracks[b];
+				track.boneIndex = b;
+				track.positionKeyframes.resize(keyframeCount);
+				track.rotationKeyframes.resize(keyframeCount);
+				for (size_t k = 0; k < keyframeCount; k++)
+				{
+					float t = k / animationKeyframesPerS;
+					float angle = 0.5f * std::sin(t + b);
+					track.positionKeyframes[k] = {t, avs::vec3(0.0f, 0.1f * b, 0.01f * std::cos(t))};
+					track.rotationKeyframes[k] = {t, avs::vec4(std::sin(angle), 0.0f, 0.0f, std::cos(angle))};
+				}
+			}
+			return std::make_shared<Animation>("benchmark", tracks);
+		}
+
+		//! Times one frame of animating a crowd, with every character sampling its own point in the same clip.
+		void RunAnimationBenchmark()
+		{
+			const avs::uid animationID = 1;
+			std::shared_ptr<Animation> animation = MakeAnimation();
+			struct Character
+			{
+				std::vector<std::shared_ptr<Bone>> bones;
+				AnimationComponent animationComponent;
+			};
+			std::vector<Character> characters(animationCharacterCount);
+			for (size_t c = 0; c < animationCharacterCount; c++)
+			{
+				Character& character = characters[c];
+				for (size_t b = 0; b < animationBoneCount; b++)
+				{
+					character.bones.push_back(std::make_shared<Bone>(b + 1, "bone"));
+					if (b)
+						character.bones[b]->SetParent(character.bones[b - 1]);
+				}
+				character.animationComponent.addAnimation(animationID, animation);
+				character.animationComponent.setAnimation(animationID);
+				// So that the characters are at different keyframes.
+				character.animationComponent.setAnimationSpeed(animationID, 0.8f + 0.4f * c / animationCharacterCount);
+			}
+
+			const float deltaTimeS = 1.0f / animationFrameRate;
+			size_t frameCount = (size_t)(animationLengthS * animationFrameRate);
+			double totalMs = 0.0, worstMs = 0.0;
+			for (size_t f = 0; f < frameCount; f++)
+			{
+				Timer timer;
+				for (Character& character : characters)
+					character.animationComponent.update(character.bones, deltaTimeS);
+				double ms = timer.ElapsedMs();
+				totalMs += ms;
+				worstMs = std::max(worstMs, ms);
+			}
+			std::cout << animationCharacterCount << " characters of " << animationBoneCount << " bones, " << frameCount << " frames.\n";
+			std::cout << "Per frame: " << totalMs / frameCount << "ms on average, " << worstMs << "ms at worst.\n";
+		}
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+
+namespace teleport
+{
+	namespace benchmarks
+	{
+		//! Measures wall-clock time from construction, or from the last call to Restart().
+		class Timer
+		{
+		public:
+			Timer()
+				: start(std::chrono::steady_clock::now())
+			{}
+			void Restart()
+			{
+				start = std::chrono::steady_clock::now();
+			}
+			double ElapsedMs() const
+			{
+				return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			}
+
+		private:
+			std::chrono::steady_clock::time_point start;
+		};
+	}
+}
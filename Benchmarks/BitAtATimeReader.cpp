@@ -0,0 +1,56 @@
+#include "BitAtATimeReader.h"
+
+namespace teleport
+{
+	namespace benchmarks
+	{
+		BitAtATimeReader::BitAtATimeReader(const uint8_t* data, size_t size)
+			: mData(data), mSize(size)
+		{
+		}
+
+		bool BitAtATimeReader::getBit()
+		{
+			if (mByteIndex >= mSize)
+				return false;
+			bool res = (mData[mByteIndex] & (1 << mBitIndex)) != 0;
+			mBitIndex--;
+			// The unsigned value of mBitIndex wraps when it goes below 0.
+			if (mBitIndex > 7)
+			{
+				mBitIndex = 7;
+				mByteIndex++;
+				if (mByteIndex >= 2 && mByteIndex < mSize && mData[mByteIndex - 2] == 0 && mData[mByteIndex - 1] == 0 && mData[mByteIndex] == 3)
+					mByteIndex++;
+			}
+			return res;
+		}
+
+		uint32_t BitAtATimeReader::getBits(size_t count)
+		{
+			uint32_t result = 0;
+			for (size_t i = 0; i < count; i++)
+			{
+				if (getBit())
+					result |= 1 << (count - i - 1);
+			}
+			return result;
+		}
+
+		uint32_t BitAtATimeReader::getGolombU()
+		{
+			long zeroBitCount = -1;
+			for (long bit = 0; !bit; zeroBitCount++)
+				bit = getBit();
+			if (zeroBitCount >= 32)
+				return 0;
+			return (1 << zeroBitCount) - 1 + getBits(zeroBitCount);
+		}
+
+		int32_t BitAtATimeReader::getGolombS()
+		{
+			int32_t buffer = getGolombU();
+			return (buffer & 1) ? (buffer + 1) >> 1 : -(buffer >> 1);
+		}
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace teleport
+{
+	namespace benchmarks
+	{
+		//! The reader the AV parser used before BitReader: one bit per call, checking for emulation prevention at each new byte.
+		//! Its functions are defined in their own source file, as they were in ClientRender, so that they are no more
+		//! inlined into the benchmark than BitReader's are.
+		class BitAtATimeReader
+		{
+		public:
+			BitAtATimeReader(const uint8_t* data, size_t size);
+			bool getBit();
+			uint32_t getBits(size_t count);
+			uint32_t getGolombU();
+			int32_t getGolombS();
+
+		private:
+			const uint8_t* mData;
+			size_t mSize;
+			size_t mByteIndex = 0;
+			uint32_t mBitIndex = 7;
+		};
+	}
+}
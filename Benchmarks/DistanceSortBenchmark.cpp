@@ -0,0 +1,98 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "ClientRender/DistanceSortedNodeList.h"
+#include "ClientRender/Node.h"
+
+using namespace clientrender;
+
+namespace teleport
+{
+	namespace benchmarks
+	{
+		static const size_t distanceSortFrameCount = 900;
+		static const float distanceSortFrameRate = 90.0f;
+
+		// Nodes that wander at walking pace through a 100m square, around a viewer who walks across it.
+		struct MovingNodes
+		{
+			std::vector<std::shared_ptr<Node>> nodes;
+			std::vector<avs::vec3> positions;
+			std::vector<avs::vec3> velocities;
+
+			MovingNodes(size_t count)
+			{
+				std::mt19937 random((unsigned)count);
+				std::uniform_real_distribution<float> place(-50.0f, 50.0f);
+				std::uniform_real_distribution<float> speed(-1.5f, 1.5f);
+				for (size_t i = 0; i < count; i++)
+				{
+					nodes.push_back(std::make_shared<Node>(i + 1, "moving"));
+					positions.push_back(avs::vec3(place(random), 0.0f, place(random)));
+					velocities.push_back(avs::vec3(speed(random), 0.0f, speed(random)));
+				}
+			}
+			// Move everything on by one frame, and update the nodes' distances from the viewer.
+			void Step(size_t frame)
+			{
+				float dt = 1.0f / distanceSortFrameRate;
+				avs::vec3 viewer(-50.0f + 1.4f * dt * frame, 1.7f, 0.0f);
+				for (size_t i = 0; i < nodes.size(); i++)
+				{
+					positions[i] = positions[i] + velocities[i] * dt;
+					avs::vec3 d = positions[i] - viewer;
+					nodes[i]->distance = sqrtf(d.x * d.x + d.y * d.y + d.z * d.z);
+				}
+			}
+		};
+
+		//! Times a frame's sort of N moving nodes by distance: with a full std::sort of shared_ptrs, as NodeManager used to
+		//! do on every call, and with DistanceSortedNodeList's incremental insertion sort.
+		void RunDistanceSortBenchmark()
+		{
+			const size_t counts[] = { 1000, 5000, 20000 };
+			for (size_t count : counts)
+			{
+				MovingNodes fullSortNodes(count);
+				std::vector<std::shared_ptr<Node>> sorted = fullSortNodes.nodes;
+				double fullSortMs = 0.0, fullSortWorstMs = 0.0;
+				for (size_t f = 0; f < distanceSortFrameCount; f++)
+				{
+					fullSortNodes.Step(f);
+					Timer timer;
+					std::sort(sorted.begin(), sorted.end(), [](std::shared_ptr<Node> a, std::shared_ptr<Node> b)
+						{
+							return a->distance < b->distance;
+						});
+					double ms = timer.ElapsedMs();
+					fullSortMs += ms;
+					fullSortWorstMs = std::max(fullSortWorstMs, ms);
+				}
+
+				MovingNodes incrementalNodes(count);
+				DistanceSortedNodeList list;
+				for (const std::shared_ptr<Node>& node : incrementalNodes.nodes)
+					list.Add(node);
+				double incrementalMs = 0.0, incrementalWorstMs = 0.0;
+				for (size_t f = 0; f < distanceSortFrameCount; f++)
+				{
+					incrementalNodes.Step(f);
+					Timer timer;
+					list.Sort();
+					double ms = timer.ElapsedMs();
+					incrementalMs += ms;
+					incrementalWorstMs = std::max(incrementalWorstMs, ms);
+				}
+
+				std::cout << count << " moving nodes:\n";
+				std::cout << "  std::sort:        " << fullSortMs / distanceSortFrameCount << " ms per frame, worst " << fullSortWorstMs << " ms\n";
+				std::cout << "  incremental sort: " << incrementalMs / distanceSortFrameCount << " ms per frame, worst " << incrementalWorstMs << " ms\n";
+			}
+		}
+	}
+}
@@ -0,0 +1,112 @@
+#include "Benchmark.h"
+
+#include <string>
+
+#include "TeleportCore/ThreadPool.h"
+#include "TeleportServer/GeometryEncoder.h"
+#include "TeleportServer/GeometryStore.h"
+#include "TeleportServer/GeometryStreamingService.h"
+#include "TeleportServer/ServerSettings.h"
+
+using namespace teleport::server;
+
+namespace teleport
+{
+	namespace benchmarks
+	{
+		static const size_t encodeNodeCount = 10000;
+		static const avs::uid encodeFirstNodeUid = 0x100000;
+
+		// Streams the nodes it is given to a client that is never connected, so that an encoder can be driven directly.
+		class EncodeBenchmarkService : public GeometryStreamingService
+		{
+		public:
+			EncodeBenchmarkService(const ServerSettings* settings)
+				: GeometryStreamingService(settings)
+			{
+				geometryStore = &GeometryStore::GetInstance();
+			}
+			avs::AxesStandard getClientAxesStandard() const override
+			{
+				return avs::AxesStandard::EngineeringStyle;
+			}
+
+		private:
+			bool clientStoppedRenderingNode_Internal(avs::uid, avs::uid) override
+			{
+				return true;
+			}
+			bool clientStartedRenderingNode_Internal(avs::uid, avs::uid) override
+			{
+				return true;
+			}
+		};
+
+		// Encodes everything the client needs, a buffer at a time as the pipeline would. Returns the number of bytes encoded.
+		static size_t EncodeAll(const ServerSettings& settings)
+		{
+			EncodeBenchmarkService service(&settings);
+			for (size_t i = 0; i < encodeNodeCount; i++)
+				service.addNode(encodeFirstNodeUid + i);
+			GeometryEncoder encoder(&settings, &service);
+			size_t total = 0;
+			for (;;)
+			{
+				encoder.encode(0, &service);
+				void* data = nullptr;
+				size_t size = 0;
+				encoder.mapOutputBuffer(data, size);
+				encoder.unmapOutputBuffer();
+				if (!size)
+					break;
+				total += size;
+			}
+			return total;
+		}
+
+		//! Encodes a store of 10k nodes for one client, on the streaming thread alone and then on the shared encode pool.
+		//! The encoded-resource cache is turned off, so that every payload is encoded rather than shared from the last run.
+		void RunEncodeBenchmark()
+		{
+			GeometryStore& geometryStore = GeometryStore::GetInstance();
+			geometryStore.clear(false);
+			for (size_t i = 0; i < encodeNodeCount; i++)
+			{
+				avs::Node node;
+				node.name = "Node " + std::to_string(i);
+				node.localTransform.position = avs::vec3((float)(i % 100), 0.0f, (float)(i / 100));
+				node.globalTransform = node.localTransform;
+				geometryStore.storeNode(encodeFirstNodeUid + i, node);
+			}
+			EncodedResourceCacheStats cacheStats = geometryStore.getEncodedResourceCacheStats();
+			geometryStore.setEncodedResourceCacheSize(0);
+
+			ServerSettings settings;
+			settings.enableGeometryStreaming = true;
+			settings.geometryBufferCutoffSize = 64 * 1024;
+			settings.serverAxesStandard = avs::AxesStandard::EngineeringStyle;
+
+			size_t threadCounts[] = { 1, core::ThreadPool::GetDefaultThreadCount() };
+			double singleMs = 0.0;
+			for (size_t threads : threadCounts)
+			{
+				GeometryEncoder::SetEncodeThreadCount(threads);
+				// The first run starts the pool's threads, so is not timed.
+				EncodeAll(settings);
+				Timer timer;
+				size_t bytes = EncodeAll(settings);
+				double ms = timer.ElapsedMs();
+				if (threads == 1)
+					singleMs = ms;
+				std::cout << encodeNodeCount << " nodes on " << threads << " thread(s): " << ms << " ms, " << bytes / 1024 << " KB";
+				if (threads != 1 && ms > 0.0)
+					std::cout << ", " << singleMs / ms << "x";
+				std::cout << "\n";
+			}
+
+			GeometryEncoder::SetEncodeThreadCount(0);
+			geometryStore.setEncodedResourceCacheSize(cacheStats.maxBytes);
+			geometryStore.clear(false);
+		}
+	}
+}
@@ -0,0 +1,108 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "TeleportServer/FlatResourceMap.h"
+
+using namespace teleport::server;
+
+namespace teleport
+{
+	namespace benchmarks
+	{
+		// About the size of the small resources the GeometryStore keeps, such as materials.
+		struct BenchmarkResource
+		{
+			uint64_t values[8] = {};
+		};
+
+		// The uids in the order the server gives them out, and in the random order lookups arrive in.
+		static void MakeUids(size_t count, std::vector<avs::uid>& uids, std::vector<avs::uid>& shuffled)
+		{
+			uids.resize(count);
+			for (size_t i = 0; i < count; i++)
+				uids[i] = 1 + i;
+			shuffled = uids;
+			std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937_64(count));
+		}
+
+		// Ids as GeometryStore::getNodeIDs() and the others returned them from a std::map: copied out on every call.
+		static std::vector<avs::uid> CopyIDs(const std::map<avs::uid, BenchmarkResource>& resources)
+		{
+			std::vector<avs::uid> ids;
+			ids.reserve(resources.size());
+			for (const auto& r : resources)
+				ids.push_back(r.first);
+			return ids;
+		}
+
+		//! Compares the std::map that the GeometryStore used to keep its resources in with FlatResourceMap.
+		//! Lookups are in random order; iteration lists the ids then looks up each resource, as callers of getNodeIDs() do.
+		void RunFlatResourceMapBenchmark()
+		{
+			const size_t counts[] = { 1000, 100000, 1000000 };
+			for (size_t count : counts)
+			{
+				std::vector<avs::uid> uids, shuffled;
+				MakeUids(count, uids, shuffled);
+				// Enough work at each size for the timings to be steady.
+				size_t repeats = std::max((size_t)1, (size_t)2000000 / count);
+
+				std::map<avs::uid, BenchmarkResource> tree;
+				FlatResourceMap<BenchmarkResource> flat;
+				Timer timer;
+				for (avs::uid u : uids)
+					tree[u].values[0] = u;
+				double treeInsertMs = timer.ElapsedMs();
+				timer.Restart();
+				for (avs::uid u : uids)
+					flat[u].values[0] = u;
+				double flatInsertMs = timer.ElapsedMs();
+
+				uint64_t treeSum = 0, flatSum = 0;
+				timer.Restart();
+				for (size_t r = 0; r < repeats; r++)
+				{
+					for (avs::uid u : shuffled)
+						treeSum += tree.find(u)->second.values[0];
+				}
+				double treeLookupNs = timer.ElapsedMs() * 1000000.0 / double(repeats * count);
+				timer.Restart();
+				for (size_t r = 0; r < repeats; r++)
+				{
+					for (avs::uid u : shuffled)
+						flatSum += flat.find(u)->values[0];
+				}
+				double flatLookupNs = timer.ElapsedMs() * 1000000.0 / double(repeats * count);
+
+				timer.Restart();
+				for (size_t r = 0; r < repeats; r++)
+				{
+					std::vector<avs::uid> ids = CopyIDs(tree);
+					for (avs::uid u : ids)
+						treeSum += tree.find(u)->second.values[0];
+				}
+				double treeIterateNs = timer.ElapsedMs() * 1000000.0 / double(repeats * count);
+				timer.Restart();
+				for (size_t r = 0; r < repeats; r++)
+				{
+					UidSpan ids = flat.getIDs();
+					for (avs::uid u : ids)
+						flatSum += flat.find(u)->values[0];
+				}
+				double flatIterateNs = timer.ElapsedMs() * 1000000.0 / double(repeats * count);
+
+				std::cout << count << " resources:\n";
+				std::cout << "  insert:  std::map " << treeInsertMs << " ms, flat " << flatInsertMs << " ms\n";
+				std::cout << "  lookup:  std::map " << treeLookupNs << " ns, flat " << flatLookupNs << " ns\n";
+				std::cout << "  iterate: std::map " << treeIterateNs << " ns, flat " << flatIterateNs << " ns per resource\n";
+				// Stops the loops from being optimised away.
+				if (treeSum != flatSum)
+					std::cout << "  (sums differ)\n";
+			}
+		}
+	}
+}
@@ -0,0 +1,170 @@
+#include "Benchmark.h"
+
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include "ClientRender/ResourceDiskCache.h"
+
+using namespace clientrender;
+
+namespace teleport
+{
+	namespace benchmarks
+	{
+		// A scene of about the size of a furnished room.
+		static const size_t joinMeshCount = 200;
+		static const size_t joinTextureCount = 100;
+		static const uint64_t joinVerticesPerMesh = 4096;
+		static const uint32_t joinVertexStride = 32;
+		static const uint32_t joinTextureSize = 256;
+		// Only used to estimate how long the streamed resources would take to arrive.
+		static const double joinBandwidthMbps = 50.0;
+
+		// The buffers of a mesh as the client receives them, before they go to the GPU.
+		struct StreamedMesh
+		{
+			std::vector<uint8_t> vertices;
+			std::vector<uint8_t> indices;
+		};
+
+		static StreamedMesh MakeMesh(size_t m)
+		{
+			StreamedMesh mesh;
+			mesh.vertices.resize(joinVerticesPerMesh * joinVertexStride);
+			for (size_t i = 0; i < mesh.vertices.size(); i++)
+				mesh.vertices[i] = (uint8_t)(i * 31 + m);
+			std::vector<uint32_t> indices(joinVerticesPerMesh * 3);
+			for (size_t i = 0; i < indices.size(); i++)
+				indices[i] = (uint32_t)((i * 7 + m) % joinVerticesPerMesh);
+			const uint8_t* indexBytes = (const uint8_t*)indices.data();
+			mesh.indices.assign(indexBytes, indexBytes + indices.size() * sizeof(uint32_t));
+			return mesh;
+		}
+
+		// The mip chain of an uncompressed RGBA8 texture.
+		static std::vector<std::vector<uint8_t>> MakeTextureImages(size_t t)
+		{
+			std::vector<std::vector<uint8_t>> images;
+			for (uint32_t size = joinTextureSize; size > 0; size /= 2)
+			{
+				std::vector<uint8_t> image((size_t)size * size * 4);
+				for (size_t i = 0; i < image.size(); i++)
+					image[i] = (uint8_t)(i * 13 + t);
+				images.push_back(std::move(image));
+			}
+			return images;
+		}
+
+		static uint64_t MeshHash(size_t m)
+		{
+			return 0x1000000ull + m;
+		}
+
+		static uint64_t TextureHash(size_t t)
+		{
+			return 0x2000000ull + t;
+		}
+
+		//! Compares joining a server whose resources are not yet on disk with joining it again once they are.
+		//! On a cold join the client builds each streamed resource and hands it to the disk cache; on a warm join the server
+		//! streams none of them, and the client loads them all from the cache. Neither time includes creating GPU resources,
+		//! which both joins do.
+		void RunJoinBenchmark()
+		{
+			std::filesystem::path folder = std::filesystem::temp_directory_path() / "teleport_join_benchmark";
+			std::error_code ec;
+			std::filesystem::remove_all(folder, ec);
+
+			std::vector<StreamedMesh> streamedMeshes(joinMeshCount);
+			std::vector<std::vector<std::vector<uint8_t>>> streamedTextures(joinTextureCount);
+			uint64_t streamedBytes = 0;
+			for (size_t m = 0; m < joinMeshCount; m++)
+			{
+				streamedMeshes[m] = MakeMesh(m);
+				streamedBytes += streamedMeshes[m].vertices.size() + streamedMeshes[m].indices.size();
+			}
+			for (size_t t = 0; t < joinTextureCount; t++)
+			{
+				streamedTextures[t] = MakeTextureImages(t);
+				for (const auto& image : streamedTextures[t])
+					streamedBytes += image.size();
+			}
+
+			double coldCreateMs = 0.0, coldWrittenMs = 0.0;
+			{
+				ResourceDiskCache diskCache;
+				diskCache.SetFolder(folder.string());
+				Timer timer;
+				for (size_t m = 0; m < joinMeshCount; m++)
+				{
+					// As ResourceCreator::CreateMesh keeps the buffers it gives to the GPU.
+					std::shared_ptr<CachedMesh> cachedMesh = std::make_shared<CachedMesh>();
+					cachedMesh->name = "mesh";
+					cachedMesh->bounds.lower = avs::vec3(-1.0f, -1.0f, -1.0f);
+					cachedMesh->bounds.upper = avs::vec3(1.0f, 1.0f, 1.0f);
+					cachedMesh->elements.resize(1);
+					CachedMeshElement& element = cachedMesh->elements[0];
+					element.attributes = {{0, VertexBufferLayout::ComponentCount::VEC3, VertexBufferLayout::Type::FLOAT}
+						, {1, VertexBufferLayout::ComponentCount::VEC3, VertexBufferLayout::Type::FLOAT}
+						, {2, VertexBufferLayout::ComponentCount::VEC2, VertexBufferLayout::Type::FLOAT}};
+					element.stride = joinVertexStride;
+					element.vertexCount = joinVerticesPerMesh;
+					element.vertices = streamedMeshes[m].vertices;
+					element.indexStride = sizeof(uint32_t);
+					element.indexCount = streamedMeshes[m].indices.size() / sizeof(uint32_t);
+					element.indices = streamedMeshes[m].indices;
+					diskCache.StoreMesh(MeshHash(m), std::move(cachedMesh));
+				}
+				for (size_t t = 0; t < joinTextureCount; t++)
+				{
+					// As ResourceCreator does with an uncompressed texture.
+					std::shared_ptr<Texture::TextureCreateInfo> textureInfo = std::make_shared<Texture::TextureCreateInfo>();
+					textureInfo->name = "texture";
+					textureInfo->width = textureInfo->height = joinTextureSize;
+					textureInfo->depth = 1;
+					textureInfo->bytesPerPixel = 4;
+					textureInfo->arrayCount = 1;
+					textureInfo->mipCount = (uint32_t)streamedTextures[t].size();
+					textureInfo->type = Texture::Type::TEXTURE_2D;
+					textureInfo->format = Texture::Format::RGBA8;
+					textureInfo->images = streamedTextures[t];
+					diskCache.StoreTexture(TextureHash(t), std::move(textureInfo));
+				}
+				coldCreateMs = timer.ElapsedMs();
+				diskCache.Flush();
+				coldWrittenMs = timer.ElapsedMs();
+			}
+
+			double warmLoadMs = 0.0;
+			size_t loaded = 0, cachedCount = 0;
+			{
+				Timer timer;
+				ResourceDiskCache diskCache;
+				diskCache.SetFolder(folder.string());
+				// Listed in the handshake, so that the server doesn't stream them.
+				cachedCount = diskCache.GetHashes().size();
+				for (size_t m = 0; m < joinMeshCount; m++)
+				{
+					CachedMesh cachedMesh;
+					loaded += diskCache.LoadMesh(MeshHash(m), cachedMesh) ? 1 : 0;
+				}
+				for (size_t t = 0; t < joinTextureCount; t++)
+				{
+					Texture::TextureCreateInfo textureInfo;
+					loaded += diskCache.LoadTexture(TextureHash(t), textureInfo) ? 1 : 0;
+				}
+				warmLoadMs = timer.ElapsedMs();
+			}
+			std::filesystem::remove_all(folder, ec);
+
+			double streamMs = streamedBytes * 8.0 / (joinBandwidthMbps * 1000.0);
+			std::cout << joinMeshCount << " meshes and " << joinTextureCount << " textures, " << streamedBytes / (1024 * 1024) << "MB.\n";
+			std::cout << "Cold join: " << streamMs << "ms to stream at " << joinBandwidthMbps << "Mbps, " << coldCreateMs
+				<< "ms to create on the decoding threads, all written to disk after " << coldWrittenMs << "ms.\n";
+			std::cout << "Warm join: nothing to stream, " << cachedCount << " entries listed, " << loaded << " loaded in " << warmLoadMs << "ms.\n";
+			if (loaded != joinMeshCount + joinTextureCount)
+				std::cerr << "Only " << loaded << " of " << joinMeshCount + joinTextureCount << " resources were loaded from the disk cache.\n";
+		}
+	}
+}
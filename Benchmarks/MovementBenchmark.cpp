@@ -0,0 +1,103 @@
+#include "Benchmark.h"
+
+#include <cmath>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "TeleportCore/MovementCodec.h"
+
+using namespace teleport::core;
+
+namespace teleport
+{
+	namespace benchmarks
+	{
+		static const size_t movementNodeCount = 5000;
+		static const float movementSendRate = 30.0f;
+		static const size_t movementTickCount = 300;
+		// About what fits in one packet of the unreliable channel.
+		static const size_t movementMaxPayloadSize = 1200;
+		// Acknowledgements reach the server this many ticks after the packets they acknowledge were sent.
+		static const size_t movementAckDelayTicks = 3;
+
+		// The nodes' movements at a tick: each circles at walking pace around its own centre, turning as it goes.
+		// Every staticInterval'th node stands still.
+		static void MakeMovements(size_t tick, size_t staticInterval, std::vector<MovementUpdate>& updates)
+		{
+			float t = tick / movementSendRate;
+			updates.resize(movementNodeCount);
+			for (size_t i = 0; i < movementNodeCount; i++)
+			{
+				MovementUpdate& u = updates[i];
+				float phase = (staticInterval && i % staticInterval == 0) ? 0.0f : 0.5f * t + 0.01f * i;
+				u.nodeID = 1000 + i;
+				u.timestamp = (int64_t)(t * 1000.0f);
+				u.isGlobal = true;
+				u.position = avs::vec3(float(i % 100) + 2.0f * std::cos(phase), 0.0f, float(i / 100) + 2.0f * std::sin(phase));
+				u.rotation = {0.0f, std::sin(0.5f * phase), 0.0f, std::cos(0.5f * phase)};
+				u.scale = {1.0f, 1.0f, 1.0f};
+				u.velocity = avs::vec3(-std::sin(phase), 0.0f, std::cos(phase));
+				u.angularVelocityAxis = avs::vec3(0, 1.0f, 0);
+				u.angularVelocityAngle = 0.5f;
+			}
+		}
+
+		static void RunMovementWorkload(const char* name, size_t staticInterval, float lossRate)
+		{
+			MovementEncoder encoder;
+			MovementDecoder decoder;
+			std::vector<MovementPacket> packets;
+			std::vector<MovementUpdate> updates, decoded;
+			std::deque<std::pair<uint32_t, uint64_t>> acknowledgements;
+			std::mt19937 random(1);
+			std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+
+			size_t encodedBytes = 0, packetCount = 0, decodedCount = 0;
+			double encodeMs = 0.0, decodeMs = 0.0;
+			for (size_t tick = 0; tick < movementTickCount; tick++)
+			{
+				MakeMovements(tick, staticInterval, updates);
+				if (acknowledgements.size() > movementAckDelayTicks)
+				{
+					encoder.acknowledge(acknowledgements.front().first, acknowledgements.front().second);
+					acknowledgements.pop_front();
+				}
+				Timer timer;
+				size_t count = encoder.encode(updates, 0, movementMaxPayloadSize, packets);
+				encodeMs += timer.ElapsedMs();
+
+				decoded.clear();
+				timer.Restart();
+				for (size_t p = 0; p < count; p++)
+				{
+					encodedBytes += packets[p].payload.size() + UpdateNodeMovementCommand::getCommandSize();
+					if (chance(random) < lossRate)
+						continue;
+					decoder.decode(packets[p].command, packets[p].payload.data(), packets[p].payload.size(), decoded);
+				}
+				decodeMs += timer.ElapsedMs();
+				packetCount += count;
+				decodedCount += decoded.size();
+				acknowledgements.push_back({decoder.getSequences().getLatest(), decoder.getSequences().getMask()});
+			}
+
+			double seconds = movementTickCount / movementSendRate;
+			double rawBytes = double(sizeof(MovementUpdate)) * movementNodeCount * movementTickCount;
+			std::cout << name << ":\n";
+			std::cout << "  as MovementUpdates: " << rawBytes / seconds / 1024.0 << " KB/s\n";
+			std::cout << "  encoded:            " << double(encodedBytes) / seconds / 1024.0 << " KB/s in " << double(packetCount) / seconds << " packets/s, "
+				<< double(decodedCount) / movementTickCount << " nodes applied per tick\n";
+			std::cout << "  encode " << encodeMs / movementTickCount << " ms, decode " << decodeMs / movementTickCount << " ms per tick\n";
+		}
+
+		//! Sends the movement of 5,000 nodes at 30 Hz through MovementEncoder and MovementDecoder, with acknowledgements
+		//! arriving a few ticks late, and compares the bandwidth with sending every MovementUpdate whole.
+		void RunMovementBenchmark()
+		{
+			RunMovementWorkload("5000 nodes, all moving", 0, 0.0f);
+			RunMovementWorkload("5000 nodes, half moving", 2, 0.0f);
+			RunMovementWorkload("5000 nodes, all moving, 5% loss", 0, 0.05f);
+		}
+	}
+}
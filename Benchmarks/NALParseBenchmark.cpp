@@ -0,0 +1,137 @@
+#include "Benchmark.h"
+
+#include <random>
+#include <vector>
+
+#include "BitAtATimeReader.h"
+#include "ClientRender/AVParser/BitReader.h"
+
+namespace teleport
+{
+	namespace benchmarks
+	{
+		// Packs bits most significant first, as they are in a NAL unit.
+		struct NALWriter
+		{
+			std::vector<uint8_t> bytes;
+			size_t bitCount = 0;
+			void put(uint32_t value, size_t count)
+			{
+				for (size_t i = count; i > 0; i--)
+				{
+					if (bitCount % 8 == 0)
+						bytes.push_back(0);
+					if ((value >> (i - 1)) & 1)
+						bytes.back() |= uint8_t(0x80 >> (bitCount % 8));
+					bitCount++;
+				}
+			}
+			void putGolombU(uint32_t value)
+			{
+				uint64_t code = uint64_t(value) + 1;
+				size_t length = 0;
+				while ((code >> length) > 1)
+					length++;
+				put(0, length);
+				put(uint32_t(code), length + 1);
+			}
+			void putGolombS(int32_t value)
+			{
+				putGolombU(value > 0 ? uint32_t(2 * value - 1) : uint32_t(-2 * value));
+			}
+		};
+
+		// How many fields of each kind a synthetic NAL holds: a header, then groups of one fixed-width field, one unsigned
+		// and one signed Exp-Golomb value, as parameter sets and slice headers are made of.
+		static const size_t nalFieldGroups = 200;
+
+		// NAL units of random fields, escaped as an encoder would. Small Exp-Golomb values are likelier, as they are in real headers.
+		static std::vector<std::vector<uint8_t>> MakeNALs(size_t count)
+		{
+			std::mt19937 random(1);
+			std::geometric_distribution<uint32_t> golomb(0.3);
+			std::uniform_int_distribution<uint32_t> bits(0, 15);
+			std::vector<std::vector<uint8_t>> nals(count);
+			for (auto& nal : nals)
+			{
+				NALWriter writer;
+				writer.put(0x4001, 16);
+				for (size_t g = 0; g < nalFieldGroups; g++)
+				{
+					writer.put(bits(random), 4);
+					writer.putGolombU(golomb(random));
+					uint32_t s = golomb(random);
+					writer.putGolombS((s & 1) ? -int32_t(s / 2) : int32_t(s / 2));
+				}
+				writer.put(1, 1);
+				int zeros = 0;
+				for (uint8_t b : writer.bytes)
+				{
+					if (zeros >= 2 && b <= 3)
+					{
+						nal.push_back(3);
+						zeros = 0;
+					}
+					nal.push_back(b);
+					zeros = b == 0 ? zeros + 1 : 0;
+				}
+			}
+			return nals;
+		}
+
+		template<typename Reader>
+		static uint64_t ParseNAL(Reader& reader)
+		{
+			uint64_t sum = reader.getBits(16);
+			for (size_t g = 0; g < nalFieldGroups; g++)
+			{
+				sum += reader.getBits(4);
+				sum += reader.getGolombU();
+				sum += (uint64_t)(int64_t)reader.getGolombS();
+			}
+			return sum;
+		}
+
+		//! Parses synthetic NAL units of fixed-width and Exp-Golomb fields with BitReader, and with the bit-at-a-time reader
+		//! it replaced, as the AV parser reads parameter sets and slice headers.
+		void RunNALParseBenchmark()
+		{
+			std::vector<std::vector<uint8_t>> nals = MakeNALs(20000);
+			size_t totalBytes = 0;
+			for (const auto& nal : nals)
+				totalBytes += nal.size();
+			const size_t repeats = 10;
+
+			uint64_t oldSum = 0, newSum = 0;
+			Timer timer;
+			for (size_t r = 0; r < repeats; r++)
+			{
+				for (const auto& nal : nals)
+				{
+					BitAtATimeReader reader(nal.data(), nal.size());
+					oldSum += ParseNAL(reader);
+				}
+			}
+			double oldMs = timer.ElapsedMs();
+			timer.Restart();
+			BitReader bitReader;
+			for (size_t r = 0; r < repeats; r++)
+			{
+				for (const auto& nal : nals)
+				{
+					bitReader.start(nal.data(), nal.size());
+					newSum += ParseNAL(bitReader);
+				}
+			}
+			double newMs = timer.ElapsedMs();
+
+			double nalCount = double(nals.size() * repeats);
+			double megabytes = double(totalBytes * repeats) / (1024.0 * 1024.0);
+			std::cout << nals.size() << " NAL units, " << totalBytes / 1024 << " KB, " << nalFieldGroups * 3 + 1 << " fields each:\n";
+			std::cout << "  bit at a time: " << oldMs * 1000000.0 / nalCount << " ns per NAL, " << megabytes / (oldMs / 1000.0) << " MB/s\n";
+			std::cout << "  BitReader:     " << newMs * 1000000.0 / nalCount << " ns per NAL, " << megabytes / (newMs / 1000.0) << " MB/s\n";
+			if (oldSum != newSum)
+				std::cout << "  (values differ)\n";
+		}
+	}
+}
@@ -0,0 +1,128 @@
+#include "Benchmark.h"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "libavstream/queue.hpp"
+
+namespace teleport
+{
+	namespace benchmarks
+	{
+		enum class QueueMode
+		{
+			Locking,		// configure(): a mutex on every read and write, and the queue grows when full.
+			Ring,			// configureSPSC(), copying buffers in with write().
+			RingInPlace		// configureSPSC(), building each buffer in the ring with reserve() and commit().
+		};
+
+		static const char* QueueModeName(QueueMode mode)
+		{
+			switch (mode)
+			{
+			case QueueMode::Locking:
+				return "locking queue";
+			case QueueMode::Ring:
+				return "ring, write()";
+			case QueueMode::RingInPlace:
+				return "ring, in place";
+			default:
+				return "";
+			}
+		}
+
+		// Stops the reads from being optimised away.
+		static volatile uint64_t queueChecksum = 0;
+
+		// Sends buffers of the given sizes from one thread to another through the queue. Returns the time taken in milliseconds.
+		// Both kinds of queue start with room for maxBuffers of maxSize; the ring makes the producer wait when it is full,
+		// where the locking queue grows instead.
+		static double RunQueue(QueueMode mode, const std::vector<size_t>& sizes, size_t maxSize, size_t maxBuffers)
+		{
+			avs::Queue queue;
+			if (mode == QueueMode::Locking)
+				queue.configure(maxSize, maxBuffers, "BenchmarkQueue");
+			else
+				queue.configureSPSC(maxSize, maxBuffers * maxSize, "BenchmarkQueue");
+			std::vector<uint8_t> source(maxSize);
+			for (size_t i = 0; i < source.size(); i++)
+				source[i] = (uint8_t)i;
+
+			Timer timer;
+			std::thread producer([&]()
+				{
+					for (size_t size : sizes)
+					{
+						if (mode == QueueMode::RingInPlace)
+						{
+							void* dst = nullptr;
+							while (queue.reserve(size, &dst) != avs::Result::OK)
+								std::this_thread::yield();
+							memcpy(dst, source.data(), size);
+							queue.commit(size);
+						}
+						else
+						{
+							size_t written = 0;
+							while (queue.write(nullptr, source.data(), size, written) != avs::Result::OK)
+								std::this_thread::yield();
+						}
+					}
+				});
+			std::vector<uint8_t> destination(maxSize);
+			size_t received = 0;
+			uint64_t checksum = 0;
+			while (received < sizes.size())
+			{
+				size_t bufferSize = destination.size();
+				size_t bytesRead = 0;
+				if (queue.read(nullptr, destination.data(), bufferSize, bytesRead) != avs::Result::OK)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+				checksum += destination[bytesRead / 2];
+				received++;
+			}
+			producer.join();
+			double ms = timer.ElapsedMs();
+			queueChecksum = checksum;
+			queue.deconfigure();
+			return ms;
+		}
+
+		static void RunQueueWorkload(const char* name, const std::vector<size_t>& sizes, size_t maxSize, size_t maxBuffers)
+		{
+			size_t totalBytes = 0;
+			for (size_t s : sizes)
+				totalBytes += s;
+			std::cout << name << ": " << sizes.size() << " buffers, " << totalBytes / (1024 * 1024) << " MB\n";
+			const QueueMode modes[] = { QueueMode::Locking, QueueMode::Ring, QueueMode::RingInPlace };
+			for (QueueMode mode : modes)
+			{
+				double ms = RunQueue(mode, sizes, maxSize, maxBuffers);
+				double ns = ms * 1000000.0 / double(sizes.size());
+				double mbPerSecond = ms > 0.0 ? double(totalBytes) / (1024.0 * 1024.0) / (ms / 1000.0) : 0.0;
+				std::cout << "  " << QueueModeName(mode) << ": " << ms << " ms, " << ns << " ns per buffer, " << mbPerSecond << " MB/s\n";
+			}
+		}
+
+		//! Passes buffers from a producer thread to a consumer thread through an avs::Queue, in its locking mode and as a ring.
+		//! Small buffers show the cost of contention on each read and write; video frames show the throughput of copying.
+		void RunQueueBenchmark()
+		{
+			// Tag data and audio packets: many small buffers, so the threads contend on nearly every operation.
+			std::vector<size_t> packets(1000000);
+			for (size_t i = 0; i < packets.size(); i++)
+				packets[i] = 16 + (i * 37) % 200;
+			RunQueueWorkload("small packets", packets, 256, 120);
+
+			// Video at 60fps for a minute, with a keyframe every second.
+			std::vector<size_t> frames(3600);
+			for (size_t i = 0; i < frames.size(); i++)
+				frames[i] = (i % 60 == 0) ? 2 * 1024 * 1024 : 40 * 1024 + (i * 997) % 8192;
+			RunQueueWorkload("video frames", frames, 2 * 1024 * 1024, 16);
+		}
+	}
+}
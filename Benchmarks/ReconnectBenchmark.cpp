@@ -0,0 +1,135 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "TeleportCore/ResourceInventory.h"
+
+using namespace teleport::core;
+
+namespace teleport
+{
+	namespace benchmarks
+	{
+		// A client returning to a large scene, with everything it was sent still cached.
+		static const size_t reconnectResourceCount = 100000;
+		static const size_t reconnectRunCount = 20;
+
+		struct ReconnectTimes
+		{
+			size_t payloadSize = 0;
+			double encodeMs = 0.0;
+			double decodeMs = 0.0;
+			double confirmMs = 0.0;
+		};
+
+		// The ids the server gave out in sequence, with the odd gap where a resource was not sent, in the order the client's
+		// resource managers list them.
+		static std::vector<avs::uid> MakeCachedResourceIDs()
+		{
+			std::mt19937 random(1);
+			std::uniform_int_distribution<int> gap(0, 99);
+			std::vector<avs::uid> ids;
+			avs::uid id = 1000;
+			for (size_t i = 0; i < reconnectResourceCount; i++)
+			{
+				id += gap(random) == 0 ? 40 : 1;
+				ids.push_back(id);
+			}
+			std::shuffle(ids.begin(), ids.end(), random);
+			return ids;
+		}
+
+		static void Keep(ReconnectTimes& best, const ReconnectTimes& run, size_t r)
+		{
+			if (r == 0 || run.encodeMs < best.encodeMs)
+				best.encodeMs = run.encodeMs;
+			if (r == 0 || run.decodeMs < best.decodeMs)
+				best.decodeMs = run.decodeMs;
+			if (r == 0 || run.confirmMs < best.confirmMs)
+				best.confirmMs = run.confirmMs;
+			best.payloadSize = run.payloadSize;
+		}
+
+		// As the handshake was before the inventory: every id appended raw, and the server inserting them one by one into a
+		// table that grows as it goes, and erasing each from the unconfirmed resources.
+		static ReconnectTimes RunRawIDs(const std::vector<avs::uid>& ids)
+		{
+			ReconnectTimes times;
+			Timer timer;
+			std::vector<uint8_t> payload(ids.size() * sizeof(avs::uid));
+			memcpy(payload.data(), ids.data(), payload.size());
+			times.encodeMs = timer.ElapsedMs();
+			times.payloadSize = payload.size();
+
+			timer.Restart();
+			std::vector<avs::uid> received(payload.size() / sizeof(avs::uid));
+			memcpy(received.data(), payload.data(), received.size() * sizeof(avs::uid));
+			times.decodeMs = timer.ElapsedMs();
+
+			timer.Restart();
+			std::unordered_map<avs::uid, bool> sentResources;
+			std::unordered_map<avs::uid, float> unconfirmedResourceTimes;
+			for (avs::uid id : received)
+			{
+				sentResources[id] = true;
+				unconfirmedResourceTimes.erase(id);
+			}
+			times.confirmMs = timer.ElapsedMs();
+			return times;
+		}
+
+		// The inventory, and GeometryStreamingService::confirmResources on a new connection.
+		static ReconnectTimes RunInventory(const std::vector<avs::uid>& ids)
+		{
+			ReconnectTimes times;
+			Timer timer;
+			std::vector<uint8_t> inventory;
+			size_t count = EncodeResourceInventory(ids, inventory);
+			times.encodeMs = timer.ElapsedMs();
+			times.payloadSize = inventory.size();
+
+			timer.Restart();
+			std::vector<avs::uid> received;
+			if (!DecodeResourceInventory(inventory.data(), inventory.size(), count, received))
+				std::cerr << "The inventory of " << count << " resources could not be decoded.\n";
+			times.decodeMs = timer.ElapsedMs();
+
+			timer.Restart();
+			std::unordered_map<avs::uid, bool> sentResources;
+			std::unordered_map<avs::uid, float> unconfirmedResourceTimes;
+			sentResources.reserve(sentResources.size() + received.size());
+			for (avs::uid id : received)
+				sentResources[id] = true;
+			if (!unconfirmedResourceTimes.empty())
+			{
+				for (avs::uid id : received)
+					unconfirmedResourceTimes.erase(id);
+			}
+			times.confirmMs = timer.ElapsedMs();
+			return times;
+		}
+
+		//! Times what a reconnecting client's handshake costs when it holds 100,000 cached resources: the size of the list of
+		//! resources it sends, the client's time to write it, and the server's time to read it and mark them all as sent.
+		//! Compares raw ids with the delta-varint inventory. The best of several runs is shown.
+		void RunReconnectBenchmark()
+		{
+			std::vector<avs::uid> ids = MakeCachedResourceIDs();
+			ReconnectTimes raw, inventory;
+			for (size_t r = 0; r < reconnectRunCount; r++)
+			{
+				Keep(raw, RunRawIDs(ids), r);
+				Keep(inventory, RunInventory(ids), r);
+			}
+			std::cout << reconnectResourceCount << " cached resources:\n";
+			std::cout << "  raw ids:   " << raw.payloadSize << " bytes, written in " << raw.encodeMs << " ms, read in " << raw.decodeMs
+				<< " ms, confirmed in " << raw.confirmMs << " ms\n";
+			std::cout << "  inventory: " << inventory.payloadSize << " bytes, written in " << inventory.encodeMs << " ms, read in " << inventory.decodeMs
+				<< " ms, confirmed in " << inventory.confirmMs << " ms\n";
+		}
+	}
+}
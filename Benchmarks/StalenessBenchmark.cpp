@@ -0,0 +1,134 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "TeleportCore/SequenceNumber.h"
+
+using namespace teleport::core;
+
+namespace teleport
+{
+	namespace benchmarks
+	{
+		// The server sends the state of the scene at 30 Hz for ten minutes.
+		static const double stalenessSendIntervalMs = 1000.0 / 30.0;
+		static const size_t stalenessPacketCount = 30 * 600;
+		// One-way latency, and the most that is added to it at random.
+		static const double stalenessLatencyMs = 40.0;
+		static const double stalenessJitterMs = 20.0;
+		// A reliable channel resends a packet when it hasn't been acknowledged within a round trip and a margin.
+		static const double stalenessResendMs = 2.0 * (stalenessLatencyMs + stalenessJitterMs) + 20.0;
+
+		struct Arrival
+		{
+			double timeMs;
+			uint32_t sequence;
+		};
+
+		struct Staleness
+		{
+			double meanMs = 0.0;
+			double p99Ms = 0.0;
+			double worstMs = 0.0;
+		};
+
+		// How old the newest state applied by the client is, sampled every millisecond, given the times at which each state is applied.
+		static Staleness MeasureStaleness(std::vector<Arrival> applied)
+		{
+			std::sort(applied.begin(), applied.end(), [](const Arrival& a, const Arrival& b)
+				{
+					return a.timeMs < b.timeMs;
+				});
+			std::vector<double> samples;
+			double endMs = stalenessPacketCount * stalenessSendIntervalMs;
+			size_t next = 0;
+			double newestSentMs = -1.0;
+			for (double t = stalenessLatencyMs + stalenessJitterMs; t < endMs; t += 1.0)
+			{
+				while (next < applied.size() && applied[next].timeMs <= t)
+				{
+					newestSentMs = std::max(newestSentMs, applied[next].sequence * stalenessSendIntervalMs);
+					next++;
+				}
+				if (newestSentMs >= 0.0)
+					samples.push_back(t - newestSentMs);
+			}
+			Staleness s;
+			if (samples.empty())
+				return s;
+			for (double v : samples)
+				s.meanMs += v;
+			s.meanMs /= samples.size();
+			std::sort(samples.begin(), samples.end());
+			s.p99Ms = samples[samples.size() * 99 / 100];
+			s.worstMs = samples.back();
+			return s;
+		}
+
+		// Packets arrive independently, in any order, and each is applied only if SequenceWindow finds it newer than the last.
+		static Staleness SimulateLatestState(float lossRate, unsigned seed)
+		{
+			std::mt19937 random(seed);
+			std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+			std::uniform_real_distribution<double> jitter(0.0, stalenessJitterMs);
+			std::vector<Arrival> arrivals;
+			for (uint32_t i = 0; i < stalenessPacketCount; i++)
+			{
+				if (chance(random) < lossRate)
+					continue;
+				arrivals.push_back({i * stalenessSendIntervalMs + stalenessLatencyMs + jitter(random), i});
+			}
+			std::sort(arrivals.begin(), arrivals.end(), [](const Arrival& a, const Arrival& b)
+				{
+					return a.timeMs < b.timeMs;
+				});
+			SequenceWindow window;
+			std::vector<Arrival> applied;
+			for (const Arrival& a : arrivals)
+			{
+				if (window.receive(a.sequence))
+					applied.push_back(a);
+			}
+			return MeasureStaleness(applied);
+		}
+
+		// Every packet is resent until it arrives, and each is only delivered once all those before it have been.
+		static Staleness SimulateReliable(float lossRate, unsigned seed)
+		{
+			std::mt19937 random(seed);
+			std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+			std::uniform_real_distribution<double> jitter(0.0, stalenessJitterMs);
+			std::vector<Arrival> applied;
+			double deliveredMs = 0.0;
+			for (uint32_t i = 0; i < stalenessPacketCount; i++)
+			{
+				double sentMs = i * stalenessSendIntervalMs;
+				while (chance(random) < lossRate)
+					sentMs += stalenessResendMs;
+				double arrivalMs = sentMs + stalenessLatencyMs + jitter(random);
+				deliveredMs = std::max(deliveredMs, arrivalMs);
+				applied.push_back({deliveredMs, i});
+			}
+			return MeasureStaleness(applied);
+		}
+
+		//! Simulates sending the latest state of the scene over a lossy link, and compares how stale the client's copy gets with
+		//! a reliable, ordered channel, where a lost packet holds up the ones after it until it is resent, and with the
+		//! unreliable latest-state channel, where the next packet simply replaces it.
+		void RunStalenessBenchmark()
+		{
+			std::cout << "30 Hz, " << stalenessLatencyMs << "-" << stalenessLatencyMs + stalenessJitterMs << " ms one way, resent after " << stalenessResendMs << " ms:\n";
+			const float lossRates[] = { 0.0f, 0.01f, 0.05f, 0.1f };
+			for (float loss : lossRates)
+			{
+				Staleness reliable = SimulateReliable(loss, 1);
+				Staleness latest = SimulateLatestState(loss, 1);
+				std::cout << "  " << loss * 100.0f << "% loss:\n";
+				std::cout << "    reliable:     mean " << reliable.meanMs << " ms, 99% " << reliable.p99Ms << " ms, worst " << reliable.worstMs << " ms\n";
+				std::cout << "    latest state: mean " << latest.meanMs << " ms, 99% " << latest.p99Ms << " ms, worst " << latest.worstMs << " ms\n";
+			}
+		}
+	}
+}
@@ -0,0 +1,115 @@
+#include "Benchmark.h"
+
+#include <array>
+#include <random>
+#include <vector>
+
+#include "libavstream/src/util/startcode.hpp"
+
+namespace teleport
+{
+	namespace benchmarks
+	{
+		// The three-byte shift register that StreamParserAVC::parse() fed every byte through before it used findStartCode().
+		struct ByteAccumulator
+		{
+			inline bool push(uint8_t byte)
+			{
+				m_buffer[0] = m_buffer[1];
+				m_buffer[1] = m_buffer[2];
+				m_buffer[2] = byte;
+				return m_buffer[0] == 0 && m_buffer[1] == 0 && m_buffer[2] == 1;
+			}
+			std::array<uint8_t, 3> m_buffer = { 0xFF, 0xFF, 0xFF };
+		};
+
+		// An Annex B stream of NAL units whose sizes are drawn between minSize and maxSize.
+		// The payloads are random, like entropy-coded slices, with the emulation-prevention an encoder would add.
+		static std::vector<uint8_t> MakeStream(size_t totalSize, size_t minSize, size_t maxSize, size_t& nalCount)
+		{
+			std::mt19937 random((unsigned)(minSize * 31 + maxSize));
+			std::uniform_int_distribution<size_t> nalSize(minSize, maxSize);
+			std::uniform_int_distribution<int> byte(0, 255);
+			std::vector<uint8_t> stream;
+			stream.reserve(totalSize + maxSize + 4);
+			nalCount = 0;
+			while (stream.size() < totalSize)
+			{
+				stream.insert(stream.end(), { 0, 0, 0, 1 });
+				nalCount++;
+				size_t size = nalSize(random);
+				for (size_t i = 0; i < size; i++)
+				{
+					uint8_t b = (uint8_t)byte(random);
+					size_t n = stream.size();
+					if (b <= 3 && n >= 2 && stream[n - 1] == 0 && stream[n - 2] == 0)
+						stream.push_back(3);
+					stream.push_back(b);
+				}
+			}
+			return stream;
+		}
+
+		static size_t CountWithAccumulator(const std::vector<uint8_t>& stream)
+		{
+			ByteAccumulator accumulator;
+			size_t count = 0;
+			for (uint8_t b : stream)
+			{
+				if (accumulator.push(b))
+					count++;
+			}
+			return count;
+		}
+
+		static size_t CountWithScanner(const std::vector<uint8_t>& stream)
+		{
+			size_t count = 0;
+			size_t i = avs::findStartCode(stream.data(), 0, stream.size());
+			while (i < stream.size())
+			{
+				count++;
+				i = avs::findStartCode(stream.data(), i + 1, stream.size());
+			}
+			return count;
+		}
+
+		static double GBPerSecond(size_t bytes, size_t repeats, double ms)
+		{
+			return ms > 0.0 ? double(bytes) * double(repeats) / (ms / 1000.0) / 1.0e9 : 0.0;
+		}
+
+		static void RunStartCodeWorkload(const char* name, size_t minSize, size_t maxSize)
+		{
+			const size_t streamSize = 64 * 1024 * 1024;
+			const size_t repeats = 4;
+			size_t nalCount = 0;
+			std::vector<uint8_t> stream = MakeStream(streamSize, minSize, maxSize, nalCount);
+
+			size_t accumulatorCount = 0, scannerCount = 0;
+			Timer timer;
+			for (size_t r = 0; r < repeats; r++)
+				accumulatorCount += CountWithAccumulator(stream);
+			double accumulatorMs = timer.ElapsedMs();
+			timer.Restart();
+			for (size_t r = 0; r < repeats; r++)
+				scannerCount += CountWithScanner(stream);
+			double scannerMs = timer.ElapsedMs();
+
+			std::cout << name << ": " << stream.size() / (1024 * 1024) << " MB, " << nalCount << " NAL units\n";
+			std::cout << "  byte accumulator: " << GBPerSecond(stream.size(), repeats, accumulatorMs) << " GB/s\n";
+			std::cout << "  findStartCode:    " << GBPerSecond(stream.size(), repeats, scannerMs) << " GB/s\n";
+			if (accumulatorCount != scannerCount)
+				std::cout << "  (counts differ: " << accumulatorCount / repeats << " and " << scannerCount / repeats << ")\n";
+		}
+
+		//! Compares the byte-at-a-time start-code search that StreamParserAVC used with avs::findStartCode(), on synthetic
+		//! Annex B streams. Video slices are large, so most of the scan is through payload; parameter sets and small
+		//! slices make the start codes dense, which is where stopping at each one costs most.
+		void RunStartCodeBenchmark()
+		{
+			RunStartCodeWorkload("video slices", 4 * 1024, 64 * 1024);
+			RunStartCodeWorkload("small NAL units", 16, 256);
+		}
+	}
+}
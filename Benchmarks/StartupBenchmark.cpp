@@ -0,0 +1,160 @@
+#include "Benchmark.h"
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+
+#include "TeleportServer/ResourcePack.h"
+#if TELEPORT_BENCHMARKS_SERVER
+#include "TeleportServer/ExtractedTypes.h"
+#include "TeleportServer/GeometryStore.h"
+#endif
+
+using namespace teleport::server;
+
+namespace teleport
+{
+	namespace benchmarks
+	{
+		// About the size of a large project's geometry cache.
+		static const size_t startupResourceCount = 40000;
+		static const size_t startupResourceSize = 2048;
+
+		static std::string MakeRecord(size_t r)
+		{
+			std::string record(startupResourceSize, ' ');
+			for (size_t i = 0; i < record.size(); i++)
+				record[i] = (char)('a' + (i * 7 + r) % 26);
+			return record;
+		}
+
+#if TELEPORT_BENCHMARKS_SERVER
+		static const size_t startupMaterialCount = 20000;
+
+		// Loads the cache in the folder into a new store, as the server does on starting, and returns the time it took.
+		static double LoadCache(const std::filesystem::path& folder, size_t& loadedCount)
+		{
+			GeometryStore store;
+			store.SetCachePath(folder.string().c_str());
+			size_t numMeshes = 0, numTextures = 0, numMaterials = 0;
+			LoadedResource *loadedMeshes = nullptr, *loadedTextures = nullptr, *loadedMaterials = nullptr;
+			Timer timer;
+			store.loadFromDisk(numMeshes, loadedMeshes, numTextures, loadedTextures, numMaterials, loadedMaterials);
+			double ms = timer.ElapsedMs();
+			delete[] loadedMeshes;
+			delete[] loadedTextures;
+			delete[] loadedMaterials;
+			loadedCount = numMaterials;
+			return ms;
+		}
+
+		// The server's own startup: GeometryStore::loadFromDisk parsing every material into the store, from the resource packs
+		// by loadPack, and from a cache saved before packs were used, of one file per resource, by loadResources.
+		// The per-file cache is made from the pack's records, which are the bytes each file would hold, so both load the same assets.
+		static void RunGeometryStoreStartup(const std::filesystem::path& folder)
+		{
+			std::filesystem::path packFolder = folder / "packed";
+			std::filesystem::path filesFolder = folder / "files";
+			std::filesystem::create_directories(packFolder);
+			{
+				GeometryStore store;
+				store.SetCachePath(packFolder.string().c_str());
+				for (size_t m = 0; m < startupMaterialCount; m++)
+				{
+					avs::Material material;
+					material.name = "material_" + std::to_string(m);
+					material.materialMode = avs::MaterialMode::OPAQUE_MATERIAL;
+					material.emissiveFactor = {(float)(m % 7) / 7.0f, 0.0f, 0.0f};
+					store.storeMaterial(avs::uid(0x1000 + m), std::to_string(m), "materials/" + material.name, 0, material);
+				}
+				if (!store.saveToDisk())
+				{
+					std::cerr << "The resource packs could not be saved.\n";
+					return;
+				}
+			}
+			{
+				ResourcePack pack;
+				if (!pack.open((packFolder / "materials.pack").string()))
+				{
+					std::cerr << "The materials pack could not be opened.\n";
+					return;
+				}
+				for (const auto& r : pack.getRecords())
+				{
+					std::filesystem::path filename = filesFolder / (r.first + ExtractedMaterial::fileExtension());
+					std::filesystem::create_directories(filename.parent_path());
+					std::ofstream file(filename, std::ios::binary);
+					file.write((const char*)pack.getRecordData(r.second), (std::streamsize)r.second.size);
+				}
+			}
+
+			size_t filesCount = 0, packCount = 0;
+			double filesMs = LoadCache(filesFolder, filesCount);
+			double packMs = LoadCache(packFolder, packCount);
+			std::cout << startupMaterialCount << " materials, loaded into the geometry store:\n";
+			std::cout << "  loadResources, one file each: " << filesMs << " ms (" << filesCount << " loaded)\n";
+			std::cout << "  loadPack, resource pack:      " << packMs << " ms (" << packCount << " loaded)\n";
+		}
+#endif
+
+		//! Compares reading a server's geometry cache from one file per resource with reading it from a resource pack.
+		//! The first part times only the file reads: both copy every record into memory, unparsed.
+		//! With the server, the second part times the store's own loaders, GeometryStore::loadResources and GeometryStore::loadPack,
+		//! parsing the same assets into the store.
+		//! The files were just written, so are likely in the OS's file cache: on a cold start, the per-file loader's many
+		//! opens and reads cost more, not less.
+		void RunStartupBenchmark()
+		{
+			std::filesystem::path folder = std::filesystem::temp_directory_path() / "teleport_startup_benchmark";
+			std::error_code ec;
+			std::filesystem::remove_all(folder, ec);
+			std::filesystem::create_directories(folder / "files");
+
+			std::map<std::string, std::string> records;
+			for (size_t r = 0; r < startupResourceCount; r++)
+			{
+				std::string name = "resource_" + std::to_string(r);
+				records[name] = MakeRecord(r);
+				std::ofstream file(folder / "files" / (name + ".mesh"), std::ios::binary);
+				file.write(records[name].data(), records[name].size());
+			}
+			std::string packFilename = (folder / "meshes.pack").string();
+			ResourcePack::Update(packFilename, records);
+			records.clear();
+
+			Timer timer;
+			size_t fileBytes = 0;
+			for (const auto& entry : std::filesystem::recursive_directory_iterator(folder / "files"))
+			{
+				std::ifstream file(entry.path(), std::ios::binary);
+				std::string record((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+				fileBytes += record.size();
+			}
+			double filesMs = timer.ElapsedMs();
+
+			timer.Restart();
+			size_t packBytes = 0;
+			{
+				ResourcePack pack;
+				pack.open(packFilename);
+				for (const auto& r : pack.getRecords())
+				{
+					std::string record((const char*)pack.getRecordData(r.second), (size_t)r.second.size);
+					packBytes += record.size();
+				}
+			}
+			double packMs = timer.ElapsedMs();
+
+			std::cout << startupResourceCount << " resources of " << startupResourceSize << " bytes, read but not parsed:\n";
+			std::cout << "  one file each: " << filesMs << " ms (" << fileBytes / (1024 * 1024) << " MB)\n";
+			std::cout << "  resource pack: " << packMs << " ms (" << packBytes / (1024 * 1024) << " MB)\n";
+#if TELEPORT_BENCHMARKS_SERVER
+			RunGeometryStoreStartup(folder / "store");
+#endif
+
+			std::filesystem::remove_all(folder, ec);
+		}
+	}
+}
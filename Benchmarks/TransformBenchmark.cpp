@@ -0,0 +1,102 @@
+#include "Benchmark.h"
+
+#include <memory>
+#include <vector>
+
+#include "ClientRender/Node.h"
+#include "ClientRender/TransformHierarchy.h"
+
+using namespace clientrender;
+
+namespace teleport
+{
+	namespace benchmarks
+	{
+		// Each root has three children, each of which has four of its own: sixteen nodes, as in a small prop or a vehicle.
+		static const size_t transformSubtreeSize = 16;
+		static const size_t transformFrameCount = 100;
+		// One node in this many moves each frame.
+		static const size_t transformMovingInterval = 10;
+
+		static std::shared_ptr<Node> MakeChild(const std::shared_ptr<Node>& parent, avs::uid id, std::vector<std::shared_ptr<Node>>& all)
+		{
+			std::shared_ptr<Node> child = std::make_shared<Node>(id, "child");
+			child->SetLocalPosition(avs::vec3(0.1f * (id % 7), 0.2f, 0.0f));
+			child->SetParent(parent);
+			parent->AddChild(child);
+			all.push_back(child);
+			return child;
+		}
+
+		// Roots of subtrees making up nodeCount nodes in total, every one of which is also listed in all.
+		static std::vector<std::shared_ptr<Node>> MakeForest(size_t nodeCount, std::vector<std::shared_ptr<Node>>& all)
+		{
+			std::vector<std::shared_ptr<Node>> roots;
+			avs::uid id = 1;
+			while (all.size() + transformSubtreeSize <= nodeCount)
+			{
+				std::shared_ptr<Node> root = std::make_shared<Node>(id++, "root");
+				root->SetLocalPosition(avs::vec3(float(roots.size()), 0.0f, 0.0f));
+				all.push_back(root);
+				roots.push_back(root);
+				for (size_t c = 0; c < 3; c++)
+				{
+					std::shared_ptr<Node> child = MakeChild(root, id++, all);
+					for (size_t g = 0; g < 4; g++)
+						MakeChild(child, id++, all);
+				}
+			}
+			return roots;
+		}
+
+		static void MoveNodes(const std::vector<std::shared_ptr<Node>>& all, size_t frame)
+		{
+			for (size_t i = frame % transformMovingInterval; i < all.size(); i += transformMovingInterval)
+				all[i]->SetLocalPosition(avs::vec3(0.01f * frame, 0.2f, 0.0f));
+		}
+
+		//! Times updating the global transforms of a scene where a tenth of the nodes move each frame: as nodes did on their
+		//! own, each marking its descendants dirty and recalculating when read, and with a TransformHierarchy.
+		void RunTransformBenchmark()
+		{
+			const size_t counts[] = { 1000, 10000, 100000 };
+			for (size_t count : counts)
+			{
+				// Stops the reads from being optimised away.
+				float sum = 0.0f;
+
+				std::vector<std::shared_ptr<Node>> lazyNodes;
+				MakeForest(count, lazyNodes);
+				Timer timer;
+				for (size_t f = 0; f < transformFrameCount; f++)
+				{
+					MoveNodes(lazyNodes, f);
+					for (const std::shared_ptr<Node>& node : lazyNodes)
+						sum += node->GetGlobalTransform().m_Translation.x;
+				}
+				double lazyMs = timer.ElapsedMs() / double(transformFrameCount);
+
+				std::vector<std::shared_ptr<Node>> hierarchyNodes;
+				std::vector<std::shared_ptr<Node>> roots = MakeForest(count, hierarchyNodes);
+				TransformHierarchy hierarchy;
+				hierarchy.Rebuild(roots);
+				hierarchy.UpdateTransforms();
+				timer.Restart();
+				for (size_t f = 0; f < transformFrameCount; f++)
+				{
+					MoveNodes(hierarchyNodes, f);
+					hierarchy.UpdateTransforms();
+					for (const std::shared_ptr<Node>& node : hierarchyNodes)
+						sum += node->GetGlobalTransform().m_Translation.x;
+				}
+				double hierarchyMs = timer.ElapsedMs() / double(transformFrameCount);
+
+				std::cout << lazyNodes.size() << " nodes:\n";
+				std::cout << "  per node, when read:  " << lazyMs << " ms per frame\n";
+				std::cout << "  transform hierarchy:  " << hierarchyMs << " ms per frame\n";
+				if (sum == 0.0f)
+					std::cout << "  (no movement)\n";
+			}
+		}
+	}
+}
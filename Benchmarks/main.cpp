@@ -0,0 +1,87 @@
+#include "Benchmark.h"
+
+#include <cstring>
+
+namespace teleport
+{
+	namespace benchmarks
+	{
+		void RunFlatResourceMapBenchmark();
+		void RunStartupBenchmark();
+		void RunQueueBenchmark();
+		void RunStartCodeBenchmark();
+		void RunMovementBenchmark();
+		void RunStalenessBenchmark();
+		void RunReconnectBenchmark();
+#if TELEPORT_BENCHMARKS_CLIENT
+		void RunJoinBenchmark();
+		void RunAnimationBenchmark();
+		void RunNALParseBenchmark();
+		void RunTransformBenchmark();
+		void RunDistanceSortBenchmark();
+#endif
+#if TELEPORT_BENCHMARKS_SERVER
+		void RunEncodeBenchmark();
+#endif
+	}
+}
+
+using namespace teleport::benchmarks;
+
+namespace
+{
+	struct NamedBenchmark
+	{
+		const char* name;
+		void (*run)();
+	};
+	const NamedBenchmark benchmarks[] = {
+		{"flatresourcemap", RunFlatResourceMapBenchmark},
+		{"startup", RunStartupBenchmark},
+		{"queue", RunQueueBenchmark},
+		{"startcode", RunStartCodeBenchmark},
+		{"movement", RunMovementBenchmark},
+		{"staleness", RunStalenessBenchmark},
+		{"reconnect", RunReconnectBenchmark},
+#if TELEPORT_BENCHMARKS_CLIENT
+		{"join", RunJoinBenchmark},
+		{"animation", RunAnimationBenchmark},
+		{"nalparse", RunNALParseBenchmark},
+		{"transform", RunTransformBenchmark},
+		{"distancesort", RunDistanceSortBenchmark},
+#endif
+#if TELEPORT_BENCHMARKS_SERVER
+		{"encode", RunEncodeBenchmark},
+#endif
+	};
+}
+
+//! Runs every benchmark, or only those named on the command line.
+int main(int argc, char** argv)
+{
+	int unknown = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		bool found = false;
+		for (const NamedBenchmark& b : benchmarks)
+			found |= strcmp(argv[i], b.name) == 0;
+		if (!found)
+		{
+			std::cerr << "Unknown benchmark " << argv[i] << ".\n";
+			unknown++;
+		}
+	}
+	if (unknown)
+		return 1;
+	for (const NamedBenchmark& b : benchmarks)
+	{
+		bool selected = argc == 1;
+		for (int i = 1; i < argc; i++)
+			selected |= strcmp(argv[i], b.name) == 0;
+		if (!selected)
+			continue;
+		std::cout << "== " << b.name << " ==\n";
+		b.run();
+	}
+	return 0;
+}
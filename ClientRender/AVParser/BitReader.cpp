@@ -2,9 +2,29 @@
 
 #include "BitReader.h"
 
+#include <algorithm>
 #include <climits>
 #include <cassert>
+#include <cstring>
 #include "TeleportCore/ErrorHandling.h"
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	// x must not be zero.
+	inline uint32_t CountLeadingZeros(uint64_t x)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanReverse64(&index, x);
+		return 63 - (uint32_t)index;
+#else
+		return (uint32_t)__builtin_clzll(x);
+#endif
+	}
+}
 
 BitReader::BitReader(const uint8_t* data, size_t size) 
 {
@@ -15,109 +35,133 @@ void BitReader::start(const uint8_t* data, size_t size)
 {
 	mData = data;
 	mSize = size;
-	mByteIndex = 0;
-	mBitIndex = mBitStartIndex;
+	mDataIndex = 0;
+	mZeroCount = 0;
+	mRbsp.clear();
+	mEmulationPrevention.clear();
+	mRbspIndex = 0;
+	mCache = 0;
+	mCacheBits = 0;
+	mOverrun = false;
+	refill();
 }
 
-bool BitReader::getBit()
+void BitReader::unescape(size_t count)
 {
-	if (mByteIndex >= mSize)
+	size_t target = mRbsp.size() + count;
+	while (mRbsp.size() < target && mDataIndex < mSize)
 	{
-		TELEPORT_CERR << "Not enough data" << std::endl;
-		return false;
+		uint8_t b = mData[mDataIndex];
+		if (mZeroCount >= 2 && b == 3)
+		{
+			mEmulationPrevention.push_back(mRbsp.size());
+			mZeroCount = 0;
+			mDataIndex++;
+			continue;
+		}
+		if (b == 0)
+		{
+			mZeroCount++;
+			mRbsp.push_back(0);
+			mDataIndex++;
+			continue;
+		}
+		// Only a byte after two zeros can be an emulation-prevention byte, so copy up to the next zero in one go.
+		size_t end = std::min(mSize, mDataIndex + (target - mRbsp.size()));
+		const uint8_t* zero = (const uint8_t*)memchr(mData + mDataIndex, 0, end - mDataIndex);
+		size_t runEnd = zero ? size_t(zero - mData) : end;
+		mRbsp.insert(mRbsp.end(), mData + mDataIndex, mData + runEnd);
+		mDataIndex = runEnd;
+		mZeroCount = 0;
 	}
+}
 
-	bool res = mData[mByteIndex] & (1 << mBitIndex);
-
-	mBitIndex--;
-
-	// The unsigned value of mBitIndex will become UINT32_MAX if it goes below 0.
-	if (mBitIndex > mBitStartIndex)
+// Every read ends with a refill, so between reads the cache holds at least 57 bits unless the data is running out.
+void BitReader::refill()
+{
+	while (mCacheBits <= 56)
 	{
-		mBitIndex = mBitStartIndex;
-		mByteIndex++;
-
-		if (mByteIndex >= 2)
+		if (mRbspIndex >= mRbsp.size())
 		{
-			if (mData[mByteIndex - 2] == 0 && mData[mByteIndex - 1] == 0 && mData[mByteIndex] == 3)
+			unescape(mUnescapeChunk);
+			if (mRbspIndex >= mRbsp.size())
 			{
-				mByteIndex++;
+				return;
 			}
 		}
+		mCache |= uint64_t(mRbsp[mRbspIndex++]) << (56 - mCacheBits);
+		mCacheBits += 8;
 	}
+}
 
-	return res;
+bool BitReader::getBit()
+{
+	return getBits(1) != 0;
 }
 
 
 uint32_t BitReader::getBits(size_t count)
 {
-	uint32_t result = 0;
-	for (size_t i = 0; i < count; i++)
+	if (count == 0)
+	{
+		return 0;
+	}
+	if (count > 32)
 	{
-		if (getBit())
+		skipBits(count - 32);
+		count = 32;
+	}
+	if (mCacheBits < count)
+	{
+		refill();
+	}
+	if (mCacheBits < count)
+	{
+		// Missing bits read as zero.
+		if (!mOverrun)
 		{
-			result |= 1 << (count - i - 1);
+			TELEPORT_CERR << "Not enough data" << std::endl;
 		}
+		mOverrun = true;
 	}
 
+	uint32_t result = uint32_t(mCache >> (64 - count));
+	mCache <<= count;
+	mCacheBits -= std::min(uint32_t(count), mCacheBits);
+	refill();
+
 	return result;
 }
 
 
 void BitReader::skipBits(size_t count)
 {
-	if (mByteIndex >= 2)
-	{
-		if (mData[mByteIndex - 2] == 0 && mData[mByteIndex - 1] == 0 && mData[mByteIndex] == 3)
-		{
-			mByteIndex++;
-		}
-	}
-
-	uint32_t bytesToSkip = uint32_t(count)/ 8;
-
-
-	while (bytesToSkip)
-	{
-		bytesToSkip--;
-		mByteIndex++;
-		if (mByteIndex >= 2)
-		{
-			if (mData[mByteIndex - 2] == 0 && mData[mByteIndex - 1] == 0 && mData[mByteIndex] == 3)
-			{
-				mByteIndex++;
-			}
-		}
-	}
-
-	if (mBitIndex > count % 8)
-	{
-		mBitIndex -= count % 8;
-	}
-	else
+	while (count > 32)
 	{
-		mByteIndex++;
-		mBitIndex = mBitIndex - (count % 8) + 8;
+		getBits(32);
+		count -= 32;
 	}
-
+	getBits(count);
 }
 
 uint32_t BitReader::getGolombU()
 {
-	long zeroBitCount = -1;
+	uint32_t zeroBitCount = mCache ? CountLeadingZeros(mCache) : 64;
 
-	for (long bit = 0; !bit; zeroBitCount++)
-	{
-		bit = getBit();
-	}
-
-	if (zeroBitCount >= 32)
+	if (zeroBitCount >= 32 || zeroBitCount >= mCacheBits)
 	{
+		// Not a valid code, or the data runs out: skip the zeros as far as the next one bit.
+		while (!getBit() && !mOverrun)
+		{
+		}
 		return 0;
 	}
 
-	return (1 << zeroBitCount) - 1 + getBits(zeroBitCount);
+	mCache <<= zeroBitCount;
+	mCacheBits -= zeroBitCount;
+
+	// The one bit and the zeroBitCount bits after it make the value plus one.
+	return getBits(zeroBitCount + 1) - 1;
 }
 
 
@@ -138,18 +182,31 @@ int32_t BitReader::getGolombS()
 	return buffer;
 }
 
+size_t BitReader::escapedIndex(size_t rbspIndex) const
+{
+	// The emulation-prevention bytes before this byte were all found when it was unescaped.
+	size_t skipped = std::upper_bound(mEmulationPrevention.begin(), mEmulationPrevention.end(), rbspIndex) - mEmulationPrevention.begin();
+	return rbspIndex + skipped;
+}
+
+size_t BitReader::getByteIndex() const
+{
+	return escapedIndex(getBitsRead() / 8);
+}
+
 size_t BitReader::getBytesRead() const
 {
-	if (mBitIndex == mBitStartIndex)
+	size_t bitsRead = getBitsRead();
+	if (bitsRead % 8 == 0)
 	{
-		return mByteIndex;
+		return escapedIndex(bitsRead / 8);
 	}
-	return mByteIndex + 1;
+	return escapedIndex(bitsRead / 8) + 1;
 }
 
-size_t BitReader::getBitsRemaining() const
+size_t BitReader::getBitsRemaining()
 {
-	size_t numBytesRemaining = (mSize - mByteIndex) - 1;
-	return (numBytesRemaining * 8) + mBitIndex + 1;
+	unescape(mSize - mDataIndex);
+	return (mRbsp.size() - mRbspIndex) * 8 + mCacheBits;
 }
 
@@ -2,8 +2,13 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <vector>
 
+//! Reads bits from a NAL unit, skipping its emulation-prevention bytes.
+//! The NAL is unescaped into a scratch buffer a chunk at a time, as far as it has been read, and bits are taken
+//! from a 64-bit cache filled from that buffer, so most reads are a shift rather than a loop over bits.
 class BitReader
 {
 public:
@@ -15,20 +20,42 @@ public:
   uint32_t getGolombU();
   int32_t getGolombS();
 
-  // Return all bytes that have been fully or partially read.
+  // Return all bytes that have been fully or partially read, in the escaped data.
   size_t getBytesRead() const;
 
-  size_t getByteIndex() const { return mByteIndex; }
+  // The index in the escaped data of the byte being read.
+  size_t getByteIndex() const;
 
   size_t getSize() const { return mSize; }
 
-  size_t getBitsRemaining() const;
+  // The number of bits that have been read, not counting emulation-prevention bytes.
+  size_t getBitsRead() const { return mRbspIndex * 8 - mCacheBits; }
+
+  // This unescapes the rest of the NAL to count its bits.
+  size_t getBitsRemaining();
 
 private:
+  // Unescape at least this many more bytes into mRbsp, if there are that many.
+  void unescape(size_t count);
+  void refill();
+  size_t escapedIndex(size_t rbspIndex) const;
+
   const uint8_t* mData;
   size_t mSize;
-  size_t mByteIndex;
-  uint32_t mBitIndex;
-
-  static constexpr uint32_t mBitStartIndex = 7;
+  // The next byte of mData to unescape, and the number of zero bytes just before it.
+  size_t mDataIndex;
+  uint32_t mZeroCount;
+
+  // The unescaped bytes so far, and the index in them of each emulation-prevention byte that was removed.
+  std::vector<uint8_t> mRbsp;
+  std::vector<size_t> mEmulationPrevention;
+  // The next byte of mRbsp to go into the cache.
+  size_t mRbspIndex;
+
+  // Unread bits, most significant first. Bits past mCacheBits are zero.
+  uint64_t mCache;
+  uint32_t mCacheBits;
+  bool mOverrun;
+
+  static constexpr size_t mUnescapeChunk = 64;
 };
@@ -1015,7 +1015,7 @@ namespace avparser
 
 					slice.short_term_ref_pic_set_sps_flag = mReader->getBits(1);
 
-					size_t remainingBits = mReader->getBitsRemaining();
+					size_t bitsRead = mReader->getBitsRead();
 
 					mExtraData.numDeltaPocsOfRefRpsIdx = 0;
 
@@ -1044,7 +1044,7 @@ namespace avparser
 						mExtraData.refRpsIdx = mExtraData.stRpsIdx;
 					}
 
-					mExtraData.short_term_ref_pic_set_size = uint32_t(remainingBits - mReader->getBitsRemaining());
+					mExtraData.short_term_ref_pic_set_size = uint32_t(mReader->getBitsRead() - bitsRead);
 
 					// Long term reference frames may not be enabled. This is an option that can be enabled in the video encoder.
 					if (mSPS.long_term_ref_pics_present_flag)
@@ -1,148 +1,255 @@
 #include "Animation.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "Bone.h"
 
 namespace clientrender
 {
-	BoneKeyframeList::BoneKeyframeList()
-	{}
-
-	void BoneKeyframeList::seekTime(std::shared_ptr<Bone> bone, float time) const
+	namespace
 	{
-		if(!bone)
+		// Working space for sampling, one per thread, as an Animation may be sampled from several threads at once.
+		struct SampleBuffers
 		{
-			return;
-		}
-
-		Transform transform = bone->GetLocalTransform();
-		setPositionToTime(time, transform.m_Translation, positionKeyframes);
-		setRotationToTime(time, transform.m_Rotation, rotationKeyframes);
+			std::vector<float> positionBlend;
+			std::vector<float> position0[3], position1[3];
+			std::vector<float> rotationBlend;
+			std::vector<float> rotation0[4], rotation1[4];
 
-		transform.UpdateModelMatrix();
-		bone->SetLocalTransform(transform);
-	}
+			void Resize(size_t count)
+			{
+				positionBlend.resize(count);
+				rotationBlend.resize(count);
+				for(int c = 0; c < 3; c++)
+				{
+					position0[c].resize(count);
+					position1[c].resize(count);
+				}
+				for(int c = 0; c < 4; c++)
+				{
+					rotation0[c].resize(count);
+					rotation1[c].resize(count);
+				}
+			}
+		};
+		thread_local SampleBuffers sampleBuffers;
 
-	void BoneKeyframeList::setPositionToTime(float time, avs::vec3& bonePosition, const std::vector<avs::Vector3Keyframe>& keyframes) const
-	{
-		if(keyframes.size() == 0)
-		{
-			return;
-		}
+		// Beyond this many keyframes on from the cursor, search instead of stepping.
+		constexpr uint32_t maxKeyframeSteps = 4;
 
-		if(keyframes.size() == 1)
+		float GetTimeBlend(const float* times, uint32_t from, uint32_t to, float time)
 		{
-			bonePosition = keyframes[0].value;
-			return;
+			if(to == from)
+				return 0.0f;
+			float t = (time - times[from]) / (times[to] - times[from]);
+			return std::max(0.0f, std::min(t, 1.0f));
 		}
+	}
 
-		size_t nextKeyframeIndex = getNextKeyframeIndex(time, keyframes);
-		const avs::Vector3Keyframe& previousKeyframe = (nextKeyframeIndex == 0 ? keyframes[nextKeyframeIndex] : keyframes[nextKeyframeIndex - 1]);
-		const avs::Vector3Keyframe& nextKeyframe = keyframes[nextKeyframeIndex];
+	BoneKeyframeList::BoneKeyframeList()
+	{}
 
-		//Linear interpolation between previous keyframe and next keyframe.
-		float timeBlend = getTimeBlend(time, previousKeyframe.time, nextKeyframe.time);
-		bonePosition = (1.0f - timeBlend) * previousKeyframe.value + timeBlend * nextKeyframe.value;
-	}
+	Animation::Animation(const std::string& name)
+		:name(name)
+	{}
 
-	void BoneKeyframeList::setRotationToTime(float time, quat& boneRotation, const std::vector<avs::Vector4Keyframe>& keyframes) const
+	Animation::Animation(const std::string& name, const std::vector<BoneKeyframeList>& bk)
+		: name(name)
 	{
-		if(keyframes.size() == 0)
+		size_t positionCount = 0;
+		size_t rotationCount = 0;
+		for(const BoneKeyframeList& boneKeyframeList : bk)
 		{
-			return;
+			positionCount += boneKeyframeList.positionKeyframes.size();
+			rotationCount += boneKeyframeList.rotationKeyframes.size();
 		}
-
-		if(keyframes.size() == 1)
+		trackBoneIndices.reserve(bk.size());
+		positionRanges.reserve(bk.size());
+		rotationRanges.reserve(bk.size());
+		positionTimes.reserve(positionCount);
+		rotationTimes.reserve(rotationCount);
+		for(int c = 0; c < 3; c++)
+			positionValues[c].reserve(positionCount);
+		for(int c = 0; c < 4; c++)
+			rotationValues[c].reserve(rotationCount);
+
+		for(const BoneKeyframeList& boneKeyframeList : bk)
 		{
-			boneRotation = keyframes[0].value;
-			return;
-		}
-
-		size_t nextKeyframeIndex = getNextKeyframeIndex(time, keyframes);
-		const avs::Vector4Keyframe& previousKeyframe = (nextKeyframeIndex == 0 ? keyframes[nextKeyframeIndex] : keyframes[nextKeyframeIndex - 1]);
-		const avs::Vector4Keyframe& nextKeyframe = keyframes[nextKeyframeIndex];
-
-		//Linear interpolation between previous keyframe and next keyframe.
-		float timeBlend = getTimeBlend(time, previousKeyframe.time, nextKeyframe.time);
-		vec4 &previousValue=*((vec4*)&previousKeyframe.value);
-		vec4 &nextValue=*((vec4*)&nextKeyframe.value);
-		boneRotation = (1.0f - timeBlend) * previousValue + timeBlend * nextValue;
-		//boneRotation = quat::Slerp(previousKeyframe.value, nextKeyframe.value, timeBlend);
-	}
-
-	size_t BoneKeyframeList::getNextKeyframeIndex(float time, const std::vector<avs::Vector3Keyframe>& keyframes) const
-	{
-		for(size_t i = 1; i < keyframes.size(); i++)
-		{
-			if(keyframes[i].time >= time)
+			trackBoneIndices.push_back(boneKeyframeList.boneIndex);
+			positionRanges.push_back({(uint32_t)positionTimes.size(), (uint32_t)boneKeyframeList.positionKeyframes.size()});
+			for(const avs::Vector3Keyframe& keyframe : boneKeyframeList.positionKeyframes)
+			{
+				positionTimes.push_back(keyframe.time);
+				positionValues[0].push_back(keyframe.value.x);
+				positionValues[1].push_back(keyframe.value.y);
+				positionValues[2].push_back(keyframe.value.z);
+			}
+			rotationRanges.push_back({(uint32_t)rotationTimes.size(), (uint32_t)boneKeyframeList.rotationKeyframes.size()});
+			for(const avs::Vector4Keyframe& keyframe : boneKeyframeList.rotationKeyframes)
 			{
-				return i;
+				rotationTimes.push_back(keyframe.time);
+				rotationValues[0].push_back(keyframe.value.x);
+				rotationValues[1].push_back(keyframe.value.y);
+				rotationValues[2].push_back(keyframe.value.z);
+				rotationValues[3].push_back(keyframe.value.w);
 			}
 		}
-
-		return keyframes.size() - 1;
+		updateAnimationLength();
 	}
 
-	size_t BoneKeyframeList::getNextKeyframeIndex(float time, const std::vector<avs::Vector4Keyframe>& keyframes) const
+	//Retrieve end time from latest time in any track.
+	void Animation::updateAnimationLength()
 	{
-		for(size_t i = 1; i < keyframes.size(); i++)
+		for(size_t i = 0; i < trackBoneIndices.size(); i++)
 		{
-			if(keyframes[i].time >= time)
-			{
-				return i;
-			}
+			if(positionRanges[i].count)
+				endTime_s = std::max(endTime_s, positionTimes[positionRanges[i].begin + positionRanges[i].count - 1]);
+			if(rotationRanges[i].count)
+				endTime_s = std::max(endTime_s, rotationTimes[rotationRanges[i].begin + rotationRanges[i].count - 1]);
 		}
-
-		return keyframes.size() - 1;
 	}
 
-	float BoneKeyframeList::getTimeBlend(float currentTime, float previousTime, float nextTime) const
+	float Animation::getAnimationLengthSeconds() const
 	{
-		return (currentTime - previousTime) / (nextTime - previousTime);
+		return endTime_s;
 	}
 
-	Animation::Animation(const std::string& name)
-		:name(name)
-	{}
-
-	Animation::Animation(const std::string& name, std::vector<BoneKeyframeList> bk)
-		: name(name), boneKeyframeLists(bk)
+	size_t Animation::getMemorySize() const
 	{
-		updateAnimationLength();
+		size_t size = trackBoneIndices.size() * (sizeof(size_t) + 2 * sizeof(KeyframeRange));
+		size += positionTimes.size() * sizeof(float) * 4;
+		size += rotationTimes.size() * sizeof(float) * 5;
+		return size;
 	}
 
-	//Retrieve end time from latest time in any bone animations.
-	//ASSUMPTION: This works for Unity, but does it work for Unreal?
-	void Animation::updateAnimationLength()
+	uint32_t Animation::findKeyframe(const std::vector<float>& times, const KeyframeRange& range, uint32_t cursor, float time)
 	{
-		if(boneKeyframeLists.empty())
+		const float* t = times.data() + range.begin;
+		uint32_t last = range.count - 1;
+		// Going backwards, or from a cursor that is out of range, search the whole track.
+		if(cursor > last || t[cursor] > time)
+			cursor = 0;
+		for(uint32_t step = 0; step < maxKeyframeSteps; step++)
 		{
-			return;
+			if(cursor == last || t[cursor + 1] > time)
+				return cursor;
+			cursor++;
 		}
+		// The last keyframe whose time is not after the given time.
+		uint32_t next = (uint32_t)(std::upper_bound(t + cursor, t + range.count, time) - t);
+		return next - 1;
+	}
 
-		BoneKeyframeList& boneAnimation = boneKeyframeLists[0];
-		if(!boneAnimation.positionKeyframes.empty())
+	void Animation::seekTime(AnimationCursor& cursor, const std::vector<std::shared_ptr<clientrender::Bone>>& boneList, float time) const
+	{
+		size_t count = trackBoneIndices.size();
+		if(!count)
 		{
-			endTime_s = std::max(endTime_s, boneAnimation.positionKeyframes[boneAnimation.positionKeyframes.size() - 1].time);
 			return;
 		}
+		cursor.positionKeyframes.resize(count, 0);
+		cursor.rotationKeyframes.resize(count, 0);
+		SampleBuffers& buffers = sampleBuffers;
+		buffers.Resize(count);
+
+		// Gather the keyframes either side of the time for every track. A track with no keyframes leaves its bone as it is,
+		// and one with a single keyframe blends it with itself.
+		for(size_t i = 0; i < count; i++)
+		{
+			const KeyframeRange& positions = positionRanges[i];
+			if(positions.count)
+			{
+				uint32_t from = findKeyframe(positionTimes, positions, cursor.positionKeyframes[i], time);
+				uint32_t to = std::min(from + 1, positions.count - 1);
+				cursor.positionKeyframes[i] = from;
+				buffers.positionBlend[i] = GetTimeBlend(positionTimes.data() + positions.begin, from, to, time);
+				for(int c = 0; c < 3; c++)
+				{
+					buffers.position0[c][i] = positionValues[c][positions.begin + from];
+					buffers.position1[c][i] = positionValues[c][positions.begin + to];
+				}
+			}
+			else
+			{
+				buffers.positionBlend[i] = 0.0f;
+				for(int c = 0; c < 3; c++)
+					buffers.position0[c][i] = buffers.position1[c][i] = 0.0f;
+			}
+			const KeyframeRange& rotations = rotationRanges[i];
+			if(rotations.count)
+			{
+				uint32_t from = findKeyframe(rotationTimes, rotations, cursor.rotationKeyframes[i], time);
+				uint32_t to = std::min(from + 1, rotations.count - 1);
+				cursor.rotationKeyframes[i] = from;
+				buffers.rotationBlend[i] = GetTimeBlend(rotationTimes.data() + rotations.begin, from, to, time);
+				for(int c = 0; c < 4; c++)
+				{
+					buffers.rotation0[c][i] = rotationValues[c][rotations.begin + from];
+					buffers.rotation1[c][i] = rotationValues[c][rotations.begin + to];
+				}
+			}
+			else
+			{
+				buffers.rotationBlend[i] = 0.0f;
+				for(int c = 0; c < 4; c++)
+					buffers.rotation0[c][i] = buffers.rotation1[c][i] = 0.0f;
+			}
+		}
 
-		if(!boneAnimation.rotationKeyframes.empty())
+		// Each loop works on one component of every track, with no branches, so that it can be vectorised.
+		// The results are written over the "from" values.
+		const float* pt = buffers.positionBlend.data();
+		for(int c = 0; c < 3; c++)
 		{
-			endTime_s = std::max(endTime_s, boneAnimation.rotationKeyframes[boneAnimation.rotationKeyframes.size() - 1].time);
-			return;
+			float* p0 = buffers.position0[c].data();
+			const float* p1 = buffers.position1[c].data();
+			for(size_t i = 0; i < count; i++)
+				p0[i] = p0[i] + (p1[i] - p0[i]) * pt[i];
 		}
-	}
 
-	float Animation::getAnimationLengthSeconds()
-	{
-		return endTime_s;
-	}
+		// Normalised lerp of the rotations, taking the shorter way round.
+		const float* rt = buffers.rotationBlend.data();
+		float* ax = buffers.rotation0[0].data();
+		float* ay = buffers.rotation0[1].data();
+		float* az = buffers.rotation0[2].data();
+		float* aw = buffers.rotation0[3].data();
+		const float* bx = buffers.rotation1[0].data();
+		const float* by = buffers.rotation1[1].data();
+		const float* bz = buffers.rotation1[2].data();
+		const float* bw = buffers.rotation1[3].data();
+		for(size_t i = 0; i < count; i++)
+		{
+			float d = ax[i] * bx[i] + ay[i] * by[i] + az[i] * bz[i] + aw[i] * bw[i];
+			float tb = d < 0.0f ? -rt[i] : rt[i];
+			float ta = 1.0f - rt[i];
+			float x = ax[i] * ta + bx[i] * tb;
+			float y = ay[i] * ta + by[i] * tb;
+			float z = az[i] * ta + bz[i] * tb;
+			float w = aw[i] * ta + bw[i] * tb;
+			float lengthSquared = x * x + y * y + z * z + w * w;
+			float r = lengthSquared > 0.0f ? 1.0f / std::sqrt(lengthSquared) : 0.0f;
+			ax[i] = x * r;
+			ay[i] = y * r;
+			az[i] = z * r;
+			aw[i] = w * r;
+		}
 
-	void Animation::seekTime(const std::vector<std::shared_ptr<clientrender::Bone>>& boneList, float time) const
-	{
-		for(BoneKeyframeList boneKeyframeList : boneKeyframeLists)
+		for(size_t i = 0; i < count; i++)
 		{
-			boneKeyframeList.seekTime(boneList[boneKeyframeList.boneIndex], time);
+			size_t boneIndex = trackBoneIndices[i];
+			if(boneIndex >= boneList.size() || !boneList[boneIndex])
+			{
+				continue;
+			}
+			Bone* bone = boneList[boneIndex].get();
+			Transform transform = bone->GetLocalTransform();
+			if(positionRanges[i].count)
+				transform.m_Translation = avs::vec3(buffers.position0[0][i], buffers.position0[1][i], buffers.position0[2][i]);
+			if(rotationRanges[i].count)
+				transform.m_Rotation = quat(ax[i], ay[i], az[i], aw[i]);
+			transform.UpdateModelMatrix();
+			bone->SetLocalTransform(transform);
 		}
 	}
-}
\ No newline at end of file
+}
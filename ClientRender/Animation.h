@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "TeleportCore/AnimationInterface.h"
@@ -8,10 +9,9 @@
 namespace clientrender
 {
 class Bone;
-struct quat;
 
 //! A list of keyframes, i.e. a single track for an animation. Defines the positions and rotations for one bone in a skeleton,
-//! across the length of a single animation.
+//! across the length of a single animation. An Animation is created from these, and keeps its keyframes in its own form.
 class BoneKeyframeList
 {
 public:
@@ -21,37 +21,83 @@ public:
 
 	std::vector<avs::Vector3Keyframe> positionKeyframes;
 	std::vector<avs::Vector4Keyframe> rotationKeyframes;
+};
 
-	void seekTime(std::shared_ptr<Bone> bone, float time) const;
-private:
-	void setPositionToTime(float time, avs::vec3& bonePosition, const std::vector<avs::Vector3Keyframe>& keyframes) const;
-	void setRotationToTime(float time, quat& boneRotation, const std::vector<avs::Vector4Keyframe>& keyframes) const;
+//! Where one instance is in playing an Animation: the keyframe each of its tracks was last sampled from.
+//! Playing forward then only has to step on to the next keyframe or two, rather than search from the start.
+struct AnimationCursor
+{
+	std::vector<uint32_t> positionKeyframes;
+	std::vector<uint32_t> rotationKeyframes;
 
-	size_t getNextKeyframeIndex(float time, const std::vector<avs::Vector3Keyframe>& keyframes) const;
-	size_t getNextKeyframeIndex(float time, const std::vector<avs::Vector4Keyframe>& keyframes) const;
-	float getTimeBlend(float currentTime, float previousTime, float nextTime) const;
+	void Reset()
+	{
+		positionKeyframes.clear();
+		rotationKeyframes.clear();
+	}
 };
 
+//! A skeletal animation. The keyframes of all of its tracks are kept in flat arrays, one per component, with each track's
+//! keyframes in a contiguous range, and all the tracks are sampled together: the keyframes either side of the time are
+//! gathered for every track, then blended over arrays of each component, which the compiler can vectorise.
+//! An Animation can be shared by many nodes, and sampled from several threads at once, each with its own cursor.
 class Animation
 {
 public:
 	const std::string name;
-	std::vector<BoneKeyframeList> boneKeyframeLists;
 
 	Animation(const std::string& name);
-	Animation(const std::string& name, std::vector<BoneKeyframeList> boneKeyframes);
-	
-	//Updates how long the animations runs for by scanning boneKeyframeLists.
+	Animation(const std::string& name, const std::vector<BoneKeyframeList>& boneKeyframes);
+
+	//Updates how long the animations runs for by scanning the tracks.
 	void updateAnimationLength();
 
 	//Returns how many seconds long the animation is.
-	float getAnimationLengthSeconds();
+	float getAnimationLengthSeconds() const;
+
+	//Returns the memory used by the keyframes, in bytes.
+	size_t getMemorySize() const;
+
+	size_t getTrackCount() const
+	{
+		return trackBoneIndices.size();
+	}
+	//Returns the index in the bones list of the bone the track moves.
+	size_t getTrackBoneIndex(size_t track) const
+	{
+		return trackBoneIndices[track];
+	}
+	size_t getPositionKeyframeCount(size_t track) const
+	{
+		return positionRanges[track].count;
+	}
+	size_t getRotationKeyframeCount(size_t track) const
+	{
+		return rotationRanges[track].count;
+	}
 
 	//Sets bone transforms to positions and rotations specified by the animation at the passed time.
+	//	cursor : Where this instance was last sampled; updated to the passed time.
 	//	boneList : List of bones for the animation.
 	//	time : Time the animation will use when moving the bone transforms in seconds.
-	void seekTime(const std::vector<std::shared_ptr<clientrender::Bone>>& boneList, float time_s) const;
+	void seekTime(AnimationCursor& cursor, const std::vector<std::shared_ptr<clientrender::Bone>>& boneList, float time_s) const;
 private:
+	struct KeyframeRange
+	{
+		uint32_t begin = 0;
+		uint32_t count = 0;
+	};
+	std::vector<size_t> trackBoneIndices;
+	std::vector<KeyframeRange> positionRanges;
+	std::vector<KeyframeRange> rotationRanges;
+	std::vector<float> positionTimes;
+	std::vector<float> positionValues[3];
+	std::vector<float> rotationTimes;
+	std::vector<float> rotationValues[4];
+
 	float endTime_s = 0.0f; //Seconds the animation lasts for.
+
+	//Returns the keyframe in the range at or before the time, starting from the one the cursor was at.
+	static uint32_t findKeyframe(const std::vector<float>& times, const KeyframeRange& range, uint32_t cursor, float time);
 };
-}
\ No newline at end of file
+}
@@ -0,0 +1,116 @@
+// (C) Copyright 2018-2022 Simul Software Ltd
+
+#include "DistanceSortedNodeList.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Node.h"
+
+using namespace clientrender;
+
+bool DistanceSortedNodeList::Add(const std::shared_ptr<Node>& node)
+{
+	if(!node || Contains(node.get()))
+		return false;
+	indices[node.get()] = (uint32_t)nodes.size();
+	nodes.push_back(node);
+	keys.push_back(DistanceKey(node->distance));
+	return true;
+}
+
+bool DistanceSortedNodeList::Remove(const Node* node)
+{
+	auto f = indices.find(node);
+	if(f == indices.end())
+		return false;
+	// Move the last node into the gap; the order is repaired at the next Sort().
+	uint32_t index = f->second;
+	indices.erase(f);
+	uint32_t last = (uint32_t)nodes.size() - 1;
+	if(index != last)
+	{
+		nodes[index] = std::move(nodes[last]);
+		keys[index] = keys[last];
+		indices[nodes[index].get()] = index;
+	}
+	nodes.pop_back();
+	keys.pop_back();
+	return true;
+}
+
+void DistanceSortedNodeList::Clear()
+{
+	nodes.clear();
+	keys.clear();
+	indices.clear();
+}
+
+uint32_t DistanceSortedNodeList::DistanceKey(float distance)
+{
+	// Positive floats are ordered the same as their bit patterns. Dropping the low mantissa bits leaves a relative precision of
+	// about 1/32768, so that tiny changes in distance do not reorder nodes.
+	if(!(distance > 0.0f))
+		return 0;
+	uint32_t bits;
+	memcpy(&bits, &distance, sizeof(bits));
+	return bits >> 8;
+}
+
+const std::vector<std::shared_ptr<Node>>& DistanceSortedNodeList::Sort()
+{
+	size_t count = nodes.size();
+	for(size_t i = 0; i < count; i++)
+		keys[i] = DistanceKey(nodes[i]->distance);
+
+	// Insertion sort, which is stable, so nodes at the same distance keep their order.
+	// If the order has changed too much since the last frame, e.g. because the viewer has moved far, sort from scratch.
+	size_t moves = 0;
+	size_t maxMoves = count * 4 + 64;
+	size_t firstMoved = count;
+	for(size_t i = 1; i < count; i++)
+	{
+		uint32_t key = keys[i];
+		if(keys[i - 1] <= key)
+			continue;
+		std::shared_ptr<Node> node = std::move(nodes[i]);
+		size_t j = i;
+		while(j > 0 && keys[j - 1] > key)
+		{
+			keys[j] = keys[j - 1];
+			nodes[j] = std::move(nodes[j - 1]);
+			j--;
+		}
+		keys[j] = key;
+		nodes[j] = std::move(node);
+		firstMoved = std::min(firstMoved, j);
+		moves += i - j;
+		if(moves > maxMoves)
+		{
+			FullSort();
+			return nodes;
+		}
+	}
+	for(size_t i = firstMoved; i < count; i++)
+		indices[nodes[i].get()] = (uint32_t)i;
+	return nodes;
+}
+
+void DistanceSortedNodeList::FullSort()
+{
+	size_t count = nodes.size();
+	sortPairs.resize(count);
+	for(size_t i = 0; i < count; i++)
+		sortPairs[i] = {keys[i], (uint32_t)i};
+	// Ties are broken by the current position, so this is as stable as the insertion sort.
+	std::sort(sortPairs.begin(), sortPairs.end());
+	sortedNodes.resize(count);
+	for(size_t i = 0; i < count; i++)
+	{
+		sortedNodes[i] = std::move(nodes[sortPairs[i].second]);
+		keys[i] = sortPairs[i].first;
+		indices[sortedNodes[i].get()] = (uint32_t)i;
+	}
+	nodes.swap(sortedNodes);
+	sortedNodes.clear();
+}
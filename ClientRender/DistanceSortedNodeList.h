@@ -0,0 +1,52 @@
+// (C) Copyright 2018-2022 Simul Software Ltd
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace clientrender
+{
+	class Node;
+
+	//! A list of nodes kept sorted near to far by Node::distance.
+	//! Nodes are found through an index map, so adding and removing are constant-time. Distances change little from one
+	//! frame to the next, so Sort() works on compact integer keys with an insertion sort, which is close to linear when
+	//! the list is nearly in order, and only falls back to a full sort when it is not.
+	class DistanceSortedNodeList
+	{
+	public:
+		//! Add the node at the end; it takes its place at the next Sort(). Returns false if it was already present.
+		bool Add(const std::shared_ptr<Node>& node);
+		//! Returns false if the node was not present.
+		bool Remove(const Node* node);
+		bool Contains(const Node* node) const
+		{
+			return indices.find(node) != indices.end();
+		}
+		void Clear();
+		size_t size() const
+		{
+			return nodes.size();
+		}
+		//! Re-sort by the nodes' current distances.
+		const std::vector<std::shared_ptr<Node>>& Sort();
+		const std::vector<std::shared_ptr<Node>>& GetNodes() const
+		{
+			return nodes;
+		}
+
+	private:
+		std::vector<std::shared_ptr<Node>> nodes;
+		std::vector<uint32_t> keys;
+		std::unordered_map<const Node*, uint32_t> indices;
+		// Scratch space for a full sort, kept to avoid reallocating.
+		std::vector<std::pair<uint32_t, uint32_t>> sortPairs;
+		std::vector<std::shared_ptr<Node>> sortedNodes;
+
+		static uint32_t DistanceKey(float distance);
+		void FullSort();
+	};
+}
@@ -8,6 +8,18 @@ GeometryCache::GeometryCache(clientrender::NodeManager *nm)
 		  mIndexBufferManager(&clientrender::IndexBuffer::Destroy),
 		  mVertexBufferManager(&clientrender::VertexBuffer::Destroy)
 {
+	memoryBudget.budgetBytes = defaultMemoryBudget;
+	mMaterialManager.SetMemoryBudget(&memoryBudget);
+	mTextureManager.SetMemoryBudget(&memoryBudget);
+	mMeshManager.SetMemoryBudget(&memoryBudget);
+	mSkinManager.SetMemoryBudget(&memoryBudget);
+	mLightManager.SetMemoryBudget(&memoryBudget);
+	mBoneManager.SetMemoryBudget(&memoryBudget);
+	mAnimationManager.SetMemoryBudget(&memoryBudget);
+	mTextCanvasManager.SetMemoryBudget(&memoryBudget);
+	mFontAtlasManager.SetMemoryBudget(&memoryBudget);
+	mIndexBufferManager.SetMemoryBudget(&memoryBudget);
+	mVertexBufferManager.SetMemoryBudget(&memoryBudget);
 }
 
 GeometryCache::~GeometryCache()
@@ -2,6 +2,7 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <mutex>
 #include <set>
 #include <thread>
@@ -41,6 +42,7 @@ namespace clientrender
 		std::string													name				= {};										//For debugging which texture failed.
 		avs::TextureCompression										compressionFormat	= avs::TextureCompression::UNCOMPRESSED;
 		float														valueScale			= 0.0f;										// scale on transcode.
+		std::chrono::steady_clock::time_point						queueTime			= std::chrono::steady_clock::now();			//When the texture was queued for transcoding.
 
 		UntranscodedTexture(avs::uid uid, const void* ptr, size_t size, const std::shared_ptr<clientrender::Texture::TextureCreateInfo>& textureCreateInfo,
 			const std::string& name, avs::TextureCompression compressionFormat, float valueScale)
@@ -56,7 +58,10 @@ namespace clientrender
 	{
 		geometry_cache_uid next_geometry_cache_uid=1;
 		std::map<uint64_t,geometry_cache_uid> uid_mapping;
+		// Declared before the managers, as they use it until they are destroyed.
+		ResourceMemoryBudget memoryBudget;
 	public:
+		static constexpr size_t defaultMemoryBudget = size_t(1024) * 1024 * 1024;
 		GeometryCache(NodeManager *);
 
 		~GeometryCache();
@@ -97,6 +102,20 @@ namespace clientrender
 			mTextCanvasManager.Update(timeElapsed_s);
 			mFontAtlasManager.Update(timeElapsed_s);
 		}
+		/// Set the memory the resources may use before unused ones are freed early; zero for no limit.
+		void SetMemoryBudget(size_t bytes)
+		{
+			memoryBudget.budgetBytes = bytes;
+		}
+		size_t GetMemoryBudget() const
+		{
+			return memoryBudget.budgetBytes;
+		}
+		/// The memory used by all the resources, in bytes.
+		size_t GetResidentBytes() const
+		{
+			return memoryBudget.residentBytes;
+		}
 		void setCacheFolder(const std::string &f);
 		void SaveNodeTree(const std::shared_ptr<clientrender::Node>& n) const;
 
@@ -104,25 +123,25 @@ namespace clientrender
 		{
 			std::vector<uid> resourceIDs;
 
-			const auto& m = mMaterialManager.GetAllIDs();
-			resourceIDs.insert(resourceIDs.end(), m.begin(), m.end());
-			const auto& t = mTextureManager.GetAllIDs();
-			resourceIDs.insert(resourceIDs.end(), t.begin(), t.end());
-			const auto& h = mMeshManager.GetAllIDs();
-			resourceIDs.insert(resourceIDs.end(), h.begin(), h.end());
-			const auto& s = mSkinManager.GetAllIDs();
-			resourceIDs.insert(resourceIDs.end(), s.begin(), s.end());
-			const auto& l = mLightManager.GetAllIDs();
-			resourceIDs.insert(resourceIDs.end(), l.begin(), l.end());
-			const auto& b = mBoneManager.GetAllIDs();
-			resourceIDs.insert(resourceIDs.end(), b.begin(), b.end());
-			const auto& a = mAnimationManager.GetAllIDs();
-			resourceIDs.insert(resourceIDs.end(), a.begin(), a.end());
+			const auto m = mMaterialManager.GetAllIDs();
+			resourceIDs.insert(resourceIDs.end(), m->begin(), m->end());
+			const auto t = mTextureManager.GetAllIDs();
+			resourceIDs.insert(resourceIDs.end(), t->begin(), t->end());
+			const auto h = mMeshManager.GetAllIDs();
+			resourceIDs.insert(resourceIDs.end(), h->begin(), h->end());
+			const auto s = mSkinManager.GetAllIDs();
+			resourceIDs.insert(resourceIDs.end(), s->begin(), s->end());
+			const auto l = mLightManager.GetAllIDs();
+			resourceIDs.insert(resourceIDs.end(), l->begin(), l->end());
+			const auto b = mBoneManager.GetAllIDs();
+			resourceIDs.insert(resourceIDs.end(), b->begin(), b->end());
+			const auto a = mAnimationManager.GetAllIDs();
+			resourceIDs.insert(resourceIDs.end(), a->begin(), a->end());
 			
-			const auto& c = mTextCanvasManager.GetAllIDs();
-			resourceIDs.insert(resourceIDs.end(), c.begin(), c.end());
-			const auto& f = mFontAtlasManager.GetAllIDs();
-			resourceIDs.insert(resourceIDs.end(), f.begin(), f.end());
+			const auto c = mTextCanvasManager.GetAllIDs();
+			resourceIDs.insert(resourceIDs.end(), c->begin(), c->end());
+			const auto f = mFontAtlasManager.GetAllIDs();
+			resourceIDs.insert(resourceIDs.end(), f->begin(), f->end());
 			return resourceIDs;
 
 			/*
@@ -1,6 +1,7 @@
 //#pragma warning(4018,off)
 #include "GeometryDecoder.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include "Common.h"
@@ -45,14 +46,24 @@ template<typename T> void copy(T* target, const uint8_t *data, size_t &dataOffse
 
 GeometryDecoder::GeometryDecoder()
 {
-	decodeThread = std::thread(&GeometryDecoder::decodeAsync, this);
+#if TELEPORT_GEOMETRY_DECODER_ASYNC
 	decodeThreadActive = true;
+	unsigned numThreads = std::max(1u, std::thread::hardware_concurrency() / 4);
+	for (unsigned i = 0; i < numThreads; i++)
+		decodeThreads.emplace_back(&GeometryDecoder::decodeAsync, this);
+#endif
 }
 
 GeometryDecoder::~GeometryDecoder()
 {
-	decodeThreadActive = false;
-	decodeThread.join();
+	{
+		std::lock_guard<std::mutex> lock(decodeMutex);
+		decodeThreadActive = false;
+	}
+	decodeCondition.notify_all();
+	decodeSpaceCondition.notify_all();
+	for (auto& t : decodeThreads)
+		t.join();
 }
 
 void GeometryDecoder::setCacheFolder(const std::string& f)
@@ -62,11 +73,7 @@ void GeometryDecoder::setCacheFolder(const std::string& f)
 
 avs::Result GeometryDecoder::decode(const void* buffer, size_t bufferSizeInBytes, avs::GeometryPayloadType type, avs::GeometryTargetBackendInterface* target)
 {
-	decodeData.emplace(buffer, bufferSizeInBytes, type, (clientrender::ResourceCreator*)target, true);
-#if !TELEPORT_GEOMETRY_DECODER_ASYNC
-	decodeInternal(decodeData.front());
-	decodeData.pop();
-#endif
+	enqueue(std::make_shared<GeometryDecodeData>(buffer, bufferSizeInBytes, type, (clientrender::ResourceCreator*)target, true));
 	return avs::Result::OK;
 }
 
@@ -79,29 +86,77 @@ avs::Result GeometryDecoder::decodeFromFile(const std::string& filename, avs::Ge
 	void *ptr=nullptr;
 	unsigned int sz=0;
 	fileLoader->AcquireFileContents(ptr,sz,filename.c_str(),false);
-	decodeData.emplace(ptr, sz, type, target, false);
-#if !TELEPORT_GEOMETRY_DECODER_ASYNC
-	decodeInternal(decodeData.front());
-	decodeData.pop();
-#endif
+	auto geometryDecodeData = std::make_shared<GeometryDecodeData>(ptr, sz, type, target, false);
 	fileLoader->ReleaseFileContents(ptr);
+	enqueue(geometryDecodeData);
 	return avs::Result::OK;
 }
 
+void GeometryDecoder::WaitFromDecodeThread()
+{
+	std::unique_lock<std::mutex> lock(decodeMutex);
+	decodeSpaceCondition.wait(lock, [this] { return decodeData.empty() || !decodeThreadActive; });
+}
+
+void GeometryDecoder::enqueue(std::shared_ptr<GeometryDecodeData> geometryDecodeData)
+{
+#if TELEPORT_GEOMETRY_DECODER_ASYNC
+	{
+		std::unique_lock<std::mutex> lock(decodeMutex);
+		// Hold back the geometry stream rather than let undecoded payloads pile up.
+		decodeSpaceCondition.wait(lock, [this] { return decodeData.size() < maxQueuedPayloads || !decodeThreadActive; });
+		if (!decodeThreadActive)
+			return;
+		decodeData.push_back(geometryDecodeData);
+		decodeDataToPrepare.push_back(geometryDecodeData);
+	}
+	decodeCondition.notify_one();
+#else
+	decodeInternal(*geometryDecodeData);
+#endif
+}
+
 void GeometryDecoder::decodeAsync()
 {
 	SetThisThreadName("GeometryDecoder::decodeAsync");
+	std::unique_lock<std::mutex> lock(decodeMutex);
 	while (decodeThreadActive)
 	{
-#if TELEPORT_GEOMETRY_DECODER_ASYNC
-		if (!decodeData.empty())
-		{
-			decodeInternal(decodeData.front());
-			decodeData.pop();
-		}
-#endif
-		std::this_thread::yield();
+		decodeCondition.wait(lock, [this] { return !decodeThreadActive || !decodeDataToPrepare.empty(); });
+		if (!decodeThreadActive)
+			break;
+		std::shared_ptr<GeometryDecodeData> geometryDecodeData = decodeDataToPrepare.front();
+		decodeDataToPrepare.pop_front();
+		lock.unlock();
+		prepare(*geometryDecodeData);
+		lock.lock();
+		geometryDecodeData->prepared = true;
+		// If no other thread is creating, create everything that is ready, in order.
+		if (!creatingDecodedData)
+			createPrepared(lock);
+	}
+}
+
+void GeometryDecoder::prepare(GeometryDecodeData& geometryDecodeData)
+{
+	if (geometryDecodeData.type == avs::GeometryPayloadType::Mesh)
+		geometryDecodeData.prepareResult = prepareMesh(geometryDecodeData);
+}
+
+void GeometryDecoder::createPrepared(std::unique_lock<std::mutex>& lock)
+{
+	creatingDecodedData = true;
+	while (decodeThreadActive && !decodeData.empty() && decodeData.front()->prepared)
+	{
+		std::shared_ptr<GeometryDecodeData> geometryDecodeData = decodeData.front();
+		lock.unlock();
+		decodeInternal(*geometryDecodeData);
+		lock.lock();
+		// Only remove it once created, so that WaitFromDecodeThread() doesn't return early.
+		decodeData.pop_front();
+		decodeSpaceCondition.notify_all();
 	}
+	creatingDecodedData = false;
 }
 
 avs::Result GeometryDecoder::decodeInternal(GeometryDecodeData& geometryDecodeData)
@@ -204,7 +259,7 @@ avs::Accessor::DataType FromDracoNumComponents(int num_components)
 }
 
 // NOTE the inefficiency here, we're coding into "DecodedGeometry", but that is then immediately converted to a MeshCreate.
-avs::Result GeometryDecoder::DracoMeshToDecodedGeometry(avs::uid primitiveArrayUid, DecodedGeometry &dg, const avs::CompressedMesh &compressedMesh)
+avs::Result GeometryDecoder::DracoMeshToDecodedGeometry(avs::uid primitiveArrayUid, DecodedGeometry &dg, const avs::CompressedMesh &compressedMesh, std::vector<std::vector<uint8_t>>& decompressedBuffers)
 {
 	size_t primitiveArraysSize = compressedMesh.subMeshes.size();
 	dg.primitiveArrays[primitiveArrayUid].reserve(primitiveArraysSize);
@@ -244,11 +299,8 @@ avs::Result GeometryDecoder::DracoMeshToDecodedGeometry(avs::uid primitiveArrayU
 			bufferView.byteLength = dracoAttribute->buffer()->data_size();
 			bufferView.byteOffset = 0;
 			buffer.byteLength = bufferView.byteLength;
-			if(m_DecompressedBufferIndex>=m_DecompressedBuffers.size())
-				m_DecompressedBuffers.resize(m_DecompressedBuffers.size()*2);
-			auto &buf=m_DecompressedBuffers[m_DecompressedBufferIndex++];
-			buf.resize(buffer.byteLength);
-			buffer.data = buf.data();
+			decompressedBuffers.emplace_back(buffer.byteLength);
+			buffer.data = decompressedBuffers.back().data();
 		
 
 			uint8_t * buf_ptr=buffer.data;
@@ -277,7 +329,8 @@ avs::Result GeometryDecoder::DracoMeshToDecodedGeometry(avs::uid primitiveArrayU
 		{
 			indicesBuffer.byteLength = 3 * sizeof(uint16_t) * subMeshFaces;
 		}
-		indicesBuffer.data = new uint8_t[indicesBuffer.byteLength];
+		decompressedBuffers.emplace_back(indicesBuffer.byteLength);
+		indicesBuffer.data = decompressedBuffers.back().data();
 		uint8_t * ind_ptr=indicesBuffer.data;
 		for(uint32_t j=0;j<subMeshFaces;j++)
 		{
@@ -443,21 +496,16 @@ avs::Result GeometryDecoder::CreateMeshesFromDecodedGeometry(clientrender::Resou
 	return avs::Result::OK;
 }
 
-avs::Result GeometryDecoder::decodeMesh(GeometryDecodeData& geometryDecodeData)
+avs::Result GeometryDecoder::prepareMesh(GeometryDecodeData& geometryDecodeData)
 {
 	//Parse buffer and fill struct DecodedGeometry
-	DecodedGeometry dg = {};
-	dg.clear();
+	geometryDecodeData.decodedGeometry = std::make_shared<DecodedGeometry>();
+	DecodedGeometry& dg = *geometryDecodeData.decodedGeometry;
 	avs::uid uid;
 
-	std::string name;
+	std::string& name = geometryDecodeData.meshName;
 
 	size_t meshCount = Next8B;
-	m_DecompressedBuffers.clear();
-	const size_t MAX_ATTR_COUNT=20;
-	if(meshCount*MAX_ATTR_COUNT>=m_DecompressedBuffers.size())
-		m_DecompressedBuffers.resize(meshCount*MAX_ATTR_COUNT);
-	m_DecompressedBufferIndex=0;
 
 	for (size_t i = 0; i < meshCount; i++)
 	{
@@ -492,7 +540,7 @@ avs::Result GeometryDecoder::decodeMesh(GeometryDecodeData& geometryDecodeData)
 				subMesh.buffer.resize(bufferSize);
 				copy<uint8_t>(subMesh.buffer.data(), geometryDecodeData.data.data(), geometryDecodeData.offset, bufferSize);
 			}
-			avs::Result result = DracoMeshToDecodedGeometry(uid, dg, compressedMesh);
+			avs::Result result = DracoMeshToDecodedGeometry(uid, dg, compressedMesh, geometryDecodeData.decompressedBuffers);
 			if (result != avs::Result::OK)
 				return result;
 		}
@@ -569,8 +617,20 @@ avs::Result GeometryDecoder::decodeMesh(GeometryDecodeData& geometryDecodeData)
 			return avs::Result::DecoderBackend_DecodeFailed;
 		}
 	}
-	
-	return CreateMeshesFromDecodedGeometry(geometryDecodeData.target, dg, name);
+	return avs::Result::OK;
+}
+
+avs::Result GeometryDecoder::decodeMesh(GeometryDecodeData& geometryDecodeData)
+{
+	if (!geometryDecodeData.prepared)
+		geometryDecodeData.prepareResult = prepareMesh(geometryDecodeData);
+	if (geometryDecodeData.prepareResult != avs::Result::OK)
+		return geometryDecodeData.prepareResult;
+	avs::Result result = CreateMeshesFromDecodedGeometry(geometryDecodeData.target, *geometryDecodeData.decodedGeometry, geometryDecodeData.meshName);
+	// The mesh has copied what it needs, so free the decompressed data now rather than when the payload is released.
+	geometryDecodeData.decodedGeometry.reset();
+	geometryDecodeData.decompressedBuffers.clear();
+	return result;
 }
 
 avs::Result GeometryDecoder::decodeMaterial(GeometryDecodeData& geometryDecodeData)
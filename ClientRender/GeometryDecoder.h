@@ -3,7 +3,11 @@
 #include <libavstream/mesh.hpp>
 #include <libavstream/geometry/mesh_interface.hpp>
 
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <thread>
 
 namespace avs
@@ -40,6 +44,13 @@ private:
 		clientrender::ResourceCreator*	target		= nullptr;
 		bool									saveToDisk	= false;
 
+		// For meshes, the Draco decoding is done in advance, possibly on another thread, and kept here until the mesh is created.
+		bool									prepared			= false;
+		avs::Result								prepareResult		= avs::Result::OK;
+		std::shared_ptr<DecodedGeometry>		decodedGeometry;
+		std::string								meshName;
+		std::vector<std::vector<uint8_t>>		decompressedBuffers;	// Storage for the buffers in decodedGeometry.
+
 		GeometryDecodeData(const void* ptr, size_t size, avs::GeometryPayloadType type_, clientrender::ResourceCreator* target_, bool saveToDisk_)
 			: data(size), type(type_), target(target_), saveToDisk(saveToDisk_) 
 		{
@@ -58,19 +69,20 @@ public:
 	//! Treat the file as buffer input and decode.
 	avs::Result decodeFromFile(const std::string &filename,avs::GeometryPayloadType type,clientrender::ResourceCreator *intf);
 
-	inline void WaitFromDecodeThread()
-	{
-		//Ugly thread spin lock
-		while (!decodeData.empty()) {}
-	}
+	//! Block until every payload received so far has been decoded.
+	void WaitFromDecodeThread();
 
 private:
+	void enqueue(std::shared_ptr<GeometryDecodeData> geometryDecodeData);
 	void decodeAsync();
+	void prepare(GeometryDecodeData& geometryDecodeData);
+	void createPrepared(std::unique_lock<std::mutex>& lock);
 	avs::Result decodeInternal(GeometryDecodeData& geometryDecodeData);
 	
-	avs::Result DracoMeshToDecodedGeometry(avs::uid primitiveArrayUid, DecodedGeometry& dg, const avs::CompressedMesh& compressedMesh);
+	avs::Result DracoMeshToDecodedGeometry(avs::uid primitiveArrayUid, DecodedGeometry& dg, const avs::CompressedMesh& compressedMesh, std::vector<std::vector<uint8_t>>& decompressedBuffers);
 	avs::Result CreateMeshesFromDecodedGeometry(clientrender::ResourceCreator* target, DecodedGeometry& dg, const std::string& name);
 
+	avs::Result prepareMesh(GeometryDecodeData& geometryDecodeData);
 	avs::Result decodeMesh(GeometryDecodeData& geometryDecodeData);
 	avs::Result decodeMaterial(GeometryDecodeData& geometryDecodeData);
 	avs::Result decodeMaterialInstance(GeometryDecodeData& geometryDecodeData);
@@ -87,14 +99,18 @@ private:
 	
 	void saveBuffer(GeometryDecodeData& geometryDecodeData, const std::string& name);
 
-	// Use for data extracted from compressed objects.
-	std::vector<std::vector<uint8_t>> m_DecompressedBuffers;
-	size_t m_DecompressedBufferIndex=0;
-
 private:
-	std::thread decodeThread;
-	bool decodeThreadActive;
-	avs::ThreadSafeQueue<GeometryDecodeData> decodeData;
+	// Payloads are prepared by any of the decode threads, so independent meshes are decompressed in parallel.
+	// They are then created strictly in the order they arrived, one at a time, as later payloads can depend on earlier ones.
+	std::vector<std::thread> decodeThreads;
+	bool decodeThreadActive = false;
+	std::mutex decodeMutex;
+	std::condition_variable decodeCondition;		// Signalled when there is a payload to prepare, or on shutdown.
+	std::condition_variable decodeSpaceCondition;	// Signalled when payloads have been created.
+	std::deque<std::shared_ptr<GeometryDecodeData>> decodeData;			// Payloads not yet created, in the order they arrived.
+	std::deque<std::shared_ptr<GeometryDecodeData>> decodeDataToPrepare;	// Payloads not yet taken by a decode thread.
+	bool creatingDecodedData = false;		// Whether a thread is creating prepared payloads.
+	size_t maxQueuedPayloads = 256;		// decode() blocks when this many payloads are waiting.
 
 private:
 	std::string cacheFolder;
@@ -886,9 +886,9 @@ void Gui::EndDebugGui(GraphicsDeviceContext& deviceContext)
 						ImGui::TableNextColumn();
 						ImGui::Text(text,rest...);
 					};
-					for(const auto &a:selected_animation->boneKeyframeLists)
+					for(size_t i=0;i<selected_animation->getTrackCount();i++)
 					{
-						DoRow((int)a.boneIndex,"%d,%d",(int)a.positionKeyframes.size(),(int)a.rotationKeyframes.size());
+						DoRow((int)selected_animation->getTrackBoneIndex(i),"%d,%d",(int)selected_animation->getPositionKeyframeCount(i),(int)selected_animation->getRotationKeyframeCount(i));
 					}
 					ImGui::EndTable();
 				}
@@ -946,8 +946,8 @@ void Gui::BoneTreeNode(const std::shared_ptr<clientrender::Bone> n, const char*
 void Gui::Textures(const ResourceManager<avs::uid,clientrender::Texture>& textureManager)
 {
 	ImGui::BeginGroup();
-	const auto& ids= textureManager.GetAllIDs();
-	for (auto id : ids)
+	const auto ids= textureManager.GetAllIDs();
+	for (auto id : *ids)
 	{
 		const auto &texture=textureManager.Get(id);
 		ImGui::TreeNodeEx(fmt::format("{0}: {1} ",id, texture->GetTextureCreateInfo().name.c_str()).c_str(),ImGuiTreeNodeFlags_Leaf);
@@ -965,8 +965,8 @@ void Gui::Textures(const ResourceManager<avs::uid,clientrender::Texture>& textur
 void Gui::Anims(const ResourceManager<avs::uid,clientrender::Animation>& animManager)
 {
 	ImGui::BeginGroup();
-	const auto& ids= animManager.GetAllIDs();
-	for (auto id : ids)
+	const auto ids= animManager.GetAllIDs();
+	for (auto id : *ids)
 	{
 		const auto &anim=animManager.Get(id);
 		ImGui::TreeNodeEx(fmt::format("{0}: {1} ",id, anim->name.c_str()).c_str());
@@ -1106,6 +1106,13 @@ void Gui::GeometryOSD()
 	LinePrint(platform::core::QuickFormat("Meshes: %d\nLights: %d", geometryCache->mMeshManager.GetCache(cacheLock).size(),
 					geometryCache->mLightManager.GetCache(cacheLock).size()), white);
 	LinePrint(platform::core::QuickFormat("Transparent Nodes: %d", geometryCache->mNodeManager->GetSortedTransparentNodes().size()), white);
+	LinePrint(platform::core::QuickFormat("Resident: %.1f of %.1f MB", geometryCache->GetResidentBytes() / 1048576.0, geometryCache->GetMemoryBudget() / 1048576.0), white);
+	LinePrint(platform::core::QuickFormat("Textures: %.1f MB, %llu evicted", geometryCache->mTextureManager.GetResidentBytes() / 1048576.0, geometryCache->mTextureManager.GetEvictionCount()), white);
+	LinePrint(platform::core::QuickFormat("Vertex Buffers: %.1f MB, %llu evicted", geometryCache->mVertexBufferManager.GetResidentBytes() / 1048576.0, geometryCache->mVertexBufferManager.GetEvictionCount()), white);
+	LinePrint(platform::core::QuickFormat("Index Buffers: %.1f MB, %llu evicted", geometryCache->mIndexBufferManager.GetResidentBytes() / 1048576.0, geometryCache->mIndexBufferManager.GetEvictionCount()), white);
+	LinePrint(platform::core::QuickFormat("Animations: %.1f MB, %llu evicted", geometryCache->mAnimationManager.GetResidentBytes() / 1048576.0, geometryCache->mAnimationManager.GetEvictionCount()), white);
+	LinePrint(platform::core::QuickFormat("Lookup wait: textures %llu us, materials %llu us, meshes %llu us, lights %llu us", geometryCache->mTextureManager.GetLookupWait_us(), geometryCache->mMaterialManager.GetLookupWait_us()
+					, geometryCache->mMeshManager.GetLookupWait_us(), geometryCache->mLightManager.GetLookupWait_us()), white);
 					
 	Scene();
 
@@ -1157,6 +1164,36 @@ void Gui::GeometryOSD()
 	}
 }
 
+void Gui::TranscodeOSD(const std::vector<clientrender::TextureTranscodeTiming>& timings)
+{
+	vec4 white(1.f, 1.f, 1.f, 1.f);
+	if(!timings.size())
+	{
+		LinePrint("Transcoded textures: none", white);
+		return;
+	}
+	float totalWaitMs=0.0f, totalTranscodeMs=0.0f, maxTranscodeMs=0.0f;
+	const clientrender::TextureTranscodeTiming *slowest=&timings[0];
+	for(const auto &t:timings)
+	{
+		totalWaitMs+=t.waitMs;
+		totalTranscodeMs+=t.transcodeMs;
+		if(t.transcodeMs>maxTranscodeMs)
+		{
+			maxTranscodeMs=t.transcodeMs;
+			slowest=&t;
+		}
+	}
+	LinePrint(platform::core::QuickFormat("Transcoded textures: %d, average wait %4.1f ms, transcode %4.1f ms", (int)timings.size(), totalWaitMs / timings.size(), totalTranscodeMs / timings.size()), white);
+	LinePrint(platform::core::QuickFormat("Slowest: %s (%llu), %4.1f ms for %d images", slowest->name.c_str(), slowest->texture_uid, slowest->transcodeMs, slowest->imageCount), white);
+	static size_t recentLimit = 8;
+	for(size_t i=timings.size()>recentLimit?timings.size()-recentLimit:0;i<timings.size();i++)
+	{
+		const auto &t=timings[i];
+		LinePrint(platform::core::QuickFormat("  %s (%llu): waited %4.1f ms, transcoded in %4.1f ms", t.name.c_str(), t.texture_uid, t.waitMs, t.transcodeMs), white);
+	}
+}
+
 bool Gui::Tab(const char *txt)
 {
 	if(!in_tabs)
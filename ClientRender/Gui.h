@@ -14,6 +14,7 @@ struct ANativeWindow;
 namespace clientrender
 {
 	struct DebugOptions;
+	struct TextureTranscodeTiming;
 }
 namespace teleport
 {
@@ -50,6 +51,8 @@ namespace teleport
 		void TagOSD(std::vector<clientrender::SceneCaptureCubeTagData> &videoTagDataCubeArray,VideoTagDataCube videoTagDataCube[]);
 		void DebugPanel(clientrender::DebugOptions &debugOptions);
 		void GeometryOSD();
+		//! The average and slowest of the recent texture transcodes, and the most recent few.
+		void TranscodeOSD(const std::vector<clientrender::TextureTranscodeTiming>& timings);
 		void Scene();
 		bool Tab(const char *txt);
 		void EndTab();
@@ -1,5 +1,6 @@
 #include "InstanceRenderer.h"
 #include "Renderer.h"
+#include <chrono>
 #include <fmt/core.h>
 #include "TeleportClient/Log.h"
 #include "TeleportClient/ServerTimestamp.h"
@@ -239,6 +240,7 @@ void InstanceRenderer::RenderView(crossplatform::GraphicsDeviceContext& deviceCo
 				renderState.cameraConstants.invWorldViewProj = deviceContext.viewStruct.invViewProj;
 				renderState.cameraConstants.viewPosition = deviceContext.viewStruct.cam_pos;
 				renderState.cubemapClearEffect->SetConstantBuffer(deviceContext, &renderState.cameraConstants);
+				resourceCreator.SetTranscodeViewPosition(renderState.cameraConstants.viewPosition);
 			}
 			if (sessionClient->IsConnected())
 			{
@@ -292,14 +294,13 @@ void InstanceRenderer::RenderLocalNodes(crossplatform::GraphicsDeviceContext& de
 	//renderState.cameraConstants.viewPosition = ((const float*)&clientServerState.headPose.globalPose.position);
 	
 	{
-		std::unique_ptr<std::lock_guard<std::mutex>> cacheLock;
-		auto &cachedLights=geometryCache.mLightManager.GetCache(cacheLock);
-		if(cachedLights.size()>renderState.lightsBuffer.count)
+		size_t lightCount=geometryCache.mLightManager.GetCount();
+		if(lightCount>renderState.lightsBuffer.count)
 		{
 			renderState.lightsBuffer.InvalidateDeviceObjects();
-			renderState.lightsBuffer.RestoreDeviceObjects(renderPlatform, static_cast<int>(cachedLights.size()));
+			renderState.lightsBuffer.RestoreDeviceObjects(renderPlatform, static_cast<int>(lightCount));
 		}
-		renderState.pbrConstants.lightCount = static_cast<int>(cachedLights.size());
+		renderState.pbrConstants.lightCount = static_cast<int>(lightCount);
 	}
 	if (deviceContext.deviceContextType == crossplatform::DeviceContextType::MULTIVIEW_GRAPHICS)
 	{
@@ -325,14 +326,13 @@ void InstanceRenderer::RenderLocalNodes(crossplatform::GraphicsDeviceContext& de
 	}
 
 	{
-		std::unique_ptr<std::lock_guard<std::mutex>> cacheLock;
-		auto &cachedLights=geometryCache.mLightManager.GetCache(cacheLock);
-		if(cachedLights.size()>renderState.lightsBuffer.count)
+		size_t lightCount=geometryCache.mLightManager.GetCount();
+		if(lightCount>renderState.lightsBuffer.count)
 		{
 			renderState.lightsBuffer.InvalidateDeviceObjects();
-			renderState.lightsBuffer.RestoreDeviceObjects(renderPlatform, static_cast<int>(cachedLights.size()));
+			renderState.lightsBuffer.RestoreDeviceObjects(renderPlatform, static_cast<int>(lightCount));
 		}
-		renderState.pbrConstants.lightCount = static_cast<int>(cachedLights.size());
+		renderState.pbrConstants.lightCount = static_cast<int>(lightCount);
 	}
 	// Now, any nodes bound to OpenXR poses will be updated. This may include hand objects, for example.
 	if(renderState.openXR)
@@ -365,14 +365,41 @@ void InstanceRenderer::RenderLocalNodes(crossplatform::GraphicsDeviceContext& de
 			}
 		}
 	}
+	// Children of the posed nodes, e.g. objects held in the hands, must follow them this frame.
+	geometryCache.mNodeManager->UpdateTransforms();
+
+	// Find the nodes in view of either eye, so that the others can be skipped before any work is done to draw them.
+	auto submitStart=std::chrono::steady_clock::now();
+	renderStats=RenderStats();
+	if(renderState.frustum_culling)
+	{
+		clientrender::Frustum frusta[2];
+		size_t frustumCount=0;
+		if (deviceContext.deviceContextType == crossplatform::DeviceContextType::MULTIVIEW_GRAPHICS)
+		{
+			crossplatform::MultiviewGraphicsDeviceContext& mgdc = *deviceContext.AsMultiviewGraphicsDeviceContext();
+			frusta[frustumCount++]=clientrender::Frustum::FromViewProjection((const float*)&mgdc.viewStructs[0].viewProj);
+			frusta[frustumCount++]=clientrender::Frustum::FromViewProjection((const float*)&mgdc.viewStructs[1].viewProj);
+		}
+		else
+		{
+			frusta[frustumCount++]=clientrender::Frustum::FromViewProjection((const float*)&deviceContext.viewStruct.viewProj);
+		}
+		renderStats.nodesTested=geometryCache.mNodeManager->CullNodes(frusta,frustumCount);
+	}
 
 	const clientrender::NodeManager::nodeList_t& nodeList = geometryCache.mNodeManager->GetSortedRootNodes();
 	for(const std::shared_ptr<clientrender::Node> node : nodeList)
 	{
 		if(renderState.show_only!=0&&renderState.show_only!=node->id)
 			continue;
-		RenderNode(deviceContext,node,false,true,false);
+		if(renderState.group_opaque_draws)
+			GatherMeshDraws(deviceContext,node,false);
+		else
+			RenderNode(deviceContext,node,false,true,false);
 	}
+	if(renderState.group_opaque_draws)
+		DrawMeshGroups(deviceContext);
 	const clientrender::NodeManager::nodeList_t& transparentList = geometryCache.mNodeManager->GetSortedTransparentNodes();
 	for(const std::shared_ptr<clientrender::Node> node : transparentList)
 	{
@@ -380,6 +407,7 @@ void InstanceRenderer::RenderLocalNodes(crossplatform::GraphicsDeviceContext& de
 			continue;
 		RenderNode(deviceContext,node,false,false,true);
 	}
+	renderStats.submitTimeMs=std::chrono::duration<float,std::milli>(std::chrono::steady_clock::now()-submitStart).count();
 	if(renderState.show_node_overlays)
 	for (const std::shared_ptr<clientrender::Node>& node : nodeList)
 	{
@@ -395,49 +423,27 @@ void InstanceRenderer::RenderNode(crossplatform::GraphicsDeviceContext& deviceCo
 	,bool transparent_pass)
 {
 	auto renderPlatform=deviceContext.renderPlatform;
-	clientrender::AVSTextureHandle th = instanceRenderState.avsTexture;
-	clientrender::AVSTexture& tx = *th;
-	AVSTextureImpl* ti = static_cast<AVSTextureImpl*>(&tx);
 
 	if (!node)
 		return;
 
-	std::shared_ptr<clientrender::Texture> globalIlluminationTexture;
-	if(node->GetGlobalIlluminationTextureUid() )
-		globalIlluminationTexture = geometryCache.mTextureManager.Get(node->GetGlobalIlluminationTextureUid());
+	crossplatform::Texture* globalIlluminationTexture=GetGlobalIlluminationTexture(*node);
 
 	bool force_highlight = force||(renderState.selected_uid== node->id);
 	//Only render visible nodes, but still render children that are close enough.
 	if(node->GetPriority()>=0)
 	if(node->IsVisible()&&(renderState.show_only == 0 || renderState.show_only == node->id))
 	{
-		const std::shared_ptr<clientrender::Mesh> mesh = node->GetMesh();
+		// A node that is out of view draws nothing, but its children may still be in view.
+		bool culled = renderState.frustum_culling && geometryCache.mNodeManager->IsCulled(node.get());
+		if(!transparent_pass && node->GetMesh())
+			(culled ? renderStats.nodesCulled : renderStats.nodesDrawn)++;
+		const std::shared_ptr<clientrender::Mesh> mesh = culled ? nullptr : node->GetMesh();
 		const std::shared_ptr<TextCanvas> textCanvas=transparent_pass?node->GetTextCanvas():nullptr;
-		crossplatform::MultiviewGraphicsDeviceContext* mvgdc = deviceContext.AsMultiviewGraphicsDeviceContext();
 		mat4 model;
 		if(mesh||textCanvas)
 		{
-			const mat4& globalTransformMatrix = node->GetGlobalTransform().GetTransformMatrix();
-			model = reinterpret_cast<const float*>(&globalTransformMatrix);
-			static bool override_model=false;
-			if(override_model)
-			{
-				model=mat4::identity();
-			}
-
-			if (deviceContext.deviceContextType == crossplatform::DeviceContextType::MULTIVIEW_GRAPHICS)
-			{
-				crossplatform::MultiviewGraphicsDeviceContext& mgdc = *deviceContext.AsMultiviewGraphicsDeviceContext();
-				mat4::mul(renderState.stereoCameraConstants.leftWorldViewProj, *((mat4*)&mgdc.viewStructs[0].viewProj), model);
-				renderState.stereoCameraConstants.leftWorld = model;
-				mat4::mul(renderState.stereoCameraConstants.rightWorldViewProj, *((mat4*)&mgdc.viewStructs[1].viewProj), model);
-				renderState.stereoCameraConstants.rightWorld = model;
-			}
-			//else
-			{
-				mat4::mul(renderState.cameraConstants.worldViewProj, *((mat4*)&deviceContext.viewStruct.viewProj), model);
-				renderState.cameraConstants.world = model;
-			}
+			model=SetModelConstants(deviceContext,*node);
 		}
 		if(mesh)
 		{
@@ -454,7 +460,6 @@ void InstanceRenderer::RenderNode(crossplatform::GraphicsDeviceContext& deviceCo
 				bool transparent	=(matInfo.materialMode==avs::MaterialMode::TRANSPARENT_MATERIAL);
 				if(transparent!=transparent_pass)
 					continue;
-				bool double_sided=false;
 				auto* vb = meshInfo.vb[element].get();
 				const auto* ib = meshInfo.ib[element].get();
 
@@ -462,108 +467,22 @@ void InstanceRenderer::RenderNode(crossplatform::GraphicsDeviceContext& deviceCo
 				if(!v[0])
 					continue;
 				crossplatform::Layout* layout = vb->GetLayout();
-				// TODO: Improve this.
-				auto sc=node->GetGlobalScale();
-				bool negative_scale=(sc.x*sc.y*sc.z)<0.0f;
-				std::shared_ptr<clientrender::SkinInstance> skinInstance = node->GetSkinInstance();
-				bool anim=skinInstance!=nullptr;
-				if (skinInstance)
-				{
-					mat4* scr_matrices = skinInstance->GetBoneMatrices(model);
-					BoneMatrices *b=static_cast<BoneMatrices*>(&renderState.boneMatrices);
-					memcpy(b, scr_matrices, sizeof(mat4) * clientrender::Skin::MAX_BONES);
-
-					renderState.pbrEffect->SetConstantBuffer(deviceContext, &renderState.boneMatrices);
-					//usedPassName = "anim_" + usedPassName;
-				}
-
+				crossplatform::StandardRenderState standardRenderState;
+				crossplatform::EffectPass *pass=GetPass(deviceContext,*node,*material,standardRenderState);
 				bool highlight=node->IsHighlighted()||force_highlight;
-				
 				highlight|= (renderState.selected_uid == material->id);
-				const clientrender::Material::MaterialData& md = material->GetMaterialData();
-				memcpy(&renderState.pbrConstants.diffuseOutputScalar, &md, sizeof(md));
-				renderState.pbrConstants.lightmapScaleOffset=*(const vec4*)(&(node->GetLightmapScaleOffset()));
-				std::shared_ptr<clientrender::Texture> diffuse	= matInfo.diffuse.texture;
-				std::shared_ptr<clientrender::Texture> normal	= matInfo.normal.texture;
-				std::shared_ptr<clientrender::Texture> combined = matInfo.combined.texture;
-				std::shared_ptr<clientrender::Texture> emissive = matInfo.emissive.texture;
-				
-				renderState.pbrEffect->SetTexture(deviceContext, renderState.pbrEffect_diffuseTexture	,diffuse ? diffuse->GetSimulTexture() : nullptr);
-				renderState.pbrEffect->SetTexture(deviceContext, renderState.pbrEffect_normalTexture	,normal ? normal->GetSimulTexture() : nullptr);
-				renderState.pbrEffect->SetTexture(deviceContext, renderState.pbrEffect_combinedTexture	,combined ? combined->GetSimulTexture() : nullptr);
-				renderState.pbrEffect->SetTexture(deviceContext, renderState.pbrEffect_emissiveTexture	,emissive ? emissive->GetSimulTexture() : nullptr);
-				
-				ShaderPassSetup * shaderPassSetup = mvgdc?(transparent?&renderState.pbrEffect_transparentMultiview:(anim?&renderState.pbrEffect_solidAnimMultiview:&renderState.pbrEffect_solidMultiview))
-																			:(transparent?&renderState.pbrEffect_transparent:(anim?&renderState.pbrEffect_solidAnim:&renderState.pbrEffect_solid));
-
-				// Pass used for rendering geometry.
-				crossplatform::EffectPass *pass=nullptr;
-				if(shaderPassSetup->overridePass)
-					pass=shaderPassSetup->overridePass;
-				else
-				{
-					if(node->IsStatic())
-						pass=shaderPassSetup->lightmapPass;
-					else
-						pass=shaderPassSetup->noLightmapPass;
-				}
-				if(material->GetMaterialCreateInfo().shader.length())
-				{
-					pass=shaderPassSetup->technique->GetPass(material->GetMaterialCreateInfo().shader.c_str());
-					double_sided=true;
-				}
-				if(!pass)
-				{
-					TELEPORT_CERR<<"Pass not found in "<<shaderPassSetup->technique->name.c_str()<<"\n";
-					pass=renderState.pbrEffect_solid.noLightmapPass;
-				}
-				if (highlight)
-				{
-					renderState.pbrConstants.emissiveOutputScalar += vec4(0.2f, 0.2f, 0.2f, 0.f);
-				}
-				renderState.pbrEffect->SetTexture(deviceContext,renderState.pbrEffect_globalIlluminationTexture, globalIlluminationTexture ? globalIlluminationTexture->GetSimulTexture() : nullptr);
 
-				renderState.pbrEffect->SetTexture(deviceContext,renderState.pbrEffect_diffuseCubemap,renderState.diffuseCubemapTexture);
-				// If lighting is via static textures.
-				if(renderState.lastSetupCommand.backgroundMode!=teleport::core::BackgroundMode::VIDEO&&renderState.lastSetupCommand.clientDynamicLighting.diffuseCubemapTexture!=0)
-				{
-					auto t = geometryCache.mTextureManager.Get(renderState.lastSetupCommand.clientDynamicLighting.diffuseCubemapTexture);
-					if(t)
-					{
-						renderState.pbrEffect->SetTexture(deviceContext,renderState.pbrEffect_diffuseCubemap,t->GetSimulTexture());
-					}
-				}
-				renderState.pbrEffect->SetTexture(deviceContext, renderState.pbrEffect_specularCubemap,renderState.specularCubemapTexture);
-				if(renderState.lastSetupCommand.backgroundMode!=teleport::core::BackgroundMode::VIDEO&&renderState.lastSetupCommand.clientDynamicLighting.specularCubemapTexture!=0)
-				{
-					auto t = geometryCache.mTextureManager.Get(renderState.lastSetupCommand.clientDynamicLighting.specularCubemapTexture);
-					if(t)
-					{
-						renderState.pbrEffect->SetTexture(deviceContext,renderState.pbrEffect_specularCubemap,t->GetSimulTexture());
-					}
-				}
-				
-				renderState.lightsBuffer.Apply(deviceContext, renderState.pbrEffect, renderState._lights );
-				renderState.tagDataCubeBuffer.Apply(deviceContext, renderState.pbrEffect, renderState.cubemapClearEffect_TagDataCubeBuffer);
-				renderState.tagDataIDBuffer.Apply(deviceContext, renderState.pbrEffect, renderState.pbrEffect_TagDataIDBuffer);
-
-				renderState.pbrEffect->SetConstantBuffer(deviceContext, &renderState.pbrConstants);
-				if (deviceContext.deviceContextType == crossplatform::DeviceContextType::MULTIVIEW_GRAPHICS)
-					renderState.pbrEffect->SetConstantBuffer(deviceContext, &renderState.stereoCameraConstants);
-				//else
-					renderState.pbrEffect->SetConstantBuffer(deviceContext, &renderState.cameraConstants);
-				if(double_sided)
-					renderPlatform->SetStandardRenderState(deviceContext,crossplatform::StandardRenderState::STANDARD_DOUBLE_SIDED);
-				else if(negative_scale)
-					renderPlatform->SetStandardRenderState(deviceContext,crossplatform::StandardRenderState::STANDARD_FRONTFACE_COUNTERCLOCKWISE);
-				else
-					renderPlatform->SetStandardRenderState(deviceContext,crossplatform::StandardRenderState::STANDARD_FRONTFACE_CLOCKWISE);
+				SetNodeConstants(deviceContext,*node,*material,model,highlight);
+				ApplyMaterialResources(deviceContext,*material,globalIlluminationTexture);
+				renderPlatform->SetStandardRenderState(deviceContext,standardRenderState);
 				renderPlatform->SetLayout(deviceContext, layout);
 				renderPlatform->SetTopology(deviceContext, crossplatform::Topology::TRIANGLELIST);
 				renderPlatform->SetVertexBuffers(deviceContext, 0, 1, v, layout);
 				renderPlatform->SetIndexBuffer(deviceContext, ib->GetSimulIndexBuffer());
 				renderPlatform->ApplyPass(deviceContext, pass);
 				renderPlatform->DrawIndexed(deviceContext, (int)ib->GetIndexBufferCreateInfo().indexCount, 0, 0);
+				renderStats.drawCalls++;
+				renderStats.instancesDrawn++;
 				renderState.pbrEffect->UnbindTextures(deviceContext);
 				renderPlatform->UnapplyPass(deviceContext);
 				layout->Unapply(deviceContext);
@@ -586,6 +505,307 @@ void InstanceRenderer::RenderNode(crossplatform::GraphicsDeviceContext& deviceCo
 	}
 }
 
+//[thread=RenderThread]
+void InstanceRenderer::GatherMeshDraws(crossplatform::GraphicsDeviceContext& deviceContext,const std::shared_ptr<clientrender::Node>& node,bool force)
+{
+	if (!node)
+		return;
+	// The same nodes and elements as RenderNode would draw in the opaque pass.
+	if(node->GetPriority()>=0)
+	if(node->IsVisible()&&(renderState.show_only == 0 || renderState.show_only == node->id))
+	{
+		const std::shared_ptr<clientrender::Mesh> mesh = node->GetMesh();
+		bool culled = mesh && renderState.frustum_culling && geometryCache.mNodeManager->IsCulled(node.get());
+		if(mesh)
+			(culled ? renderStats.nodesCulled : renderStats.nodesDrawn)++;
+		if(mesh && !culled)
+		{
+			const auto& meshInfo	= mesh->GetMeshCreateInfo();
+			bool force_highlight	= force||(renderState.selected_uid== node->id);
+			crossplatform::Texture* globalIlluminationTexture=GetGlobalIlluminationTexture(*node);
+			for(size_t element=0; element<node->GetMaterials().size() && element<meshInfo.ib.size(); element++)
+			{
+				clientrender::Material *material = node->GetMaterials()[element].get();
+				if(!material)
+					continue;
+				if(material->GetMaterialCreateInfo().materialMode==avs::MaterialMode::TRANSPARENT_MATERIAL)
+					continue;
+				MeshDraw draw;
+				draw.vb = meshInfo.vb[element].get();
+				draw.ib = meshInfo.ib[element].get();
+				if(!draw.vb->GetSimulVertexBuffer())
+					continue;
+				draw.pass = GetPass(deviceContext,*node,*material,draw.standardRenderState,&draw.instancedPass);
+				draw.material = material;
+				draw.skinInstance = node->GetSkinInstance().get();
+				draw.globalIlluminationTexture = globalIlluminationTexture;
+				draw.node = node.get();
+				draw.highlight = node->IsHighlighted()||force_highlight||(renderState.selected_uid == material->id);
+				draw.lightmapScaleOffset = *(const vec4*)(&(node->GetLightmapScaleOffset()));
+				meshDraws.push_back(draw);
+			}
+		}
+	}
+	for(std::weak_ptr<clientrender::Node> childPtr : node->GetChildren())
+	{
+		std::shared_ptr<clientrender::Node> child = childPtr.lock();
+		if(child)
+		{
+			GatherMeshDraws(deviceContext,child,false);
+		}
+	}
+}
+
+//[thread=RenderThread]
+void InstanceRenderer::DrawMeshGroups(crossplatform::GraphicsDeviceContext& deviceContext)
+{
+	auto renderPlatform=deviceContext.renderPlatform;
+	// Group the draws that share all their state. The draws were gathered nearest first, so numbering the states in the order
+	// they are first met puts the groups in order of their nearest draw. The sort is stable, so each group stays in near-to-far
+	// order, and as it doesn't compare addresses, the order is the same from run to run.
+	meshDrawGroups.clear();
+	for(MeshDraw& draw:meshDraws)
+		draw.group=meshDrawGroups.emplace(draw,(uint32_t)meshDrawGroups.size()).first->second;
+	std::stable_sort(meshDraws.begin(),meshDraws.end(),[](const MeshDraw& a,const MeshDraw& b)
+	{
+		return a.group<b.group;
+	});
+	auto GroupEnd=[this](size_t begin)
+	{
+		size_t end=begin+1;
+		while(end<meshDraws.size()&&meshDraws[end].group==meshDraws[begin].group)
+			end++;
+		return end;
+	};
+	// The world matrices of every group that is drawn instanced go into the instances buffer together, a run to each group.
+	size_t instanceCount=0;
+	for(size_t begin=0,end=0;begin<meshDraws.size();begin=end)
+	{
+		end=GroupEnd(begin);
+		if(meshDraws[begin].instancedPass&&end-begin>1)
+			instanceCount+=end-begin;
+	}
+	PbrInstance* instances=nullptr;
+	if(instanceCount)
+	{
+		if(instanceCount>(size_t)renderState.instancesBuffer.count)
+			renderState.instancesBuffer.RestoreDeviceObjects(renderPlatform,(int)instanceCount,false,false,nullptr,"instances");
+		instances=renderState.instancesBuffer.GetBuffer(deviceContext);
+	}
+	int firstInstance=0;
+	for(size_t begin=0,end=0;begin<meshDraws.size();begin=end)
+	{
+		end=GroupEnd(begin);
+		const MeshDraw& first=meshDraws[begin];
+		int groupSize=(int)(end-begin);
+		bool instanced=instances&&first.instancedPass&&groupSize>1;
+
+		// Bind the group's resources and pipeline once.
+		crossplatform::Layout* layout = first.vb->GetLayout();
+		const crossplatform::Buffer* const v[] = {first.vb->GetSimulVertexBuffer()};
+		int indexCount=(int)first.ib->GetIndexBufferCreateInfo().indexCount;
+		mat4 model=SetModelConstants(deviceContext,*first.node);
+		renderState.pbrConstants.firstInstance=instanced?firstInstance:0;
+		SetNodeConstants(deviceContext,*first.node,*first.material,model,first.highlight);
+		ApplyMaterialResources(deviceContext,*first.material,first.globalIlluminationTexture);
+		renderPlatform->SetStandardRenderState(deviceContext,first.standardRenderState);
+		renderPlatform->SetLayout(deviceContext, layout);
+		renderPlatform->SetTopology(deviceContext, crossplatform::Topology::TRIANGLELIST);
+		renderPlatform->SetVertexBuffers(deviceContext, 0, 1, v, layout);
+		renderPlatform->SetIndexBuffer(deviceContext, first.ib->GetSimulIndexBuffer());
+		if(instanced)
+		{
+			// The nodes of the group differ only in their world matrices, so they are drawn together, each instance taking its own.
+			for(size_t i=begin;i<end;i++)
+			{
+				const mat4& globalTransformMatrix = meshDraws[i].node->GetGlobalTransform().GetTransformMatrix();
+				instances[firstInstance+(i-begin)].world = reinterpret_cast<const float*>(&globalTransformMatrix);
+			}
+			renderState.instancesBuffer.Apply(deviceContext, renderState.pbrEffect, renderState.pbrEffect_instances);
+			renderPlatform->ApplyPass(deviceContext, first.instancedPass);
+			renderPlatform->DrawIndexedInstanced(deviceContext, indexCount, groupSize, 0, 0, 0);
+			renderStats.drawCalls++;
+			renderStats.instancesDrawn+=groupSize;
+			firstInstance+=groupSize;
+		}
+		else
+		{
+			// Skinned nodes have bone matrices of their own, and some passes have no instanced version: these take a call to each node.
+			renderPlatform->ApplyPass(deviceContext, first.pass);
+			for(size_t i=begin;i<end;i++)
+			{
+				const MeshDraw& draw=meshDraws[i];
+				if(i!=begin)
+				{
+					model=SetModelConstants(deviceContext,*draw.node);
+					SetNodeConstants(deviceContext,*draw.node,*draw.material,model,draw.highlight);
+				}
+				renderPlatform->DrawIndexed(deviceContext, indexCount, 0, 0);
+				renderStats.drawCalls++;
+				renderStats.instancesDrawn++;
+			}
+		}
+		renderState.pbrEffect->UnbindTextures(deviceContext);
+		renderPlatform->UnapplyPass(deviceContext);
+		layout->Unapply(deviceContext);
+	}
+	renderState.pbrConstants.firstInstance=0;
+	meshDraws.clear();
+}
+
+crossplatform::Texture* InstanceRenderer::GetGlobalIlluminationTexture(const clientrender::Node& node)
+{
+	if(!node.GetGlobalIlluminationTextureUid())
+		return nullptr;
+	std::shared_ptr<clientrender::Texture> globalIlluminationTexture = geometryCache.mTextureManager.Get(node.GetGlobalIlluminationTextureUid());
+	return globalIlluminationTexture ? globalIlluminationTexture->GetSimulTexture() : nullptr;
+}
+
+crossplatform::EffectPass* InstanceRenderer::GetPass(crossplatform::GraphicsDeviceContext& deviceContext,const clientrender::Node& node,const clientrender::Material& material
+	,crossplatform::StandardRenderState& standardRenderState,crossplatform::EffectPass** instancedPass)
+{
+	const clientrender::Material::MaterialCreateInfo& matInfo = material.GetMaterialCreateInfo();
+	bool transparent	=(matInfo.materialMode==avs::MaterialMode::TRANSPARENT_MATERIAL);
+	bool anim			=node.GetSkinInstance()!=nullptr;
+	bool multiview		=deviceContext.AsMultiviewGraphicsDeviceContext()!=nullptr;
+	ShaderPassSetup * shaderPassSetup = multiview?(transparent?&renderState.pbrEffect_transparentMultiview:(anim?&renderState.pbrEffect_solidAnimMultiview:&renderState.pbrEffect_solidMultiview))
+												:(transparent?&renderState.pbrEffect_transparent:(anim?&renderState.pbrEffect_solidAnim:&renderState.pbrEffect_solid));
+
+	// Pass used for rendering geometry.
+	crossplatform::EffectPass *pass=nullptr;
+	bool double_sided=false;
+	if(shaderPassSetup->overridePass)
+		pass=shaderPassSetup->overridePass;
+	else
+	{
+		if(node.IsStatic())
+			pass=shaderPassSetup->lightmapPass;
+		else
+			pass=shaderPassSetup->noLightmapPass;
+	}
+	if(matInfo.shader.length())
+	{
+		pass=shaderPassSetup->technique->GetPass(matInfo.shader.c_str());
+		double_sided=true;
+	}
+	if(!pass)
+	{
+		TELEPORT_CERR<<"Pass not found in "<<shaderPassSetup->technique->name.c_str()<<"\n";
+		pass=renderState.pbrEffect_solid.noLightmapPass;
+	}
+	// A mirroring transform reverses the winding of the triangles.
+	auto sc=node.GetGlobalScale();
+	bool negative_scale=(sc.x*sc.y*sc.z)<0.0f;
+	if(double_sided)
+		standardRenderState=crossplatform::StandardRenderState::STANDARD_DOUBLE_SIDED;
+	else if(negative_scale)
+		standardRenderState=crossplatform::StandardRenderState::STANDARD_FRONTFACE_COUNTERCLOCKWISE;
+	else
+		standardRenderState=crossplatform::StandardRenderState::STANDARD_FRONTFACE_CLOCKWISE;
+	// Only the standard opaque passes have instanced versions.
+	if(instancedPass)
+	{
+		if(pass==shaderPassSetup->lightmapPass)
+			*instancedPass=shaderPassSetup->lightmapInstancedPass;
+		else if(pass==shaderPassSetup->noLightmapPass)
+			*instancedPass=shaderPassSetup->noLightmapInstancedPass;
+		else
+			*instancedPass=nullptr;
+	}
+	return pass;
+}
+
+mat4 InstanceRenderer::SetModelConstants(crossplatform::GraphicsDeviceContext& deviceContext,const clientrender::Node& node)
+{
+	const mat4& globalTransformMatrix = node.GetGlobalTransform().GetTransformMatrix();
+	mat4 model = reinterpret_cast<const float*>(&globalTransformMatrix);
+	static bool override_model=false;
+	if(override_model)
+	{
+		model=mat4::identity();
+	}
+
+	if (deviceContext.deviceContextType == crossplatform::DeviceContextType::MULTIVIEW_GRAPHICS)
+	{
+		crossplatform::MultiviewGraphicsDeviceContext& mgdc = *deviceContext.AsMultiviewGraphicsDeviceContext();
+		mat4::mul(renderState.stereoCameraConstants.leftWorldViewProj, *((mat4*)&mgdc.viewStructs[0].viewProj), model);
+		renderState.stereoCameraConstants.leftWorld = model;
+		mat4::mul(renderState.stereoCameraConstants.rightWorldViewProj, *((mat4*)&mgdc.viewStructs[1].viewProj), model);
+		renderState.stereoCameraConstants.rightWorld = model;
+	}
+	//else
+	{
+		mat4::mul(renderState.cameraConstants.worldViewProj, *((mat4*)&deviceContext.viewStruct.viewProj), model);
+		renderState.cameraConstants.world = model;
+	}
+	return model;
+}
+
+void InstanceRenderer::SetNodeConstants(crossplatform::GraphicsDeviceContext& deviceContext,const clientrender::Node& node,const clientrender::Material& material,const mat4& model,bool highlight)
+{
+	std::shared_ptr<clientrender::SkinInstance> skinInstance = node.GetSkinInstance();
+	if (skinInstance)
+	{
+		mat4* scr_matrices = skinInstance->GetBoneMatrices(model);
+		BoneMatrices *b=static_cast<BoneMatrices*>(&renderState.boneMatrices);
+		memcpy(b, scr_matrices, sizeof(mat4) * clientrender::Skin::MAX_BONES);
+
+		renderState.pbrEffect->SetConstantBuffer(deviceContext, &renderState.boneMatrices);
+		//usedPassName = "anim_" + usedPassName;
+	}
+	const clientrender::Material::MaterialData& md = material.GetMaterialData();
+	memcpy(&renderState.pbrConstants.diffuseOutputScalar, &md, sizeof(md));
+	renderState.pbrConstants.lightmapScaleOffset=*(const vec4*)(&(node.GetLightmapScaleOffset()));
+	if (highlight)
+	{
+		renderState.pbrConstants.emissiveOutputScalar += vec4(0.2f, 0.2f, 0.2f, 0.f);
+	}
+	renderState.pbrEffect->SetConstantBuffer(deviceContext, &renderState.pbrConstants);
+	if (deviceContext.deviceContextType == crossplatform::DeviceContextType::MULTIVIEW_GRAPHICS)
+		renderState.pbrEffect->SetConstantBuffer(deviceContext, &renderState.stereoCameraConstants);
+	//else
+		renderState.pbrEffect->SetConstantBuffer(deviceContext, &renderState.cameraConstants);
+}
+
+void InstanceRenderer::ApplyMaterialResources(crossplatform::GraphicsDeviceContext& deviceContext,const clientrender::Material& material,crossplatform::Texture* globalIlluminationTexture)
+{
+	const clientrender::Material::MaterialCreateInfo& matInfo = material.GetMaterialCreateInfo();
+	std::shared_ptr<clientrender::Texture> diffuse	= matInfo.diffuse.texture;
+	std::shared_ptr<clientrender::Texture> normal	= matInfo.normal.texture;
+	std::shared_ptr<clientrender::Texture> combined = matInfo.combined.texture;
+	std::shared_ptr<clientrender::Texture> emissive = matInfo.emissive.texture;
+	
+	renderState.pbrEffect->SetTexture(deviceContext, renderState.pbrEffect_diffuseTexture	,diffuse ? diffuse->GetSimulTexture() : nullptr);
+	renderState.pbrEffect->SetTexture(deviceContext, renderState.pbrEffect_normalTexture	,normal ? normal->GetSimulTexture() : nullptr);
+	renderState.pbrEffect->SetTexture(deviceContext, renderState.pbrEffect_combinedTexture	,combined ? combined->GetSimulTexture() : nullptr);
+	renderState.pbrEffect->SetTexture(deviceContext, renderState.pbrEffect_emissiveTexture	,emissive ? emissive->GetSimulTexture() : nullptr);
+	renderState.pbrEffect->SetTexture(deviceContext,renderState.pbrEffect_globalIlluminationTexture, globalIlluminationTexture);
+
+	renderState.pbrEffect->SetTexture(deviceContext,renderState.pbrEffect_diffuseCubemap,renderState.diffuseCubemapTexture);
+	// If lighting is via static textures.
+	if(renderState.lastSetupCommand.backgroundMode!=teleport::core::BackgroundMode::VIDEO&&renderState.lastSetupCommand.clientDynamicLighting.diffuseCubemapTexture!=0)
+	{
+		auto t = geometryCache.mTextureManager.Get(renderState.lastSetupCommand.clientDynamicLighting.diffuseCubemapTexture);
+		if(t)
+		{
+			renderState.pbrEffect->SetTexture(deviceContext,renderState.pbrEffect_diffuseCubemap,t->GetSimulTexture());
+		}
+	}
+	renderState.pbrEffect->SetTexture(deviceContext, renderState.pbrEffect_specularCubemap,renderState.specularCubemapTexture);
+	if(renderState.lastSetupCommand.backgroundMode!=teleport::core::BackgroundMode::VIDEO&&renderState.lastSetupCommand.clientDynamicLighting.specularCubemapTexture!=0)
+	{
+		auto t = geometryCache.mTextureManager.Get(renderState.lastSetupCommand.clientDynamicLighting.specularCubemapTexture);
+		if(t)
+		{
+			renderState.pbrEffect->SetTexture(deviceContext,renderState.pbrEffect_specularCubemap,t->GetSimulTexture());
+		}
+	}
+	
+	renderState.lightsBuffer.Apply(deviceContext, renderState.pbrEffect, renderState._lights );
+	renderState.tagDataCubeBuffer.Apply(deviceContext, renderState.pbrEffect, renderState.cubemapClearEffect_TagDataCubeBuffer);
+	renderState.tagDataIDBuffer.Apply(deviceContext, renderState.pbrEffect, renderState.pbrEffect_TagDataIDBuffer);
+}
+
 void InstanceRenderer::RenderTextCanvas(crossplatform::GraphicsDeviceContext& deviceContext,const std::shared_ptr<TextCanvas> textCanvas)
 {
 	auto fontAtlas=geometryCache.mFontAtlasManager.Get(textCanvas->textCanvasCreateInfo.font);
@@ -744,8 +964,6 @@ void InstanceRenderer::SetNodeAnimationSpeed(avs::uid nodeID, avs::uid animation
 void InstanceRenderer::UpdateTagDataBuffers(crossplatform::GraphicsDeviceContext& deviceContext)
 {				
 	{
-		std::unique_ptr<std::lock_guard<std::mutex>> cacheLock;
-		auto &cachedLights=geometryCache.mLightManager.GetCache(cacheLock);
 		for (int i = 0; i < videoTagDataCubeArray.size(); ++i)
 		{
 			const auto& td = videoTagDataCubeArray[i];
@@ -779,10 +997,10 @@ void InstanceRenderer::UpdateTagDataBuffers(crossplatform::GraphicsDeviceContext
 				t.direction=q*vec3(0,0,1.0f);
 				t.worldToShadowMatrix	=ConvertMat4(l.worldToShadowMatrix);
 
-				auto nodeLight=cachedLights.find(l.uid);
-				if(nodeLight!=cachedLights.end()&& nodeLight->second.resource!=nullptr)
+				auto nodeLight=geometryCache.mLightManager.Get(l.uid);
+				if(nodeLight)
 				{
-					const clientrender::Light::LightCreateInfo &lc=nodeLight->second.resource->GetLightCreateInfo();
+					const clientrender::Light::LightCreateInfo &lc=nodeLight->GetLightCreateInfo();
 					t.is_point=float(lc.type!=clientrender::Light::Type::DIRECTIONAL);
 					t.is_spot=float(lc.type==clientrender::Light::Type::SPOT);
 					t.radius=lc.lightRadius;
@@ -843,6 +1061,16 @@ void InstanceRenderer::ClearGeometryResources()
 	resourceCreator.Clear();
 }
 
+std::vector<uint64_t> InstanceRenderer::GetCachedResourceHashes()
+{
+	return resourceCreator.GetCachedResourceHashes();
+}
+
+void InstanceRenderer::OnResourceContentHashes(const std::vector<teleport::core::ResourceContentHash>& hashes)
+{
+	resourceCreator.SetResourceContentHashes(hashes);
+}
+
 void InstanceRenderer::OnLightingSetupChanged(const teleport::core::SetupLightingCommand &l)
 {
 	renderState.lastSetupLightingCommand=l;
@@ -992,7 +1220,10 @@ bool InstanceRenderer::OnSetupCommandReceived(const char *server_ip,const telepo
 		TELEPORT_CERR << "Failed to configure output surface node!\n";
 	}
 
-	clientPipeline.videoQueue.configure(300000, 16, "VideoQueue");
+	// The network source's thread is the only writer to the video, tag data and audio queues, and the decoders the only readers,
+	// so these queues can be lock-free rings. The geometry queue also takes files from the HTTP thread, and payloads of any size,
+	// so it keeps the locking queue, which grows to fit. A ring can't grow, so its maximum buffer size must allow for the largest keyframe.
+	clientPipeline.videoQueue.configureSPSC(16 * 1024 * 1024, 16 * 1024 * 1024, "VideoQueue");
 
 	avs::PipelineNode::link(clientPipeline.source, clientPipeline.videoQueue);
 	avs::PipelineNode::link(clientPipeline.videoQueue, clientPipeline.decoder);
@@ -1006,7 +1237,7 @@ bool InstanceRenderer::OnSetupCommandReceived(const char *server_ip,const telepo
 			TELEPORT_CERR << "Failed to configure video tag data decoder node!\n";
 		}
 
-		clientPipeline.tagDataQueue.configure(200, 16, "clientPipeline.tagDataQueue");
+		clientPipeline.tagDataQueue.configureSPSC(4 * 1024, 64 * 1024, "clientPipeline.tagDataQueue");
 
 		avs::PipelineNode::link(clientPipeline.source, clientPipeline.tagDataQueue);
 		clientPipeline.pipeline.link({ &clientPipeline.tagDataQueue, &clientPipeline.tagDataDecoder });
@@ -1028,7 +1259,7 @@ bool InstanceRenderer::OnSetupCommandReceived(const char *server_ip,const telepo
 		#endif
 		clientPipeline.avsAudioTarget.configure(audioStreamTarget.get());
 
-		clientPipeline.audioQueue.configure(4096, 120, "AudioQueue");
+		clientPipeline.audioQueue.configureSPSC(64 * 1024, 512 * 1024, "AudioQueue");
 
 		avs::PipelineNode::link(clientPipeline.source, clientPipeline.audioQueue);
 		avs::PipelineNode::link(clientPipeline.audioQueue, clientPipeline.avsAudioDecoder);
@@ -2,6 +2,8 @@
 #pragma once
 
 #include "Common.h"
+#include <cstring>
+#include <unordered_map>
 #include <libavstream/surfaces/surface_interface.hpp>
 #include "Platform/CrossPlatform/DeviceContext.h"
 #include "Node.h"
@@ -56,6 +58,9 @@ namespace clientrender
 		platform::crossplatform::EffectPass			*lightmapPass			=nullptr;
 		platform::crossplatform::EffectPass			*noLightmapPass			=nullptr;
 		platform::crossplatform::EffectPass			*overridePass			=nullptr;
+		// The same as lightmapPass and noLightmapPass, but taking each instance's world matrix from the instances buffer.
+		platform::crossplatform::EffectPass			*lightmapInstancedPass		=nullptr;
+		platform::crossplatform::EffectPass			*noLightmapInstancedPass	=nullptr;
 	};
 	struct RenderState
 	{
@@ -63,6 +68,8 @@ namespace clientrender
 		avs::uid show_only=0;
 		avs::uid selected_uid=0;
 		bool show_node_overlays			=false;
+		bool frustum_culling			=true;
+		bool group_opaque_draws			=true;
 		static constexpr int maxTagDataSize = 32;
 		teleport::core::SetupCommand lastSetupCommand;
 		teleport::core::SetupLightingCommand lastSetupLightingCommand;
@@ -95,6 +102,7 @@ namespace clientrender
 		platform::crossplatform::ShaderResource RWTextureTargetArray;
 		platform::crossplatform::ShaderResource cubemapClearEffect_TagDataIDBuffer;
 		platform::crossplatform::ShaderResource pbrEffect_TagDataIDBuffer;
+		platform::crossplatform::ShaderResource pbrEffect_instances;
 		platform::crossplatform::ShaderResource pbrEffect_specularCubemap,pbrEffect_diffuseCubemap;
 		platform::crossplatform::ShaderResource pbrEffect_diffuseTexture;
 		platform::crossplatform::ShaderResource pbrEffect_normalTexture;
@@ -110,12 +118,23 @@ namespace clientrender
 		platform::crossplatform::ConstantBuffer<BoneMatrices> boneMatrices;
 		platform::crossplatform::StructuredBuffer<VideoTagDataCube> tagDataCubeBuffer;
 		platform::crossplatform::StructuredBuffer<PbrLight> lightsBuffer;
+		platform::crossplatform::StructuredBuffer<PbrInstance> instancesBuffer;
 	};
 	//! API objects that are per-server.
 	struct InstanceRenderState
 	{
 		AVSTextureHandle avsTexture;
 	};
+	//! Counts of the work done by the last call to InstanceRenderer::RenderLocalNodes.
+	struct RenderStats
+	{
+		uint32_t nodesTested	=0;		//Bounding boxes tested against the view frusta.
+		uint32_t nodesCulled	=0;		//Nodes with meshes that were out of view.
+		uint32_t nodesDrawn		=0;		//Nodes with meshes that were in view, or could not be culled.
+		uint32_t drawCalls		=0;		//Draw calls for mesh elements.
+		uint32_t instancesDrawn	=0;		//Mesh elements drawn, several to a call where nodes share a mesh and material.
+		float submitTimeMs		=0.0f;	//CPU time taken to cull the nodes and submit their draw calls.
+	};
 	//! Renderer that draws for a specific server.
 	//! There will be one instance of a derived class of clientrender::Renderer for each attached server.
 	class InstanceRenderer:public teleport::client::SessionCommandInterface
@@ -127,6 +146,67 @@ namespace clientrender
 		teleport::client::SessionClient *sessionClient=nullptr;
 		RenderState &renderState;
 		InstanceRenderState instanceRenderState;
+		RenderStats renderStats;
+		//! A mesh element to be drawn in the opaque pass, with everything that decides which draws can share state.
+		struct MeshDraw
+		{
+			platform::crossplatform::EffectPass				*pass						=nullptr;
+			// The instanced version of pass, if it has one.
+			platform::crossplatform::EffectPass				*instancedPass				=nullptr;
+			const clientrender::Material					*material					=nullptr;
+			clientrender::VertexBuffer						*vb							=nullptr;
+			const clientrender::IndexBuffer					*ib							=nullptr;
+			const clientrender::SkinInstance				*skinInstance				=nullptr;
+			platform::crossplatform::Texture				*globalIlluminationTexture	=nullptr;
+			platform::crossplatform::StandardRenderState	standardRenderState;
+			clientrender::Node								*node						=nullptr;
+			bool											highlight					=false;
+			vec4											lightmapScaleOffset;
+			// Index of the draw's state among the states of the frame, in the order they were first gathered.
+			uint32_t										group						=0;
+
+			bool SharesStateWith(const MeshDraw& d) const
+			{
+				return pass==d.pass&&material==d.material&&vb==d.vb&&ib==d.ib&&skinInstance==d.skinInstance
+					&&globalIlluminationTexture==d.globalIlluminationTexture&&standardRenderState==d.standardRenderState
+					&&highlight==d.highlight&&memcmp(&lightmapScaleOffset,&d.lightmapScaleOffset,sizeof(lightmapScaleOffset))==0;
+			}
+		};
+		struct MeshDrawStateHash
+		{
+			size_t operator()(const MeshDraw& d) const
+			{
+				size_t h=std::hash<const void*>()(d.pass);
+				for(const void* p:{(const void*)d.material,(const void*)d.vb,(const void*)d.ib,(const void*)d.skinInstance,(const void*)d.globalIlluminationTexture})
+					h=h*31+std::hash<const void*>()(p);
+				return (h*31+(size_t)d.standardRenderState)*2+(d.highlight?1:0);
+			}
+		};
+		struct MeshDrawStateEqual
+		{
+			bool operator()(const MeshDraw& a,const MeshDraw& b) const
+			{
+				return a.SharesStateWith(b);
+			}
+		};
+		// Scratch space for the opaque draws of a frame, kept to avoid reallocating.
+		std::vector<MeshDraw> meshDraws;
+		// Scratch space mapping each state of the frame's opaque draws to its group.
+		std::unordered_map<MeshDraw,uint32_t,MeshDrawStateHash,MeshDrawStateEqual> meshDrawGroups;
+		//! Collect the opaque draws of this node and its descendants.
+		void GatherMeshDraws(platform::crossplatform::GraphicsDeviceContext& deviceContext,const std::shared_ptr<clientrender::Node>& node,bool force);
+		//! Draw the collected opaque draws, grouped by state. Each group of nodes that differ only in their world matrices is drawn
+		//! with one instanced call, its matrices taken from the instances buffer. Skinned nodes, and passes with no instanced version,
+		//! are drawn with a call to each node, still binding the group's resources once.
+		void DrawMeshGroups(platform::crossplatform::GraphicsDeviceContext& deviceContext);
+		platform::crossplatform::Texture* GetGlobalIlluminationTexture(const clientrender::Node& node);
+		platform::crossplatform::EffectPass* GetPass(platform::crossplatform::GraphicsDeviceContext& deviceContext,const clientrender::Node& node,const clientrender::Material& material
+			,platform::crossplatform::StandardRenderState& standardRenderState,platform::crossplatform::EffectPass** instancedPass=nullptr);
+		//! Set the world matrices of the camera constants for this node, and return its model matrix.
+		mat4 SetModelConstants(platform::crossplatform::GraphicsDeviceContext& deviceContext,const clientrender::Node& node);
+		//! Set the node's bone matrices and material constants, and apply the constant buffers.
+		void SetNodeConstants(platform::crossplatform::GraphicsDeviceContext& deviceContext,const clientrender::Node& node,const clientrender::Material& material,const mat4& model,bool highlight);
+		void ApplyMaterialResources(platform::crossplatform::GraphicsDeviceContext& deviceContext,const clientrender::Material& material,platform::crossplatform::Texture* globalIlluminationTexture);
 		teleport::client::Config &config;
 		GeometryDecoder &geometryDecoder;
 		static constexpr bool AudioStream	= true;
@@ -158,6 +238,10 @@ namespace clientrender
 		{
 			return instanceRenderState;
 		}
+		const RenderStats &GetRenderStats() const
+		{
+			return renderStats;
+		}
 	public:
 		InstanceRenderer(avs::uid server,teleport::client::Config &config,GeometryDecoder &geometryDecoder,RenderState &renderState,teleport::client::SessionClient *sessionClient);
 		virtual ~InstanceRenderer();
@@ -196,6 +280,8 @@ namespace clientrender
 		// Implement SessionCommandInterface
 		std::vector<avs::uid> GetGeometryResources() override;
 		void ClearGeometryResources() override;
+		std::vector<uint64_t> GetCachedResourceHashes() override;
+		void OnResourceContentHashes(const std::vector<teleport::core::ResourceContentHash>& hashes) override;
 		bool OnNodeEnteredBounds(avs::uid nodeID) override;
 		bool OnNodeLeftBounds(avs::uid nodeID) override;
 	
@@ -4,8 +4,28 @@
 #include "ClientRender/VertexBuffer.h"
 #include "ClientRender/IndexBuffer.h"
 
+#include <algorithm>
+#include <cfloat>
+
 namespace clientrender
 {
+	//! An axis-aligned box, which is empty until a point is added.
+	struct Bounds
+	{
+		avs::vec3 lower = avs::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+		avs::vec3 upper = avs::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+		bool IsEmpty() const
+		{
+			return lower.x > upper.x || lower.y > upper.y || lower.z > upper.z;
+		}
+		void Add(const avs::vec3& p)
+		{
+			lower = avs::vec3(std::min(lower.x, p.x), std::min(lower.y, p.y), std::min(lower.z, p.z));
+			upper = avs::vec3(std::max(upper.x, p.x), std::max(upper.y, p.y), std::max(upper.z, p.z));
+		}
+	};
+
 	class Mesh
 	{
 	public:
@@ -15,6 +35,7 @@ namespace clientrender
 			avs::uid id;
 			std::vector<std::shared_ptr<VertexBuffer>> vb;
 			std::vector<std::shared_ptr<IndexBuffer>> ib;
+			Bounds bounds; //The bounds of the vertices of all elements, in the mesh's own space.
 		};
 
 	protected:
@@ -0,0 +1,250 @@
+// (C) Copyright 2018-2022 Simul Software Ltd
+
+#include "MovementInterpolator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Node.h"
+
+using namespace clientrender;
+
+void MovementSnapshots::Add(const teleport::core::MovementUpdate& update, float history_ms)
+{
+	size_t i = snapshots.size();
+	while(i > 0 && snapshots[i - 1].timestamp > update.timestamp)
+		i--;
+	if(i > 0 && snapshots[i - 1].timestamp == update.timestamp)
+	{
+		snapshots[i - 1] = update;
+		return;
+	}
+	snapshots.insert(snapshots.begin() + i, update);
+	// The render time is at least history_ms behind the newest update, so keep one update at or before that, to interpolate from.
+	double oldest_ms = (double)snapshots.back().timestamp - history_ms;
+	size_t unneeded = 0;
+	while(unneeded + 1 < snapshots.size() && (double)snapshots[unneeded + 1].timestamp <= oldest_ms)
+		unneeded++;
+	snapshots.erase(snapshots.begin(), snapshots.begin() + unneeded);
+}
+
+void MovementInterpolator::Add(Node* node)
+{
+	if(node->movingIndex >= 0 || !node->movementSnapshots.Count())
+		return;
+	node->movingIndex = (int32_t)movingNodes.size();
+	movingNodes.push_back(node);
+}
+
+void MovementInterpolator::Remove(Node* node)
+{
+	int32_t index = node->movingIndex;
+	if(index < 0)
+		return;
+	node->movingIndex = -1;
+	Node* last = movingNodes.back();
+	movingNodes.pop_back();
+	if(last != node)
+	{
+		movingNodes[index] = last;
+		last->movingIndex = index;
+	}
+}
+
+void MovementInterpolator::Clear()
+{
+	for(Node* node : movingNodes)
+		node->movingIndex = -1;
+	movingNodes.clear();
+}
+
+void MovementInterpolator::Resize(size_t count)
+{
+	settled.resize(count);
+	for(int c = 0; c < 3; c++)
+	{
+		position0[c].resize(count);
+		position1[c].resize(count);
+		scale0[c].resize(count);
+		scale1[c].resize(count);
+		velocity[c].resize(count);
+		angularVelocity[c].resize(count);
+		position[c].resize(count);
+		scale[c].resize(count);
+	}
+	for(int c = 0; c < 4; c++)
+	{
+		rotation0[c].resize(count);
+		rotation1[c].resize(count);
+		rotation[c].resize(count);
+	}
+	blend.resize(count);
+	extrapolation.resize(count);
+}
+
+void MovementInterpolator::Gather(size_t index, double renderTime_ms, float maxExtrapolation_ms)
+{
+	const MovementSnapshots& snapshots = movingNodes[index]->movementSnapshots;
+	const teleport::core::MovementUpdate* from = &snapshots.snapshots[0];
+	const teleport::core::MovementUpdate* to = from;
+	const teleport::core::MovementUpdate& newest = snapshots.snapshots.back();
+	float t = 0.0f;
+	float extrapolate_s = 0.0f;
+	avs::vec3 v = {0, 0, 0};
+	avs::vec3 w = {0, 0, 0};
+	bool rest = false;
+	if(renderTime_ms >= (double)newest.timestamp)
+	{
+		// Past the newest update: follow its velocity, up to the limit.
+		from = to = &newest;
+		double ahead_ms = std::min(renderTime_ms - (double)newest.timestamp, (double)maxExtrapolation_ms);
+		extrapolate_s = (float)(ahead_ms / 1000.0);
+		v = newest.velocity;
+		w = newest.angularVelocityAxis * newest.angularVelocityAngle;
+		bool stationary = v.x == 0.0f && v.y == 0.0f && v.z == 0.0f && newest.angularVelocityAngle == 0.0f;
+		rest = stationary || ahead_ms >= (double)maxExtrapolation_ms;
+	}
+	else if(renderTime_ms > (double)from->timestamp)
+	{
+		size_t i = 1;
+		while((double)snapshots.snapshots[i].timestamp < renderTime_ms)
+			i++;
+		from = &snapshots.snapshots[i - 1];
+		to = &snapshots.snapshots[i];
+		// Only blend between updates in the same space.
+		if(from->isGlobal == to->isGlobal)
+			t = (float)((renderTime_ms - (double)from->timestamp) / (double)(to->timestamp - from->timestamp));
+		else
+			from = to;
+	}
+	settled[index] = rest ? 1 : 0;
+
+	position0[0][index] = from->position.x;
+	position0[1][index] = from->position.y;
+	position0[2][index] = from->position.z;
+	position1[0][index] = to->position.x;
+	position1[1][index] = to->position.y;
+	position1[2][index] = to->position.z;
+	rotation0[0][index] = from->rotation.x;
+	rotation0[1][index] = from->rotation.y;
+	rotation0[2][index] = from->rotation.z;
+	rotation0[3][index] = from->rotation.w;
+	rotation1[0][index] = to->rotation.x;
+	rotation1[1][index] = to->rotation.y;
+	rotation1[2][index] = to->rotation.z;
+	rotation1[3][index] = to->rotation.w;
+	scale0[0][index] = from->scale.x;
+	scale0[1][index] = from->scale.y;
+	scale0[2][index] = from->scale.z;
+	scale1[0][index] = to->scale.x;
+	scale1[1][index] = to->scale.y;
+	scale1[2][index] = to->scale.z;
+	blend[index] = t;
+	velocity[0][index] = v.x;
+	velocity[1][index] = v.y;
+	velocity[2][index] = v.z;
+	angularVelocity[0][index] = w.x;
+	angularVelocity[1][index] = w.y;
+	angularVelocity[2][index] = w.z;
+	extrapolation[index] = extrapolate_s;
+}
+
+void MovementInterpolator::Interpolate(size_t count)
+{
+	// Each loop works on one component of every node, with no branches, so that it can be vectorised.
+	const float* t = blend.data();
+	const float* e = extrapolation.data();
+	for(int c = 0; c < 3; c++)
+	{
+		const float* p0 = position0[c].data();
+		const float* p1 = position1[c].data();
+		const float* v = velocity[c].data();
+		const float* s0 = scale0[c].data();
+		const float* s1 = scale1[c].data();
+		float* p = position[c].data();
+		float* s = scale[c].data();
+		for(size_t i = 0; i < count; i++)
+		{
+			p[i] = p0[i] + (p1[i] - p0[i]) * t[i] + v[i] * e[i];
+			s[i] = s0[i] + (s1[i] - s0[i]) * t[i];
+		}
+	}
+
+	// Normalised lerp of the rotations, taking the shorter way round.
+	const float* ax = rotation0[0].data();
+	const float* ay = rotation0[1].data();
+	const float* az = rotation0[2].data();
+	const float* aw = rotation0[3].data();
+	const float* bx = rotation1[0].data();
+	const float* by = rotation1[1].data();
+	const float* bz = rotation1[2].data();
+	const float* bw = rotation1[3].data();
+	float* qx = rotation[0].data();
+	float* qy = rotation[1].data();
+	float* qz = rotation[2].data();
+	float* qw = rotation[3].data();
+	for(size_t i = 0; i < count; i++)
+	{
+		float d = ax[i] * bx[i] + ay[i] * by[i] + az[i] * bz[i] + aw[i] * bw[i];
+		float tb = d < 0.0f ? -t[i] : t[i];
+		float ta = 1.0f - t[i];
+		float x = ax[i] * ta + bx[i] * tb;
+		float y = ay[i] * ta + by[i] * tb;
+		float z = az[i] * ta + bz[i] * tb;
+		float w = aw[i] * ta + bw[i] * tb;
+		float lengthSquared = x * x + y * y + z * z + w * w;
+		float r = lengthSquared > 0.0f ? 1.0f / std::sqrt(lengthSquared) : 0.0f;
+		qx[i] = x * r;
+		qy[i] = y * r;
+		qz[i] = z * r;
+		qw[i] = w * r;
+	}
+
+	// Then turn by the angular velocity for the extrapolated time: by the quaternion (axis*sin(a/2),cos(a/2)),
+	// where axis*a is the angular velocity times the time. The server sends the angular velocity in world space,
+	// so the turn is applied after the rotation, i.e. d*q, rather than in the node's own frame.
+	const float* wx = angularVelocity[0].data();
+	const float* wy = angularVelocity[1].data();
+	const float* wz = angularVelocity[2].data();
+	for(size_t i = 0; i < count; i++)
+	{
+		float hx = wx[i] * e[i] * 0.5f;
+		float hy = wy[i] * e[i] * 0.5f;
+		float hz = wz[i] * e[i] * 0.5f;
+		float halfAngle = std::sqrt(hx * hx + hy * hy + hz * hz);
+		float sinc = halfAngle > 0.0f ? std::sin(halfAngle) / halfAngle : 1.0f;
+		float dx = hx * sinc;
+		float dy = hy * sinc;
+		float dz = hz * sinc;
+		float dw = std::cos(halfAngle);
+		float x = qx[i], y = qy[i], z = qz[i], w = qw[i];
+		qx[i] = dw * x + dx * w + dy * z - dz * y;
+		qy[i] = dw * y - dx * z + dy * w + dz * x;
+		qz[i] = dw * z + dx * y - dy * x + dz * w;
+		qw[i] = dw * w - dx * x - dy * y - dz * z;
+	}
+}
+
+void MovementInterpolator::Update(double renderTime_ms, float maxExtrapolation_ms)
+{
+	size_t count = movingNodes.size();
+	if(!count)
+		return;
+	Resize(count);
+	for(size_t i = 0; i < count; i++)
+		Gather(i, renderTime_ms, maxExtrapolation_ms);
+	Interpolate(count);
+	for(size_t i = 0; i < count; i++)
+	{
+		avs::vec3 p(position[0][i], position[1][i], position[2][i]);
+		quat q(rotation[0][i], rotation[1][i], rotation[2][i], rotation[3][i]);
+		avs::vec3 s(scale[0][i], scale[1][i], scale[2][i]);
+		movingNodes[i]->UpdateModelMatrix(p, q, s);
+	}
+	// Nodes that have come to rest keep their last transform, and are not updated again until they receive a new movement.
+	for(size_t i = count; i-- > 0;)
+	{
+		if(settled[i])
+			Remove(movingNodes[i]);
+	}
+}
@@ -0,0 +1,72 @@
+// (C) Copyright 2018-2022 Simul Software Ltd
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "TeleportCore/CommonNetworking.h"
+
+namespace clientrender
+{
+	class Node;
+
+	//! The movement updates received for a node, in order of their server timestamps, going back far enough to interpolate
+	//! at the render time however often they arrive: all those within history_ms of the newest, and the one before them.
+	struct MovementSnapshots
+	{
+		std::vector<teleport::core::MovementUpdate> snapshots;
+
+		//! Insert the update in order, replacing one with the same timestamp, and drop those no longer needed.
+		void Add(const teleport::core::MovementUpdate& update, float history_ms);
+		size_t Count() const
+		{
+			return snapshots.size();
+		}
+		void Clear()
+		{
+			snapshots.clear();
+		}
+	};
+
+	//! Moves the nodes that have received movement updates smoothly, whenever and however unevenly the updates arrive.
+	//! Each node is shown as it was at a time a little behind the server's, so there is usually an update on either side
+	//! to interpolate between. Past its newest update, a node follows its last velocity, for a limited time.
+	//! Nodes are only tracked while they move, and the interpolation is done for all of them together, over flat arrays
+	//! of each component, which the compiler can vectorise.
+	class MovementInterpolator
+	{
+	public:
+		//! Start moving the node, whose snapshots have changed.
+		void Add(Node* node);
+		void Remove(Node* node);
+		void Clear();
+		//! Set the transforms of all moving nodes as they were at this server time.
+		//! Nodes are extrapolated at most maxExtrapolation_ms beyond their newest update; once there, they stop being tracked.
+		void Update(double renderTime_ms, float maxExtrapolation_ms);
+		size_t GetMovingNodeCount() const
+		{
+			return movingNodes.size();
+		}
+
+	private:
+		std::vector<Node*> movingNodes;
+		std::vector<uint8_t> settled;
+		// Per moving node: positions, rotations and scales to blend between, the blend factor, and the velocities to extrapolate with
+		// for the given number of seconds.
+		std::vector<float> position0[3], position1[3];
+		std::vector<float> rotation0[4], rotation1[4];
+		std::vector<float> scale0[3], scale1[3];
+		std::vector<float> blend;
+		std::vector<float> velocity[3];
+		std::vector<float> angularVelocity[3];
+		std::vector<float> extrapolation;
+		// The results.
+		std::vector<float> position[3];
+		std::vector<float> rotation[4];
+		std::vector<float> scale[3];
+
+		void Resize(size_t count);
+		void Gather(size_t index, double renderTime_ms, float maxExtrapolation_ms);
+		void Interpolate(size_t count);
+	};
+}
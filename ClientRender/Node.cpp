@@ -1,6 +1,7 @@
 // (C) Copyright 2018-2022 Simul Software Ltd
 
 #include "Node.h"
+#include "TransformHierarchy.h"
 
 #include "TeleportClient/ServerTimestamp.h"
 
@@ -66,54 +67,35 @@ void Node::RequestTransformUpdate()
 {
 	isTransformDirty = true;
 
+	if(transformHierarchy)
+	{
+		transformHierarchy->SetLocalChanged(transformHierarchyIndex, localTransform);
+		return;
+	}
 	//The node's children need to update their transforms, as their parent's transform has been updated.
 	RequestChildrenUpdateTransforms();
 }
 
-void Node::SetLastMovement(const teleport::core::MovementUpdate& update)
+void Node::SetLastMovement(const teleport::core::MovementUpdate& update, float history_ms)
 {
-	//TODO: Use movement updates to extrapolate a transform and then linearly interpolate towards the extrapolated position, rather than setting transform to the update. This will result in smoother movement.
+	// A change between global and local transforms can't be interpolated, so start again from this update.
+	if(movementSnapshots.Count() && update.isGlobal != lastReceivedMovement.isGlobal)
+		movementSnapshots.Clear();
 	lastReceivedMovement = update;
-
-	//Set transform, then tick based on difference in time since the update was sent and now.
-	UpdateModelMatrix(update.position, update.rotation, update.scale);
-	TickExtrapolatedTransform(static_cast<float>(teleport::client::ServerTimestamp::getCurrentTimestampUTCUnixMs() - update.timestamp));
-}
-
-void Node::TickExtrapolatedTransform(float deltaTime)
-{
-	deltaTime /= 1000;
-	const Transform& transform = (ShouldUseGlobalTransform() ? GetGlobalTransform() : GetLocalTransform());
-
-	avs::vec3 newTranslation = transform.m_Translation;// + (lastReceivedMovement.velocity * deltaTime);
-
-	clientrender::quat newRotation = transform.m_Rotation;
-/*	if(lastReceivedMovement.angularVelocityAngle != 0)
-	{
-		quat deltaRotation(lastReceivedMovement.angularVelocityAngle * deltaTime, lastReceivedMovement.angularVelocityAxis);
-		newRotation *= deltaRotation;
-	}*/
-
-	UpdateModelMatrix(newTranslation, newRotation, transform.m_Scale);
+	movementSnapshots.Add(update, history_ms);
 }
 
 void Node::Update(float deltaTime_ms)
 {
-	TickExtrapolatedTransform(deltaTime_ms);
 	visibility.update(deltaTime_ms);
+}
 
-	//Attempt to animate, if we have a skin.
-	if(skinInstance&&skinInstance->GetSkin())
+void Node::UpdateAnimation(float deltaTime_ms)
+{
+	if(IsSkinned())
 	{
 		animationComponent.update(skinInstance->GetJoints(), deltaTime_ms);
 	}
-
-	for(std::weak_ptr<Node> child : children)
-	{
-		std::shared_ptr n = child.lock();
-		if(n)
-			n->Update(deltaTime_ms);
-	}
 }
 
 void Node::SetParent(std::shared_ptr<Node> newParent)
@@ -133,6 +115,8 @@ void Node::SetParent(std::shared_ptr<Node> newParent)
 	}
 	else
 		parent=newParent;
+	if(transformHierarchy)
+		transformHierarchy->SetStructureChanged();
 	// New parent may have different position.
 	RequestTransformUpdate();
 }
@@ -140,6 +124,8 @@ void Node::SetParent(std::shared_ptr<Node> newParent)
 void Node::AddChild(std::shared_ptr<Node> child)
 {
 	children.push_back(child);
+	if(transformHierarchy)
+		transformHierarchy->SetStructureChanged();
 }
 
 void Node::RemoveChild(std::shared_ptr<Node> node)
@@ -150,6 +136,8 @@ void Node::RemoveChild(std::shared_ptr<Node> node)
 		if(child == node)
 		{
 			children.erase(it);
+			if(transformHierarchy)
+				transformHierarchy->SetStructureChanged();
 			child->SetParent(nullptr);
 			return;
 		}
@@ -164,6 +152,8 @@ void Node::RemoveChild(avs::uid childID)
 		if(child && child->id == childID)
 		{
 			children.erase(it);
+			if(transformHierarchy)
+				transformHierarchy->SetStructureChanged();
 			child->SetParent(nullptr);
 			return;
 		}
@@ -173,6 +163,8 @@ void Node::RemoveChild(avs::uid childID)
 void Node::ClearChildren()
 {
 	children.clear();
+	if(transformHierarchy)
+		transformHierarchy->SetStructureChanged();
 }
 
 void Node::SetVisible(bool visible)
@@ -188,7 +180,7 @@ void Node::SetLocalTransform(const Transform& transform)
 		return;
 	}
 	localTransform = transform;
-	isTransformDirty = true;
+	RequestTransformUpdate();
 }
 
 void Node::SetGlobalTransform(const Transform& transform)
@@ -240,6 +232,11 @@ void Node::UpdateGlobalTransform() const
 
 void Node::RequestChildrenUpdateTransforms()
 {
+	if(transformHierarchy)
+	{
+		transformHierarchy->SetGlobalChanged(transformHierarchyIndex, globalTransform);
+		return;
+	}
 	for(auto childIt = children.begin(); childIt != children.end();)
 	{
 		std::shared_ptr<Node> child = childIt->lock();
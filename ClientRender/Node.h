@@ -1,6 +1,8 @@
 // (C) Copyright 2018-2022 Simul Software Ltd
 #pragma once
 
+#include <atomic>
+
 #include "TeleportCore/CommonNetworking.h"
 #include "libavstream/geometry/mesh_interface.hpp"
 
@@ -9,6 +11,7 @@
 #include "ClientRender/UniformBuffer.h"
 #include "Material.h"
 #include "Mesh.h"
+#include "MovementInterpolator.h"
 #include "NodeComponents/AnimationComponent.h"
 #include "NodeComponents/VisibilityComponent.h"
 #include "TextCanvas.h"
@@ -19,8 +22,14 @@
 
 namespace clientrender
 {
+	class TransformHierarchy;
+	class NodeBoundsTree;
+
 	class Node: public IncompleteNode
 	{
+		friend class TransformHierarchy;
+		friend class NodeBoundsTree;
+		friend class MovementInterpolator;
 	public:
 		const std::string name;
 
@@ -46,11 +55,21 @@ namespace clientrender
 		//Requests global transform of node, and node's children, be recalculated.
 		void RequestTransformUpdate();
 
-		void SetLastMovement(const teleport::core::MovementUpdate& update);
-		//Updates the transform by extrapolating data from the last confirmed timestamp.
-		void TickExtrapolatedTransform(float deltaTime);
+		//Adds the update to the node's snapshots; its NodeManager's MovementInterpolator then moves the node through them.
+		//Snapshots are kept for history_ms behind the newest, which must cover the interpolation delay.
+		void SetLastMovement(const teleport::core::MovementUpdate& update, float history_ms);
+		const MovementSnapshots& GetMovementSnapshots() const { return movementSnapshots; }
 
+		//! Update this node only; the NodeManager updates each of its nodes in turn, so children are not updated from here.
 		void Update(float deltaTime);
+		//! Whether the node has a skin for its animations to move.
+		bool IsSkinned() const
+		{
+			return skinInstance && skinInstance->GetSkin();
+		}
+		//! Play the node's current animation on its skin. Each node's skin has its own bones, so different nodes can be
+		//! animated on different threads.
+		void UpdateAnimation(float deltaTime);
 
 		void SetParent(std::shared_ptr<Node> parent);
 		std::weak_ptr<Node> GetParent() const { return parent; }
@@ -68,13 +87,13 @@ namespace clientrender
 		void SetVisible(bool visible);
 		float GetTimeSinceLastVisible() const { return visibility.getTimeSinceLastVisible(); }
 
-		virtual void SetMesh(std::shared_ptr<Mesh> mesh) { this->mesh = mesh; }
+		virtual void SetMesh(std::shared_ptr<Mesh> mesh) { this->mesh = mesh; boundsChanged.store(true, std::memory_order_release); }
 		std::shared_ptr<Mesh> GetMesh() const { return mesh; }
 
 		void SetTextCanvas(std::shared_ptr<TextCanvas> t) { this->textCanvas = t; }
 		std::shared_ptr<TextCanvas> GetTextCanvas() const { return textCanvas; }
 		
-		virtual void SetSkin(std::shared_ptr<Skin> skin) { skinInstance.reset(new SkinInstance(skin)); }
+		virtual void SetSkin(std::shared_ptr<Skin> skin) { skinInstance.reset(new SkinInstance(skin)); boundsChanged.store(true, std::memory_order_release); }
 		const std::shared_ptr<SkinInstance> GetSkinInstance() const { return skinInstance; }
 		std::shared_ptr<SkinInstance> GetSkinInstance() { return skinInstance; }
 
@@ -180,11 +199,23 @@ namespace clientrender
 		//Cached global transform, and dirty flag; updated when necessary on a request.
 		mutable bool isTransformDirty = true;
 		mutable Transform globalTransform;
+		//If the node belongs to a NodeManager, its hierarchy updates the global transforms of changed nodes' descendants,
+		//so changes need only be recorded there. Otherwise, descendants are marked dirty one by one.
+		TransformHierarchy* transformHierarchy = nullptr;
+		uint32_t transformHierarchyIndex = 0;
+		uint32_t transformHierarchyBuild = 0;
+		//The node's leaf in its NodeManager's NodeBoundsTree, if it has one, and whether its mesh has changed since the tree was updated.
+		//The mesh and skin are set on the geometry decoding threads, while the tree is updated on the render thread.
+		int32_t boundsTreeIndex = -1;
+		std::atomic<bool> boundsChanged = true;
 
 		std::weak_ptr<Node> parent;
 		std::vector<std::weak_ptr<Node>> children;
 
 		teleport::core::MovementUpdate lastReceivedMovement;
+		MovementSnapshots movementSnapshots;
+		//The node's index in its NodeManager's MovementInterpolator, while it is moving.
+		int32_t movingIndex = -1;
 
 		bool isHighlighted = false;
 
@@ -0,0 +1,439 @@
+// (C) Copyright 2018-2022 Simul Software Ltd
+
+#include "NodeBoundsTree.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Node.h"
+#include "TransformHierarchy.h"
+
+using namespace clientrender;
+
+namespace
+{
+	// Boxes are enlarged by this fraction of their largest side, plus a fixed distance in metres.
+	constexpr float marginScale = 0.1f;
+	constexpr float marginMinimum = 0.05f;
+	// A node is reinserted if its stored box has become more than this many margins too large, e.g. because it shrank.
+	constexpr float maxMargins = 4.0f;
+
+	enum class Containment
+	{
+		OUTSIDE,
+		INTERSECTS,
+		INSIDE
+	};
+
+	Bounds Union(const Bounds& a, const Bounds& b)
+	{
+		Bounds u;
+		u.lower = avs::vec3(std::min(a.lower.x, b.lower.x), std::min(a.lower.y, b.lower.y), std::min(a.lower.z, b.lower.z));
+		u.upper = avs::vec3(std::max(a.upper.x, b.upper.x), std::max(a.upper.y, b.upper.y), std::max(a.upper.z, b.upper.z));
+		return u;
+	}
+
+	bool Contains(const Bounds& outer, const Bounds& inner)
+	{
+		return outer.lower.x <= inner.lower.x && outer.lower.y <= inner.lower.y && outer.lower.z <= inner.lower.z
+			&& outer.upper.x >= inner.upper.x && outer.upper.y >= inner.upper.y && outer.upper.z >= inner.upper.z;
+	}
+
+	float SurfaceArea(const Bounds& b)
+	{
+		avs::vec3 d = b.upper - b.lower;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	float Margin(const Bounds& b)
+	{
+		avs::vec3 d = b.upper - b.lower;
+		return std::max(std::max(d.x, d.y), d.z) * marginScale + marginMinimum;
+	}
+
+	Bounds Enlarge(const Bounds& b, float margin)
+	{
+		Bounds e;
+		e.lower = avs::vec3(b.lower.x - margin, b.lower.y - margin, b.lower.z - margin);
+		e.upper = avs::vec3(b.upper.x + margin, b.upper.y + margin, b.upper.z + margin);
+		return e;
+	}
+
+	Containment Classify(const Frustum& frustum, const Bounds& b)
+	{
+		avs::vec3 centre = (b.lower + b.upper) * 0.5f;
+		avs::vec3 extent = (b.upper - b.lower) * 0.5f;
+		Containment result = Containment::INSIDE;
+		for(const avs::vec4& p : frustum.planes)
+		{
+			float d = centre.x * p.x + centre.y * p.y + centre.z * p.z + p.w;
+			float r = extent.x * fabsf(p.x) + extent.y * fabsf(p.y) + extent.z * fabsf(p.z);
+			if(d + r < 0.0f)
+				return Containment::OUTSIDE;
+			if(d - r < 0.0f)
+				result = Containment::INTERSECTS;
+		}
+		return result;
+	}
+}
+
+Frustum Frustum::FromViewProjection(const float* m)
+{
+	// A point is within the sides of the view if -w<=x<=w and -w<=y<=w in clip space.
+	const float* row0 = m;
+	const float* row1 = m + 4;
+	const float* row3 = m + 12;
+	Frustum f;
+	f.planes[0] = {row3[0] + row0[0], row3[1] + row0[1], row3[2] + row0[2], row3[3] + row0[3]};
+	f.planes[1] = {row3[0] - row0[0], row3[1] - row0[1], row3[2] - row0[2], row3[3] - row0[3]};
+	f.planes[2] = {row3[0] + row1[0], row3[1] + row1[1], row3[2] + row1[2], row3[3] + row1[3]};
+	f.planes[3] = {row3[0] - row1[0], row3[1] - row1[1], row3[2] - row1[2], row3[3] - row1[3]};
+	return f;
+}
+
+Bounds NodeBoundsTree::GetWorldBounds(const Node& node)
+{
+	if(!node.mesh || node.skinInstance)
+		return Bounds();
+	const Bounds& local = node.mesh->GetMeshCreateInfo().bounds;
+	if(local.IsEmpty())
+		return Bounds();
+
+	// Transform the centre, and take the extent of the transformed box's axes, as the model matrix would (translation * rotation * scale).
+	const Transform& t = node.GetGlobalTransform();
+	avs::vec3 centre = (local.lower + local.upper) * 0.5f;
+	avs::vec3 half = (local.upper - local.lower) * 0.5f;
+	centre = t.m_Translation + t.m_Rotation.RotateVector(centre * t.m_Scale);
+	avs::vec3 x = t.m_Rotation.RotateVector(avs::vec3(half.x * t.m_Scale.x, 0.0f, 0.0f));
+	avs::vec3 y = t.m_Rotation.RotateVector(avs::vec3(0.0f, half.y * t.m_Scale.y, 0.0f));
+	avs::vec3 z = t.m_Rotation.RotateVector(avs::vec3(0.0f, 0.0f, half.z * t.m_Scale.z));
+	avs::vec3 extent = abs(x) + abs(y) + abs(z);
+	Bounds world;
+	world.lower = centre - extent;
+	world.upper = centre + extent;
+	return world;
+}
+
+void NodeBoundsTree::Update(const TransformHierarchy& hierarchy)
+{
+	const std::vector<std::shared_ptr<Node>>& nodes = hierarchy.GetNodes();
+	for(uint32_t i = 0; i < (uint32_t)nodes.size(); i++)
+	{
+		Node* node = nodes[i].get();
+		if(hierarchy.IsGlobalChanged(i) || node->boundsChanged.load(std::memory_order_acquire))
+			Update(node);
+	}
+}
+
+void NodeBoundsTree::Update(Node* node)
+{
+	// Cleared before the mesh is read, so that a mesh set meanwhile is picked up at the next update.
+	node->boundsChanged.exchange(false, std::memory_order_acq_rel);
+	Bounds bounds = GetWorldBounds(*node);
+	bool present = IsLeafOf(node);
+	if(bounds.IsEmpty())
+	{
+		if(present)
+			Remove(node);
+		return;
+	}
+	float margin = Margin(bounds);
+	if(present)
+	{
+		const Bounds& stored = treeNodes[node->boundsTreeIndex].bounds;
+		if(Contains(stored, bounds) && Contains(Enlarge(bounds, margin * maxMargins), stored))
+			return;
+		RemoveLeaf(node->boundsTreeIndex);
+		treeNodes[node->boundsTreeIndex].bounds = Enlarge(bounds, margin);
+		InsertLeaf(node->boundsTreeIndex);
+		return;
+	}
+	int32_t leaf = AllocateTreeNode();
+	TreeNode& t = treeNodes[leaf];
+	t.bounds = Enlarge(bounds, margin);
+	t.node = node;
+	t.height = 0;
+	// Until the next Cull(), a new node is drawn.
+	t.visibleCull = cullNumber;
+	node->boundsTreeIndex = leaf;
+	InsertLeaf(leaf);
+	leafCount++;
+}
+
+void NodeBoundsTree::Remove(Node* node)
+{
+	if(!node || !IsLeafOf(node))
+		return;
+	int32_t leaf = node->boundsTreeIndex;
+	node->boundsTreeIndex = nullIndex;
+	RemoveLeaf(leaf);
+	FreeTreeNode(leaf);
+	leafCount--;
+}
+
+void NodeBoundsTree::Clear()
+{
+	// Nodes' indices are checked against the leaves before use, so they need not be reset here.
+	treeNodes.clear();
+	root = nullIndex;
+	freeList = nullIndex;
+	leafCount = 0;
+}
+
+bool NodeBoundsTree::IsLeafOf(const Node* node) const
+{
+	int32_t index = node->boundsTreeIndex;
+	return index >= 0 && index < (int32_t)treeNodes.size() && treeNodes[index].node == node && treeNodes[index].height == 0;
+}
+
+bool NodeBoundsTree::IsCulled(const Node* node) const
+{
+	if(!IsLeafOf(node))
+		return false;
+	return treeNodes[node->boundsTreeIndex].visibleCull != cullNumber;
+}
+
+uint32_t NodeBoundsTree::Cull(const Frustum* frusta, size_t count)
+{
+	cullNumber++;
+	uint32_t tested = 0;
+	if(root == nullIndex)
+		return tested;
+	// Each entry is a tree node, and whether it is known to be wholly inside a frustum, in which case so are its descendants.
+	cullStack.clear();
+	cullStack.push_back({root, false});
+	while(cullStack.size())
+	{
+		int32_t index = cullStack.back().first;
+		bool inside = cullStack.back().second;
+		cullStack.pop_back();
+		TreeNode& t = treeNodes[index];
+		if(!inside)
+		{
+			tested++;
+			Containment best = Containment::OUTSIDE;
+			for(size_t i = 0; i < count && best != Containment::INSIDE; i++)
+				best = std::max(best, Classify(frusta[i], t.bounds));
+			if(best == Containment::OUTSIDE)
+				continue;
+			inside = (best == Containment::INSIDE);
+		}
+		if(t.IsLeaf())
+		{
+			t.visibleCull = cullNumber;
+			continue;
+		}
+		cullStack.push_back({t.right, inside});
+		cullStack.push_back({t.left, inside});
+	}
+	return tested;
+}
+
+int32_t NodeBoundsTree::AllocateTreeNode()
+{
+	if(freeList == nullIndex)
+	{
+		treeNodes.emplace_back();
+		return (int32_t)treeNodes.size() - 1;
+	}
+	int32_t index = freeList;
+	freeList = treeNodes[index].parent;
+	treeNodes[index] = TreeNode();
+	return index;
+}
+
+void NodeBoundsTree::FreeTreeNode(int32_t index)
+{
+	TreeNode& t = treeNodes[index];
+	t.node = nullptr;
+	t.left = t.right = nullIndex;
+	t.height = -1;
+	t.parent = freeList;
+	freeList = index;
+}
+
+void NodeBoundsTree::InsertLeaf(int32_t leaf)
+{
+	treeNodes[leaf].parent = nullIndex;
+	if(root == nullIndex)
+	{
+		root = leaf;
+		return;
+	}
+
+	// Descend to the sibling that gives the least total surface area, counting the growth of the ancestors on the way.
+	Bounds leafBounds = treeNodes[leaf].bounds;
+	int32_t index = root;
+	while(!treeNodes[index].IsLeaf())
+	{
+		const TreeNode& t = treeNodes[index];
+		float area = SurfaceArea(t.bounds);
+		float combinedArea = SurfaceArea(Union(t.bounds, leafBounds));
+		// The cost of making a new parent for this node and the leaf, and the minimum cost of pushing the leaf further down.
+		float cost = 2.0f * combinedArea;
+		float inheritanceCost = 2.0f * (combinedArea - area);
+		auto childCost = [&](int32_t c)
+		{
+			const TreeNode& child = treeNodes[c];
+			float unionArea = SurfaceArea(Union(leafBounds, child.bounds));
+			return (child.IsLeaf() ? unionArea : unionArea - SurfaceArea(child.bounds)) + inheritanceCost;
+		};
+		float leftCost = childCost(t.left);
+		float rightCost = childCost(t.right);
+		if(cost < leftCost && cost < rightCost)
+			break;
+		index = leftCost < rightCost ? t.left : t.right;
+	}
+
+	// Make a new parent for the sibling and the leaf.
+	int32_t sibling = index;
+	int32_t oldParent = treeNodes[sibling].parent;
+	int32_t newParent = AllocateTreeNode();
+	TreeNode& p = treeNodes[newParent];
+	p.parent = oldParent;
+	p.bounds = Union(leafBounds, treeNodes[sibling].bounds);
+	p.height = treeNodes[sibling].height + 1;
+	p.left = sibling;
+	p.right = leaf;
+	if(oldParent == nullIndex)
+		root = newParent;
+	else if(treeNodes[oldParent].left == sibling)
+		treeNodes[oldParent].left = newParent;
+	else
+		treeNodes[oldParent].right = newParent;
+	treeNodes[sibling].parent = newParent;
+	treeNodes[leaf].parent = newParent;
+
+	Refit(treeNodes[leaf].parent);
+}
+
+void NodeBoundsTree::RemoveLeaf(int32_t leaf)
+{
+	if(leaf == root)
+	{
+		root = nullIndex;
+		return;
+	}
+	int32_t parent = treeNodes[leaf].parent;
+	int32_t grandParent = treeNodes[parent].parent;
+	int32_t sibling = treeNodes[parent].left == leaf ? treeNodes[parent].right : treeNodes[parent].left;
+	// The sibling takes the parent's place.
+	treeNodes[sibling].parent = grandParent;
+	FreeTreeNode(parent);
+	if(grandParent == nullIndex)
+	{
+		root = sibling;
+		return;
+	}
+	if(treeNodes[grandParent].left == parent)
+		treeNodes[grandParent].left = sibling;
+	else
+		treeNodes[grandParent].right = sibling;
+	Refit(grandParent);
+}
+
+void NodeBoundsTree::Refit(int32_t index)
+{
+	// Rebalance and recalculate the bounds of each ancestor in turn.
+	while(index != nullIndex)
+	{
+		index = Balance(index);
+		TreeNode& t = treeNodes[index];
+		const TreeNode& left = treeNodes[t.left];
+		const TreeNode& right = treeNodes[t.right];
+		t.height = 1 + std::max(left.height, right.height);
+		t.bounds = Union(left.bounds, right.bounds);
+		index = t.parent;
+	}
+}
+
+int32_t NodeBoundsTree::Balance(int32_t iA)
+{
+	// If one child of A is more than one level taller than the other, rotate that child up to take A's place.
+	TreeNode* A = &treeNodes[iA];
+	if(A->IsLeaf() || A->height < 2)
+		return iA;
+	int32_t iB = A->left;
+	int32_t iC = A->right;
+	TreeNode* B = &treeNodes[iB];
+	TreeNode* C = &treeNodes[iC];
+	int32_t balance = C->height - B->height;
+	if(balance > 1)
+	{
+		// Rotate C up.
+		int32_t iF = C->left;
+		int32_t iG = C->right;
+		TreeNode* F = &treeNodes[iF];
+		TreeNode* G = &treeNodes[iG];
+		C->left = iA;
+		C->parent = A->parent;
+		A->parent = iC;
+		if(C->parent == nullIndex)
+			root = iC;
+		else if(treeNodes[C->parent].left == iA)
+			treeNodes[C->parent].left = iC;
+		else
+			treeNodes[C->parent].right = iC;
+		// A keeps the shorter of C's children.
+		if(F->height > G->height)
+		{
+			C->right = iF;
+			A->right = iG;
+			G->parent = iA;
+			A->bounds = Union(B->bounds, G->bounds);
+			C->bounds = Union(A->bounds, F->bounds);
+			A->height = 1 + std::max(B->height, G->height);
+			C->height = 1 + std::max(A->height, F->height);
+		}
+		else
+		{
+			C->right = iG;
+			A->right = iF;
+			F->parent = iA;
+			A->bounds = Union(B->bounds, F->bounds);
+			C->bounds = Union(A->bounds, G->bounds);
+			A->height = 1 + std::max(B->height, F->height);
+			C->height = 1 + std::max(A->height, G->height);
+		}
+		return iC;
+	}
+	if(balance < -1)
+	{
+		// Rotate B up.
+		int32_t iD = B->left;
+		int32_t iE = B->right;
+		TreeNode* D = &treeNodes[iD];
+		TreeNode* E = &treeNodes[iE];
+		B->left = iA;
+		B->parent = A->parent;
+		A->parent = iB;
+		if(B->parent == nullIndex)
+			root = iB;
+		else if(treeNodes[B->parent].left == iA)
+			treeNodes[B->parent].left = iB;
+		else
+			treeNodes[B->parent].right = iB;
+		if(D->height > E->height)
+		{
+			B->right = iD;
+			A->left = iE;
+			E->parent = iA;
+			A->bounds = Union(C->bounds, E->bounds);
+			B->bounds = Union(A->bounds, D->bounds);
+			A->height = 1 + std::max(C->height, E->height);
+			B->height = 1 + std::max(A->height, D->height);
+		}
+		else
+		{
+			B->right = iE;
+			A->left = iD;
+			D->parent = iA;
+			A->bounds = Union(C->bounds, D->bounds);
+			B->bounds = Union(A->bounds, E->bounds);
+			A->height = 1 + std::max(C->height, D->height);
+			B->height = 1 + std::max(A->height, E->height);
+		}
+		return iB;
+	}
+	return iA;
+}
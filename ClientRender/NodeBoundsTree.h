@@ -0,0 +1,84 @@
+// (C) Copyright 2018-2022 Simul Software Ltd
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.h"
+
+namespace clientrender
+{
+	class Node;
+	class TransformHierarchy;
+
+	//! The four side planes of a view frustum, each (x,y,z,w) with its normal pointing inwards, so that a point p is inside
+	//! if dot(p,xyz)+w>=0 for every plane. The near and far planes are left out, so the test does not depend on the depth
+	//! convention of the projection; the side planes alone still exclude everything behind the viewer.
+	struct Frustum
+	{
+		avs::vec4 planes[4];
+
+		//! From a view-projection matrix stored so that row i, dotted with (x,y,z,1), gives clip-space coordinate i.
+		static Frustum FromViewProjection(const float* viewProj);
+	};
+
+	//! A bounding volume hierarchy of the world-space boxes of a NodeManager's meshes, for skipping nodes that are out of view.
+	//! Each box is stored enlarged by a margin, so a node that moves a little need not be reinserted. Leaves are inserted
+	//! where they least increase the surface area of the tree, which is kept balanced by rotations, as in Box2D's dynamic tree.
+	//! Nodes without bounds, such as text or skinned meshes, whose vertices can move far from the bind pose, are not added, and are never culled.
+	class NodeBoundsTree
+	{
+	public:
+		//! Add, move or remove the nodes whose global transforms changed in the hierarchy's last update, or whose meshes have changed.
+		void Update(const TransformHierarchy& hierarchy);
+		//! Add, move or remove this node according to its mesh and global transform.
+		void Update(Node* node);
+		void Remove(Node* node);
+		void Clear();
+		//! Mark the nodes whose boxes are within any of the frusta, e.g. one for each eye. Returns the number of boxes tested.
+		uint32_t Cull(const Frustum* frusta, size_t count);
+		//! Whether the node was outside every frustum at the last Cull().
+		bool IsCulled(const Node* node) const;
+		size_t GetLeafCount() const
+		{
+			return leafCount;
+		}
+
+		//! The world-space box of the node's mesh, or an empty box if it should not be culled.
+		static Bounds GetWorldBounds(const Node& node);
+
+	private:
+		static constexpr int32_t nullIndex = -1;
+		struct TreeNode
+		{
+			Bounds bounds;
+			Node* node = nullptr;			//For leaves only.
+			int32_t parent = nullIndex;		//Or the next free node, if this one is free.
+			int32_t left = nullIndex;
+			int32_t right = nullIndex;
+			int32_t height = 0;				//Zero for leaves, -1 if free.
+			uint32_t visibleCull = 0;		//The last Cull() that found this leaf to be visible.
+
+			bool IsLeaf() const
+			{
+				return left == nullIndex;
+			}
+		};
+
+		std::vector<TreeNode> treeNodes;
+		int32_t root = nullIndex;
+		int32_t freeList = nullIndex;
+		size_t leafCount = 0;
+		uint32_t cullNumber = 0;
+		// Scratch space for the traversal, kept to avoid reallocating.
+		std::vector<std::pair<int32_t, bool>> cullStack;
+
+		bool IsLeafOf(const Node* node) const;
+		int32_t AllocateTreeNode();
+		void FreeTreeNode(int32_t index);
+		void InsertLeaf(int32_t leaf);
+		void RemoveLeaf(int32_t leaf);
+		int32_t Balance(int32_t index);
+		void Refit(int32_t index);
+	};
+}
@@ -96,10 +96,15 @@ namespace clientrender
 			return;
 		}
 
-		std::shared_ptr<Animation> animation = currentAnimationState->second.getAnimation();
-		currentAnimationState->second.currentAnimationTimeS+=deltaTimeS * currentAnimationState->second.speed;
-		currentAnimationState->second.currentAnimationTimeS = std::max(0.0f,std::min(currentAnimationState->second.currentAnimationTimeS, animation->getAnimationLengthSeconds()));
-		animation->seekTime(boneList, currentAnimationState->second.currentAnimationTimeS);
+		AnimationState& animationState = currentAnimationState->second;
+		std::shared_ptr<Animation> animation = animationState.getAnimation();
+		if(!animation)
+		{
+			return;
+		}
+		animationState.currentAnimationTimeS+=deltaTimeS * animationState.speed;
+		animationState.currentAnimationTimeS = std::max(0.0f,std::min(animationState.currentAnimationTimeS, animation->getAnimationLengthSeconds()));
+		animation->seekTime(animationState.cursor, boneList, animationState.currentAnimationTimeS);
 
 #if CYCLE_ANIMATIONS
 		if(currentAnimationTime >= animation->getAnimationLength())
@@ -112,7 +117,7 @@ namespace clientrender
 			}
 
 			currentAnimationTime = 0.0f;
-			animation->seekTime(boneList, currentAnimationTime);
+			animation->seekTime(currentAnimationState->second.cursor, boneList, currentAnimationTime);
 		}
 #endif
 	}
@@ -13,6 +13,7 @@ namespace clientrender
 	void AnimationState::setAnimation(const std::shared_ptr<Animation>& reference)
 	{
 		animation = reference;
+		cursor.Reset();
 	}
 
 	std::shared_ptr<Animation> AnimationState::getAnimation() const
@@ -19,6 +19,7 @@ namespace clientrender
 	public:
 		float speed = 1.0f; //Speed the animation plays at.
 		float currentAnimationTimeS = 0.0f;
+		AnimationCursor cursor; //Where this instance of the animation was last sampled.
 
 		AnimationState();
 		AnimationState(const std::shared_ptr<Animation>& animation);
@@ -1,9 +1,22 @@
 #include "NodeManager.h"
 
+#include <algorithm>
+
+#include "TeleportClient/ServerTimestamp.h"
+#include "TeleportCore/ThreadPool.h"
+
 using namespace clientrender;
 
 using InvisibilityReason = VisibilityComponent::InvisibilityReason;
 
+NodeManager::~NodeManager()
+{
+	// Nodes can outlive the manager, so they must not keep pointing to its hierarchy.
+	for(const auto& n : nodeLookup)
+		transformHierarchy.Detach(n.second.get());
+	movementInterpolator.Clear();
+}
+
 std::shared_ptr<Node> NodeManager::CreateNode(avs::uid id, const avs::Node &avsNode) 
 {
 	std::shared_ptr<Node> node= std::make_shared<Node>(id, avsNode.name);
@@ -24,11 +37,12 @@ void NodeManager::AddNode(std::shared_ptr<Node> node, const avs::Node& avsNode)
 		rootNodes_mutex.lock();
 		rootNodes.push_back(node);
 		rootNodes_mutex.unlock();
-		distanceSortedRootNodes.push_back(node);
+		distanceSortedRootNodes.Add(node);
 	}
 	nodeLookup_mutex.lock();
 	nodeLookup[node->id] = node;
 	nodeLookup_mutex.unlock();
+	transformHierarchy.SetStructureChanged();
 	if(avsNode.parentID)
 		parentLookup[node->id]=avsNode.parentID;
 	//Link new node to parent.
@@ -45,7 +59,8 @@ void NodeManager::AddNode(std::shared_ptr<Node> node, const avs::Node& avsNode)
 	auto movementIt = earlyMovements.find(node->id);
 	if(movementIt != earlyMovements.end())
 	{
-		node->SetLastMovement(movementIt->second);
+		node->SetLastMovement(movementIt->second, movementInterpolationDelay);
+		movementInterpolator.Add(node.get());
 		earlyMovements.erase(movementIt);
 	}
 
@@ -119,6 +134,8 @@ void NodeManager::NotifyModifiedMaterials(std::shared_ptr<Node> node)
 void NodeManager::RemoveNode(std::shared_ptr<Node> node)
 {
 	nodeLookup_mutex.lock();
+	// The child lists and the hierarchy are walked by Update(), so change them under the same lock.
+	rootNodes_mutex.lock();
 	//Remove node from parent's child list.
 	if(!node->GetParent().expired())
 	{
@@ -129,17 +146,13 @@ void NodeManager::RemoveNode(std::shared_ptr<Node> node)
 	//Remove from root nodes, if the node had no parent.
 	else
 	{
-		rootNodes_mutex.lock();
 		rootNodes.erase(std::find(rootNodes.begin(), rootNodes.end(), node));
-		rootNodes_mutex.unlock();
-		distanceSortedRootNodes.erase(std::find(distanceSortedRootNodes.begin(), distanceSortedRootNodes.end(), node));
+		distanceSortedRootNodes.Remove(node.get());
 	}
 	// If it's in the transparent list, erase it from there.
 	{
 		std::scoped_lock l(distanceSortedTransparentNodes_mutex);
-		auto f = std::find(distanceSortedTransparentNodes.begin(), distanceSortedTransparentNodes.end(), node);
-		if (f != distanceSortedTransparentNodes.end())
-			distanceSortedTransparentNodes.erase(f);
+		distanceSortedTransparentNodes.Remove(node.get());
 	}
 
 	//Attach children to world root.
@@ -149,10 +162,8 @@ void NodeManager::RemoveNode(std::shared_ptr<Node> node)
 		std::shared_ptr<Node> child = childPtr.lock();
 		if (child)
 		{
-			rootNodes_mutex.lock();
 			rootNodes.push_back(child);
-			rootNodes_mutex.unlock();
-			distanceSortedRootNodes.push_back(child);
+			distanceSortedRootNodes.Add(child);
 			//Remove parent
 			child->SetParent(nullptr);
 			parentLookup.erase(child->id);
@@ -161,6 +172,10 @@ void NodeManager::RemoveNode(std::shared_ptr<Node> node)
 
 	//Remove from node lookup table.
 	nodeLookup.erase(node->id);
+	transformHierarchy.Detach(node.get());
+	boundsTree.Remove(node.get());
+	movementInterpolator.Remove(node.get());
+	rootNodes_mutex.unlock();
 	nodeLookup_mutex.unlock();
 }
 
@@ -205,23 +220,14 @@ const NodeManager::nodeList_t& NodeManager::GetRootNodes() const
 const std::vector<std::shared_ptr<Node>>& NodeManager::GetSortedRootNodes()
 {
 	std::scoped_lock lock(distanceSortedRootNodes_mutex);
-	std::sort
-	(
-		distanceSortedRootNodes.begin(),
-		distanceSortedRootNodes.end(),
-		[](std::shared_ptr<Node> a, std::shared_ptr<Node> b)
-		{
-			return a->distance < b->distance;
-		}
-	);
-
-	return distanceSortedRootNodes;
+	return distanceSortedRootNodes.Sort();
 }
 
 const std::vector<std::shared_ptr<Node>>& NodeManager::GetSortedTransparentNodes()
 {
-	std::set<std::shared_ptr<Node>>::iterator n=nodesWithModifiedMaterials.begin();
-	while(n!=nodesWithModifiedMaterials.end())
+	std::scoped_lock l(distanceSortedTransparentNodes_mutex);
+	// Sort nodes whose materials have changed into or out of the transparent list, once all their materials are known.
+	for(auto n = nodesWithModifiedMaterials.begin(); n != nodesWithModifiedMaterials.end();)
 	{
 		const auto &m=n->get()->GetMaterials();
 		bool transparent=false;
@@ -229,58 +235,27 @@ const std::vector<std::shared_ptr<Node>>& NodeManager::GetSortedTransparentNodes
 		for(const auto &M:m)
 		{
 			if(!M)
+			{
 				unknown=true;
+				break;
+			}
 			if(M->GetMaterialCreateInfo().materialMode==avs::MaterialMode::TRANSPARENT_MATERIAL)
 				transparent=true;
 		}
-		if(n->get()->GetTextCanvas())
-			transparent=true;
-		if(!unknown)
+		if(unknown)
 		{
-			if(transparent)
-			{
-				bool alreadyPresent=false;
-				std::scoped_lock l(distanceSortedTransparentNodes_mutex);
-				for(auto i=distanceSortedTransparentNodes.begin();i!=distanceSortedTransparentNodes.end();i++)
-				{
-					if(*i==*n)
-					{
-						alreadyPresent=true;
-						break;
-					}
-				}
-				if(!alreadyPresent)
-					distanceSortedTransparentNodes.push_back(*n);
-			}
-			else
-			{
-				std::scoped_lock l(distanceSortedTransparentNodes_mutex);
-				for(auto i=distanceSortedTransparentNodes.begin();i!=distanceSortedTransparentNodes.end();i++)
-				{
-					if(*i==*n)
-					{
-						distanceSortedTransparentNodes.erase(i);
-						break;
-					}
-				}
-			}
-			nodesWithModifiedMaterials.erase(n);
-			break;
+			n++;
+			continue;
 		}
+		if(n->get()->GetTextCanvas())
+			transparent=true;
+		if(transparent)
+			distanceSortedTransparentNodes.Add(*n);
+		else
+			distanceSortedTransparentNodes.Remove(n->get());
+		n = nodesWithModifiedMaterials.erase(n);
 	}
-	{
-		std::scoped_lock l(distanceSortedTransparentNodes_mutex);
-		std::sort
-		(
-			distanceSortedTransparentNodes.begin(),
-			distanceSortedTransparentNodes.end(),
-			[](std::shared_ptr<Node> a, std::shared_ptr<Node> b)
-			{
-				return a->distance < b->distance;
-			}
-		);
-	}
-	return distanceSortedTransparentNodes;
+	return distanceSortedTransparentNodes.Sort();
 }
 
 bool NodeManager::ShowNode(avs::uid nodeID)
@@ -340,20 +315,30 @@ bool NodeManager::UpdateNodeTransform(avs::uid nodeID, const avs::vec3& translat
 
 void NodeManager::UpdateNodeMovement(const std::vector<teleport::core::MovementUpdate>& updateList)
 {
-	earlyMovements.clear();
-
+	// Early movements are kept until their nodes arrive, as a node that doesn't move again won't be in later updates.
+	int64_t latestTimestamp = 0;
 	for(teleport::core::MovementUpdate update : updateList)
 	{
+		latestTimestamp = std::max(latestTimestamp, update.timestamp);
 		std::shared_ptr<Node> node = GetNode(update.nodeID);
 		if(node)
 		{
-			node->SetLastMovement(update);
+			node->SetLastMovement(update, movementInterpolationDelay);
+			movementInterpolator.Add(node.get());
 		}
 		else
 		{
 			earlyMovements[update.nodeID] = update;
 		}
 	}
+	// But not for ever: a node that arrives later carries a newer transform, and one that never arrives must not leave its movement behind.
+	for(auto movementIt = earlyMovements.begin(); movementIt != earlyMovements.end();)
+	{
+		if(latestTimestamp - movementIt->second.timestamp > maxEarlyMovementAge_ms)
+			movementIt = earlyMovements.erase(movementIt);
+		else
+			++movementIt;
+	}
 }
 
 void NodeManager::UpdateNodeEnabledState(const std::vector<teleport::core::NodeUpdateEnabledState>& updateList)
@@ -469,10 +454,19 @@ void NodeManager::Update(float deltaTime)
 {
 	rootNodes_mutex.lock();
 	nodeList_t expiredNodes;
-	for(const std::shared_ptr<Node> node : rootNodes)
+	transformHierarchy.Rebuild(rootNodes);
+	double renderTime = teleport::client::ServerTimestamp::getCurrentTimestampUTCUnixMs() - movementInterpolationDelay;
+	movementInterpolator.Update(renderTime, maxMovementExtrapolation);
+	skinnedNodes.clear();
+	for(const std::shared_ptr<Node>& node : transformHierarchy.GetNodes())
 	{
 		node->Update(deltaTime);
+		if(node->IsSkinned())
+			skinnedNodes.push_back(node.get());
 	}
+	UpdateAnimations(deltaTime);
+	transformHierarchy.UpdateTransforms();
+	boundsTree.Update(transformHierarchy);
 	rootNodes_mutex.unlock();
 	for(const avs::uid u : hiddenNodes)
 	{
@@ -495,6 +489,38 @@ void NodeManager::Update(float deltaTime)
 	}
 }
 
+void NodeManager::UpdateAnimations(float deltaTime)
+{
+	if(skinnedNodes.size() < minParallelSkins)
+	{
+		for(Node* node : skinnedNodes)
+			node->UpdateAnimation(deltaTime);
+		return;
+	}
+	TransformHierarchy::GetThreadPool().parallelFor(skinnedNodes.size(), [this, deltaTime](size_t i)
+	{
+		skinnedNodes[i]->UpdateAnimation(deltaTime);
+	});
+}
+
+void NodeManager::UpdateTransforms()
+{
+	std::lock_guard<std::mutex> lock(rootNodes_mutex);
+	transformHierarchy.Rebuild(rootNodes);
+	transformHierarchy.UpdateTransforms();
+	boundsTree.Update(transformHierarchy);
+}
+
+uint32_t NodeManager::CullNodes(const Frustum* frusta, size_t count)
+{
+	return boundsTree.Cull(frusta, count);
+}
+
+bool NodeManager::IsCulled(const Node* node) const
+{
+	return boundsTree.IsCulled(node);
+}
+
 const std::set<avs::uid> &NodeManager::GetRemovedNodeUids() const
 {
 	return removed_node_uids;
@@ -507,13 +533,17 @@ void NodeManager::Clear()
 	rootNodes_mutex.unlock();
 	{
 		std::scoped_lock lock(distanceSortedRootNodes_mutex);
-		distanceSortedRootNodes.clear();
+		distanceSortedRootNodes.Clear();
 	}
 	{
 		std::scoped_lock lock(distanceSortedTransparentNodes_mutex);
-		distanceSortedTransparentNodes.clear();
+		distanceSortedTransparentNodes.Clear();
 	}
+	for(const auto& n : nodeLookup)
+		transformHierarchy.Detach(n.second.get());
 	nodeLookup.clear();
+	boundsTree.Clear();
+	movementInterpolator.Clear();
 
 	parentLookup.clear();
 
@@ -574,9 +604,7 @@ void NodeManager::LinkToParentNode(avs::uid childID)
 			if (r == rootNodes.end())
 				rootNodes.push_back(child);
 			distanceSortedRootNodes_mutex.lock();
-			auto f = std::find(distanceSortedRootNodes.begin(), distanceSortedRootNodes.end(), child);
-			if (f == distanceSortedRootNodes.end())
-				distanceSortedRootNodes.push_back(child);
+			distanceSortedRootNodes.Add(child);
 			distanceSortedRootNodes_mutex.unlock();
 	rootNodes_mutex.unlock();
 		}
@@ -587,17 +615,15 @@ void NodeManager::LinkToParentNode(avs::uid childID)
 		return;
 	}
 
-	parent->AddChild(child);
 	{
 		std::scoped_lock l(distanceSortedRootNodes_mutex);
-		auto f = std::find(distanceSortedRootNodes.begin(), distanceSortedRootNodes.end(), child);
-		if (f != distanceSortedRootNodes.end())
-			distanceSortedRootNodes.erase(f);
+		distanceSortedRootNodes.Remove(child.get());
 	}
 	//Erase child from the root nodes list, as they now have a parent.
 	// TODO: ONLY do this if it was unparented before.....
 	
 	rootNodes_mutex.lock();
+	parent->AddChild(child);
 	auto r=std::find(rootNodes.begin(), rootNodes.end(), child);
 	if(r!=rootNodes.end())
 		rootNodes.erase(r);
@@ -9,8 +9,12 @@
 
 #include "libavstream/geometry/mesh_interface.hpp"
 
+#include "DistanceSortedNodeList.h"
+#include "MovementInterpolator.h"
 #include "Node.h"
+#include "NodeBoundsTree.h"
 #include "ResourceManager.h"
+#include "TransformHierarchy.h"
 
 namespace clientrender
 {
@@ -21,8 +25,10 @@ namespace clientrender
 		typedef std::vector<std::shared_ptr<Node>> nodeList_t;
 
 		uint32_t nodeLifetime = 30000; //Milliseconds the manager waits before removing invisible nodes.
+		float movementInterpolationDelay = 100.0f; //Milliseconds behind the server's time that moving nodes are shown, so there is usually an update either side.
+		float maxMovementExtrapolation = 250.0f; //Milliseconds a node keeps following its last velocity when no newer update has arrived.
 
-		virtual ~NodeManager() = default;
+		virtual ~NodeManager();
 
 		virtual std::shared_ptr<Node> CreateNode(avs::uid id, const avs::Node &avsNode) ;
 
@@ -65,6 +71,13 @@ namespace clientrender
 		//Tick the node manager along, and remove any nodes that have been invisible for too long.
 		//	deltaTime : Milliseconds since last update.
 		void Update(float deltaTime);
+		//! Bring global transforms up to date now, e.g. after setting the poses of tracked nodes just before rendering.
+		//! Update() also does this.
+		void UpdateTransforms();
+		//! Mark the nodes whose bounds are outside all of these frusta, e.g. one for each eye, as culled. Returns the number of boxes tested.
+		uint32_t CullNodes(const Frustum* frusta, size_t count);
+		//! Whether the node was out of view at the last CullNodes(). Nodes without bounds are never culled.
+		bool IsCulled(const Node* node) const;
 
 		//Clear node manager of all nodes.
 		void Clear();
@@ -77,16 +90,27 @@ namespace clientrender
 		const std::set<avs::uid> &GetRemovedNodeUids() const;
 	protected:
 		nodeList_t rootNodes; //Nodes that are parented to the world root.
-		std::vector<std::shared_ptr<clientrender::Node>> distanceSortedRootNodes; //The rootNodes list above, but sorted from near to far.
+		DistanceSortedNodeList distanceSortedRootNodes; //The rootNodes list above, but sorted from near to far.
 	
 		nodeList_t transparentNodes; //Nodes that are parented to the world root.
-		std::vector<std::shared_ptr<clientrender::Node>> distanceSortedTransparentNodes; //The rootNodes list above, but sorted from near to far.
+		DistanceSortedNodeList distanceSortedTransparentNodes; //Nodes with transparent materials or text, sorted from near to far.
 
 		// Nodes that have been added, or modified, to be sorted into transparent or not.
 		std::set<std::shared_ptr<clientrender::Node>> nodesWithModifiedMaterials;
 
         std::unordered_map<avs::uid, std::shared_ptr<Node>> nodeLookup;
 
+		//The nodes' transforms in parent-first order, for updating all global transforms in one pass.
+		TransformHierarchy transformHierarchy;
+		//The world-space bounds of the nodes' meshes, updated as their global transforms change.
+		NodeBoundsTree boundsTree;
+		//Moves the nodes that have received movement updates between them.
+		MovementInterpolator movementInterpolator;
+		//The nodes with skins to animate in this update.
+		std::vector<Node*> skinnedNodes;
+		//Fewer skins than this are not worth spreading across threads.
+		static constexpr size_t minParallelSkins = 16;
+
 	private:
 		struct EarlyAnimationControl
 		{
@@ -106,6 +130,8 @@ namespace clientrender
 		std::set<avs::uid> removed_node_uids;
 		//Node updates that were received before the node was received.
 		std::map<avs::uid, teleport::core::MovementUpdate> earlyMovements;
+		//Milliseconds an early movement is kept for, measured from the newest movement update.
+		static constexpr int64_t maxEarlyMovementAge_ms = 5000;
 		std::map<avs::uid, teleport::core::NodeUpdateEnabledState> earlyEnabledUpdates;
 		std::map<avs::uid, bool> earlyNodeHighlights;
 		std::map<avs::uid, teleport::core::ApplyAnimation> earlyAnimationUpdates;
@@ -118,6 +144,8 @@ namespace clientrender
 
 		//Links the node with the passed ID to it's parent. If the node doesn't exist, then it doesn't do anything.
 		void LinkToParentNode(avs::uid nodeID);
+		//Animates the skinned nodes, on several threads if there are enough of them.
+		void UpdateAnimations(float deltaTime);
 		mutable std::mutex nodeLookup_mutex;
 		mutable std::mutex rootNodes_mutex;
 		mutable std::mutex distanceSortedRootNodes_mutex;
@@ -188,6 +188,7 @@ void Renderer::Init(crossplatform::RenderPlatform *r,teleport::client::OpenXR *u
 	renderState.tagDataIDBuffer.RestoreDeviceObjects(renderPlatform, 1, true);
 	renderState.tagDataCubeBuffer.RestoreDeviceObjects(renderPlatform,RenderState::maxTagDataSize, false, true);
 	renderState.lightsBuffer.RestoreDeviceObjects(renderPlatform,10,false,true);
+	renderState.instancesBuffer.RestoreDeviceObjects(renderPlatform,256,false,false,nullptr,"instances");
 	renderState.boneMatrices.RestoreDeviceObjects(renderPlatform);
 	renderState.boneMatrices.LinkToEffect(renderState.pbrEffect, "boneMatrices");
 
@@ -204,9 +205,9 @@ void Renderer::Init(crossplatform::RenderPlatform *r,teleport::client::OpenXR *u
 	avs::uid hand_uid = 11;
 	auto &localGeometryCache=localInstanceRenderer->geometryCache;
 	auto uids=localGeometryCache.mMeshManager.GetAllIDs();
-	if (uids.size())
+	if (uids->size())
 	{
-		hand_uid = uids[0];
+		hand_uid = (*uids)[0];
 	}
 	else
 	{
@@ -214,9 +215,9 @@ void Renderer::Init(crossplatform::RenderPlatform *r,teleport::client::OpenXR *u
 	}
 	uids=localGeometryCache.mSkinManager.GetAllIDs();
 	hand_skin_uid=0;
-	if (uids.size())
+	if (uids->size())
 	{
-		hand_skin_uid = uids[0];
+		hand_skin_uid = (*uids)[0];
 	}
 	else
 	{
@@ -224,9 +225,9 @@ void Renderer::Init(crossplatform::RenderPlatform *r,teleport::client::OpenXR *u
 	}
 	uids=localGeometryCache.mAnimationManager.GetAllIDs();
 	avs::uid point_anim_uid=0;
-	if (uids.size())
+	if (uids->size())
 	{
-		point_anim_uid = uids[0];
+		point_anim_uid = (*uids)[0];
 	}
 	else
 	{
@@ -313,6 +314,7 @@ void Renderer::Init(crossplatform::RenderPlatform *r,teleport::client::OpenXR *u
 
 	geometryDecoder.setCacheFolder(config.GetStorageFolder());
 	localGeometryCache.setCacheFolder(config.GetStorageFolder());
+	resourceDiskCache.SetFolder(config.GetStoragePath()+"resource_cache");
 
 	client::SessionClient::GetSessionClient(server_uid)->SetSessionCommandInterface(GetInstanceRenderer(server_uid).get());
 }
@@ -332,6 +334,14 @@ void Renderer::UpdateShaderPasses()
 	renderState.pbrEffect_solidAnim				=SetPasses("solid_anim");
 	renderState.pbrEffect_solid					=SetPasses("solid");
 	renderState.pbrEffect_solidMultiview		=SetPasses("solid_multiview");
+	auto SetInstancedPasses= [this](ShaderPassSetup &shaderPassSetup,const char *techname)
+		{
+			platform::crossplatform::EffectTechnique *technique=renderState.pbrEffect->GetTechniqueByName(techname);
+			shaderPassSetup.noLightmapInstancedPass	=technique?technique->GetPass("pbr_nolightmap"):nullptr;
+			shaderPassSetup.lightmapInstancedPass	=technique?technique->GetPass("pbr_lightmap"):nullptr;
+		};
+	SetInstancedPasses(renderState.pbrEffect_solid,"solid_instanced");
+	SetInstancedPasses(renderState.pbrEffect_solidMultiview,"solid_multiview_instanced");
 	renderState.pbrEffect_solidAnimMultiview	=SetPasses("solid_anim_multiview");
 	
 	renderState.pbrEffect_transparent			=SetPasses("transparent");
@@ -362,6 +372,7 @@ void Renderer::RecompileShaders()
 	renderState.RWTextureTargetArray					=renderState.cubemapClearEffect->GetShaderResource("RWTextureTargetArray");
 	renderState.cubemapClearEffect_TagDataIDBuffer		=renderState.cubemapClearEffect->GetShaderResource("TagDataIDBuffer");
 	renderState.pbrEffect_TagDataIDBuffer				=renderState.pbrEffect->GetShaderResource("TagDataIDBuffer");
+	renderState.pbrEffect_instances						=renderState.pbrEffect->GetShaderResource("instances");
 	
 	renderState.pbrEffect_diffuseCubemap				=renderState.pbrEffect->GetShaderResource("diffuseCubemap");
 	renderState.pbrEffect_specularCubemap				=renderState.pbrEffect->GetShaderResource("specularCubemap");
@@ -379,6 +390,9 @@ std::shared_ptr<InstanceRenderer> Renderer::GetInstanceRenderer(avs::uid server_
 	if(i==instanceRenderers.end())
 	{
 		auto r=std::make_shared<InstanceRenderer>(server_uid,config,geometryDecoder,renderState,sc.get());
+		// The local renderer's resources come from files, not servers, so are not cached.
+		if(server_uid!=0)
+			r->resourceCreator.SetDiskCache(&resourceDiskCache);
 		instanceRenderers[server_uid]=r;
 		r->RestoreDeviceObjects(renderPlatform);
 		return r;
@@ -688,6 +702,7 @@ void Renderer::Update(double timestamp_ms)
 				renderState.openXR->RemoveNodePoseMapping(i.first,u);
 		}
 	}
+	resourceDiskCache.Update(static_cast<float>(timeElapsed_s));
 	previousTimestamp = timestamp_ms;
 }
 
@@ -1153,7 +1168,7 @@ void Renderer::RenderDesktopView(int view_id, void* context, void* renderTexture
 		{
 			std::unique_ptr<std::lock_guard<std::mutex>> cacheLock;
 			auto& textures = geometryCache.mTextureManager.GetCache(cacheLock);
-			for (auto t : textures)
+			for (const auto &t : textures)
 			{
 				clientrender::Texture* pct = t.second.resource.get();
 				renderPlatform->DrawTexture(deviceContext, x, y, tw, tw, pct->GetSimulTexture());
@@ -1345,7 +1360,11 @@ void Renderer::DrawOSD(crossplatform::GraphicsDeviceContext& deviceContext)
 	}
 	if(gui.Tab("Geometry"))
 	{
+		const clientrender::RenderStats &renderStats=instanceRenderer->GetRenderStats();
+		gui.LinePrint(platform::core::QuickFormat("Nodes tested: %d, culled: %d, drawn: %d", renderStats.nodesTested, renderStats.nodesCulled, renderStats.nodesDrawn), white);
+		gui.LinePrint(platform::core::QuickFormat("Draw calls: %d for %d mesh elements, submitted in %4.3f ms", renderStats.drawCalls, renderStats.instancesDrawn, renderStats.submitTimeMs), white);
 		gui.GeometryOSD();
+		gui.TranscodeOSD(instanceRenderer->resourceCreator.GetTranscodeTimings());
 		gui.EndTab();
 	}
 	if(gui.Tab("Tags"))
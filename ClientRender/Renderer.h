@@ -65,6 +65,8 @@ namespace clientrender
 			return show_osd;
 		}
 	protected:
+		//! Meshes and textures kept on disk between sessions. The instance renderers use it, so it is declared before them.
+		clientrender::ResourceDiskCache resourceDiskCache;
 		std::map<avs::uid,std::shared_ptr<InstanceRenderer>> instanceRenderers;
 		virtual std::shared_ptr<InstanceRenderer> GetInstanceRenderer(avs::uid server_uid);
 		void RemoveInstanceRenderer(avs::uid);
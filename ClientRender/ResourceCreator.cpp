@@ -5,6 +5,8 @@
 #pragma warning(disable : 4018) //warning C4018: '<': signed/unsigned mismatch
 #endif
 
+#include <algorithm>
+
 #include "Animation.h"
 #include "Material.h"
 #include <Platform/External/magic_enum/include/magic_enum.hpp>
@@ -21,16 +23,24 @@ using namespace clientrender;
 #define RESOURCECREATOR_DEBUG_COUT(txt, ...)
 
 ResourceCreator::ResourceCreator()
-	:basisThread(&ResourceCreator::BasisThread_TranscodeTextures, this)
 {
 	basist::basisu_transcoder_init();
+	// Leave some cores for rendering and networking.
+	unsigned numThreads = std::max(1u, std::thread::hardware_concurrency() / 2);
+	for (unsigned i = 0; i < numThreads; i++)
+		basisThreads.emplace_back(&ResourceCreator::BasisThread_TranscodeTextures, this);
 }
 
 ResourceCreator::~ResourceCreator()
 {
-	//Safely close the basis transcoding thread.
-	shouldBeTranscoding = false;
-	basisThread.join();
+	//Safely close the basis transcoding threads.
+	{
+		std::lock_guard<std::mutex> lock_texturesToTranscode(mutex_texturesToTranscode);
+		shouldBeTranscoding = false;
+	}
+	transcodeCondition.notify_all();
+	for (auto& t : basisThreads)
+		t.join();
 }
 
 void ResourceCreator::Initialize(platform::crossplatform::RenderPlatform* r, clientrender::VertexBufferLayout::PackingStyle packingStyle)
@@ -104,6 +114,9 @@ void ResourceCreator::Clear()
 {
 	mutex_texturesToTranscode.lock();
 	texturesToTranscode.clear();
+	transcodePriorities.clear();
+	transcodeWaitingNodes.clear();
+	transcodeWaitingNodesChanged = false;
 	mutex_texturesToTranscode.unlock();
 
 	geometryCache->ClearResourceRequests();
@@ -111,12 +124,113 @@ void ResourceCreator::Clear()
 	geometryCache->ClearReceivedResources();
 	geometryCache->m_CompletedNodes.clear();
 	geometryCache->m_MissingResources.clear();
+
+	std::lock_guard<std::mutex> lock_contentHashes(mutex_contentHashes);
+	contentHashes.clear();
 }
 
 void ResourceCreator::Update(float deltaTime)
 {
 }
 
+// Called on the render thread, which is the only one that moves the nodes, so their global transforms can be read here.
+void ResourceCreator::SetTranscodeViewPosition(const vec3& viewPosition)
+{
+	std::lock_guard<std::mutex> lock_texturesToTranscode(mutex_texturesToTranscode);
+	float dx = viewPosition.x - transcodePriorityViewPosition.x, dy = viewPosition.y - transcodePriorityViewPosition.y, dz = viewPosition.z - transcodePriorityViewPosition.z;
+	// Unless the waiting nodes have changed, only reorder the queue when the view is far enough away to change which textures are wanted first.
+	if (!transcodeWaitingNodesChanged && dx * dx + dy * dy + dz * dz < transcodePriorityMoveThreshold * transcodePriorityMoveThreshold)
+		return;
+	transcodePriorityViewPosition = viewPosition;
+	transcodeWaitingNodesChanged = false;
+	std::unordered_map<avs::uid, float> priorities = GetTranscodePriorities(transcodeWaitingNodes, viewPosition);
+	transcodePriorities.swap(priorities);
+}
+
+// A texture is wanted by the nodes waiting for it. The priority is the largest apparent size, scale over distance, of any of them.
+std::unordered_map<avs::uid, float> ResourceCreator::GetTranscodePriorities(const std::unordered_map<avs::uid, std::vector<std::weak_ptr<Node>>>& waitingNodes, const vec3& viewPosition)
+{
+	std::unordered_map<avs::uid, float> priorities;
+	for (const auto& w : waitingNodes)
+	{
+		float priority = 0.0f;
+		for (const std::weak_ptr<Node>& n : w.second)
+		{
+			std::shared_ptr<Node> node = n.lock();
+			if (!node)
+				continue;
+			const avs::vec3& pos = node->GetGlobalPosition();
+			const avs::vec3& scale = node->GetGlobalScale();
+			float dx = pos.x - viewPosition.x, dy = pos.y - viewPosition.y, dz = pos.z - viewPosition.z;
+			float size = std::max(std::max(fabs(scale.x), fabs(scale.y)), fabs(scale.z));
+			priority = std::max(priority, size / (1.0f + sqrtf(dx * dx + dy * dy + dz * dz)));
+		}
+		if (priority > 0.0f)
+			priorities[w.first] = priority;
+	}
+	return priorities;
+}
+
+// Called on the thread that creates resources, so that the missing resources it reads don't change underneath it.
+// Only the list of waiting nodes is made here: their transforms belong to the render thread, which works out the priorities from them.
+void ResourceCreator::UpdateTranscodeWaitingNodes()
+{
+	// When many resources arrive at once, there's no need to reorder the queue for each one.
+	auto now = std::chrono::steady_clock::now();
+	if (now - lastTranscodePriorityUpdate < std::chrono::milliseconds(100))
+		return;
+	lastTranscodePriorityUpdate = now;
+	std::vector<avs::uid> queued;
+	{
+		std::lock_guard<std::mutex> lock_texturesToTranscode(mutex_texturesToTranscode);
+		if (texturesToTranscode.empty())
+			return;
+		queued.reserve(texturesToTranscode.size());
+		for (const auto& t : texturesToTranscode)
+			queued.push_back(t.texture_uid);
+	}
+	// A texture is wanted by the materials waiting for it, which are wanted by the nodes waiting for them.
+	// The nodes are kept, so that the render thread can work out the priorities again when the view moves.
+	std::unordered_map<avs::uid, std::vector<std::weak_ptr<Node>>> waitingNodes;
+	{
+		std::lock_guard<std::mutex> lock_completeTexture(mutex_completeTexture);
+		for (avs::uid textureID : queued)
+		{
+			const MissingResource* missingTexture = geometryCache->GetMissingResourceIfMissing(textureID, avs::GeometryPayloadType::Texture);
+			if (!missingTexture)
+				continue;
+			std::vector<std::weak_ptr<Node>>& nodes = waitingNodes[textureID];
+			for (const auto& waiting : missingTexture->waitingResources)
+			{
+				if (waiting->type == avs::GeometryPayloadType::Node)
+				{
+					nodes.push_back(std::static_pointer_cast<Node>(waiting));
+				}
+				else if (waiting->type == avs::GeometryPayloadType::Material)
+				{
+					const MissingResource* missingMaterial = geometryCache->GetMissingResourceIfMissing(waiting->id, avs::GeometryPayloadType::Material);
+					if (!missingMaterial)
+						continue;
+					for (const auto& node : missingMaterial->waitingResources)
+					{
+						if (node->type == avs::GeometryPayloadType::Node)
+							nodes.push_back(std::static_pointer_cast<Node>(node));
+					}
+				}
+			}
+		}
+	}
+	std::lock_guard<std::mutex> lock_texturesToTranscode(mutex_texturesToTranscode);
+	transcodeWaitingNodes.swap(waitingNodes);
+	transcodeWaitingNodesChanged = true;
+}
+
+std::vector<TextureTranscodeTiming> ResourceCreator::GetTranscodeTimings() const
+{
+	std::lock_guard<std::mutex> lock_transcodeTimings(mutex_transcodeTimings);
+	return std::vector<TextureTranscodeTiming>(transcodeTimings.begin(), transcodeTimings.end());
+}
+
 avs::Result ResourceCreator::CreateMesh(avs::MeshCreate& meshCreate)
 {
 	geometryCache->ReceivedResource(meshCreate.mesh_uid);
@@ -138,6 +252,14 @@ avs::Result ResourceCreator::CreateMesh(avs::MeshCreate& meshCreate)
 	size_t num=meshCreate.m_MeshElementCreate.size();
 	mesh_ci.vb.resize(num);
 	mesh_ci.ib.resize(num);
+	// If the server has sent the mesh's content hash, keep it in the disk cache for later sessions.
+	uint64_t contentHash = diskCache ? GetContentHash(meshCreate.mesh_uid) : 0;
+	std::shared_ptr<CachedMesh> cachedMesh;
+	if (contentHash)
+	{
+		cachedMesh = std::make_shared<CachedMesh>();
+		cachedMesh->elements.resize(num);
+	}
 
 	for (size_t i = 0; i < num; i++)
 	{
@@ -150,6 +272,12 @@ avs::Result ResourceCreator::CreateMesh(avs::MeshCreate& meshCreate)
 			meshElementCreate.m_UV1s = paddedUV1s.data();
 		}
 
+		if (meshElementCreate.m_Vertices)
+		{
+			for (size_t j = 0; j < meshElementCreate.m_VertexCount; j++)
+				mesh_ci.bounds.Add(meshElementCreate.m_Vertices[j]);
+		}
+
 		std::shared_ptr<VertexBufferLayout> layout(new VertexBufferLayout);
 		if (meshElementCreate.m_Vertices)
 		{
@@ -397,37 +525,159 @@ avs::Result ResourceCreator::CreateMesh(avs::MeshCreate& meshCreate)
 			return avs::Result::GeometryDecoder_ClientRendererError;
 		}
 
-		std::shared_ptr<VertexBuffer> vb = std::make_shared<clientrender::VertexBuffer>(renderPlatform);
-		VertexBuffer::VertexBufferCreateInfo vb_ci;
-		vb_ci.layout = layout;
-		vb_ci.usage = BufferUsageBit::STATIC_BIT | BufferUsageBit::DRAW_BIT;
-		vb_ci.vertexCount = meshElementCreate.m_VertexCount;
-		vb_ci.size = constructedVBSize;
-		vb_ci.data = (const void*)constructedVB.get();
-		vb->Create(&vb_ci);
-
-		std::shared_ptr<IndexBuffer> ib = std::make_shared<clientrender::IndexBuffer>(renderPlatform);
-		IndexBuffer::IndexBufferCreateInfo ib_ci;
-		ib_ci.usage = BufferUsageBit::STATIC_BIT | BufferUsageBit::DRAW_BIT;
-		ib_ci.indexCount = meshElementCreate.m_IndexCount;
-		ib_ci.stride = meshElementCreate.m_IndexSize;
-		ib_ci.data = _indices.get();
-		ib->Create(&ib_ci);
-
-		geometryCache->mVertexBufferManager.Add(geometryCache->GenerateUid(meshElementCreate.vb_id), vb);
-		geometryCache->mIndexBufferManager.Add(geometryCache->GenerateUid(meshElementCreate.ib_id), ib);
-
-		mesh_ci.vb[i] = vb;
-		mesh_ci.ib[i] = ib;
+		CreateMeshElementBuffers(geometryCache->GenerateUid(meshElementCreate.vb_id), geometryCache->GenerateUid(meshElementCreate.ib_id), layout
+			, meshElementCreate.m_VertexCount, constructedVB.get(), constructedVBSize
+			, meshElementCreate.m_IndexCount, meshElementCreate.m_IndexSize, _indices.get()
+			, mesh_ci.vb[i], mesh_ci.ib[i]);
+
+		if (contentHash)
+		{
+			// Keep the buffers as they were given to the GPU.
+			CachedMeshElement& cachedElement = cachedMesh->elements[i];
+			cachedElement.packingStyle = layout->m_PackingStyle;
+			cachedElement.attributes = layout->m_Attributes;
+			cachedElement.stride = layout->m_Stride;
+			cachedElement.vertexCount = meshElementCreate.m_VertexCount;
+			const uint8_t* vertices = (const uint8_t*)constructedVB.get();
+			cachedElement.vertices.assign(vertices, vertices + constructedVBSize);
+			cachedElement.indexCount = meshElementCreate.m_IndexCount;
+			cachedElement.indexStride = meshElementCreate.m_IndexSize;
+			cachedElement.indices.assign(_indices.get(), _indices.get() + indicesSize);
+		}
 	}
 	if (!geometryCache->mMeshManager.Has(meshCreate.mesh_uid))
 	{
 		CompleteMesh(meshCreate.mesh_uid, mesh_ci);
 	}
+	if (contentHash)
+	{
+		cachedMesh->name = mesh_ci.name;
+		cachedMesh->bounds = mesh_ci.bounds;
+		// Written to disk on the cache's own thread.
+		diskCache->StoreMesh(contentHash, std::move(cachedMesh));
+	}
 
 	return avs::Result::OK;
 }
 
+void ResourceCreator::CreateMeshElementBuffers(geometry_cache_uid vb_uid, geometry_cache_uid ib_uid, const std::shared_ptr<VertexBufferLayout>& layout
+	, size_t vertexCount, const void* vertices, size_t verticesSize
+	, size_t indexCount, size_t indexStride, const uint8_t* indices
+	, std::shared_ptr<VertexBuffer>& vb, std::shared_ptr<IndexBuffer>& ib)
+{
+	vb = std::make_shared<clientrender::VertexBuffer>(renderPlatform);
+	VertexBuffer::VertexBufferCreateInfo vb_ci;
+	vb_ci.layout = layout;
+	vb_ci.usage = BufferUsageBit::STATIC_BIT | BufferUsageBit::DRAW_BIT;
+	vb_ci.vertexCount = vertexCount;
+	vb_ci.size = verticesSize;
+	vb_ci.data = vertices;
+	vb->Create(&vb_ci);
+
+	ib = std::make_shared<clientrender::IndexBuffer>(renderPlatform);
+	IndexBuffer::IndexBufferCreateInfo ib_ci;
+	ib_ci.usage = BufferUsageBit::STATIC_BIT | BufferUsageBit::DRAW_BIT;
+	ib_ci.indexCount = indexCount;
+	ib_ci.stride = indexStride;
+	ib_ci.data = indices;
+	ib->Create(&ib_ci);
+
+	geometryCache->mVertexBufferManager.Add(vb_uid, vb, verticesSize);
+	geometryCache->mIndexBufferManager.Add(ib_uid, ib, indexCount * indexStride);
+}
+
+std::vector<uint64_t> ResourceCreator::GetCachedResourceHashes() const
+{
+	if (!diskCache)
+		return {};
+	return diskCache->GetHashes();
+}
+
+void ResourceCreator::SetResourceContentHashes(const std::vector<teleport::core::ResourceContentHash>& hashes)
+{
+	{
+		std::lock_guard<std::mutex> lock_contentHashes(mutex_contentHashes);
+		for (const auto& h : hashes)
+			contentHashes[h.uid] = h.hash;
+	}
+	if (!diskCache)
+		return;
+	// The server does not stream what is in the disk cache, so load those now. If that fails, they will be requested
+	// from the server when a node needs them.
+	for (const auto& h : hashes)
+	{
+		switch (diskCache->GetType(h.hash))
+		{
+		case avs::GeometryPayloadType::Mesh:
+			if (!geometryCache->mMeshManager.Has(h.uid))
+				LoadMeshFromDiskCache(h.uid, h.hash);
+			break;
+		case avs::GeometryPayloadType::Texture:
+			if (!geometryCache->mTextureManager.Has(h.uid))
+				LoadTextureFromDiskCache(h.uid, h.hash);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+uint64_t ResourceCreator::GetContentHash(avs::uid id) const
+{
+	std::lock_guard<std::mutex> lock_contentHashes(mutex_contentHashes);
+	auto h = contentHashes.find(id);
+	return h != contentHashes.end() ? h->second : 0;
+}
+
+bool ResourceCreator::LoadMeshFromDiskCache(avs::uid id, uint64_t hash)
+{
+	CachedMesh cachedMesh;
+	if (!renderPlatform || !diskCache->LoadMesh(hash, cachedMesh))
+		return false;
+	clientrender::Mesh::MeshCreateInfo mesh_ci;
+	mesh_ci.name = cachedMesh.name;
+	mesh_ci.id = id;
+	mesh_ci.bounds = cachedMesh.bounds;
+	size_t num = cachedMesh.elements.size();
+	mesh_ci.vb.resize(num);
+	mesh_ci.ib.resize(num);
+	for (size_t i = 0; i < num; i++)
+	{
+		const CachedMeshElement& cachedElement = cachedMesh.elements[i];
+		std::shared_ptr<VertexBufferLayout> layout(new VertexBufferLayout);
+		layout->m_PackingStyle = cachedElement.packingStyle;
+		layout->m_Attributes = cachedElement.attributes;
+		layout->m_Stride = cachedElement.stride;
+		CreateMeshElementBuffers(geometryCache->GenerateUid(), geometryCache->GenerateUid(), layout
+			, cachedElement.vertexCount, cachedElement.vertices.data(), cachedElement.vertices.size()
+			, cachedElement.indexCount, cachedElement.indexStride, cachedElement.indices.data()
+			, mesh_ci.vb[i], mesh_ci.ib[i]);
+	}
+	CompleteMesh(id, mesh_ci);
+	return true;
+}
+
+void ResourceCreator::StoreTextureInDiskCache(avs::uid id, std::shared_ptr<const clientrender::Texture::TextureCreateInfo> textureInfo)
+{
+	if (!diskCache)
+		return;
+	// Without a content hash from the server, the texture can't be recognised in a later session.
+	uint64_t contentHash = GetContentHash(id);
+	if (contentHash)
+		diskCache->StoreTexture(contentHash, std::move(textureInfo));
+}
+
+bool ResourceCreator::LoadTextureFromDiskCache(avs::uid id, uint64_t hash)
+{
+	clientrender::Texture::TextureCreateInfo textureInfo;
+	if (!renderPlatform || !diskCache->LoadTexture(hash, textureInfo))
+		return false;
+	textureInfo.uid = id;
+	std::lock_guard<std::mutex> lock_completeTexture(mutex_completeTexture);
+	CompleteTexture(id, textureInfo);
+	return true;
+}
+
 //Returns a clientrender::Texture::Format from a avs::TextureFormat.
 clientrender::Texture::Format textureFormatFromAVSTextureFormat(avs::TextureFormat format)
 {
@@ -514,8 +764,12 @@ void ResourceCreator::CreateTexture(avs::uid id, const avs::Texture& texture)
 
 	if (texture.compression != avs::TextureCompression::UNCOMPRESSED)
 	{
-		std::lock_guard<std::mutex> lock_texturesToTranscode(mutex_texturesToTranscode);
-		texturesToTranscode.emplace_back(id, texture.data, texture.dataSize, texInfo, texture.name, texture.compression, texture.valueScale);
+		{
+			std::lock_guard<std::mutex> lock_texturesToTranscode(mutex_texturesToTranscode);
+			texturesToTranscode.emplace_back(id, texture.data, texture.dataSize, texInfo, texture.name, texture.compression, texture.valueScale);
+		}
+		transcodeCondition.notify_one();
+		UpdateTranscodeWaitingNodes();
 	}
 	else
 	{
@@ -523,7 +777,11 @@ void ResourceCreator::CreateTexture(avs::uid id, const avs::Texture& texture)
 		memcpy(texInfo->images.back().data(), texture.data, texture.dataSize);
 
 		//std::cout << "Uncompressed, completing.\n";
-		CompleteTexture(id, *texInfo);
+		{
+			std::lock_guard<std::mutex> lock_completeTexture(mutex_completeTexture);
+			CompleteTexture(id, *texInfo);
+		}
+		StoreTextureInDiskCache(id, texInfo);
 	}
 }
 
@@ -602,6 +860,7 @@ void ResourceCreator::CreateNode(avs::uid id, avs::Node& node)
 		SCR_LOG("Unknown NodeDataType: %c", static_cast<int>(node.data_type));
 		break;
 	}
+	UpdateTranscodeWaitingNodes();
 }
 
 void ResourceCreator::CreateFontAtlas(avs::uid id,teleport::core::FontAtlas &fontAtlas)
@@ -1041,7 +1300,10 @@ void ResourceCreator::CompleteTexture(avs::uid id, const clientrender::Texture::
 	std::shared_ptr<clientrender::Texture> scrTexture = std::make_shared<clientrender::Texture>(renderPlatform);
 	scrTexture->Create(textureInfo);
 
-	geometryCache->mTextureManager.Add(id, scrTexture);
+	size_t textureSize = 0;
+	for(const auto& image : textureInfo.images)
+		textureSize += image.size();
+	geometryCache->mTextureManager.Add(id, scrTexture, textureSize);
 
 	//Add texture to materials waiting for texture.
 	MissingResource * missingTexture = geometryCache->GetMissingResourceIfMissing(id, avs::GeometryPayloadType::Texture);
@@ -1190,7 +1452,7 @@ void ResourceCreator::CompleteAnimation(avs::uid id, std::shared_ptr<clientrende
 
 	//Update animation length before adding to the animation manager.
 	animation->updateAnimationLength();
-	geometryCache->mAnimationManager.Add(id, animation);
+	geometryCache->mAnimationManager.Add(id, animation, animation->getMemorySize());
 
 	//Add animation to waiting nodes.
 	MissingResource *missingAnimation = geometryCache->GetMissingResourceIfMissing(id, avs::GeometryPayloadType::Animation);
@@ -1333,127 +1595,204 @@ void ResourceCreator::BasisThread_TranscodeTextures()
 	SetThisThreadName("BasisThread_TranscodeTextures");
 	while (shouldBeTranscoding)
 	{
-		//std::this_thread::yield(); //Yield at the start, as we don't want to yield before we unlock (when lock goes out of scope).
-
-		//Copy the data out of the shared data structure and minimise thread stalls due to mutexes
-		std::vector<UntranscodedTexture> texturesToTranscode_Internal;
-		texturesToTranscode_Internal.reserve(texturesToTranscode.size());
-		{
-			std::lock_guard<std::mutex> lock_texturesToTranscode(mutex_texturesToTranscode);
-			texturesToTranscode_Internal.insert(texturesToTranscode_Internal.end(), texturesToTranscode.begin(), texturesToTranscode.end());
-			texturesToTranscode.clear();
-		}
-
-		for (UntranscodedTexture& transcoding : texturesToTranscode_Internal)
+		std::shared_ptr<BasisTranscodeJob> job;
+		std::unique_ptr<UntranscodedTexture> transcoding;
 		{
-			if (transcoding.compressionFormat == avs::TextureCompression::PNG)
+			std::unique_lock<std::mutex> lock_texturesToTranscode(mutex_texturesToTranscode);
+			transcodeCondition.wait(lock_texturesToTranscode, [this] { return !shouldBeTranscoding || !basisJobs.empty() || !texturesToTranscode.empty(); });
+			if (!shouldBeTranscoding)
+				break;
+			// Help to finish a texture that has been started, before starting another.
+			if (!basisJobs.empty())
 			{
-				RESOURCECREATOR_DEBUG_COUT("Transcoding  {0}with PNG",transcoding.name.c_str());
-				int mipWidth=0, mipHeight=0;
-				uint8_t *srcPtr=transcoding.data.data();
-				uint8_t *basePtr=srcPtr;
-				// let's have a uint16 here, N with the number of images, then a list of N uint32 offsets. Each is a subresource image. Then image 0 starts.
-				uint16_t num_images=*((uint16_t*)srcPtr);
-				std::vector<uint32_t> imageOffsets(num_images);
-				srcPtr+=sizeof(uint16_t);
-				size_t dataSize=transcoding.data.size()-sizeof(uint16_t);
-				for(int i=0;i<num_images;i++)
-				{
-					imageOffsets[i]=*((uint32_t*)srcPtr);
-					srcPtr+=sizeof(uint32_t);
-					dataSize-=sizeof(uint32_t);
-				}
-				imageOffsets.push_back((uint32_t)transcoding.data.size());
-				std::vector<uint32_t> imageSizes(num_images);
-				for(int i=0;i<num_images;i++)
-				{
-					imageSizes[i]=imageOffsets[i+1]-imageOffsets[i];
-				}
-				transcoding.textureCI->images.resize(num_images);
-				for(int i=0;i<num_images;i++)
+				job = basisJobs.front();
+			}
+			else
+			{
+				// Take the highest-priority texture, or the first queued if they are equal.
+				size_t best = 0;
+				float bestPriority = -1.0f;
+				for (size_t i = 0; i < texturesToTranscode.size(); i++)
 				{
-					// Convert from Png to raw data:
-					int num_channels=0;
-					unsigned char *target = teleport::stbi_load_from_memory(basePtr+imageOffsets[i],(int) imageSizes[i], &mipWidth, &mipHeight, &num_channels,(int)0);
-					if( mipWidth > 0 && mipHeight > 0&&target&&transcoding.data.size()>2)
-					{
-						// this is for 8-bits-per-channel textures:
-						size_t outDataSize = (size_t)(mipWidth * mipHeight * num_channels);
-						transcoding.textureCI->images[i].resize(outDataSize);
-						memcpy(transcoding.textureCI->images[i].data(), target, outDataSize);
-						transcoding.textureCI->valueScale=transcoding.valueScale;
-
-					}
-					else
+					auto p = transcodePriorities.find(texturesToTranscode[i].texture_uid);
+					float priority = p == transcodePriorities.end() ? 0.0f : p->second;
+					if (priority > bestPriority)
 					{
-						TELEPORT_CERR << "Failed to transcode PNG-format texture \"" << transcoding.name << "\"." << std::endl;
+						best = i;
+						bestPriority = priority;
 					}
-					teleport::stbi_image_free(target);
-				}
-				if (transcoding.textureCI->images.size() != 0)
-				{
-					CompleteTexture(transcoding.texture_uid, *(transcoding.textureCI));
-				}
-				else
-				{
-					TELEPORT_CERR << "Texture \"" << transcoding.name << "\" failed to transcode, no images found." << std::endl;
 				}
+				transcoding.reset(new UntranscodedTexture(std::move(texturesToTranscode[best])));
+				texturesToTranscode.erase(texturesToTranscode.begin() + best);
+				transcodePriorities.erase(transcoding->texture_uid);
+				transcodeWaitingNodes.erase(transcoding->texture_uid);
 			}
-			else if(transcoding.compressionFormat==avs::TextureCompression::BASIS_COMPRESSED)
+		}
+		if (transcoding)
+		{
+			if (transcoding->compressionFormat == avs::TextureCompression::PNG)
 			{
-				RESOURCECREATOR_DEBUG_COUT("Transcoding {0} with BASIS",transcoding.name.c_str());
-				//We need a new transcoder for every .basis file.
-				basist::basisu_transcoder basis_transcoder;
-				basist::basisu_file_info fileinfo;
-				if (!basis_transcoder.get_file_info(transcoding.data.data(), (uint32_t)transcoding.data.size(), fileinfo))
-				{
-					TELEPORT_CERR << "Failed to transcode texture \"" << transcoding.name << "\"." << std::endl;
-					continue;
-				}
-				BasisValidate(basis_transcoder, fileinfo,transcoding.data);
-				if (basis_transcoder.start_transcoding(transcoding.data.data(), (uint32_t)transcoding.data.size()))
-				{
-					transcoding.textureCI->mipCount = basis_transcoder.get_total_image_levels(transcoding.data.data(), (uint32_t)transcoding.data.size(), 0);
-					transcoding.textureCI->images.resize(transcoding.textureCI->mipCount*transcoding.textureCI->arrayCount);
+				TranscodePNGTexture(*transcoding);
+			}
+			else if (transcoding->compressionFormat == avs::TextureCompression::BASIS_COMPRESSED)
+			{
+				job = StartBasisTexture(std::move(*transcoding));
+			}
+		}
+		if (job)
+		{
+			TranscodeBasisImages(job);
+		}
+	}
+}
 
-					if (!basis_is_format_supported(basis_transcoder_textureFormat, fileinfo.m_tex_format))
-					{
-						TELEPORT_CERR << "Failed to transcode texture \"" << transcoding.name << "\"." << std::endl;
-						continue;
-					}
-					int imageIndex=0;
-					for (uint32_t arrayIndex = 0; arrayIndex < transcoding.textureCI->arrayCount; arrayIndex++)
-					{
-						for (uint32_t mipIndex = 0; mipIndex < transcoding.textureCI->mipCount; mipIndex++)
-						{
-							uint32_t basisWidth, basisHeight, basisBlocks;
-
-							basis_transcoder.get_image_level_desc(transcoding.data.data(), (uint32_t)transcoding.data.size(), arrayIndex, mipIndex, basisWidth, basisHeight, basisBlocks);
-							uint32_t outDataSize = basist::basis_get_bytes_per_block_or_pixel(basis_transcoder_textureFormat) * basisBlocks;
-							auto &img=transcoding.textureCI->images[imageIndex];
-							img.resize(outDataSize);
-							if (!basis_transcoder.transcode_image_level(transcoding.data.data(), (uint32_t)transcoding.data.size(),arrayIndex, mipIndex, img.data(), basisBlocks, basis_transcoder_textureFormat))
-							{
-								TELEPORT_CERR << "Texture \"" << transcoding.name << "\" failed to transcode mipmap level " << mipIndex << "." << std::endl;
-							}
-							imageIndex++;
-						}
-					}
+void ResourceCreator::TranscodePNGTexture(UntranscodedTexture& transcoding)
+{
+	auto startTime = std::chrono::steady_clock::now();
+	RESOURCECREATOR_DEBUG_COUT("Transcoding  {0}with PNG",transcoding.name.c_str());
+	int mipWidth=0, mipHeight=0;
+	uint8_t *srcPtr=transcoding.data.data();
+	uint8_t *basePtr=srcPtr;
+	// let's have a uint16 here, N with the number of images, then a list of N uint32 offsets. Each is a subresource image. Then image 0 starts.
+	uint16_t num_images=*((uint16_t*)srcPtr);
+	std::vector<uint32_t> imageOffsets(num_images);
+	srcPtr+=sizeof(uint16_t);
+	size_t dataSize=transcoding.data.size()-sizeof(uint16_t);
+	for(int i=0;i<num_images;i++)
+	{
+		imageOffsets[i]=*((uint32_t*)srcPtr);
+		srcPtr+=sizeof(uint32_t);
+		dataSize-=sizeof(uint32_t);
+	}
+	imageOffsets.push_back((uint32_t)transcoding.data.size());
+	std::vector<uint32_t> imageSizes(num_images);
+	for(int i=0;i<num_images;i++)
+	{
+		imageSizes[i]=imageOffsets[i+1]-imageOffsets[i];
+	}
+	transcoding.textureCI->images.resize(num_images);
+	for(int i=0;i<num_images;i++)
+	{
+		// Convert from Png to raw data:
+		int num_channels=0;
+		unsigned char *target = teleport::stbi_load_from_memory(basePtr+imageOffsets[i],(int) imageSizes[i], &mipWidth, &mipHeight, &num_channels,(int)0);
+		if( mipWidth > 0 && mipHeight > 0&&target&&transcoding.data.size()>2)
+		{
+			// this is for 8-bits-per-channel textures:
+			size_t outDataSize = (size_t)(mipWidth * mipHeight * num_channels);
+			transcoding.textureCI->images[i].resize(outDataSize);
+			memcpy(transcoding.textureCI->images[i].data(), target, outDataSize);
+			transcoding.textureCI->valueScale=transcoding.valueScale;
 
-					if (transcoding.textureCI->images.size() != 0)
-					{
-						CompleteTexture(transcoding.texture_uid, *(transcoding.textureCI));
-					}
-					else
-					{
-						TELEPORT_CERR << "Texture \"" << transcoding.name << "\" failed to transcode, but was a valid basis file." << std::endl;
-					}
-				}
-				else
-				{
-					TELEPORT_CERR << "Texture \"" << transcoding.name << "\" failed to start transcoding." << std::endl;
-				}
-			}
 		}
+		else
+		{
+			TELEPORT_CERR << "Failed to transcode PNG-format texture \"" << transcoding.name << "\"." << std::endl;
+		}
+		teleport::stbi_image_free(target);
+	}
+	if (transcoding.textureCI->images.size() != 0)
+	{
+		FinishTexture(transcoding, startTime);
+	}
+	else
+	{
+		TELEPORT_CERR << "Texture \"" << transcoding.name << "\" failed to transcode, no images found." << std::endl;
+	}
+}
+
+std::shared_ptr<ResourceCreator::BasisTranscodeJob> ResourceCreator::StartBasisTexture(UntranscodedTexture&& texture)
+{
+	auto job = std::make_shared<BasisTranscodeJob>(std::move(texture));
+	job->startTime = std::chrono::steady_clock::now();
+	UntranscodedTexture& transcoding = job->texture;
+	RESOURCECREATOR_DEBUG_COUT("Transcoding {0} with BASIS",transcoding.name.c_str());
+	basist::basisu_file_info fileinfo;
+	if (!job->transcoder.get_file_info(transcoding.data.data(), (uint32_t)transcoding.data.size(), fileinfo))
+	{
+		TELEPORT_CERR << "Failed to transcode texture \"" << transcoding.name << "\"." << std::endl;
+		return nullptr;
+	}
+	BasisValidate(job->transcoder, fileinfo,transcoding.data);
+	if (!job->transcoder.start_transcoding(transcoding.data.data(), (uint32_t)transcoding.data.size()))
+	{
+		TELEPORT_CERR << "Texture \"" << transcoding.name << "\" failed to start transcoding." << std::endl;
+		return nullptr;
+	}
+	if (!basis_is_format_supported(basis_transcoder_textureFormat, fileinfo.m_tex_format))
+	{
+		TELEPORT_CERR << "Failed to transcode texture \"" << transcoding.name << "\"." << std::endl;
+		return nullptr;
+	}
+	transcoding.textureCI->mipCount = job->transcoder.get_total_image_levels(transcoding.data.data(), (uint32_t)transcoding.data.size(), 0);
+	job->imageCount = transcoding.textureCI->mipCount * transcoding.textureCI->arrayCount;
+	transcoding.textureCI->images.resize(job->imageCount);
+	if (!job->imageCount)
+	{
+		TELEPORT_CERR << "Texture \"" << transcoding.name << "\" failed to transcode, but was a valid basis file." << std::endl;
+		return nullptr;
+	}
+	job->imagesRemaining = job->imageCount;
+	// Once started, transcode_image_level() is safe to call from several threads, so other threads can take a share of the images.
+	if (job->imageCount > 1)
+	{
+		{
+			std::lock_guard<std::mutex> lock_texturesToTranscode(mutex_texturesToTranscode);
+			basisJobs.push_back(job);
+		}
+		transcodeCondition.notify_all();
+	}
+	return job;
+}
+
+void ResourceCreator::TranscodeBasisImages(const std::shared_ptr<BasisTranscodeJob>& job)
+{
+	UntranscodedTexture& transcoding = job->texture;
+	uint32_t imageIndex;
+	while ((imageIndex = job->nextImage++) < job->imageCount)
+	{
+		uint32_t mipCount = transcoding.textureCI->mipCount;
+		uint32_t arrayIndex = imageIndex / mipCount;
+		uint32_t mipIndex = imageIndex % mipCount;
+		uint32_t basisWidth, basisHeight, basisBlocks;
+
+		job->transcoder.get_image_level_desc(transcoding.data.data(), (uint32_t)transcoding.data.size(), arrayIndex, mipIndex, basisWidth, basisHeight, basisBlocks);
+		uint32_t outDataSize = basist::basis_get_bytes_per_block_or_pixel(basis_transcoder_textureFormat) * basisBlocks;
+		auto &img=transcoding.textureCI->images[imageIndex];
+		img.resize(outDataSize);
+		if (!job->transcoder.transcode_image_level(transcoding.data.data(), (uint32_t)transcoding.data.size(),arrayIndex, mipIndex, img.data(), basisBlocks, basis_transcoder_textureFormat))
+		{
+			TELEPORT_CERR << "Texture \"" << transcoding.name << "\" failed to transcode mipmap level " << mipIndex << "." << std::endl;
+		}
+		// Whichever thread transcodes the last image completes the texture.
+		if (--job->imagesRemaining == 0)
+		{
+			FinishTexture(transcoding, job->startTime);
+		}
+	}
+	// All the images are claimed, so no other thread needs to pick this job up.
+	std::lock_guard<std::mutex> lock_texturesToTranscode(mutex_texturesToTranscode);
+	auto j = std::find(basisJobs.begin(), basisJobs.end(), job);
+	if (j != basisJobs.end())
+		basisJobs.erase(j);
+}
+
+void ResourceCreator::FinishTexture(const UntranscodedTexture& transcoding, std::chrono::steady_clock::time_point startTime)
+{
+	{
+		std::lock_guard<std::mutex> lock_completeTexture(mutex_completeTexture);
+		CompleteTexture(transcoding.texture_uid, *(transcoding.textureCI));
 	}
+	auto endTime = std::chrono::steady_clock::now();
+	StoreTextureInDiskCache(transcoding.texture_uid, transcoding.textureCI);
+	TextureTranscodeTiming timing;
+	timing.texture_uid = transcoding.texture_uid;
+	timing.name = transcoding.name;
+	timing.waitMs = std::chrono::duration<float, std::milli>(startTime - transcoding.queueTime).count();
+	timing.transcodeMs = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+	timing.imageCount = (uint32_t)transcoding.textureCI->images.size();
+	std::lock_guard<std::mutex> lock_transcodeTimings(mutex_transcodeTimings);
+	transcodeTimings.push_back(timing);
+	if (transcodeTimings.size() > maxTranscodeTimings)
+		transcodeTimings.pop_front();
 }
@@ -2,9 +2,12 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <set>
 #include <thread>
+#include <unordered_map>
 
 #include "transcoder/basisu_transcoder.h"
 
@@ -17,10 +20,12 @@
 #include "MemoryUtil.h"
 #include "NodeManager.h"
 #include "ResourceManager.h"
+#include "ResourceDiskCache.h"
 #include "Skin.h"
 #include "GeometryCache.h"
 #include "FontAtlas.h"
 #include "TextCanvas.h"
+#include "TeleportCore/CommonNetworking.h"
 
 namespace clientrender
 {
@@ -30,6 +35,16 @@ namespace clientrender
 
 namespace clientrender
 {
+	//! How long one texture took to transcode, for profiling.
+	struct TextureTranscodeTiming
+	{
+		avs::uid texture_uid = 0;
+		std::string name;
+		float waitMs = 0.0f;			//Time from being queued to starting transcoding.
+		float transcodeMs = 0.0f;		//Time from starting to finishing transcoding, across all the threads that worked on it.
+		uint32_t imageCount = 0;
+	};
+
 	/*! A class to receive geometry stream instructions and create meshes. It will then manage them for rendering and destroy them when done.*/
 	class ResourceCreator final : public avs::GeometryTargetBackendInterface
 	{
@@ -53,6 +68,23 @@ namespace clientrender
 			geometryCache = c;
 		}
 
+		//! Keep meshes and textures in this disk cache for later sessions, once the server has sent their content hashes.
+		void SetDiskCache(ResourceDiskCache* c)
+		{
+			diskCache = c;
+		}
+		//! The content hashes of the resources in the disk cache, to list in the handshake.
+		std::vector<uint64_t> GetCachedResourceHashes() const;
+		//! Record the content hashes the server sent for this session's resources. Those in the disk cache, which the server
+		//! will not stream, are loaded from it.
+		void SetResourceContentHashes(const std::vector<teleport::core::ResourceContentHash>& hashes);
+
+		//! Textures waiting to be transcoded are ordered so that those needed by the nodes nearest this position, relative to their size, go first.
+		//! Call from the render thread, which owns the nodes' transforms.
+		void SetTranscodeViewPosition(const vec3& viewPosition);
+		//! Timings of the most recently transcoded textures, oldest first.
+		std::vector<TextureTranscodeTiming> GetTranscodeTimings() const;
+
 		// Inherited via GeometryTargetBackendInterface
 		avs::Result CreateMesh(avs::MeshCreate& meshCreate) override;
 
@@ -77,6 +109,17 @@ namespace clientrender
 		void CreateLight(avs::uid id, avs::Node& node);
 		void CreateBone(avs::uid id, avs::Node& node);
 
+		//! Create the GPU buffers of a mesh element, from its packed vertices and its indices.
+		void CreateMeshElementBuffers(geometry_cache_uid vb_uid, geometry_cache_uid ib_uid, const std::shared_ptr<VertexBufferLayout>& layout
+			, size_t vertexCount, const void* vertices, size_t verticesSize
+			, size_t indexCount, size_t indexStride, const uint8_t* indices
+			, std::shared_ptr<VertexBuffer>& vb, std::shared_ptr<IndexBuffer>& ib);
+		uint64_t GetContentHash(avs::uid id) const;
+		bool LoadMeshFromDiskCache(avs::uid id, uint64_t hash);
+		bool LoadTextureFromDiskCache(avs::uid id, uint64_t hash);
+		//! The texture's data is shared with the disk cache's writer thread, so must not be modified afterwards.
+		void StoreTextureInDiskCache(avs::uid id, std::shared_ptr<const clientrender::Texture::TextureCreateInfo> textureInfo);
+
 		void CompleteMesh(avs::uid id, const clientrender::Mesh::MeshCreateInfo& meshInfo);
 		void CompleteSkin(avs::uid id, std::shared_ptr<IncompleteSkin> completeSkin);
 		void CompleteTexture(avs::uid id, const clientrender::Texture::TextureCreateInfo& textureInfo);
@@ -97,7 +140,27 @@ namespace clientrender
 								  std::shared_ptr<IncompleteMaterial> incompleteMaterial,
 								  clientrender::Material::MaterialParameter& materialParameter);
 
+		//A basis texture whose images are being transcoded, possibly by several threads at once.
+		struct BasisTranscodeJob
+		{
+			UntranscodedTexture texture;
+			basist::basisu_transcoder transcoder;
+			uint32_t imageCount = 0;
+			std::atomic<uint32_t> nextImage = 0;
+			std::atomic<uint32_t> imagesRemaining = 0;
+			std::chrono::steady_clock::time_point startTime;
+			BasisTranscodeJob(UntranscodedTexture&& t)
+				: texture(std::move(t))
+			{}
+		};
+
+		void UpdateTranscodeWaitingNodes();
+		static std::unordered_map<avs::uid, float> GetTranscodePriorities(const std::unordered_map<avs::uid, std::vector<std::weak_ptr<clientrender::Node>>>& waitingNodes, const vec3& viewPosition);
 		void BasisThread_TranscodeTextures();
+		void TranscodePNGTexture(UntranscodedTexture& transcoding);
+		std::shared_ptr<BasisTranscodeJob> StartBasisTexture(UntranscodedTexture&& transcoding);
+		void TranscodeBasisImages(const std::shared_ptr<BasisTranscodeJob>& job);
+		void FinishTexture(const UntranscodedTexture& transcoding, std::chrono::steady_clock::time_point startTime);
 
 		platform::crossplatform::RenderPlatform* renderPlatform = nullptr;
 		clientrender::VertexBufferLayout::PackingStyle m_PackingStyle = clientrender::VertexBufferLayout::PackingStyle::GROUPED;
@@ -110,9 +173,21 @@ namespace clientrender
 	#endif
 
 		std::vector<UntranscodedTexture> texturesToTranscode;
-		std::mutex mutex_texturesToTranscode;
-		std::atomic_bool shouldBeTranscoding = true;	//Whether the basis thread should be running, and transcoding textures. Settings this to false causes the thread to end.
-		std::thread basisThread;						//Thread where we transcode basis files to mip data.
+		std::unordered_map<avs::uid, float> transcodePriorities;	//Textures not listed have priority zero.
+		std::deque<std::shared_ptr<BasisTranscodeJob>> basisJobs;	//Textures with images still to be claimed by a thread.
+		std::unordered_map<avs::uid, std::vector<std::weak_ptr<clientrender::Node>>> transcodeWaitingNodes;	//The nodes waiting for each queued texture.
+		bool transcodeWaitingNodesChanged = false;					//Set when transcodeWaitingNodes is replaced, so the render thread works out the priorities again.
+		vec3 transcodePriorityViewPosition = {0, 0, 0};				//Where the view was when the transcode priorities were last worked out.
+		std::mutex mutex_texturesToTranscode;						//Guards texturesToTranscode, transcodePriorities, transcodeWaitingNodes, the two above and basisJobs.
+		std::condition_variable transcodeCondition;
+		std::atomic_bool shouldBeTranscoding = true;	//Whether the basis threads should be running, and transcoding textures. Settings this to false causes the threads to end.
+		std::vector<std::thread> basisThreads;			//Threads where we transcode basis files to mip data.
+		std::mutex mutex_completeTexture;				//Textures are completed one at a time, as that updates the geometry cache.
+		static constexpr float transcodePriorityMoveThreshold = 0.5f;	//Metres the view moves before the transcode priorities are worked out again.
+		std::chrono::steady_clock::time_point lastTranscodePriorityUpdate;
+		std::deque<TextureTranscodeTiming> transcodeTimings;
+		mutable std::mutex mutex_transcodeTimings;
+		static constexpr size_t maxTranscodeTimings = 256;
 	
 		const uint32_t whiteBGRA = 0xFFFFFFFF;
 	
@@ -122,6 +197,9 @@ namespace clientrender
 		const uint32_t greenBGRA = 0xFF337733;
 	
 		clientrender::GeometryCache* geometryCache = nullptr;
+		ResourceDiskCache* diskCache = nullptr;
+		std::unordered_map<avs::uid, uint64_t> contentHashes;	//Content hashes of this session's meshes and textures, from the server.
+		mutable std::mutex mutex_contentHashes;
 	};
 
 
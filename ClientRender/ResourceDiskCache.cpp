@@ -0,0 +1,687 @@
+// (C) Copyright 2018-2022 Simul Software Ltd
+#include "ResourceDiskCache.h"
+
+#include <cstring>
+#include <filesystem>
+
+#include "Platform/Core/FileLoader.h"
+#include "TeleportCore/ErrorHandling.h"
+
+using namespace clientrender;
+
+namespace
+{
+	const uint32_t manifestMagic = 0x4D435254;	//"TRCM"
+	const uint32_t entryMagic = 0x45435254;		//"TRCE"
+	const uint32_t cacheVersion = 1;
+
+	class Writer
+	{
+	public:
+		std::vector<uint8_t> bytes;
+		template<typename T> void Put(const T& value)
+		{
+			PutBytes(&value, sizeof(T));
+		}
+		void PutBytes(const void* data, size_t size)
+		{
+			const uint8_t* b = static_cast<const uint8_t*>(data);
+			bytes.insert(bytes.end(), b, b + size);
+		}
+		void PutString(const std::string& s)
+		{
+			Put<uint32_t>((uint32_t)s.size());
+			PutBytes(s.data(), s.size());
+		}
+		void PutVector(const std::vector<uint8_t>& v)
+		{
+			Put<uint64_t>(v.size());
+			PutBytes(v.data(), v.size());
+		}
+	};
+
+	//! Reads what Writer wrote; once anything is out of range, every read fails.
+	class Reader
+	{
+	public:
+		Reader(const uint8_t* data, size_t size)
+			: data(data), size(size)
+		{}
+		template<typename T> bool Get(T& value)
+		{
+			return GetBytes(&value, sizeof(T));
+		}
+		bool GetBytes(void* dest, size_t count)
+		{
+			if (!ok || count > size - offset)
+				return ok = false;
+			memcpy(dest, data + offset, count);
+			offset += count;
+			return true;
+		}
+		bool GetString(std::string& s)
+		{
+			uint32_t length = 0;
+			if (!Get(length) || length > size - offset)
+				return ok = false;
+			s.assign((const char*)data + offset, length);
+			offset += length;
+			return true;
+		}
+		bool GetVector(std::vector<uint8_t>& v)
+		{
+			uint64_t length = 0;
+			if (!Get(length) || length > size - offset)
+				return ok = false;
+			v.assign(data + offset, data + offset + length);
+			offset += length;
+			return true;
+		}
+		void Fail()
+		{
+			ok = false;
+		}
+		bool IsComplete() const
+		{
+			return ok && offset == size;
+		}
+
+	private:
+		const uint8_t* data;
+		size_t size;
+		size_t offset = 0;
+		bool ok = true;
+	};
+
+	bool ReadFile(const std::string& filename, std::vector<uint8_t>& bytes)
+	{
+		platform::core::FileLoader* fileLoader = platform::core::FileLoader::GetFileLoader();
+		if (!fileLoader->FileExists(filename.c_str()))
+			return false;
+		void* ptr = nullptr;
+		unsigned int sz = 0;
+		fileLoader->AcquireFileContents(ptr, sz, filename.c_str(), false);
+		if (!ptr)
+			return false;
+		bytes.assign((const uint8_t*)ptr, (const uint8_t*)ptr + sz);
+		fileLoader->ReleaseFileContents(ptr);
+		return true;
+	}
+
+	//! Writes to a temporary file that then replaces the original, so an interrupted write never leaves a partial file under the real name.
+	bool WriteFile(const std::string& filename, const std::vector<uint8_t>& bytes)
+	{
+		if (bytes.size() > 0xFFFFFFFF)
+			return false;
+		std::string tempFilename = filename + ".tmp";
+		platform::core::FileLoader* fileLoader = platform::core::FileLoader::GetFileLoader();
+		fileLoader->Save(bytes.data(), (unsigned int)bytes.size(), tempFilename.c_str(), false);
+		std::error_code ec;
+		if (!fileLoader->FileExists(tempFilename.c_str()) || std::filesystem::file_size(tempFilename, ec) != bytes.size())
+		{
+			std::filesystem::remove(tempFilename, ec);
+			return false;
+		}
+		std::filesystem::rename(tempFilename, filename, ec);
+		if (ec)
+		{
+			std::filesystem::remove(tempFilename, ec);
+			return false;
+		}
+		return true;
+	}
+}
+
+ResourceDiskCache::~ResourceDiskCache()
+{
+	{
+		std::lock_guard<std::mutex> lock(writeMutex);
+		writeThreadActive = false;
+	}
+	writeCondition.notify_all();
+	// The thread writes whatever is still queued before it finishes.
+	if (writeThread.joinable())
+		writeThread.join();
+	SaveManifest();
+}
+
+void ResourceDiskCache::SetFolder(const std::string& f)
+{
+	Flush();
+	SaveManifest();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		folder = f;
+		entries.clear();
+		entryLookup.clear();
+		totalSize = 0;
+		manifestChanged = false;
+	}
+	std::error_code ec;
+	std::filesystem::create_directories(f, ec);
+	LoadManifest();
+	DeleteOrphans();
+}
+
+void ResourceDiskCache::SetSizeLimit(uint64_t bytes)
+{
+	std::vector<std::string> evicted;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		sizeLimit = bytes;
+		evicted = Evict();
+	}
+	DeleteFiles(evicted);
+}
+
+uint64_t ResourceDiskCache::GetSizeLimit() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return sizeLimit;
+}
+
+uint64_t ResourceDiskCache::GetTotalSize() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return totalSize;
+}
+
+size_t ResourceDiskCache::GetEntryCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries.size();
+}
+
+std::vector<uint64_t> ResourceDiskCache::GetHashes() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<uint64_t> hashes;
+	hashes.reserve(entries.size());
+	for (const Entry& e : entries)
+		hashes.push_back(e.hash);
+	return hashes;
+}
+
+avs::GeometryPayloadType ResourceDiskCache::GetType(uint64_t hash) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto i = entryLookup.find(hash);
+	return i != entryLookup.end() ? i->second->type : avs::GeometryPayloadType::Invalid;
+}
+
+void ResourceDiskCache::StoreMesh(uint64_t hash, std::shared_ptr<const CachedMesh> mesh)
+{
+	if (!mesh || GetType(hash) == avs::GeometryPayloadType::Mesh)
+		return;
+	uint64_t size = 0;
+	for (const CachedMeshElement& element : mesh->elements)
+		size += element.vertices.size() + element.indices.size();
+	QueueWrite({hash, size, std::move(mesh), nullptr});
+}
+
+void ResourceDiskCache::StoreTexture(uint64_t hash, std::shared_ptr<const Texture::TextureCreateInfo> textureInfo)
+{
+	if (!textureInfo || GetType(hash) == avs::GeometryPayloadType::Texture)
+		return;
+	uint64_t size = 0;
+	for (const auto& image : textureInfo->images)
+		size += image.size();
+	QueueWrite({hash, size, nullptr, std::move(textureInfo)});
+}
+
+void ResourceDiskCache::Flush()
+{
+	std::unique_lock<std::mutex> lock(writeMutex);
+	writtenCondition.wait(lock, [this] { return pendingHashes.empty(); });
+}
+
+void ResourceDiskCache::QueueWrite(PendingWrite&& pendingWrite)
+{
+	{
+		std::lock_guard<std::mutex> lock(writeMutex);
+		if (pendingHashes.count(pendingWrite.hash))
+			return;
+		// The disk isn't keeping up; it's only a cache, so the entry can be left out.
+		if (pendingSize + pendingWrite.size > maxPendingSize)
+			return;
+		if (!writeThread.joinable())
+		{
+			writeThreadActive = true;
+			writeThread = std::thread(&ResourceDiskCache::WriteAsync, this);
+		}
+		pendingHashes.insert(pendingWrite.hash);
+		pendingSize += pendingWrite.size;
+		pendingWrites.push_back(std::move(pendingWrite));
+	}
+	writeCondition.notify_one();
+}
+
+void ResourceDiskCache::WriteAsync()
+{
+	std::unique_lock<std::mutex> lock(writeMutex);
+	while (true)
+	{
+		writeCondition.wait(lock, [this] { return !writeThreadActive || !pendingWrites.empty(); });
+		if (pendingWrites.empty())
+			break;
+		PendingWrite pendingWrite = std::move(pendingWrites.front());
+		pendingWrites.pop_front();
+		lock.unlock();
+		uint64_t hash = pendingWrite.hash;
+		uint64_t size = pendingWrite.size;
+		if (pendingWrite.mesh)
+			WriteMesh(hash, *pendingWrite.mesh);
+		else if (pendingWrite.textureInfo)
+			WriteTexture(hash, *pendingWrite.textureInfo);
+		// Release the data before waking anyone waiting for the write.
+		pendingWrite = {};
+		lock.lock();
+		pendingHashes.erase(hash);
+		pendingSize -= size;
+		if (pendingHashes.empty())
+			writtenCondition.notify_all();
+	}
+}
+
+bool ResourceDiskCache::WriteMesh(uint64_t hash, const CachedMesh& mesh)
+{
+	Writer w;
+	w.PutString(mesh.name);
+	w.Put(mesh.bounds.lower);
+	w.Put(mesh.bounds.upper);
+	w.Put<uint32_t>((uint32_t)mesh.elements.size());
+	for (const CachedMeshElement& element : mesh.elements)
+	{
+		w.Put<uint32_t>((uint32_t)element.packingStyle);
+		w.Put<uint32_t>((uint32_t)element.attributes.size());
+		for (const auto& attribute : element.attributes)
+		{
+			w.Put<uint32_t>(attribute.location);
+			w.Put<uint32_t>((uint32_t)attribute.componentCount);
+			w.Put<uint32_t>((uint32_t)attribute.type);
+		}
+		w.Put(element.stride);
+		w.Put(element.vertexCount);
+		w.PutVector(element.vertices);
+		w.Put(element.indexCount);
+		w.Put(element.indexStride);
+		w.PutVector(element.indices);
+	}
+	return Store(hash, avs::GeometryPayloadType::Mesh, w.bytes);
+}
+
+bool ResourceDiskCache::WriteTexture(uint64_t hash, const Texture::TextureCreateInfo& textureInfo)
+{
+	Writer w;
+	w.PutString(textureInfo.name);
+	w.Put(textureInfo.width);
+	w.Put(textureInfo.height);
+	w.Put(textureInfo.depth);
+	w.Put(textureInfo.bytesPerPixel);
+	w.Put(textureInfo.arrayCount);
+	w.Put(textureInfo.mipCount);
+	w.Put<uint32_t>((uint32_t)textureInfo.type);
+	w.Put<uint32_t>((uint32_t)textureInfo.format);
+	w.Put<uint32_t>((uint32_t)textureInfo.sampleCount);
+	w.Put<uint32_t>((uint32_t)textureInfo.compression);
+	w.Put<uint8_t>(textureInfo.externalResource ? 1 : 0);
+	w.Put(textureInfo.valueScale);
+	w.Put<uint32_t>((uint32_t)textureInfo.images.size());
+	for (const auto& image : textureInfo.images)
+		w.PutVector(image);
+	return Store(hash, avs::GeometryPayloadType::Texture, w.bytes);
+}
+
+bool ResourceDiskCache::LoadMesh(uint64_t hash, CachedMesh& mesh)
+{
+	std::vector<uint8_t> bytes;
+	if (!Load(hash, avs::GeometryPayloadType::Mesh, bytes))
+		return false;
+	Reader r(bytes.data(), bytes.size());
+	uint32_t elementCount = 0;
+	r.GetString(mesh.name);
+	r.Get(mesh.bounds.lower);
+	r.Get(mesh.bounds.upper);
+	r.Get(elementCount);
+	mesh.elements.clear();
+	// Each element takes at least this many bytes, which bounds the count before anything is allocated.
+	const size_t minElementSize = 2 * sizeof(uint32_t) + 5 * sizeof(uint64_t) + sizeof(uint32_t);
+	if (elementCount <= bytes.size() / minElementSize)
+		mesh.elements.resize(elementCount);
+	else
+		r.Fail();
+	for (CachedMeshElement& element : mesh.elements)
+	{
+		uint32_t packingStyle = 0, attributeCount = 0;
+		r.Get(packingStyle);
+		r.Get(attributeCount);
+		element.packingStyle = (VertexBufferLayout::PackingStyle)packingStyle;
+		if (attributeCount > 16)
+		{
+			r.Fail();
+			break;
+		}
+		element.attributes.resize(attributeCount);
+		for (auto& attribute : element.attributes)
+		{
+			uint32_t componentCount = 0, type = 0;
+			r.Get(attribute.location);
+			r.Get(componentCount);
+			r.Get(type);
+			attribute.componentCount = (VertexBufferLayout::ComponentCount)componentCount;
+			attribute.type = (VertexBufferLayout::Type)type;
+		}
+		r.Get(element.stride);
+		r.Get(element.vertexCount);
+		r.GetVector(element.vertices);
+		r.Get(element.indexCount);
+		r.Get(element.indexStride);
+		r.GetVector(element.indices);
+		if (element.vertices.size() != element.stride * element.vertexCount || element.indices.size() != element.indexCount * element.indexStride)
+		{
+			r.Fail();
+			break;
+		}
+	}
+	if (!r.IsComplete())
+	{
+		TELEPORT_CERR << "Cached mesh " << GetEntryFilename(hash) << " is corrupt, so will be streamed instead.\n";
+		Remove(hash);
+		return false;
+	}
+	return true;
+}
+
+bool ResourceDiskCache::LoadTexture(uint64_t hash, Texture::TextureCreateInfo& textureInfo)
+{
+	std::vector<uint8_t> bytes;
+	if (!Load(hash, avs::GeometryPayloadType::Texture, bytes))
+		return false;
+	Reader r(bytes.data(), bytes.size());
+	uint32_t type = 0, format = 0, sampleCount = 0, compression = 0, imageCount = 0;
+	uint8_t externalResource = 0;
+	r.GetString(textureInfo.name);
+	r.Get(textureInfo.width);
+	r.Get(textureInfo.height);
+	r.Get(textureInfo.depth);
+	r.Get(textureInfo.bytesPerPixel);
+	r.Get(textureInfo.arrayCount);
+	r.Get(textureInfo.mipCount);
+	r.Get(type);
+	r.Get(format);
+	r.Get(sampleCount);
+	r.Get(compression);
+	r.Get(externalResource);
+	r.Get(textureInfo.valueScale);
+	r.Get(imageCount);
+	textureInfo.type = (Texture::Type)type;
+	textureInfo.format = (Texture::Format)format;
+	textureInfo.sampleCount = (Texture::SampleCountBit)sampleCount;
+	textureInfo.compression = (Texture::CompressionFormat)compression;
+	textureInfo.externalResource = externalResource != 0;
+	textureInfo.images.clear();
+	if (imageCount <= bytes.size() / sizeof(uint64_t))
+		textureInfo.images.resize(imageCount);
+	else
+		r.Fail();
+	for (auto& image : textureInfo.images)
+		r.GetVector(image);
+	if (!r.IsComplete())
+	{
+		TELEPORT_CERR << "Cached texture " << GetEntryFilename(hash) << " is corrupt, so will be streamed instead.\n";
+		Remove(hash);
+		return false;
+	}
+	return true;
+}
+
+void ResourceDiskCache::Update(float deltaTime)
+{
+	timeSinceManifestSaved += deltaTime;
+	if (timeSinceManifestSaved < manifestSaveInterval)
+		return;
+	timeSinceManifestSaved = 0.0f;
+	SaveManifest();
+}
+
+void ResourceDiskCache::SaveManifest()
+{
+	std::string filename;
+	std::vector<uint8_t> bytes;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!manifestChanged || folder.empty())
+			return;
+		manifestChanged = false;
+		filename = folder + "/manifest.bin";
+		bytes = WriteManifest();
+	}
+	if (!WriteFile(filename, bytes))
+		TELEPORT_CERR << "Failed to write the resource cache manifest " << filename << ".\n";
+}
+
+std::string ResourceDiskCache::GetEntryFilename(uint64_t hash) const
+{
+	static const char hex[] = "0123456789abcdef";
+	std::string name(16, '0');
+	for (int i = 15; i >= 0; i--, hash >>= 4)
+		name[i] = hex[hash & 0xF];
+	return folder + "/" + name + ".bin";
+}
+
+bool ResourceDiskCache::Store(uint64_t hash, avs::GeometryPayloadType type, const std::vector<uint8_t>& payload)
+{
+	Writer w;
+	w.bytes.reserve(payload.size() + 16);
+	w.Put(entryMagic);
+	w.Put(cacheVersion);
+	w.Put<uint8_t>((uint8_t)type);
+	w.PutBytes(payload.data(), payload.size());
+	std::string filename;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (folder.empty() || w.bytes.size() > sizeLimit)
+			return false;
+		filename = GetEntryFilename(hash);
+	}
+	if (!WriteFile(filename, w.bytes))
+	{
+		TELEPORT_CERR << "Failed to write cached resource " << filename << ".\n";
+		return false;
+	}
+	std::vector<std::string> evicted;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto i = entryLookup.find(hash);
+		if (i != entryLookup.end())
+		{
+			totalSize -= i->second->size;
+			entries.erase(i->second);
+		}
+		entries.push_front({hash, type, w.bytes.size()});
+		entryLookup[hash] = entries.begin();
+		totalSize += w.bytes.size();
+		manifestChanged = true;
+		evicted = Evict();
+	}
+	DeleteFiles(evicted);
+	return true;
+}
+
+bool ResourceDiskCache::Load(uint64_t hash, avs::GeometryPayloadType type, std::vector<uint8_t>& bytes)
+{
+	std::string filename;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto i = entryLookup.find(hash);
+		if (i == entryLookup.end() || i->second->type != type)
+			return false;
+		entries.splice(entries.begin(), entries, i->second);
+		manifestChanged = true;
+		filename = GetEntryFilename(hash);
+	}
+	std::vector<uint8_t> file;
+	uint32_t magic = 0, version = 0;
+	uint8_t storedType = 0;
+	Reader r(file.data(), 0);
+	if (ReadFile(filename, file))
+	{
+		r = Reader(file.data(), file.size());
+		r.Get(magic);
+		r.Get(version);
+		r.Get(storedType);
+	}
+	const size_t headerSize = sizeof(magic) + sizeof(version) + sizeof(storedType);
+	if (file.size() < headerSize || magic != entryMagic || version != cacheVersion || storedType != (uint8_t)type)
+	{
+		TELEPORT_CERR << "Cached resource " << filename << " is missing or invalid, so will be streamed instead.\n";
+		Remove(hash);
+		return false;
+	}
+	bytes.assign(file.begin() + headerSize, file.end());
+	return true;
+}
+
+void ResourceDiskCache::Remove(uint64_t hash)
+{
+	std::string filename;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto i = entryLookup.find(hash);
+		if (i == entryLookup.end())
+			return;
+		totalSize -= i->second->size;
+		entries.erase(i->second);
+		entryLookup.erase(i);
+		manifestChanged = true;
+		filename = GetEntryFilename(hash);
+	}
+	DeleteFiles({filename});
+}
+
+std::vector<std::string> ResourceDiskCache::Evict()
+{
+	std::vector<std::string> evicted;
+	// The newest entry is kept, as it was just used.
+	while (totalSize > sizeLimit && entries.size() > 1)
+	{
+		const Entry& e = entries.back();
+		evicted.push_back(GetEntryFilename(e.hash));
+		totalSize -= e.size;
+		entryLookup.erase(e.hash);
+		entries.pop_back();
+		manifestChanged = true;
+	}
+	return evicted;
+}
+
+void ResourceDiskCache::DeleteFiles(const std::vector<std::string>& filenames)
+{
+	for (const std::string& f : filenames)
+	{
+		std::error_code ec;
+		std::filesystem::remove(f, ec);
+	}
+}
+
+void ResourceDiskCache::LoadManifest()
+{
+	std::string filename;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		filename = folder + "/manifest.bin";
+	}
+	std::vector<uint8_t> bytes;
+	if (!ReadFile(filename, bytes))
+		return;
+	Reader r(bytes.data(), bytes.size());
+	uint32_t magic = 0, version = 0;
+	uint64_t count = 0;
+	r.Get(magic);
+	r.Get(version);
+	r.Get(count);
+	if (magic != manifestMagic || version != cacheVersion)
+	{
+		TELEPORT_CERR << "Resource cache manifest " << filename << " is not readable; starting with an empty cache.\n";
+		return;
+	}
+	const size_t recordSize = sizeof(uint64_t) + sizeof(uint8_t) + sizeof(uint64_t);
+	if (count > bytes.size() / recordSize)
+		count = 0;
+	std::vector<Entry> loaded(count);
+	for (Entry& e : loaded)
+	{
+		uint8_t type = 0;
+		r.Get(e.hash);
+		r.Get(type);
+		r.Get(e.size);
+		e.type = (avs::GeometryPayloadType)type;
+	}
+	if (!r.IsComplete())
+	{
+		TELEPORT_CERR << "Resource cache manifest " << filename << " is corrupt; starting with an empty cache.\n";
+		return;
+	}
+	platform::core::FileLoader* fileLoader = platform::core::FileLoader::GetFileLoader();
+	std::vector<std::string> evicted;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// Listed most recently used first.
+		for (const Entry& e : loaded)
+		{
+			if (entryLookup.count(e.hash) || !fileLoader->FileExists(GetEntryFilename(e.hash).c_str()))
+			{
+				manifestChanged = true;
+				continue;
+			}
+			entries.push_back(e);
+			entryLookup[e.hash] = std::prev(entries.end());
+			totalSize += e.size;
+		}
+		evicted = Evict();
+	}
+	DeleteFiles(evicted);
+}
+
+void ResourceDiskCache::DeleteOrphans()
+{
+	std::string cacheFolder;
+	std::unordered_set<std::string> entryFilenames;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		cacheFolder = folder;
+		for (const Entry& e : entries)
+			entryFilenames.insert(std::filesystem::path(GetEntryFilename(e.hash)).filename().string());
+	}
+	// Entries written after the manifest was last saved, those whose eviction was never recorded, and temporary files
+	// left by an interrupted write would otherwise take up space that nothing accounts for, for good.
+	std::vector<std::string> orphans;
+	std::error_code ec;
+	for (const auto& dirEntry : std::filesystem::directory_iterator(cacheFolder, ec))
+	{
+		if (!dirEntry.is_regular_file(ec))
+			continue;
+		std::string name = dirEntry.path().filename().string();
+		std::string extension = dirEntry.path().extension().string();
+		if (name == "manifest.bin" || (extension != ".bin" && extension != ".tmp"))
+			continue;
+		if (!entryFilenames.count(name))
+			orphans.push_back(dirEntry.path().string());
+	}
+	DeleteFiles(orphans);
+}
+
+std::vector<uint8_t> ResourceDiskCache::WriteManifest() const
+{
+	Writer w;
+	w.Put(manifestMagic);
+	w.Put(cacheVersion);
+	w.Put<uint64_t>(entries.size());
+	for (const Entry& e : entries)
+	{
+		w.Put(e.hash);
+		w.Put<uint8_t>((uint8_t)e.type);
+		w.Put(e.size);
+	}
+	return std::move(w.bytes);
+}
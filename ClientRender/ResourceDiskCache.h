@@ -0,0 +1,133 @@
+// (C) Copyright 2018-2022 Simul Software Ltd
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <libavstream/common.hpp>
+
+#include "Mesh.h"
+#include "Texture.h"
+#include "VertexBufferLayout.h"
+
+namespace clientrender
+{
+	//! A mesh element as it is given to the GPU: the packed vertex buffer with its layout, and the index buffer.
+	struct CachedMeshElement
+	{
+		VertexBufferLayout::PackingStyle packingStyle = VertexBufferLayout::PackingStyle::INTERLEAVED;
+		std::vector<VertexBufferLayout::VertexAttribute> attributes;
+		uint64_t stride = 0;
+		uint64_t vertexCount = 0;
+		std::vector<uint8_t> vertices;
+		uint64_t indexCount = 0;
+		uint32_t indexStride = 0;
+		std::vector<uint8_t> indices;
+	};
+
+	struct CachedMesh
+	{
+		std::string name;
+		Bounds bounds;
+		std::vector<CachedMeshElement> elements;
+	};
+
+	//! Keeps meshes and textures on disk between sessions, in the form they are given to the GPU, so that when a server
+	//! would stream them again they need neither be downloaded nor transcoded.
+	//! Entries are keyed by the content hash the server sends for each resource, as a uid only holds for one session.
+	//! A manifest lists the entries in order of use; the least recently used are deleted to keep the total size within a limit.
+	//! Entries and the manifest are written to temporary files that then replace them, so a crash leaves no partial files.
+	//! The methods can be called from any thread. Entries are written on a thread of their own, so storing one doesn't wait on the disk.
+	class ResourceDiskCache
+	{
+	public:
+		static constexpr uint64_t defaultSizeLimit = 1024ull * 1024ull * 1024ull;
+
+		~ResourceDiskCache();
+		//! Use this folder, and read its manifest. Entries whose files have gone are dropped, and files the manifest doesn't list are deleted.
+		void SetFolder(const std::string& folder);
+		void SetSizeLimit(uint64_t bytes);
+		uint64_t GetSizeLimit() const;
+		uint64_t GetTotalSize() const;
+		size_t GetEntryCount() const;
+		//! The content hashes of all the entries, to list in the handshake.
+		std::vector<uint64_t> GetHashes() const;
+		//! The type of the entry with this hash, or Invalid if there is none.
+		avs::GeometryPayloadType GetType(uint64_t hash) const;
+
+		//! Queue an entry to be written, unless there is one already. The data is shared with the writer thread, so must not be
+		//! modified afterwards. If too much is already waiting to be written, the entry is not kept.
+		void StoreMesh(uint64_t hash, std::shared_ptr<const CachedMesh> mesh);
+		void StoreTexture(uint64_t hash, std::shared_ptr<const Texture::TextureCreateInfo> textureInfo);
+		//! Wait until every queued entry has been written.
+		void Flush();
+		//! Read an entry, making it the most recently used. An entry that cannot be read is removed.
+		bool LoadMesh(uint64_t hash, CachedMesh& mesh);
+		bool LoadTexture(uint64_t hash, Texture::TextureCreateInfo& textureInfo);
+
+		//! Writes the manifest, if it has changed, every few seconds; should be called regularly.
+		//!	deltaTime : Seconds since the last call.
+		void Update(float deltaTime);
+		//! Write the manifest now, if it has changed.
+		void SaveManifest();
+
+	private:
+		struct PendingWrite
+		{
+			uint64_t hash = 0;
+			uint64_t size = 0;
+			std::shared_ptr<const CachedMesh> mesh;
+			std::shared_ptr<const Texture::TextureCreateInfo> textureInfo;
+		};
+		struct Entry
+		{
+			uint64_t hash = 0;
+			avs::GeometryPayloadType type = avs::GeometryPayloadType::Invalid;
+			uint64_t size = 0;
+		};
+		mutable std::mutex mutex;
+		std::string folder;
+		std::list<Entry> entries;	//Most recently used first.
+		std::unordered_map<uint64_t, std::list<Entry>::iterator> entryLookup;
+		uint64_t totalSize = 0;
+		uint64_t sizeLimit = defaultSizeLimit;
+		bool manifestChanged = false;
+		float timeSinceManifestSaved = 0.0f;
+		static constexpr float manifestSaveInterval = 5.0f;
+
+		std::thread writeThread;
+		bool writeThreadActive = false;
+		std::mutex writeMutex;
+		std::condition_variable writeCondition;		// Signalled when there is an entry to write, or on shutdown.
+		std::condition_variable writtenCondition;	// Signalled when every queued entry has been written.
+		std::deque<PendingWrite> pendingWrites;
+		std::unordered_set<uint64_t> pendingHashes;	// Entries queued or being written.
+		uint64_t pendingSize = 0;					// Bytes of data queued or being written.
+		static constexpr uint64_t maxPendingSize = 256ull * 1024ull * 1024ull;
+
+		void QueueWrite(PendingWrite&& pendingWrite);
+		void WriteAsync();
+		bool WriteMesh(uint64_t hash, const CachedMesh& mesh);
+		bool WriteTexture(uint64_t hash, const Texture::TextureCreateInfo& textureInfo);
+
+		std::string GetEntryFilename(uint64_t hash) const;
+		bool Store(uint64_t hash, avs::GeometryPayloadType type, const std::vector<uint8_t>& bytes);
+		bool Load(uint64_t hash, avs::GeometryPayloadType type, std::vector<uint8_t>& bytes);
+		void Remove(uint64_t hash);
+		//! Remove the least recently used entries until the total size is within the limit. Returns the files to delete.
+		std::vector<std::string> Evict();
+		void DeleteFiles(const std::vector<std::string>& filenames);
+		void LoadManifest();
+		//! Delete the files in the folder that are not entries in the manifest.
+		void DeleteOrphans();
+		std::vector<uint8_t> WriteManifest() const;
+	};
+}
@@ -8,7 +8,10 @@
 #include <memory> //Smart pointers
 #include <mutex> //Thread safety.
 #include <algorithm> //std::remove
-#include "MemoryUtil.h"
+#include <atomic> //std::atomic
+#include <chrono> //Timing lookups that wait.
+#include <list> //std::list
+#include <shared_mutex> //Lookups by many threads at once.
 
 namespace clientrender
 {
@@ -76,8 +79,24 @@ namespace clientrender
 }
 typedef unsigned long long uid; //Unique identifier for a resource.
 
-//A class for managing resources that are destroyed after a set amount of time.
+//The memory shared by a group of resource managers, e.g. those of one GeometryCache.
+//While the resident total is over the budget, the managers free their least recently used resources that are not in use.
+struct ResourceMemoryBudget
+{
+	std::atomic<size_t> residentBytes = 0;
+	size_t budgetBytes = 0; //Zero for no limit.
+
+	bool IsExceeded() const
+	{
+		return budgetBytes != 0 && residentBytes > budgetBytes;
+	}
+};
+
+//A class for managing resources that are destroyed after a set amount of time, or sooner when memory is short.
 //Get resources by claiming them, and then unclaim them when you no longer are using them; i.e. when the object instant is destructed.
+//The resources are kept in order of use, so only the least recently used need be checked each tick.
+//Lookups by id go through a set of shards, each with its own reader-writer lock, so the render thread's calls to Get
+//neither wait on each other nor on the main lock, which threads adding resources and the Update hold for longer.
 template<typename u,class T>
 class ResourceManager
 {
@@ -86,8 +105,12 @@ public:
 	struct ResourceData
 	{
 		std::shared_ptr<T> resource;
-		float postUseLifetime_s; // Seconds the resource should be kept alive after the last object has stopped using it.
-		float timeSinceLastUse_s; // Seconds since the data was last used by the session.
+		float postUseLifetime_s = 0.0f; // Seconds the resource should be kept alive after the last object has stopped using it.
+		size_t size_bytes = 0; // Memory the resource holds, e.g. in GPU buffers.
+		std::atomic<float> lastUse_s = 0.0f; // Manager time at which the resource was last used; set by Get() on any thread.
+		float listTime_s = 0.0f; // Manager time at which the resource was put at the front of the list.
+		bool wasInUse = false; // Whether the resource was found in use when last checked, so may have been released since.
+		typename std::list<u>::iterator recency; // Position in the list of resources in order of use.
 	};
 
 	//Create a resource manager with the class specific function to free it from memory before destroying the resource.
@@ -97,11 +120,18 @@ public:
 	//Add a resource to the resource manager.
 	//	id : Unique identifier of the resource.
 	//	newResource : The resource.
-	//	postUseLifetime : Milliseconds the resource should be kept alive after the last object has stopped using it.
-	void Add(u id, std::shared_ptr<T> & newItem, float postUseLifetime_s = 60.0f);
+	//	size_bytes : Memory held by the resource, counted against the memory budget.
+	//	postUseLifetime : Seconds the resource should be kept alive after the last object has stopped using it.
+	void Add(u id, std::shared_ptr<T> & newItem, size_t size_bytes = 0, float postUseLifetime_s = 60.0f);
 
 	//Returns whether the manager contains the resource.
 	bool Has(u id) const;
+
+	//Returns the number of resources held.
+	size_t GetCount() const
+	{
+		return count;
+	}
 	
 	//Returns the internal cache.
 	//	cacheLock : A lock which must live for the same duration of the map, or will break thread-safety. 
@@ -112,6 +142,27 @@ public:
 	//Set the factor to adjust the lifetime of resources before freeing them; i.e. 0.5 would halve the lifetime of a resource in the manager.
 	void SetLifetimeFactor(float lifetimeFactor);
 
+	//Share a memory budget with other managers; nullptr for none.
+	void SetMemoryBudget(ResourceMemoryBudget* budget);
+
+	//Returns the total size of the resources held, in bytes.
+	size_t GetResidentBytes() const
+	{
+		return residentBytes;
+	}
+
+	//Returns how many resources have been freed by Update, for being unused too long or to keep within the memory budget.
+	uint64_t GetEvictionCount() const
+	{
+		return evictionCount;
+	}
+
+	//Returns the total time that lookups have spent waiting for resources to be added or removed, in microseconds.
+	uint64_t GetLookupWait_us() const
+	{
+		return lookupWait_ns / 1000;
+	}
+
 	//! Returns a shared pointer to the resource; returns nullptr if the resource was not found.
 	// !Resets time since last use of the resource.
 	std::shared_ptr<T> Get(u id);
@@ -120,11 +171,11 @@ public:
 	u GetUidByName(const char *) const;
 
 	//Returns a shared pointer to the resource; returns nullptr if the resource was not found.
-	//Resets time since last use of the resource.
 	std::shared_ptr<const T> Get(u id) const;
 
-	//Pushes the IDs of all of the resources stored in the resource manager into the passed vector.
-	const std::vector<u>& GetAllIDs() const;
+	//Returns the IDs of all of the resources stored in the resource manager.
+	//The list is only rebuilt when resources have been added or removed since the last call, and is not changed once returned.
+	std::shared_ptr<const std::vector<u>> GetAllIDs() const;
 
 	//Clear, and free memory of, all resources.
 	void Clear();
@@ -133,31 +184,60 @@ public:
 	void ClearAllButExcluded(std::vector<u>& excludeList);
 
 	//Process the ResourceManager for this tick; allowing it to free any resources that have not been used for a while.
-	//	deltaTimestamp : Milliseconds that have passed since the last update.
+	//	deltaTimestamp : Seconds that have passed since the last update.
 	void Update(float deltaTimestamp);
 private:
-
-	mutable std::vector<u> resourceIDs;
-	mutable uint64_t cacheChecksum=0;
-	mutable uint64_t idListChecksum=0;
 	//Increases readability by obfuscating the full iterator definition.
 	typedef typename std::unordered_map<u, ResourceManager<u,T>::ResourceData>::iterator mapIterator_t;
 
+	//Part of the index from id to resource. Entries are added and removed with the main mutex held as well.
+	struct Shard
+	{
+		mutable std::shared_mutex mutex;
+		std::unordered_map<u, ResourceData*> items;
+	};
+	static constexpr size_t shardCount = 16;
+	Shard shards[shardCount];
+
 	float lifetimeFactor = 1.0; //The factor lifetimes are adjusted to determine if a resource should be freed. 0.5 = Halve lifetime.
 	std::function<void(T&)> freeResourceFunction; //A functional reference to the function that frees this resource.
 	std::unordered_map<u, ResourceData> cachedItems = std::unordered_map<u, ResourceData>(); //Hashmap of the stored resources.
+	std::list<u> recentlyUsed; //IDs of the stored resources, most recently used first.
+	mutable std::shared_ptr<const std::vector<u>> resourceIDs; //Null when resources have changed since it was made.
+	std::atomic<float> time_s = 0.0f; //Seconds of updates since construction.
+	std::atomic<size_t> count = 0;
+	std::atomic<size_t> residentBytes = 0;
+	std::atomic<uint64_t> evictionCount = 0;
+	mutable std::atomic<uint64_t> lookupWait_ns = 0;
+	ResourceMemoryBudget* memoryBudget = nullptr;
 
 	mutable std::mutex mutex_cachedItems; //Mutex for thread-safety of cachedItems.
 
+	Shard& GetShard(u id)
+	{
+		return shards[std::hash<u>()(id) % shardCount];
+	}
+	const Shard& GetShard(u id) const
+	{
+		return shards[std::hash<u>()(id) % shardCount];
+	}
+	//Lock the shard for reading, adding any time spent waiting to lookupWait_ns.
+	std::shared_lock<std::shared_mutex> LockShard(const Shard& shard) const;
 	//Frees the resource using the function that was passed to the resource manager on construction
 	void FreeResource(T & resource);
+	//Mark the resource as just used.
+	void Touch(ResourceData& data);
+	//Move the resource to the front of the list, keeping its last use. The list stays in order of when resources were listed,
+	//which is never earlier than their last use before then, so a resource may be freed up to one lifetime late, but never early.
+	void Relist(ResourceData& data);
 	//Remove, and free the memory of, the item the iterator is pointing to.
 	//	it : Iterator pointing to the item we want to delete.
 	//Returns an iterator to the next item in the unordered map.
 	mapIterator_t RemoveResource(mapIterator_t it);
-
-	// Bytes
-	static constexpr long MIN_REQUIRED_MEMORY = 1000000;
+	//Remove the item if nothing outside the manager is using it. Returns whether it was removed.
+	bool TryEvictResource(mapIterator_t it);
+	//Free the item once it is no longer in the index, and remove it from the cache.
+	mapIterator_t EraseResource(mapIterator_t it);
 };
 
 template<typename u,class T>
@@ -172,17 +252,36 @@ ResourceManager<u,T>::~ResourceManager()
 }
 
 template<typename u,class T>
-void ResourceManager<u,T>::Add(u id, std::shared_ptr<T> & newItem, float postUseLifetime_s)
+void ResourceManager<u,T>::Add(u id, std::shared_ptr<T> & newItem, size_t size_bytes, float postUseLifetime_s)
 {
 	std::lock_guard<std::mutex> lock_cachedItems(mutex_cachedItems);
-	cachedItems.emplace(id, ResourceData{newItem, postUseLifetime_s, 0});
-	cacheChecksum++;
+	auto [it, inserted] = cachedItems.try_emplace(id);
+	if(!inserted)
+		return;
+	ResourceData& data = it->second;
+	data.resource = newItem;
+	data.postUseLifetime_s = postUseLifetime_s;
+	data.size_bytes = size_bytes;
+	data.listTime_s = time_s;
+	data.lastUse_s = data.listTime_s;
+	data.recency = recentlyUsed.insert(recentlyUsed.begin(), id);
+	{
+		Shard& shard = GetShard(id);
+		std::unique_lock<std::shared_mutex> lock_shard(shard.mutex);
+		shard.items.emplace(id, &data);
+	}
+	count++;
+	residentBytes += size_bytes;
+	if(memoryBudget)
+		memoryBudget->residentBytes += size_bytes;
+	resourceIDs.reset();
 }
 
 template<typename u,class T> bool ResourceManager<u,T>::Has(u id) const
 {
-	std::lock_guard<std::mutex> lock_cachedItems(mutex_cachedItems);
-	return cachedItems.find(id) != cachedItems.end();
+	const Shard& shard = GetShard(id);
+	std::shared_lock<std::shared_mutex> lock_shard = LockShard(shard);
+	return shard.items.find(id) != shard.items.end();
 }
 
 template<typename u,class T> inline std::unordered_map<u, typename ResourceManager<u,T>::ResourceData>& ResourceManager<u,T>::GetCache(std::unique_ptr<std::lock_guard<std::mutex>>& cacheLock)
@@ -202,6 +301,16 @@ template<typename u,class T> void ResourceManager<u,T>::SetLifetimeFactor(float
 	this->lifetimeFactor = lifetimeFactor;
 }
 
+template<typename u,class T> void ResourceManager<u,T>::SetMemoryBudget(ResourceMemoryBudget* budget)
+{
+	std::lock_guard<std::mutex> lock_cachedItems(mutex_cachedItems);
+	if(memoryBudget)
+		memoryBudget->residentBytes -= residentBytes;
+	memoryBudget = budget;
+	if(memoryBudget)
+		memoryBudget->residentBytes += residentBytes;
+}
+
 template<typename u,class T> u ResourceManager<u,T>::GetUidByName(const char *n) const
 {
 	std::lock_guard<std::mutex> lock_cachedItems(mutex_cachedItems);
@@ -213,46 +322,63 @@ template<typename u,class T> u ResourceManager<u,T>::GetUidByName(const char *n)
 	}
 	return 0;
 }
+
+template<typename u,class T> std::shared_lock<std::shared_mutex> ResourceManager<u,T>::LockShard(const Shard& shard) const
+{
+	std::shared_lock<std::shared_mutex> lock_shard(shard.mutex, std::try_to_lock);
+	if(!lock_shard.owns_lock())
+	{
+		auto start = std::chrono::steady_clock::now();
+		lock_shard.lock();
+		auto wait = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+		lookupWait_ns.fetch_add((uint64_t)wait.count(), std::memory_order_relaxed);
+	}
+	return lock_shard;
+}
+
 template<typename u,class T> std::shared_ptr<T> ResourceManager<u,T>::Get(u id)
 {
-	std::lock_guard<std::mutex> lock_cachedItems(mutex_cachedItems);
+	const Shard& shard = GetShard(id);
+	std::shared_lock<std::shared_mutex> lock_shard = LockShard(shard);
 
-	auto it=cachedItems.find(id);
-	if(it==cachedItems.end())
+	auto it = shard.items.find(id);
+	if(it == shard.items.end())
 		return nullptr;
 
-	ResourceData& data = it->second;
+	ResourceData& data = *it->second;
 
-	data.timeSinceLastUse_s = 0;
+	//Only the time is written here; Update moves recently used resources up the list.
+	data.lastUse_s.store(time_s.load(std::memory_order_relaxed), std::memory_order_relaxed);
 
 	return data.resource;
 }
 
 template<typename u,class T> std::shared_ptr<const T> ResourceManager<u,T>::Get(u id) const
 {
-	std::lock_guard<std::mutex> lock_cachedItems(mutex_cachedItems);
+	const Shard& shard = GetShard(id);
+	std::shared_lock<std::shared_mutex> lock_shard = LockShard(shard);
 
-	auto it = cachedItems.find(id);
-	if (it == cachedItems.end())
+	auto it = shard.items.find(id);
+	if(it == shard.items.end())
 		return nullptr;
 
-	const ResourceData& data = it->second;
+	const ResourceData& data = *it->second;
 
 	return data.resource;
 }
 
-template<typename u,class T> const std::vector<u>&  ResourceManager<u,T>::GetAllIDs() const
+template<typename u,class T> std::shared_ptr<const std::vector<u>> ResourceManager<u,T>::GetAllIDs() const
 {
-	if(cacheChecksum!=idListChecksum)
+	std::lock_guard<std::mutex> lock_cachedItems(mutex_cachedItems);
+	if(!resourceIDs)
 	{
-		resourceIDs.clear();
-		std::lock_guard<std::mutex> lock_cachedItems(mutex_cachedItems);
-
-		for(auto idDataPair : cachedItems)
+		auto ids = std::make_shared<std::vector<u>>();
+		ids->reserve(cachedItems.size());
+		for(const auto& idDataPair : cachedItems)
 		{
-			resourceIDs.push_back(idDataPair.first);
+			ids->push_back(idDataPair.first);
 		}
-		idListChecksum=cacheChecksum;
+		resourceIDs = ids;
 	}
 	return resourceIDs;
 }
@@ -260,13 +386,23 @@ template<typename u,class T> const std::vector<u>&  ResourceManager<u,T>::GetAll
 template<typename u,class T> void ResourceManager<u,T>::Clear()
 {
 	std::lock_guard<std::mutex> lock_cachedItems(mutex_cachedItems);
+	for(Shard& shard : shards)
+	{
+		std::unique_lock<std::shared_mutex> lock_shard(shard.mutex);
+		shard.items.clear();
+	}
 	for(auto &[id, data] : cachedItems)
 	{
 		FreeResource(*data.resource);
 	}
 
 	cachedItems.clear();
-	cacheChecksum++;
+	recentlyUsed.clear();
+	if(memoryBudget)
+		memoryBudget->residentBytes -= residentBytes;
+	residentBytes = 0;
+	count = 0;
+	resourceIDs.reset();
 }
 
 template<typename u,class T> void ResourceManager<u,T>::ClearAllButExcluded(std::vector<u>& excludeList)
@@ -299,40 +435,69 @@ template<typename u,class T> void ResourceManager<u,T>::ClearAllButExcluded(std:
 			it = RemoveResource(it);
 		}
 	}
-	cacheChecksum++;
 }
 
 template<typename u,class T>
 void ResourceManager<u,T>::Update(float deltaTimestamp_s)
 {
-	const bool sufficientMemory = false;//clientrender::MemoryUtil::Get()->isSufficientMemory(MIN_REQUIRED_MEMORY);
-
 	std::lock_guard<std::mutex> lock_cachedItems(mutex_cachedItems);
-	//We will be deleting any resources that have lived without being used for more than their allowed lifetime.
-	for(auto it = cachedItems.begin(); it != cachedItems.end();)
+	const float now_s = time_s + deltaTimestamp_s;
+	time_s = now_s;
+	//Check resources from the least recently used, until one is found that has been used recently enough to keep.
+	//Each is checked at most once per tick, as those that are kept move to the front.
+	for(size_t remaining = recentlyUsed.size(); remaining > 0; remaining--)
 	{
-		//Increment time spent unused, if the resource manager is the only object pointing to the resource.
-		if(it->second.resource.use_count() == 1)
+		mapIterator_t it = cachedItems.find(recentlyUsed.back());
+		ResourceData& data = it->second;
+		const float lastUse_s = data.lastUse_s.load(std::memory_order_relaxed);
+		const bool usedSinceListed = lastUse_s > data.listTime_s;
+		const bool expired = now_s - lastUse_s >= data.postUseLifetime_s * lifetimeFactor;
+		const bool overBudget = memoryBudget && memoryBudget->IsExceeded();
+		if(!expired && !overBudget)
 		{
-			it->second.timeSinceLastUse_s += deltaTimestamp_s;
-
-			//Delete the resource, if memory is low and it has been too long since the object was last used.
-			if(!sufficientMemory && it->second.timeSinceLastUse_s >= it->second.postUseLifetime_s * lifetimeFactor)
-			{
-				it = RemoveResource(it);
-			}
-			else
-			{
-				++it;
-			}
+			//Nothing further up the list was listed before this, so none of those have expired either.
+			if(!usedSinceListed)
+				break;
+			Relist(data);
+		}
+		//It may only just have been released, so give it its full lifetime from now, unless memory is short.
+		else if(data.wasInUse && !overBudget && data.resource.use_count() == 1)
+		{
+			Touch(data);
+			data.wasInUse = false;
 		}
+		//Prefer to free those that have not been used since they were listed.
+		else if(overBudget && !expired && usedSinceListed)
+		{
+			Relist(data);
+		}
+		else if(TryEvictResource(it))
+		{
+			evictionCount++;
+		}
+		//The resource manager isn't the only object pointing to the resource, so it is still in use.
 		else
 		{
-			++it;
+			Touch(data);
+			data.wasInUse = true;
 		}
 	}
 }
 
+template<typename u,class T>
+void ResourceManager<u,T>::Touch(ResourceData& data)
+{
+	Relist(data);
+	data.lastUse_s = data.listTime_s;
+}
+
+template<typename u,class T>
+void ResourceManager<u,T>::Relist(ResourceData& data)
+{
+	data.listTime_s = time_s;
+	recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, data.recency);
+}
+
 template<typename u,class T>
 void ResourceManager<u,T>::FreeResource(T & resource)
 {
@@ -344,8 +509,39 @@ void ResourceManager<u,T>::FreeResource(T & resource)
 
 template<typename u,class T>
 typename ResourceManager<u,T>::mapIterator_t ResourceManager<u,T>::RemoveResource(typename ResourceManager<u,T>::mapIterator_t it)
+{
+	{
+		Shard& shard = GetShard(it->first);
+		std::unique_lock<std::shared_mutex> lock_shard(shard.mutex);
+		shard.items.erase(it->first);
+	}
+	return EraseResource(it);
+}
+
+template<typename u,class T>
+bool ResourceManager<u,T>::TryEvictResource(typename ResourceManager<u,T>::mapIterator_t it)
+{
+	{
+		//With the shard locked, no Get can take a new reference to the resource while it is checked and removed.
+		Shard& shard = GetShard(it->first);
+		std::unique_lock<std::shared_mutex> lock_shard(shard.mutex);
+		if(it->second.resource.use_count() > 1)
+			return false;
+		shard.items.erase(it->first);
+	}
+	EraseResource(it);
+	return true;
+}
+
+template<typename u,class T>
+typename ResourceManager<u,T>::mapIterator_t ResourceManager<u,T>::EraseResource(typename ResourceManager<u,T>::mapIterator_t it)
 {
 	FreeResource(*it->second.resource);
-	cacheChecksum++;
+	recentlyUsed.erase(it->second.recency);
+	count--;
+	residentBytes -= it->second.size_bytes;
+	if(memoryBudget)
+		memoryBudget->residentBytes -= it->second.size_bytes;
+	resourceIDs.reset();
 	return cachedItems.erase(it);
 }
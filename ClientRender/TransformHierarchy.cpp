@@ -0,0 +1,174 @@
+// (C) Copyright 2018-2022 Simul Software Ltd
+
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+
+#include "Node.h"
+#include "TeleportCore/ThreadPool.h"
+
+using namespace clientrender;
+
+teleport::core::ThreadPool& TransformHierarchy::GetThreadPool()
+{
+	static teleport::core::ThreadPool pool;
+	return pool;
+}
+
+void TransformHierarchy::Rebuild(const std::vector<std::shared_ptr<Node>>& rootNodes)
+{
+	// Nodes that have been removed are released once the lock is, in case that frees them.
+	std::vector<std::shared_ptr<Node>> oldNodes;
+	std::lock_guard<std::mutex> lock(mutex);
+	if(!structureChanged)
+		return;
+	structureChanged = false;
+	build++;
+
+	// Keep any changes that have not been applied yet, under the nodes' new indices.
+	std::vector<Change> oldChanges;
+	oldChanges.swap(changes);
+	oldNodes.swap(nodes);
+	parentIndices.clear();
+	localPoses.clear();
+	globalPoses.clear();
+	std::vector<std::pair<uint32_t, uint32_t>> rootRanges;
+	for(const std::shared_ptr<Node>& root : rootNodes)
+	{
+		if(!root)
+			continue;
+		uint32_t begin = (uint32_t)nodes.size();
+		AddSubtree(root, -1, oldChanges);
+		if(nodes.size() > begin)
+			rootRanges.emplace_back(begin, (uint32_t)nodes.size());
+	}
+	globalChanged.assign(nodes.size(), 0);
+
+	// Group whole subtrees into ranges for the update threads, several per thread so that uneven subtrees balance out.
+	updateRanges.clear();
+	if(nodes.size() < minParallelNodes || rootRanges.size() < 2)
+	{
+		updateRanges.emplace_back(0, (uint32_t)nodes.size());
+		return;
+	}
+	size_t rangeSize = std::max(nodes.size() / ((GetThreadPool().getThreadCount() + 1) * 4), size_t(1));
+	for(const auto& r : rootRanges)
+	{
+		if(updateRanges.size() && updateRanges.back().second - updateRanges.back().first < rangeSize)
+			updateRanges.back().second = r.second;
+		else
+			updateRanges.push_back(r);
+	}
+}
+
+void TransformHierarchy::AddSubtree(const std::shared_ptr<Node>& root, int32_t parentIndex, const std::vector<Change>& oldChanges)
+{
+	std::vector<std::pair<std::shared_ptr<Node>, int32_t>> stack = {{root, parentIndex}};
+	while(stack.size())
+	{
+		std::shared_ptr<Node> node = std::move(stack.back().first);
+		int32_t nodeParentIndex = stack.back().second;
+		stack.pop_back();
+		// A node is only added once, even if the hierarchy we were sent has a cycle.
+		bool attached = node->transformHierarchy == this;
+		if(attached && node->transformHierarchyBuild == build)
+			continue;
+
+		Change change = node->isTransformDirty ? Change::LOCAL : Change::NONE;
+		if(!attached)
+		{
+			// Changes to a newly-added node were not recorded; if its global transform is clean, it was set directly.
+			if(change == Change::NONE)
+				change = Change::GLOBAL;
+		}
+		else if(node->transformHierarchyIndex < oldChanges.size() && oldChanges[node->transformHierarchyIndex] != Change::NONE)
+		{
+			change = oldChanges[node->transformHierarchyIndex];
+		}
+
+		uint32_t index = (uint32_t)nodes.size();
+		node->transformHierarchy = this;
+		node->transformHierarchyIndex = index;
+		node->transformHierarchyBuild = build;
+		nodes.push_back(node);
+		parentIndices.push_back(nodeParentIndex);
+		changes.push_back(change);
+		const Transform& local = node->localTransform;
+		localPoses.push_back({local.m_Translation, local.m_Rotation, local.m_Scale});
+		const Transform& global = node->globalTransform;
+		globalPoses.push_back({global.m_Translation, global.m_Rotation, global.m_Scale});
+
+		// Push in reverse, so that children are added in their original order.
+		const std::vector<std::weak_ptr<Node>>& children = node->children;
+		for(auto c = children.rbegin(); c != children.rend(); c++)
+		{
+			std::shared_ptr<Node> child = c->lock();
+			if(child)
+				stack.push_back({std::move(child), (int32_t)index});
+		}
+	}
+}
+
+void TransformHierarchy::Detach(Node* node)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if(!node || node->transformHierarchy != this)
+		return;
+	node->transformHierarchy = nullptr;
+	structureChanged = true;
+}
+
+void TransformHierarchy::UpdateTransforms()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if(updateRanges.size() < 2)
+	{
+		UpdateRange(0, (uint32_t)nodes.size());
+		return;
+	}
+	GetThreadPool().parallelFor(updateRanges.size(), [this](size_t i)
+	{
+		UpdateRange(updateRanges[i].first, updateRanges[i].second);
+	});
+}
+
+void TransformHierarchy::UpdateRange(uint32_t begin, uint32_t end)
+{
+	for(uint32_t i = begin; i < end; i++)
+	{
+		int32_t parentIndex = parentIndices[i];
+		bool parentChanged = parentIndex >= 0 && globalChanged[parentIndex];
+		Change change = changes[i];
+		changes[i] = Change::NONE;
+		if(change == Change::GLOBAL)
+		{
+			// The pose was stored when the change was recorded.
+			globalChanged[i] = 1;
+			continue;
+		}
+		if(change == Change::NONE && !parentChanged)
+		{
+			globalChanged[i] = 0;
+			continue;
+		}
+
+		// The same calculation as Transform::operator*, without constructing a Transform.
+		const Pose& local = localPoses[i];
+		Pose& global = globalPoses[i];
+		if(parentIndex < 0)
+		{
+			global = local;
+		}
+		else
+		{
+			const Pose& parent = globalPoses[parentIndex];
+			global.scale = avs::vec3(local.scale.x * parent.scale.x, local.scale.y * parent.scale.y, local.scale.z * parent.scale.z);
+			global.rotation = parent.rotation * local.rotation;
+			global.position = parent.position + parent.rotation.RotateVector(local.position * abs(parent.scale));
+		}
+		Node* node = nodes[i].get();
+		node->globalTransform.UpdateModelMatrix(global.position, global.rotation, global.scale);
+		node->isTransformDirty = false;
+		globalChanged[i] = 1;
+	}
+}
@@ -0,0 +1,118 @@
+// (C) Copyright 2018-2022 Simul Software Ltd
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "Transform.h"
+
+namespace teleport
+{
+	namespace core
+	{
+		class ThreadPool;
+	}
+}
+
+namespace clientrender
+{
+	class Node;
+
+	//! The transforms of a NodeManager's nodes, kept in flat arrays rather than followed through the nodes' child lists.
+	//! Nodes are stored depth-first, so every node comes after its parent and each root's subtree is one contiguous range.
+	//! Global transforms are then updated in a single forward pass, which only recalculates a node's global transform if it or
+	//! an ancestor has changed, and which is split across threads by subtree.
+	//! Local transforms are copied into the hierarchy's own arrays when they change, so that the pass reads them in order
+	//! rather than from each node; the nodes are only written, to store the global transforms that have been recalculated.
+	//! Changes can be recorded from any thread. The hierarchy holds its nodes until it is rebuilt, so a node that is
+	//! removed meanwhile is not freed while it is still in the arrays.
+	class TransformHierarchy
+	{
+	public:
+		enum class Change : uint8_t
+		{
+			NONE = 0,
+			LOCAL,	//The local transform changed, so recalculate the global transform from it.
+			GLOBAL	//The global transform was set directly, so keep it, but recalculate the descendants.
+		};
+
+		//! Record that the local transform of the node at this index has changed to this.
+		void SetLocalChanged(uint32_t index, const Transform& local)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(index < changes.size())
+			{
+				changes[index] = Change::LOCAL;
+				localPoses[index] = {local.m_Translation, local.m_Rotation, local.m_Scale};
+			}
+		}
+		//! Record that the global transform of the node at this index was set directly, to this.
+		void SetGlobalChanged(uint32_t index, const Transform& global)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(index < changes.size())
+			{
+				changes[index] = Change::GLOBAL;
+				globalPoses[index] = {global.m_Translation, global.m_Rotation, global.m_Scale};
+			}
+		}
+		//! Nodes have been added, removed or reparented, so the order must be rebuilt before the next update.
+		void SetStructureChanged()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			structureChanged = true;
+		}
+		bool IsStructureChanged() const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return structureChanged;
+		}
+		//! Rebuild the order from these root nodes, if the structure has changed.
+		void Rebuild(const std::vector<std::shared_ptr<Node>>& rootNodes);
+		//! Stop tracking the node, e.g. because it is being removed. Its transforms are then updated lazily, as before it was added.
+		void Detach(Node* node);
+		//! Recalculate the global transforms of changed nodes and their descendants. Rebuild() must be called first.
+		void UpdateTransforms();
+		//! All the tracked nodes, parents before children. Only valid until the next Rebuild(), on the thread that calls it.
+		const std::vector<std::shared_ptr<Node>>& GetNodes() const
+		{
+			return nodes;
+		}
+		//! The workers that node updates are spread over, shared by all node managers. It is only created once it is first needed.
+		static teleport::core::ThreadPool& GetThreadPool();
+		//! Whether the global transform of the node at this index changed in the last UpdateTransforms().
+		bool IsGlobalChanged(uint32_t index) const
+		{
+			return index < globalChanged.size() && globalChanged[index] != 0;
+		}
+
+	private:
+		struct Pose
+		{
+			avs::vec3 position;
+			quat rotation;
+			avs::vec3 scale;
+		};
+		// Subtrees of fewer nodes than this in total are not worth spreading across threads.
+		static constexpr size_t minParallelNodes = 2048;
+
+		std::vector<std::shared_ptr<Node>> nodes;
+		std::vector<int32_t> parentIndices;
+		// Guards changes, structureChanged and the poses, which are written from other threads, against the update and rebuild.
+		mutable std::mutex mutex;
+		std::vector<Change> changes;
+		std::vector<uint8_t> globalChanged;
+		std::vector<Pose> localPoses;
+		std::vector<Pose> globalPoses;
+		// Ranges [first,second) of whole root subtrees, each of which is updated by one thread.
+		std::vector<std::pair<uint32_t, uint32_t>> updateRanges;
+		bool structureChanged = true;
+		uint32_t build = 0;
+
+		void AddSubtree(const std::shared_ptr<Node>& node, int32_t parentIndex, const std::vector<Change>& oldChanges);
+		void UpdateRange(uint32_t begin, uint32_t end);
+	};
+}
@@ -41,17 +41,22 @@ LOCAL_SRC_FILES  := 	../Effect.cpp										\
 						../Light.cpp								\
 						../Material.cpp							\
 						../Mesh.cpp								\
+						../MovementInterpolator.cpp				\
 						../Node.cpp								\
 						../NodeComponents/AnimationComponent.cpp	\
 						../NodeComponents/AnimationState.cpp		\
 						../NodeComponents/VisibilityComponent.cpp	\
 						../NodeManager.cpp						\
+						../NodeBoundsTree.cpp						\
+						../DistanceSortedNodeList.cpp				\
 						../ResourceCreator.cpp					\
+						../ResourceDiskCache.cpp					\
 						../Renderer.cpp						\
 						../ShaderSystem.cpp						\
 						../ShaderResource.cpp						\
 						../Skin.cpp								\
 						../Transform.cpp							\
+						../TransformHierarchy.cpp					\
 						../MemoryUtil.cpp							\
 
 LOCAL_CFLAGS += -D__ANDROID__
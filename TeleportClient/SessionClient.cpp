@@ -11,6 +11,7 @@
 
 #include "TeleportClient/Log.h"
 #include "TeleportCore/ErrorHandling.h"
+#include "TeleportCore/ResourceInventory.h"
 #include "DiscoveryService.h"
 #include "Config.h"
 
@@ -277,6 +278,8 @@ void SessionClient::Frame(const avs::DisplayInfo &displayInfo
 					break;
 				case ENET_EVENT_TYPE_DISCONNECT:
 					mTimeSinceLastServerComm = 0;
+					if(event.data == static_cast<enet_uint32>(teleport::core::DisconnectReason::ProtocolVersionMismatch))
+						TELEPORT_CLIENT_WARN("The server rejected this client's protocol version, %u: the client and server must be updated to the same version.", teleport::core::protocolVersion);
 					Disconnect(0);
 					return;
 			}
@@ -360,6 +363,7 @@ void SessionClient::DispatchEvent(const ENetEvent& event)
 	switch(event.channelID)
 	{
 		case static_cast<enet_uint8>(teleport::core::RemotePlaySessionChannel::RPCH_Control) :
+		case static_cast<enet_uint8>(teleport::core::RemotePlaySessionChannel::RPCH_LatestState) :
 			ReceiveCommandPacket(event.packet);
 			break;
 		default:
@@ -423,6 +427,9 @@ void SessionClient::ReceiveCommandPacket(ENetPacket* packet)
 		case teleport::core::CommandPayloadType::AssignNodePosePath:
 			ReceiveAssignNodePosePathCommand(packet);
 			break;
+		case teleport::core::CommandPayloadType::ResourceContentHashes:
+			ReceiveResourceContentHashesCommand(packet);
+			break;
 		default:
 			break;
 	};
@@ -439,6 +446,9 @@ void SessionClient::SendNodePoses(const avs::Pose& headPose,const std::map<avs::
 	teleport::core::ControllerPosesMessage message;
 	message.headPose=headPose;
 	message.numPoses=(uint16_t)poses.size();
+	message.sequence=++poseSequence;
+	message.movementAcknowledged=movementDecoder.getSequences().getLatest();
+	message.movementAcknowledgedMask=movementDecoder.getSequences().getMask();
 	if(isnan(headPose.position.x))
 	{
 		TELEPORT_CLIENT_WARN("Trying to send NaN");
@@ -457,7 +467,7 @@ void SessionClient::SendNodePoses(const avs::Pose& headPose,const std::map<avs::
 		memcpy(target,&nodePose,sizeof(nodePose));
 		target+=sizeof(nodePose);
 	}
-	enet_peer_send(mServerPeer, static_cast<enet_uint8>(teleport::core::RemotePlaySessionChannel::RPCH_ClientMessage), packet);
+	enet_peer_send(mServerPeer, static_cast<enet_uint8>(teleport::core::RemotePlaySessionChannel::RPCH_LatestState), packet);
 }
 
 
@@ -690,13 +700,23 @@ void SessionClient::SendKeyframeRequest()
 void SessionClient::SendHandshake(const teleport::core::Handshake& handshake, const std::vector<avs::uid>& clientResourceIDs)
 {
 	size_t handshakeSize = sizeof(teleport::core::Handshake);
-	size_t resourceListSize = sizeof(avs::uid) * clientResourceIDs.size();
-
-	//Create handshake.
-	ENetPacket* packet = enet_packet_create(&handshake, handshakeSize, ENET_PACKET_FLAG_RELIABLE);
-	//Append list of resource IDs the client has.
-	enet_packet_resize(packet, handshakeSize + resourceListSize);
-	memcpy(packet->data + handshakeSize, clientResourceIDs.data(), resourceListSize);
+	// The server will start the movement stream again from scratch.
+	movementDecoder.reset();
+
+	//Encode the list of resource IDs the client has.
+	teleport::core::Handshake sentHandshake = handshake;
+	std::vector<uint8_t> inventory;
+	sentHandshake.resourceCount = teleport::core::EncodeResourceInventory(clientResourceIDs, inventory);
+	//And the content hashes of the resources in its disk cache, from this server or any other.
+	std::vector<uint64_t> cachedResourceHashes = mCommandInterface->GetCachedResourceHashes();
+	sentHandshake.cachedResourceCount = cachedResourceHashes.size();
+	size_t hashesSize = sizeof(uint64_t) * cachedResourceHashes.size();
+
+	//Create handshake, with the hashes and the list appended.
+	ENetPacket* packet = enet_packet_create(&sentHandshake, handshakeSize, ENET_PACKET_FLAG_RELIABLE);
+	enet_packet_resize(packet, handshakeSize + hashesSize + inventory.size());
+	memcpy(packet->data + handshakeSize, cachedResourceHashes.data(), hashesSize);
+	memcpy(packet->data + handshakeSize + hashesSize, inventory.data(), inventory.size());
 
 	enet_peer_send(mServerPeer, static_cast<enet_uint8>(teleport::core::RemotePlaySessionChannel::RPCH_Handshake), packet);
 }
@@ -735,7 +755,6 @@ void SessionClient::ReceiveSetupCommand(const ENetPacket* packet)
 	if(setupCommand.server_id == lastServerID)
 	{
 		resourceIDs = mCommandInterface->GetGeometryResources();
-		handshake.resourceCount = resourceIDs.size();
 	}
 	else
 	{
@@ -817,12 +836,20 @@ void SessionClient::ReceiveNodeMovementUpdate(const ENetPacket* packet)
 	//Extract command from packet.
 	teleport::core::UpdateNodeMovementCommand command;
 	size_t commandSize = command.getCommandSize();
+	if(packet->dataLength < commandSize)
+	{
+		TELEPORT_CERR << "Received malformed node movement update of length " << packet->dataLength << "!\n";
+		return;
+	}
 	memcpy(static_cast<void*>(&command), packet->data, commandSize);
 
-	std::vector<teleport::core::MovementUpdate> updateList(command.updatesCount);
-	memcpy(updateList.data(), packet->data + commandSize, sizeof(teleport::core::MovementUpdate) * command.updatesCount);
+	// If some of the updates could not be read, the packet is not acknowledged, and the server will send them again.
+	movementUpdates.clear();
+	if(!movementDecoder.decode(command, packet->data + commandSize, packet->dataLength - commandSize, movementUpdates))
+		TELEPORT_CLIENT_WARN("Could not read all of node movement update %u.", command.sequence);
 
-	mCommandInterface->UpdateNodeMovement(updateList);
+	if(movementUpdates.size())
+		mCommandInterface->UpdateNodeMovement(movementUpdates);
 }
 
 void SessionClient::ReceiveNodeEnabledStateUpdate(const ENetPacket* packet)
@@ -927,6 +954,27 @@ void SessionClient::ReceiveUpdateNodeStructureCommand(const ENetPacket* packet)
 	mCommandInterface->UpdateNodeStructure(updateNodeStructureCommand);
 }
 
+void SessionClient::ReceiveResourceContentHashesCommand(const ENetPacket* packet)
+{
+	size_t commandSize = sizeof(teleport::core::ResourceContentHashesCommand);
+	if(packet->dataLength<commandSize)
+	{
+		TELEPORT_CERR << "Bad packet." << std::endl;
+		return;
+	}
+	teleport::core::ResourceContentHashesCommand command;
+	memcpy(static_cast<void*>(&command), packet->data, commandSize);
+	size_t listSize = packet->dataLength - commandSize;
+	if(listSize % sizeof(teleport::core::ResourceContentHash) != 0 || listSize / sizeof(teleport::core::ResourceContentHash) != command.hashCount)
+	{
+		TELEPORT_CERR << "Bad packet." << std::endl;
+		return;
+	}
+	std::vector<teleport::core::ResourceContentHash> hashes(command.hashCount);
+	memcpy(hashes.data(), packet->data + commandSize, listSize);
+	mCommandInterface->OnResourceContentHashes(hashes);
+}
+
 void SessionClient::ReceiveAssignNodePosePathCommand(const ENetPacket* packet)
 {
 	size_t commandSize = sizeof(teleport::core::AssignNodePosePathCommand);
@@ -13,6 +13,7 @@
 #include <libavstream/libavstream.hpp>
 
 #include "TeleportCore/Input.h"
+#include "TeleportCore/MovementCodec.h"
 #include "TeleportClient/basic_linear_algebra.h"
 
 typedef unsigned int uint;
@@ -45,6 +46,9 @@ namespace teleport
 
 			virtual std::vector<avs::uid> GetGeometryResources() = 0;
 			virtual void ClearGeometryResources() = 0;
+			//! The content hashes of the resources in the disk cache, which are kept across sessions and servers.
+			virtual std::vector<uint64_t> GetCachedResourceHashes() = 0;
+			virtual void OnResourceContentHashes(const std::vector<teleport::core::ResourceContentHash>& hashes) = 0;
 
 			virtual void SetVisibleNodes(const std::vector<avs::uid>& visibleNodes) = 0;
 			virtual void UpdateNodeMovement(const std::vector<teleport::core::MovementUpdate>& updateList) = 0;
@@ -153,6 +157,7 @@ namespace teleport
 			void ReceiveSetupInputsCommand(const ENetPacket* packet);
 			void ReceiveUpdateNodeStructureCommand(const ENetPacket* packet);
 			void ReceiveAssignNodePosePathCommand(const ENetPacket* packet);
+			void ReceiveResourceContentHashesCommand(const ENetPacket* packet);
 			static constexpr double RESOURCE_REQUEST_RESEND_TIME = 10.0; //Seconds we wait before resending a resource request.
 
 			avs::uid lastServerID = 0; //UID of the server we last connected to.
@@ -180,6 +185,9 @@ namespace teleport
 			std::string remoteIP;
 			double mTimeSinceLastServerComm = 0;
 			std::vector<teleport::core::InputDefinition> inputDefinitions;
+			teleport::core::MovementDecoder movementDecoder;	//The last movements received for each node, that the next updates are deltas from.
+			std::vector<teleport::core::MovementUpdate> movementUpdates;
+			uint32_t poseSequence = 0;
 
 			ConnectionStatus connectionRequest = ConnectionStatus::UNCONNECTED;
 		};
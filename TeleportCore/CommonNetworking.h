@@ -14,6 +14,18 @@ namespace teleport
 	#ifdef _MSC_VER
 	#pragma pack(push, 1)
 	#endif
+		//! Sent in the handshake, so that a server can turn away a client whose messages it would misread.
+		//! Increase it whenever the layout or meaning of a message changes.
+		//! 2: the handshake's resource ids are sent as an inventory (see ResourceInventory.h), after the client's cached content hashes.
+		static constexpr uint32_t protocolVersion = 2;
+
+		//! Why a server disconnected a client: sent as the data of the ENet disconnect, which any version of the client can read.
+		enum class DisconnectReason : uint32_t
+		{
+			None,
+			ProtocolVersionMismatch
+		};
+
 		enum class BackgroundMode : uint8_t
 		{
 			NONE = 0, COLOUR, TEXTURE, VIDEO
@@ -28,6 +40,7 @@ namespace teleport
 			RPCH_KeyframeRequest = 5,
 			RPCH_ClientMessage = 6,
 			RPCH_Origin = 7,
+			RPCH_LatestState = 8,	//!< Unreliable: movement and poses, where only the newest packet matters.
 			RPCH_NumChannels
 		};
 
@@ -65,6 +78,7 @@ namespace teleport
 			UpdateNodeStructure,
 			AssignNodePosePath,
 			SetupInputs,
+			ResourceContentHashes,
 		};
 
 		//! The payload type, or how to interpret the client's message.
@@ -88,6 +102,7 @@ namespace teleport
 		//! Acknowledged by returning a avs::AcknowledgeHandshakeCommand to the client.
 		struct Handshake
 		{
+			uint32_t version = protocolVersion;	// Kept first, so that it can be read whatever the version.
 			avs::DisplayInfo startDisplayInfo = avs::DisplayInfo();
 			float MetresPerUnit = 1.0f;
 			float FOV = 90.0f;
@@ -97,7 +112,8 @@ namespace teleport
 			uint8_t framerate = 0;				// In hertz
 			bool usingHands = false; //Whether to send the hand nodes to the client.
 			bool isVR = true;
-			uint64_t resourceCount = 0;			//Count of resources the client has, and are appended to the handshake.
+			uint64_t resourceCount = 0;			//Count of resources the client has, whose ids are appended to the handshake as an inventory (see ResourceInventory.h).
+			uint64_t cachedResourceCount = 0;	//Count of content hashes of the resources in the client's disk cache, appended before the inventory.
 			uint32_t maxLightsSupported = 0;
 			uint32_t clientStreamingPort = 0;	// the local port on the client to receive the stream.
 			int32_t minimumPriority = 0;		// The lowest priority object this client will render, meshes with lower priority need not be sent.
@@ -170,6 +186,13 @@ namespace teleport
 			bool enabled = false;	//< Whether the node is enabled, and thus should be rendered.
 		} AVS_PACKED;
 
+		//! Identifies the content of a mesh or texture across sessions, where its uid only identifies it within one.
+		struct ResourceContentHash
+		{
+			avs::uid uid = 0;
+			uint64_t hash = 0;
+		} AVS_PACKED;
+
 		struct ApplyAnimation
 		{
 			int64_t timestamp = 0;	//< When the animation change was detected.
@@ -359,9 +382,13 @@ namespace teleport
 		} AVS_PACKED;
 
 		//! Instructs the client to modify the motion of the specified nodes.
+		//! The updates follow as records written by MovementEncoder, each holding the differences from the node's last movement.
 		struct UpdateNodeMovementCommand : public Command
 		{
-			size_t updatesCount;	//!< How many updates are included.
+			size_t updatesCount;		//!< How many updates are included.
+			uint32_t sequence = 0;		//!< Increases with each command, so the client can drop stale ones and acknowledge the rest.
+			int64_t timestamp = 0;		//!< The timestamp of the updates, unless a record gives its own.
+			avs::vec3 origin = {0, 0, 0};	//!< The point that positions are quantised relative to.
 
 			UpdateNodeMovementCommand()
 				:UpdateNodeMovementCommand(0)
@@ -458,6 +485,27 @@ namespace teleport
 				return sizeof(AssignNodePosePathCommand);
 			}
 		} AVS_PACKED;
+
+		//! Tells the client the content hashes of meshes and textures, so it can keep them in its disk cache for later sessions;
+		//! both those about to be streamed, and those it already holds in the cache, which will not be streamed.
+		//! Followed by hashCount ResourceContentHash structs.
+		struct ResourceContentHashesCommand : public Command
+		{
+			size_t hashCount;
+
+			ResourceContentHashesCommand()
+				:ResourceContentHashesCommand(0)
+			{}
+
+			ResourceContentHashesCommand(size_t hashCount)
+				:Command(CommandPayloadType::ResourceContentHashes), hashCount(hashCount)
+			{}
+
+			static size_t getCommandSize()
+			{
+				return sizeof(ResourceContentHashesCommand);
+			}
+		} AVS_PACKED;
 	
 		//! Update the animation state of the specified nodes.
 		struct UpdateNodeAnimationCommand : public Command
@@ -572,6 +620,11 @@ namespace teleport
 			avs::Pose headPose;
 		//! Poses of the  controllers.
 			uint16_t numPoses=0;
+		//! Increases with each message, so the server can drop stale ones.
+			uint32_t sequence=0;
+		//! The newest UpdateNodeMovementCommand received, and a mask of the ones up to it that were used.
+			uint32_t movementAcknowledged=0;
+			uint64_t movementAcknowledgedMask=0;
 
 			ControllerPosesMessage()
 				:ClientMessage(ClientMessagePayloadType::ControllerPoses)
@@ -0,0 +1,484 @@
+#include "MovementCodec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace teleport;
+using namespace core;
+
+namespace
+{
+	// Which values a record holds; the others are the same as in its baseline.
+	enum MovementField : uint8_t
+	{
+		FIELD_POSITION = 1 << 0,
+		FIELD_ROTATION = 1 << 1,
+		FIELD_SCALE = 1 << 2,
+		FIELD_VELOCITY = 1 << 3,
+		FIELD_ANGULAR_VELOCITY = 1 << 4,
+		FIELD_IS_GLOBAL = 1 << 5,	//The value of isGlobal, always present.
+		FIELD_TIMESTAMP = 1 << 6,	//The record's timestamp differs from the command's.
+		FIELD_BASELINE = 1 << 7		//The values are differences from an earlier movement, rather than from zero.
+	};
+
+	// The most a record can take: varints of up to 10 bytes for the id, timestamp and baseline, 5 for each of nine deltas,
+	// the flags, rotation and scale.
+	constexpr size_t maxRecordSize = 10 * 3 + 5 * 9 + 1 + 6 + 12;
+
+	constexpr uint32_t rotationComponentBits = 15;
+	constexpr uint32_t rotationComponentMax = (1 << rotationComponentBits) - 1;
+	constexpr size_t packedRotationSize = 6;
+	// The smallest three components of a unit quaternion lie within +-1/sqrt(2).
+	constexpr float rotationComponentRange = 0.70710678f;
+
+	int32_t Quantise(float value, float step)
+	{
+		float q = std::round(value / step);
+		q = std::max(q, (float)INT32_MIN);
+		q = std::min(q, (float)INT32_MAX);
+		return (int32_t)q;
+	}
+
+	uint64_t ZigZag(int64_t value)
+	{
+		return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+	}
+
+	int64_t UnZigZag(uint64_t value)
+	{
+		return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+	}
+
+	void WriteVarint(std::vector<uint8_t>& payload, uint64_t value)
+	{
+		while(value >= 0x80)
+		{
+			payload.push_back((uint8_t)(value | 0x80));
+			value >>= 7;
+		}
+		payload.push_back((uint8_t)value);
+	}
+
+	void WriteDelta(std::vector<uint8_t>& payload, const int32_t* value, const int32_t* previous)
+	{
+		for(int i = 0; i < 3; i++)
+			WriteVarint(payload, ZigZag((int64_t)value[i] - (int64_t)previous[i]));
+	}
+
+	// Reads from a payload, failing rather than reading past its end.
+	struct PayloadReader
+	{
+		const uint8_t* data;
+		size_t size;
+		size_t offset = 0;
+
+		bool ReadVarint(uint64_t& value)
+		{
+			value = 0;
+			for(uint32_t shift = 0; shift < 64; shift += 7)
+			{
+				if(offset >= size)
+					return false;
+				uint8_t byte = data[offset++];
+				value |= (uint64_t)(byte & 0x7F) << shift;
+				if(!(byte & 0x80))
+					return true;
+			}
+			return false;
+		}
+
+		bool ReadDelta(int32_t* value)
+		{
+			for(int i = 0; i < 3; i++)
+			{
+				uint64_t v;
+				if(!ReadVarint(v))
+					return false;
+				value[i] = (int32_t)((int64_t)value[i] + UnZigZag(v));
+			}
+			return true;
+		}
+
+		bool ReadBytes(void* dest, size_t count)
+		{
+			if(size - offset < count)
+				return false;
+			memcpy(dest, data + offset, count);
+			offset += count;
+			return true;
+		}
+	};
+
+	QuantisedMovement QuantiseMovement(const MovementUpdate& update, const avs::vec3& origin)
+	{
+		QuantisedMovement q;
+		avs::vec3 relativePosition = update.position - origin;
+		q.position[0] = Quantise(relativePosition.x, movementPositionStep);
+		q.position[1] = Quantise(relativePosition.y, movementPositionStep);
+		q.position[2] = Quantise(relativePosition.z, movementPositionStep);
+		q.rotation = PackRotation(update.rotation);
+		q.scale[0] = update.scale.x;
+		q.scale[1] = update.scale.y;
+		q.scale[2] = update.scale.z;
+		q.velocity[0] = Quantise(update.velocity.x, movementVelocityStep);
+		q.velocity[1] = Quantise(update.velocity.y, movementVelocityStep);
+		q.velocity[2] = Quantise(update.velocity.z, movementVelocityStep);
+		avs::vec3 angularVelocity = update.angularVelocityAxis * update.angularVelocityAngle;
+		q.angularVelocity[0] = Quantise(angularVelocity.x, movementAngularVelocityStep);
+		q.angularVelocity[1] = Quantise(angularVelocity.y, movementAngularVelocityStep);
+		q.angularVelocity[2] = Quantise(angularVelocity.z, movementAngularVelocityStep);
+		q.isGlobal = update.isGlobal;
+		return q;
+	}
+
+	MovementUpdate DequantiseMovement(const QuantisedMovement& q, const avs::vec3& origin)
+	{
+		MovementUpdate update;
+		update.isGlobal = q.isGlobal;
+		update.position = origin + avs::vec3((float)q.position[0], (float)q.position[1], (float)q.position[2]) * movementPositionStep;
+		update.rotation = UnpackRotation(q.rotation);
+		update.scale = {q.scale[0], q.scale[1], q.scale[2]};
+		update.velocity = avs::vec3((float)q.velocity[0], (float)q.velocity[1], (float)q.velocity[2]) * movementVelocityStep;
+		avs::vec3 angularVelocity = avs::vec3((float)q.angularVelocity[0], (float)q.angularVelocity[1], (float)q.angularVelocity[2]) * movementAngularVelocityStep;
+		float angle = std::sqrt(angularVelocity.x * angularVelocity.x + angularVelocity.y * angularVelocity.y + angularVelocity.z * angularVelocity.z);
+		if(angle > 0.0f)
+		{
+			update.angularVelocityAxis = angularVelocity / angle;
+			update.angularVelocityAngle = angle;
+		}
+		return update;
+	}
+}
+
+bool QuantisedMovement::operator==(const QuantisedMovement& other) const
+{
+	return memcmp(position, other.position, sizeof(position)) == 0
+		&& rotation == other.rotation
+		&& memcmp(scale, other.scale, sizeof(scale)) == 0
+		&& memcmp(velocity, other.velocity, sizeof(velocity)) == 0
+		&& memcmp(angularVelocity, other.angularVelocity, sizeof(angularVelocity)) == 0
+		&& isGlobal == other.isGlobal;
+}
+
+uint64_t teleport::core::PackRotation(const avs::vec4& rotation)
+{
+	float q[4] = {rotation.x, rotation.y, rotation.z, rotation.w};
+	float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+	if(!(length > 0.0f))
+	{
+		q[0] = q[1] = q[2] = 0.0f;
+		q[3] = length = 1.0f;
+	}
+	uint32_t largest = 0;
+	for(uint32_t i = 1; i < 4; i++)
+	{
+		if(std::abs(q[i]) > std::abs(q[largest]))
+			largest = i;
+	}
+	// q and -q are the same rotation, so flip the sign to make the largest component positive, and leave it out.
+	float scale = (q[largest] < 0.0f ? -1.0f : 1.0f) / length;
+	uint64_t packed = largest;
+	for(uint32_t i = 0; i < 4; i++)
+	{
+		if(i == largest)
+			continue;
+		float normalised = (q[i] * scale / rotationComponentRange + 1.0f) * 0.5f;
+		normalised = std::min(std::max(normalised, 0.0f), 1.0f);
+		packed = (packed << rotationComponentBits) | (uint64_t)std::lround(normalised * rotationComponentMax);
+	}
+	return packed;
+}
+
+avs::vec4 teleport::core::UnpackRotation(uint64_t packed)
+{
+	float q[4];
+	uint32_t largest = (uint32_t)(packed >> (3 * rotationComponentBits)) & 3;
+	float sumOfSquares = 0.0f;
+	uint32_t shift = 3 * rotationComponentBits;
+	for(uint32_t i = 0; i < 4; i++)
+	{
+		if(i == largest)
+			continue;
+		shift -= rotationComponentBits;
+		uint32_t value = (uint32_t)(packed >> shift) & rotationComponentMax;
+		q[i] = ((float)value / (float)rotationComponentMax * 2.0f - 1.0f) * rotationComponentRange;
+		sumOfSquares += q[i] * q[i];
+	}
+	q[largest] = std::sqrt(std::max(0.0f, 1.0f - sumOfSquares));
+	return {q[0], q[1], q[2], q[3]};
+}
+
+void MovementEncoder::reset()
+{
+	history.clear();
+	acknowledgements.reset();
+	originNodeID = 0;
+}
+
+void MovementEncoder::removeNode(avs::uid nodeID)
+{
+	history.erase(nodeID);
+}
+
+void MovementEncoder::acknowledge(uint32_t latest, uint64_t mask)
+{
+	acknowledgements.acknowledge(latest, mask);
+}
+
+size_t MovementEncoder::encode(const std::vector<MovementUpdate>& updates, avs::uid originNodeID, size_t maxPayloadSize, std::vector<MovementPacket>& packets)
+{
+	if(updates.empty())
+		return 0;
+
+	// Deltas can't be taken across a change of origin, so when it moves, everything is sent again in full.
+	if(originNodeID != this->originNodeID)
+	{
+		for(const MovementUpdate& update : updates)
+		{
+			if(update.nodeID == originNodeID && update.isGlobal)
+			{
+				origin = update.position;
+				this->originNodeID = originNodeID;
+				history.clear();
+				break;
+			}
+		}
+	}
+
+	// In order of id, so each id can be sent as a small difference from the one before.
+	sortedIndices.resize(updates.size());
+	for(uint32_t i = 0; i < (uint32_t)updates.size(); i++)
+		sortedIndices[i] = i;
+	std::stable_sort(sortedIndices.begin(), sortedIndices.end(), [&updates](uint32_t a, uint32_t b)
+	{
+		return updates[a].nodeID < updates[b].nodeID;
+	});
+
+	static const QuantisedMovement initialMovement;
+	size_t packetCount = 0;
+	MovementPacket* packet = nullptr;
+	avs::uid previousID = 0;
+	for(uint32_t index : sortedIndices)
+	{
+		const MovementUpdate& update = updates[index];
+		QuantisedMovement movement = QuantiseMovement(update, origin);
+		NodeHistory& nodeHistory = history[update.nodeID];
+
+		// Find the newest movement the client has acknowledged. Once seen, an acknowledgement is kept, as the window forgets it.
+		const SentMovement* baseline = nullptr;
+		bool unchanged = true;
+		for(uint32_t i = 1; i <= nodeHistory.count; i++)
+		{
+			SentMovement& sent = nodeHistory.sent[(nodeHistory.next + movementHistoryLength - i) % movementHistoryLength];
+			unchanged = unchanged && sent.movement == movement;
+			if(!sent.acknowledged)
+				sent.acknowledged = acknowledgements.isAcknowledged(sent.sequence);
+			if(sent.acknowledged)
+			{
+				baseline = &sent;
+				break;
+			}
+		}
+		// The client has this movement, and every one sent since was the same, so whichever of those it applied last, it is
+		// up to date. Acknowledgements take a round trip, so the newest sent is rarely acknowledged yet.
+		if(baseline && unchanged)
+			continue;
+		const QuantisedMovement& previous = baseline ? baseline->movement : initialMovement;
+
+		if(!packet || packet->payload.size() + maxRecordSize > maxPayloadSize)
+		{
+			if(packets.size() <= packetCount)
+				packets.resize(packetCount + 1);
+			packet = &packets[packetCount++];
+			packet->command = UpdateNodeMovementCommand(0);
+			packet->command.sequence = nextSequence++;
+			packet->command.timestamp = update.timestamp;
+			packet->command.origin = origin;
+			packet->payload.clear();
+			previousID = 0;
+		}
+		UpdateNodeMovementCommand& command = packet->command;
+		std::vector<uint8_t>& payload = packet->payload;
+
+		uint8_t fields = 0;
+		if(memcmp(movement.position, previous.position, sizeof(movement.position)) != 0)
+			fields |= FIELD_POSITION;
+		if(movement.rotation != previous.rotation)
+			fields |= FIELD_ROTATION;
+		if(memcmp(movement.scale, previous.scale, sizeof(movement.scale)) != 0)
+			fields |= FIELD_SCALE;
+		if(memcmp(movement.velocity, previous.velocity, sizeof(movement.velocity)) != 0)
+			fields |= FIELD_VELOCITY;
+		if(memcmp(movement.angularVelocity, previous.angularVelocity, sizeof(movement.angularVelocity)) != 0)
+			fields |= FIELD_ANGULAR_VELOCITY;
+		if(movement.isGlobal)
+			fields |= FIELD_IS_GLOBAL;
+		if(update.timestamp != command.timestamp)
+			fields |= FIELD_TIMESTAMP;
+		if(baseline)
+			fields |= FIELD_BASELINE;
+
+		WriteVarint(payload, update.nodeID - previousID);
+		payload.push_back(fields);
+		if(fields & FIELD_TIMESTAMP)
+			WriteVarint(payload, ZigZag(update.timestamp - command.timestamp));
+		if(fields & FIELD_BASELINE)
+			WriteVarint(payload, command.sequence - baseline->sequence);
+		if(fields & FIELD_POSITION)
+			WriteDelta(payload, movement.position, previous.position);
+		if(fields & FIELD_ROTATION)
+		{
+			for(size_t i = 0; i < packedRotationSize; i++)
+				payload.push_back((uint8_t)(movement.rotation >> (8 * i)));
+		}
+		if(fields & FIELD_SCALE)
+		{
+			size_t offset = payload.size();
+			payload.resize(offset + sizeof(movement.scale));
+			memcpy(payload.data() + offset, movement.scale, sizeof(movement.scale));
+		}
+		if(fields & FIELD_VELOCITY)
+			WriteDelta(payload, movement.velocity, previous.velocity);
+		if(fields & FIELD_ANGULAR_VELOCITY)
+			WriteDelta(payload, movement.angularVelocity, previous.angularVelocity);
+
+		// The baseline must stay in the client's history until this arrives. The client keeps the movements of the highest sequences
+		// it has received for the node, as many as this history holds, and every one of those was sent no earlier than the oldest here.
+		// So any movement it has dropped is older than every one the server still has, and can't be a baseline.
+		SentMovement& sent = nodeHistory.sent[nodeHistory.next];
+		sent.sequence = command.sequence;
+		sent.acknowledged = false;
+		sent.movement = movement;
+		nodeHistory.next = (nodeHistory.next + 1) % movementHistoryLength;
+		nodeHistory.count = std::min(nodeHistory.count + 1, movementHistoryLength);
+
+		previousID = update.nodeID;
+		command.updatesCount++;
+	}
+	return packetCount;
+}
+
+void MovementDecoder::reset()
+{
+	history.clear();
+	sequences.reset();
+}
+
+void MovementDecoder::keep(NodeHistory& nodeHistory, uint32_t sequence, const QuantisedMovement& movement)
+{
+	// Packets arrive out of order, so the history keeps the highest sequences rather than the latest arrivals:
+	// a late packet must not push out a newer movement the server may be using as a baseline.
+	uint32_t slot = nodeHistory.count;
+	for(uint32_t h = 0; h < nodeHistory.count; h++)
+	{
+		if(nodeHistory.received[h].sequence == sequence)
+			return;
+	}
+	if(nodeHistory.count == movementHistoryLength)
+	{
+		slot = 0;
+		for(uint32_t h = 1; h < movementHistoryLength; h++)
+		{
+			if(IsSequenceNewer(nodeHistory.received[slot].sequence, nodeHistory.received[h].sequence))
+				slot = h;
+		}
+		// Older than every movement held, so the server can no longer be using it.
+		if(!IsSequenceNewer(sequence, nodeHistory.received[slot].sequence))
+			return;
+	}
+	else
+	{
+		nodeHistory.count++;
+	}
+	nodeHistory.received[slot].sequence = sequence;
+	nodeHistory.received[slot].movement = movement;
+}
+
+bool MovementDecoder::decode(const UpdateNodeMovementCommand& command, const uint8_t* payload, size_t payloadSize, std::vector<MovementUpdate>& updates)
+{
+	bool complete = true;
+	PayloadReader reader{payload, payloadSize};
+	avs::uid nodeID = 0;
+	for(size_t i = 0; i < command.updatesCount; i++)
+	{
+		uint64_t idDelta;
+		uint8_t fields;
+		if(!reader.ReadVarint(idDelta) || !reader.ReadBytes(&fields, 1))
+			return false;
+		nodeID += idDelta;
+
+		int64_t timestamp = command.timestamp;
+		if(fields & FIELD_TIMESTAMP)
+		{
+			uint64_t timestampDelta;
+			if(!reader.ReadVarint(timestampDelta))
+				return false;
+			timestamp += UnZigZag(timestampDelta);
+		}
+
+		NodeHistory& nodeHistory = history[nodeID];
+		// Only the latest state matters, so a record that arrives after a newer one for the same node is not applied.
+		// It is still kept, as once this packet is acknowledged, the server may send deltas from it.
+		bool stale = nodeHistory.count > 0 && !IsSequenceNewer(command.sequence, nodeHistory.newest);
+		QuantisedMovement movement;
+		bool found = true;
+		if(fields & FIELD_BASELINE)
+		{
+			uint64_t age;
+			if(!reader.ReadVarint(age))
+				return false;
+			uint32_t baselineSequence = command.sequence - (uint32_t)age;
+			found = false;
+			for(uint32_t h = 0; h < nodeHistory.count; h++)
+			{
+				if(nodeHistory.received[h].sequence == baselineSequence)
+				{
+					movement = nodeHistory.received[h].movement;
+					found = true;
+					break;
+				}
+			}
+		}
+
+		// The values must be read even if the baseline is missing, to reach the next record.
+		if((fields & FIELD_POSITION) && !reader.ReadDelta(movement.position))
+			return false;
+		if(fields & FIELD_ROTATION)
+		{
+			uint8_t bytes[packedRotationSize];
+			if(!reader.ReadBytes(bytes, packedRotationSize))
+				return false;
+			movement.rotation = 0;
+			for(size_t b = 0; b < packedRotationSize; b++)
+				movement.rotation |= (uint64_t)bytes[b] << (8 * b);
+		}
+		if((fields & FIELD_SCALE) && !reader.ReadBytes(movement.scale, sizeof(movement.scale)))
+			return false;
+		if((fields & FIELD_VELOCITY) && !reader.ReadDelta(movement.velocity))
+			return false;
+		if((fields & FIELD_ANGULAR_VELOCITY) && !reader.ReadDelta(movement.angularVelocity))
+			return false;
+		movement.isGlobal = (fields & FIELD_IS_GLOBAL) != 0;
+		if(!found)
+		{
+			complete = false;
+			continue;
+		}
+
+		keep(nodeHistory, command.sequence, movement);
+		if(stale)
+			continue;
+		nodeHistory.newest = command.sequence;
+
+		MovementUpdate update = DequantiseMovement(movement, command.origin);
+		update.nodeID = nodeID;
+		update.timestamp = timestamp;
+		updates.push_back(update);
+	}
+	if(reader.offset != payloadSize)
+		return false;
+	if(complete)
+		sequences.acknowledge(command.sequence);
+	return complete;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "CommonNetworking.h"
+#include "SequenceNumber.h"
+
+namespace teleport
+{
+	namespace core
+	{
+		//! A node's movement as it is sent: positions and velocities in whole steps, the rotation as its smallest three components.
+		//! The server and client each keep copies of the last few sent for every node, and the next is sent as a difference from one.
+		struct QuantisedMovement
+		{
+			int32_t position[3] = {0, 0, 0};
+			uint64_t rotation = 0;
+			float scale[3] = {0, 0, 0};
+			int32_t velocity[3] = {0, 0, 0};
+			int32_t angularVelocity[3] = {0, 0, 0};	//The axis multiplied by the angle.
+			bool isGlobal = true;
+
+			bool operator==(const QuantisedMovement& other) const;
+			bool operator!=(const QuantisedMovement& other) const
+			{
+				return !(*this == other);
+			}
+		};
+
+		//! Sizes of a step of the quantised values.
+		static constexpr float movementPositionStep = 1.0f / 1024.0f;			//Metres.
+		static constexpr float movementVelocityStep = 1.0f / 256.0f;			//Metres per second.
+		static constexpr float movementAngularVelocityStep = 1.0f / 256.0f;	//Radians per second.
+
+		//! Pack a quaternion (x,y,z,w) into 48 bits: the index of its largest component, and the other three in 15 bits each.
+		uint64_t PackRotation(const avs::vec4& q);
+		avs::vec4 UnpackRotation(uint64_t packed);
+
+		//! How many of the last movements sent for each node are kept, to take deltas from.
+		static constexpr uint32_t movementHistoryLength = 8;
+
+		//! A packet's worth of encoded movement.
+		struct MovementPacket
+		{
+			UpdateNodeMovementCommand command;
+			std::vector<uint8_t> payload;
+		};
+
+		//! Writes lists of MovementUpdate as the payloads of UpdateNodeMovementCommands, for one client.
+		//! The commands are sent unreliably, so each node's values are sent as differences from the latest of its movements
+		//! that the client has acknowledged, or in full if there is none. A node is left out once the client has acknowledged its
+		//! current state. Each record can be read on its own, so a lost packet only delays the nodes in it until they are resent.
+		class MovementEncoder
+		{
+		public:
+			//! Forget what has been sent, e.g. for a new connection.
+			void reset();
+			//! Forget what has been sent for one node, e.g. when it leaves the client's bounds.
+			void removeNode(avs::uid nodeID);
+			//! Merge in the acknowledgements reported by the client.
+			void acknowledge(uint32_t latest, uint64_t mask);
+			//! Fill in packets for these updates, each with a payload of at most about maxPayloadSize bytes.
+			//! Positions are measured from the origin node, if it is in the list, so nearby positions need few bits.
+			//! Returns the number of packets filled, which is zero if there is nothing to send.
+			size_t encode(const std::vector<MovementUpdate>& updates, avs::uid originNodeID, size_t maxPayloadSize, std::vector<MovementPacket>& packets);
+
+		private:
+			struct SentMovement
+			{
+				uint32_t sequence = 0;
+				bool acknowledged = false;
+				QuantisedMovement movement;
+			};
+			struct NodeHistory
+			{
+				SentMovement sent[movementHistoryLength];
+				uint32_t count = 0;
+				uint32_t next = 0;
+			};
+			std::unordered_map<avs::uid, NodeHistory> history;
+			SequenceWindow acknowledgements;
+			uint32_t nextSequence = 1;
+			avs::uid originNodeID = 0;
+			avs::vec3 origin = {0, 0, 0};
+			std::vector<uint32_t> sortedIndices;
+		};
+
+		//! Reads the payloads written by MovementEncoder, keeping the last few movements received for each node,
+		//! and the sequence numbers to acknowledge. A node's record is dropped if a newer one for it has already arrived.
+		class MovementDecoder
+		{
+		public:
+			void reset();
+			//! Append the full movement of every node in the payload to the updates, except those that are stale.
+			//! Returns false if the payload is malformed, or refers to movements that were not received, in which case the updates
+			//! that could be read are still appended, but the packet is not acknowledged, so the server will send them again.
+			bool decode(const UpdateNodeMovementCommand& command, const uint8_t* payload, size_t payloadSize, std::vector<MovementUpdate>& updates);
+			//! The packets to acknowledge to the server.
+			const SequenceWindow& getSequences() const
+			{
+				return sequences;
+			}
+
+		private:
+			struct ReceivedMovement
+			{
+				uint32_t sequence = 0;
+				QuantisedMovement movement;
+			};
+			struct NodeHistory
+			{
+				ReceivedMovement received[movementHistoryLength];	//The highest sequences received, in no order.
+				uint32_t count = 0;
+				uint32_t newest = 0;	//The sequence number of the movement last applied.
+			};
+			std::unordered_map<avs::uid, NodeHistory> history;
+			SequenceWindow sequences;
+			static void keep(NodeHistory& nodeHistory, uint32_t sequence, const QuantisedMovement& movement);
+		};
+	}
+}
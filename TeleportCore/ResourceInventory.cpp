@@ -0,0 +1,62 @@
+#include "ResourceInventory.h"
+
+#include <algorithm>
+
+using namespace teleport;
+using namespace core;
+
+size_t teleport::core::EncodeResourceInventory(std::vector<avs::uid> resourceIDs, std::vector<uint8_t>& inventory)
+{
+	std::sort(resourceIDs.begin(), resourceIDs.end());
+	resourceIDs.erase(std::unique(resourceIDs.begin(), resourceIDs.end()), resourceIDs.end());
+
+	inventory.clear();
+	inventory.reserve(resourceIDs.size() * 2);
+	avs::uid previousID = 0;
+	for(avs::uid id : resourceIDs)
+	{
+		uint64_t delta = id - previousID;
+		while(delta >= 0x80)
+		{
+			inventory.push_back((uint8_t)(delta | 0x80));
+			delta >>= 7;
+		}
+		inventory.push_back((uint8_t)delta);
+		previousID = id;
+	}
+	return resourceIDs.size();
+}
+
+bool teleport::core::DecodeResourceInventory(const uint8_t* inventory, size_t inventorySize, uint64_t resourceCount, std::vector<avs::uid>& resourceIDs)
+{
+	// Every id takes at least one byte, so a count larger than the inventory can't be right.
+	if(resourceCount > inventorySize)
+		return false;
+	resourceIDs.reserve(resourceIDs.size() + resourceCount);
+	avs::uid id = 0;
+	size_t offset = 0;
+	for(uint64_t i = 0; i < resourceCount; i++)
+	{
+		uint64_t delta = 0;
+		uint32_t shift = 0;
+		for(;;)
+		{
+			if(offset >= inventorySize || shift >= 64)
+				return false;
+			uint8_t byte = inventory[offset++];
+			// The tenth byte holds only the top bit of 64, and ends the varint.
+			if(shift == 63 && byte > 1)
+				return false;
+			delta |= (uint64_t)(byte & 0x7F) << shift;
+			shift += 7;
+			if(!(byte & 0x80))
+				break;
+		}
+		// Ids ascend, so a delta that wraps past the largest id is malformed.
+		if(delta > UINT64_MAX - id)
+			return false;
+		id += delta;
+		resourceIDs.push_back(id);
+	}
+	return offset == inventorySize;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "libavstream/common.hpp"
+
+namespace teleport
+{
+	namespace core
+	{
+		//! Write the ids of the resources a client holds, as sent in its handshake: the ids are sorted, duplicates removed,
+		//! and each written as a varint of its difference from the one before. Ids given out in sequence take a byte or two each,
+		//! rather than eight.
+		//! Returns the number of distinct ids written.
+		size_t EncodeResourceInventory(std::vector<avs::uid> resourceIDs, std::vector<uint8_t>& inventory);
+		//! Read the ids written by EncodeResourceInventory, appending them to resourceIDs in ascending order.
+		//! Returns false if the inventory is malformed or does not hold the expected number of ids.
+		bool DecodeResourceInventory(const uint8_t* inventory, size_t inventorySize, uint64_t resourceCount, std::vector<avs::uid>& resourceIDs);
+	}
+}
@@ -0,0 +1,52 @@
+#include "SequenceNumber.h"
+
+using namespace teleport;
+using namespace core;
+
+void SequenceWindow::reset()
+{
+	any = false;
+	latest = 0;
+	mask = 0;
+}
+
+bool SequenceWindow::receive(uint32_t sequence)
+{
+	if(any && !IsSequenceNewer(sequence, latest))
+		return false;
+	uint32_t shift = sequence - latest;
+	mask = (!any || shift >= windowSize) ? 0 : mask << shift;
+	latest = sequence;
+	any = true;
+	return true;
+}
+
+void SequenceWindow::acknowledge(uint32_t sequence)
+{
+	if(!any || IsSequenceNewer(sequence, latest))
+		receive(sequence);
+	uint32_t age = latest - sequence;
+	if(age < windowSize)
+		mask |= (uint64_t)1 << age;
+}
+
+void SequenceWindow::acknowledge(uint32_t otherLatest, uint64_t otherMask)
+{
+	if(!any || IsSequenceNewer(otherLatest, latest))
+	{
+		receive(otherLatest);
+		mask |= otherMask;
+		return;
+	}
+	uint32_t shift = latest - otherLatest;
+	if(shift < windowSize)
+		mask |= otherMask << shift;
+}
+
+bool SequenceWindow::isAcknowledged(uint32_t sequence) const
+{
+	if(!any || IsSequenceNewer(sequence, latest))
+		return false;
+	uint32_t age = latest - sequence;
+	return age < windowSize && (mask & ((uint64_t)1 << age)) != 0;
+}
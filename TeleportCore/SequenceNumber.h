@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+namespace teleport
+{
+	namespace core
+	{
+		//! Whether sequence number a was issued after b, allowing for the counter wrapping around.
+		inline bool IsSequenceNewer(uint32_t a, uint32_t b)
+		{
+			return (int32_t)(a - b) > 0;
+		}
+
+		//! The recent sequence numbers of packets on an unreliable channel, where only the latest state matters.
+		//! The receiver drops any packet that is not newer than the newest it has seen, and records the ones it used,
+		//! which it acknowledges as the newest number and a mask of the 64 numbers up to it.
+		//! The sender merges those acknowledgements to find out which of its packets arrived.
+		class SequenceWindow
+		{
+		public:
+			static constexpr uint32_t windowSize = 64;
+
+			void reset();
+			//! Whether a packet with this number is newer than any seen so far. If so, it becomes the newest, otherwise it is stale.
+			bool receive(uint32_t sequence);
+			//! Record that the packet with this number was used.
+			void acknowledge(uint32_t sequence);
+			//! Merge in the acknowledgements reported by the receiver.
+			void acknowledge(uint32_t latest, uint64_t mask);
+			//! Whether this packet is known to have been used. Only the last windowSize numbers are remembered.
+			bool isAcknowledged(uint32_t sequence) const;
+
+			uint32_t getLatest() const
+			{
+				return latest;
+			}
+			//! Bit i is set if packet (latest-i) was used.
+			uint64_t getMask() const
+			{
+				return mask;
+			}
+
+		private:
+			bool any = false;
+			uint32_t latest = 0;
+			uint64_t mask = 0;
+		};
+	}
+}
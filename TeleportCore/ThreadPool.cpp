@@ -0,0 +1,130 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <memory>
+
+using namespace teleport;
+using namespace core;
+
+size_t ThreadPool::GetDefaultThreadCount()
+{
+	size_t n = (size_t)std::thread::hardware_concurrency();
+	return n > 1 ? n - 1 : 1;
+}
+
+ThreadPool::ThreadPool(size_t numThreads)
+{
+	if (!numThreads)
+		numThreads = GetDefaultThreadCount();
+	threads.reserve(numThreads);
+	for (size_t i = 0; i < numThreads; i++)
+	{
+		threads.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(tasksMutex);
+		stopping = true;
+	}
+	tasksCondition.notify_all();
+	for (auto& t : threads)
+	{
+		if (t.joinable())
+			t.join();
+	}
+}
+
+void ThreadPool::push(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(tasksMutex);
+		tasks.push(std::move(task));
+	}
+	tasksCondition.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(tasksMutex);
+			tasksCondition.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty())
+				return;
+			task = std::move(tasks.front());
+			tasks.pop();
+		}
+		task();
+	}
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& fn)
+{
+	if (!count)
+		return;
+	// With one item, or no workers, there is nothing to be gained from handing off.
+	if (count == 1 || threads.empty())
+	{
+		for (size_t i = 0; i < count; i++)
+			fn(i);
+		return;
+	}
+	struct Shared
+	{
+		std::atomic<size_t> next = 0;
+		size_t remainingHelpers = 0;
+		std::mutex doneMutex;
+		std::condition_variable doneCondition;
+	};
+	auto shared = std::make_shared<Shared>();
+	auto drain = [shared, count, &fn]()
+	{
+		size_t i;
+		while ((i = shared->next.fetch_add(1)) < count)
+			fn(i);
+	};
+	size_t numHelpers = std::min(threads.size(), count - 1);
+	shared->remainingHelpers = numHelpers;
+	for (size_t h = 0; h < numHelpers; h++)
+	{
+		push([shared, drain]()
+		{
+			drain();
+			std::lock_guard<std::mutex> lock(shared->doneMutex);
+			if (--shared->remainingHelpers == 0)
+				shared->doneCondition.notify_all();
+		});
+	}
+	// The calling thread works too, rather than sitting idle.
+	drain();
+	// While helpers are still queued, run queued tasks here instead of blocking: the caller may itself be a worker,
+	// and if every worker blocked on tasks that are still in the queue, none would be left to run them.
+	// Once the queue is empty, every remaining helper is running on some thread, so it is safe to wait.
+	while (runQueuedTask())
+	{
+		std::lock_guard<std::mutex> lock(shared->doneMutex);
+		if (shared->remainingHelpers == 0)
+			return;
+	}
+	std::unique_lock<std::mutex> lock(shared->doneMutex);
+	shared->doneCondition.wait(lock, [&shared] { return shared->remainingHelpers == 0; });
+}
+
+bool ThreadPool::runQueuedTask()
+{
+	std::function<void()> task;
+	{
+		std::lock_guard<std::mutex> lock(tasksMutex);
+		if (tasks.empty())
+			return false;
+		task = std::move(tasks.front());
+		tasks.pop();
+	}
+	task();
+	return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace teleport
+{
+	namespace core
+	{
+		//! A fixed-size pool of worker threads, shared by systems that want to spread independent jobs across cores.
+		class ThreadPool
+		{
+		public:
+			//! Create a pool with the given number of workers. Zero means one less than the number of hardware threads.
+			ThreadPool(size_t numThreads = 0);
+			~ThreadPool();
+
+			//! The number of worker threads, not counting any thread that calls parallelFor.
+			size_t getThreadCount() const
+			{
+				return threads.size();
+			}
+			//! Queue a task to run on any worker.
+			void push(std::function<void()> task);
+			//! Call fn(i) for every i in [0,count). Indices are taken dynamically from a shared counter by the workers
+			//! and by the calling thread, so an expensive item does not hold up the rest. Returns when all calls are complete.
+			//! It may be called from within a task on this pool, including from fn: while it waits, the caller runs queued tasks.
+			void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+			//! The default number of workers for this machine.
+			static size_t GetDefaultThreadCount();
+		private:
+			void workerLoop();
+			//! Take one task from the queue and run it on this thread. Returns false if the queue was empty.
+			bool runQueuedTask();
+			std::vector<std::thread> threads;
+			std::queue<std::function<void()>> tasks;
+			std::mutex tasksMutex;
+			std::condition_variable tasksCondition;
+			bool stopping = false;
+		};
+	}
+}
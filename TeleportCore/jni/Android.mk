@@ -24,7 +24,7 @@ LOCAL_C_INCLUDES += $(LOCAL_PATH)/../../client/LibOVRKernel/Src
 LOCAL_C_INCLUDES += $(LOCAL_PATH)/../../firstparty
 LOCAL_EXPORT_C_INCLUDES := $(LOCAL_C_INCLUDES)
 
-LOCAL_SRC_FILES :=	../TeleportCore.cpp	../ErrorHandling.cpp ../Input.cpp			\
+LOCAL_SRC_FILES :=	../TeleportCore.cpp	../ErrorHandling.cpp ../Input.cpp ../MovementCodec.cpp ../ResourceInventory.cpp ../SequenceNumber.cpp ../ThreadPool.cpp		\
 
 LOCAL_CFLAGS += -D__ANDROID__
 LOCAL_CPPFLAGS += -Wc++17-extensions -Wunused-variable
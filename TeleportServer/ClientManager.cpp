@@ -3,6 +3,7 @@
 #include "ClientMessaging.h"
 
 #include <algorithm>
+#include <chrono>
 #include <iostream>
 
 #include "enet/enet.h"
@@ -118,25 +119,41 @@ using namespace server;
 			}
 		}
 		mClients.push_back(client);
+		if (mAsyncNetworkDataProcessingActive)
+		{
+			startStreamingWorker(client);
+		}
 	}
 
 	void ClientManager::removeClient(ClientMessaging* client)
 	{
-		std::lock_guard<std::mutex> lock(mNetworkMutex);
-		for (int i = 0; i < mClients.size(); ++i)
+		std::unique_ptr<StreamingWorker> worker;
 		{
-			if (mClients[i]->clientID == client->clientID)
+			std::lock_guard<std::mutex> lock(mNetworkMutex);
+			for (int i = 0; i < mClients.size(); ++i)
 			{
-				mClients.erase(mClients.begin() + i);
-				int index = client->streamingPort - (mHost->address.port + 2);
-				if (index >= 0)
+				if (mClients[i]->clientID == client->clientID)
 				{
-					mPorts[index] = false;
-					client->streamingPort = 0;
+					mClients.erase(mClients.begin() + i);
+					int index = client->streamingPort - (mHost->address.port + 2);
+					if (index >= 0)
+					{
+						mPorts[index] = false;
+						client->streamingPort = 0;
+					}
+					break;
 				}
-				break;
+			}
+			auto w = mStreamingWorkers.find(client->clientID);
+			if (w != mStreamingWorkers.end())
+			{
+				worker = std::move(w->second);
+				mStreamingWorkers.erase(w);
 			}
 		}
+		// Wait for the worker outside the lock, so that other clients carry on meanwhile.
+		// The caller then tears down the client's session, which the worker must no longer be using.
+		StopStreamingWorker(worker);
 	}
 
 	bool ClientManager::hasClient(avs::uid clientID)
@@ -179,11 +196,25 @@ using namespace server;
 				mLastTickTimestamp = avs::PlatformWindows::getTimestamp();
 				mNetworkThread = std::thread(&ClientManager::processNetworkDataAsync, this);
 			}
+			std::lock_guard<std::mutex> lock(mNetworkMutex);
+			for (auto client : mClients)
+			{
+				startStreamingWorker(client);
+			}
 		}
 	}
 
 	void ClientManager::stopAsyncNetworkDataProcessing(bool killThread)
 	{
+		std::map<avs::uid, std::unique_ptr<StreamingWorker>> workers;
+		{
+			std::lock_guard<std::mutex> lock(mNetworkMutex);
+			workers.swap(mStreamingWorkers);
+		}
+		for (auto& w : workers)
+		{
+			StopStreamingWorker(w.second);
+		}
 		if (mAsyncNetworkDataProcessingActive)
 		{
 			mAsyncNetworkDataProcessingActive = false;
@@ -198,39 +229,103 @@ using namespace server;
 		}
 	}
 
+	bool ClientManager::isMainThreadResponsive() const
+	{
+		avs::Timestamp timestamp = avs::PlatformWindows::getTimestamp();
+		std::lock_guard<std::mutex> lock(mDataMutex);
+		return avs::PlatformWindows::getTimeElapsedInSeconds(mLastTickTimestamp, timestamp) < 1.0;
+	}
+
+	void ClientManager::startStreamingWorker(ClientMessaging* client)
+	{
+		auto& worker = mStreamingWorkers[client->clientID];
+		if (worker)
+		{
+			return;
+		}
+		worker.reset(new StreamingWorker);
+		worker->client = client;
+		worker->active = true;
+		worker->thread = std::thread(&ClientManager::processClientStreaming, this, worker.get());
+	}
+
+	void ClientManager::StopStreamingWorker(std::unique_ptr<StreamingWorker>& worker)
+	{
+		if (!worker)
+		{
+			return;
+		}
+		worker->active = false;
+		if (worker->client->clientNetworkContext)
+		{
+			worker->client->clientNetworkContext->streamingSignal->notify();
+		}
+		if (worker->thread.joinable())
+		{
+			worker->thread.join();
+		}
+		worker.reset();
+	}
+
 	void ClientManager::processNetworkDataAsync()
 	{
 		mAsyncNetworkDataProcessingFailed = false;
-		// Elapsed time since the main thread last ticked (seconds).
-		avs::Timestamp timestamp;
-		double elapsedTime;
 		while (mAsyncNetworkDataProcessingActive)
 		{
-			// Only continue processing if the main thread hasn't hung.
-			timestamp = avs::PlatformWindows::getTimestamp();
+			// Proceed only if the main thread hasn't hung.
+			if (isMainThreadResponsive())
 			{
-				std::lock_guard<std::mutex> lock(mDataMutex);
-				elapsedTime = avs::PlatformWindows::getTimeElapsedInSeconds(mLastTickTimestamp, timestamp);
+				// Waiting in the ENet host, rather than sleeping between polls, wakes as soon as a packet arrives,
+				// and isn't rounded up to the system timer's resolution.
+				std::lock_guard<std::mutex> lock(mNetworkMutex);
+				handleMessages(mServiceTimeoutMs);
 			}
+			else
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(mUnresponsiveWaitMs));
+			}
+		}
+	}
 
-			// Proceed only if the main thread hasn't hung.
-			if (elapsedTime < 1.0)
+	void ClientManager::processClientStreaming(StreamingWorker* worker)
+	{
+		ClientMessaging* client = worker->client;
+		StreamingSignal& signal = *client->clientNetworkContext->streamingSignal;
+		while (worker->active)
+		{
+			// The pipeline is created when the handshake arrives, and the worker is stopped before the session is torn down.
+			if (!client->receivedHandshake.load(std::memory_order_acquire) || !isMainThreadResponsive())
 			{
-				std::lock_guard<std::mutex> lock(mNetworkMutex);
-				handleMessages();
-				handleStreaming();
+				signal.waitFor(std::chrono::milliseconds(mUnresponsiveWaitMs));
+				continue;
 			}
+			NetworkPipeline* pipeline = client->clientNetworkContext->NetworkPipeline.get();
+			if (!pipeline->process())
+			{
+				mAsyncNetworkDataProcessingFailed = true;
+				signal.waitFor(std::chrono::milliseconds(mUnresponsiveWaitMs));
+				continue;
+			}
+			// The sink sends at most one buffer from each queue per call, so carry on while any is left.
+			if (pipeline->hasQueuedData())
+			{
+				continue;
+			}
+			// Packets held back by throttling are released as time passes; otherwise sleep until a queue is written to.
+			signal.waitFor(std::chrono::milliseconds(pipeline->hasThrottledData() ? mThrottledWaitMs : mIdleWaitMs));
 		}
 	}
 
-	void ClientManager::handleMessages()
+	void ClientManager::handleMessages(uint32_t timeoutMs)
 	{
 		ENetEvent event;
 		try
 		{
 		// TODO: Can hang in enet_host_service. Why?
-			while (enet_host_service(mHost, &event, 0) > 0)
+			// Wait for the first event only: once one has arrived, take any others that are already waiting.
+			while (enet_host_service(mHost, &event, timeoutMs) > 0)
 			{
+				timeoutMs = 0;
 				if (event.type != ENET_EVENT_TYPE_NONE)
 				{
 					for (auto client : mClients)
@@ -254,17 +349,3 @@ using namespace server;
 		{
 		}
 	}
-
-	void ClientManager::handleStreaming()
-	{
-		for (auto client : mClients)
-		{
-			if (client->receivedHandshake)
-			{
-				if (!client->clientNetworkContext->NetworkPipeline->process())
-				{
-					mAsyncNetworkDataProcessingFailed = true;
-				}
-			}
-		}
-	}
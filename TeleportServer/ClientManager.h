@@ -2,6 +2,8 @@
 
 #include <atomic>
 #include <functional>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <vector>
@@ -17,6 +19,8 @@ namespace teleport
 	{
 		class ClientMessaging;
 		//! Container for the client-specific data objects.
+		//! One thread services the shared ENet host, handing each event to its client's event queue.
+		//! Each client streams from its own worker thread, so a slow client doesn't hold up the others.
 		class ClientManager
 		{
 		public:
@@ -46,9 +50,18 @@ namespace teleport
 			}
 
 		private:
-			void handleMessages();
-			void handleStreaming();
+			struct StreamingWorker
+			{
+				ClientMessaging* client = nullptr;
+				std::atomic_bool active = false;
+				std::thread thread;
+			};
+			void handleMessages(uint32_t timeoutMs);
 			void processNetworkDataAsync();
+			void processClientStreaming(StreamingWorker* worker);
+			bool isMainThreadResponsive() const;
+			void startStreamingWorker(ClientMessaging* client);
+			static void StopStreamingWorker(std::unique_ptr<StreamingWorker>& worker);
 
 			std::atomic_bool mAsyncNetworkDataProcessingFailed = false;
 			bool mInitialized = false;
@@ -59,6 +72,8 @@ namespace teleport
 			std::atomic_bool mAsyncNetworkDataProcessingActive = false;
 
 			std::vector<ClientMessaging*> mClients;
+			//! Streaming workers by client uid; guarded by mNetworkMutex.
+			std::map<avs::uid, std::unique_ptr<StreamingWorker>> mStreamingWorkers;
 			std::thread mNetworkThread;
 			std::mutex mNetworkMutex;
 			mutable std::mutex mDataMutex;
@@ -68,6 +83,14 @@ namespace teleport
 
 			// Seconds
 			static constexpr float mStartSessionTimeout = 3;
+			// Milliseconds the network thread waits in the ENet host for a packet.
+			static constexpr uint32_t mServiceTimeoutMs = 1;
+			// Milliseconds threads wait while the main thread is unresponsive, or a client's session hasn't started.
+			static constexpr uint32_t mUnresponsiveWaitMs = 10;
+			// Milliseconds a streaming worker waits for throttled packets to be allowed out.
+			static constexpr uint32_t mThrottledWaitMs = 1;
+			// Milliseconds a streaming worker with nothing to send waits before checking its connection again.
+			static constexpr uint32_t mIdleWaitMs = 100;
 		};
 	}
 }
\ No newline at end of file
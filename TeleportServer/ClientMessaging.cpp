@@ -5,6 +5,7 @@
 
 #include "libavstream/common_input.h"
 #include "TeleportCore/CommonNetworking.h"
+#include "TeleportCore/ResourceInventory.h"
 
 #include "DiscoveryService.h"
 #include "TeleportCore/ErrorHandling.h"
@@ -113,7 +114,7 @@ void ClientMessaging::stopSession()
 		peer = nullptr;
 	}
 
-	receivedHandshake = false;
+	receivedHandshake.store(false, std::memory_order_release);
 	geometryStreamingService.reset();
 
 	eventQueue.clear();
@@ -122,7 +123,7 @@ void ClientMessaging::stopSession()
 void ClientMessaging::tick(float deltaTime)
 {
 	//Don't stream geometry to the client before we've received the handshake.
-	if (!receivedHandshake)
+	if (!receivedHandshake.load(std::memory_order_acquire))
 		return;
 
 	
@@ -143,6 +144,7 @@ void ClientMessaging::tick(float deltaTime)
 	if (timeSinceLastGeometryStream >= TIME_BETWEEN_GEOMETRY_TICKS)
 	{
 		geometryStreamingService.tick(TIME_BETWEEN_GEOMETRY_TICKS);
+		sendResourceContentHashes();
 
 		//Tell the client to change the visibility of nodes that have changed whether they are within streamable bounds.
 		if (!nodesEnteredBounds.empty() || !nodesLeftBounds.empty())
@@ -296,13 +298,32 @@ void ClientMessaging::nodeEnteredBounds(avs::uid nodeID)
 void ClientMessaging::nodeLeftBounds(avs::uid nodeID)
 {
 	nodesLeftBounds.push_back(nodeID);
+	movementEncoder.removeNode(nodeID);
 	nodesEnteredBounds.erase(std::remove(nodesEnteredBounds.begin(), nodesEnteredBounds.end(), nodeID), nodesEnteredBounds.end());
 }
 
 void ClientMessaging::updateNodeMovement(const std::vector<teleport::core::MovementUpdate>& updateList)
 {
-	teleport::core::UpdateNodeMovementCommand command(updateList.size());
-	sendCommand<>(command, updateList);
+	if(!peer)
+		return;
+	// Movement is sent unreliably on its own channel, so a lost packet does not hold up later ones: what it held will be sent again
+	// until the client acknowledges it. Each packet is kept within the MTU, so a single lost fragment can't lose the rest.
+	// The packets are unsequenced, as a tick's movement may take several, and the client drops stale records node by node.
+	size_t packetCount = movementEncoder.encode(updateList, originNodeID, maxMovementPayloadSize, movementPackets);
+	for(size_t i = 0; i < packetCount; i++)
+	{
+		const teleport::core::MovementPacket& movementPacket = movementPackets[i];
+		size_t commandSize = sizeof(teleport::core::UpdateNodeMovementCommand);
+		ENetPacket* packet = enet_packet_create(nullptr, commandSize + movementPacket.payload.size(), ENET_PACKET_FLAG_UNSEQUENCED);
+		if(!packet)
+		{
+			TELEPORT_CERR << "Failed to send node movement! Failed to create packet!\n";
+			return;
+		}
+		memcpy(packet->data, &movementPacket.command, commandSize);
+		memcpy(packet->data + commandSize, movementPacket.payload.data(), movementPacket.payload.size());
+		enet_peer_send(peer, static_cast<enet_uint8>(teleport::core::RemotePlaySessionChannel::RPCH_LatestState), packet);
+	}
 }
 
 void ClientMessaging::updateNodeEnabledState(const std::vector<teleport::core::NodeUpdateEnabledState>& updateList)
@@ -417,6 +438,7 @@ void ClientMessaging::receive(const ENetEvent& event)
 		receiveKeyframeRequest(event.packet);
 		break;
 	case teleport::core::RemotePlaySessionChannel::RPCH_ClientMessage:
+	case teleport::core::RemotePlaySessionChannel::RPCH_LatestState:
 		receiveClientMessage(event.packet);
 		break;
 	default:
@@ -428,10 +450,28 @@ void ClientMessaging::receive(const ENetEvent& event)
 void ClientMessaging::receiveHandshake(const ENetPacket* packet)
 {
 	size_t handShakeSize = sizeof(teleport::core::Handshake);
+	if (packet->dataLength < handShakeSize)
+	{
+		TELEPORT_CERR << "Error on receive handshake for Client_" << clientID << "! Received packet of length " << packet->dataLength << "; less than the handshake size of " << handShakeSize << "!\n";
+		return;
+	}
 
+	uint32_t version = 0;
+	memcpy(&version, packet->data, sizeof(version));
+	if (version != teleport::core::protocolVersion)
+	{
+		TELEPORT_CERR << "Client_" << clientID << " uses protocol version " << version << ", but this server uses version " << teleport::core::protocolVersion << "; disconnecting it.\n";
+		// The client sees the reason when the disconnect arrives; its DISCONNECT event here then ends the session.
+		if (peer)
+			enet_peer_disconnect(peer, static_cast<enet_uint32>(teleport::core::DisconnectReason::ProtocolVersionMismatch));
+		return;
+	}
 	memcpy(&handshake, packet->data, handShakeSize);
 
 	clientNetworkContext->axesStandard = handshake.axesStandard;
+	// A new session: the client has none of the movements previously sent.
+	movementEncoder.reset();
+	poseSequences.reset();
 
 	if (!clientNetworkContext->NetworkPipeline)
 	{
@@ -473,19 +513,39 @@ void ClientMessaging::receiveHandshake(const ENetPacket* packet)
 	cameraInfo.fov = handshake.FOV;
 	cameraInfo.isVR = handshake.isVR;
 
-	//Extract list of resources the client has.
-	std::vector<avs::uid> clientResources(handshake.resourceCount);
-	memcpy(clientResources.data(), packet->data + handShakeSize, sizeof(avs::uid)* handshake.resourceCount);
-
-	//Confirm resources the client has told us they have.
-	for (int i = 0; i < handshake.resourceCount; i++)
+	//Extract the content hashes of the resources in the client's disk cache, which are followed by the list of resources the client has.
+	std::vector<uint64_t> cachedResourceHashes;
+	size_t inventoryOffset = handShakeSize;
+	if (handshake.cachedResourceCount <= (packet->dataLength - handShakeSize) / sizeof(uint64_t))
 	{
-		geometryStreamingService.confirmResource(clientResources[i]);
+		cachedResourceHashes.resize(handshake.cachedResourceCount);
+		memcpy(cachedResourceHashes.data(), packet->data + handShakeSize, sizeof(uint64_t) * cachedResourceHashes.size());
+		inventoryOffset += sizeof(uint64_t) * cachedResourceHashes.size();
 	}
+	else
+	{
+		TELEPORT_CERR << "Handshake lists " << handshake.cachedResourceCount << " cached resources, more than fit in the packet; ignoring the client's disk cache.\n";
+		inventoryOffset = packet->dataLength;
+	}
+	std::vector<avs::uid> clientResources;
+	if (!teleport::core::DecodeResourceInventory(packet->data + inventoryOffset, packet->dataLength - inventoryOffset, handshake.resourceCount, clientResources))
+	{
+		TELEPORT_CERR << "Malformed resource inventory in handshake; the client's resources will be sent again.\n";
+		clientResources.clear();
+	}
+
+	//Confirm resources the client has told us they have.
+	geometryStreamingService.confirmResources(clientResources);
 
 	captureComponentDelegates.startStreaming(clientNetworkContext);
 	geometryStreamingService.startStreaming(clientNetworkContext, handshake);
-	receivedHandshake = true;
+	// Publishes the pipeline set up above to the streaming worker, and wakes it.
+	receivedHandshake.store(true, std::memory_order_release);
+	clientNetworkContext->streamingSignal->notify();
+
+	//Resources in the client's disk cache need not be streamed; tell the client their uids in this session, so it can load them.
+	geometryStreamingService.confirmCachedResources(cachedResourceHashes);
+	sendResourceContentHashes();
 
 	//Client has nothing, thus can't show nodes.
 	if (handshake.resourceCount == 0)
@@ -504,12 +564,23 @@ void ClientMessaging::receiveHandshake(const ENetPacket* packet)
 	TELEPORT_COUT << "RemotePlay: Started streaming to " << getClientIP() << ":" << streamingPort << "\n";
 }
 
+void ClientMessaging::sendResourceContentHashes()
+{
+	std::vector<teleport::core::ResourceContentHash>& contentHashes = geometryStreamingService.getContentHashesToSend();
+	if (contentHashes.empty())
+		return;
+	teleport::core::ResourceContentHashesCommand command(contentHashes.size());
+	sendCommand<>(command, contentHashes);
+	contentHashes.clear();
+}
+
 bool ClientMessaging::setOrigin(uint64_t valid_counter, avs::uid originNode)
 {
 	teleport::core::SetStageSpaceOriginNodeCommand setp;
 	if (clientNetworkContext->axesStandard != avs::AxesStandard::NotInitialized)
 	{
 		setp.origin_node=originNode;
+		originNodeID = originNode;
 		setp.valid_counter = valid_counter;
 		return sendCommand(setp);
 	}
@@ -671,6 +742,10 @@ void ClientMessaging::receiveClientMessage(const ENetPacket* packet)
 			TELEPORT_CERR << "Bad packet size.\n";
 			return;
 		}
+		movementEncoder.acknowledge(message.movementAcknowledged, message.movementAcknowledgedMask);
+		// A newer pose has already been applied.
+		if(!poseSequences.receive(message.sequence))
+			return;
 		avs::ConvertRotation(clientNetworkContext->axesStandard, settings->serverAxesStandard, message.headPose.orientation);
 		avs::ConvertPosition(clientNetworkContext->axesStandard, settings->serverAxesStandard, message.headPose.position);
 		setHeadPose(clientID, &message.headPose);
@@ -15,6 +15,7 @@
 #include "VideoEncodePipeline.h"
 #include "TeleportCore/ErrorHandling.h"
 #include "TeleportCore/Input.h"
+#include "TeleportCore/MovementCodec.h"
 #include "enet/enet.h"
 
 typedef void(__stdcall* SetHeadPoseFn) (avs::uid uid, const avs::Pose*);
@@ -218,6 +219,8 @@ namespace teleport
 			void receiveResourceRequest(const ENetPacket* packet);
 			void receiveKeyframeRequest(const ENetPacket* packet);
 			void receiveClientMessage(const ENetPacket* packet);
+			//! Send the content hashes the streaming service has gathered, so the client can cache those resources on disk.
+			void sendResourceContentHashes();
 
 			avs::ThreadSafeQueue<ENetEvent> eventQueue;
 			teleport::core::Handshake handshake;
@@ -246,15 +249,22 @@ namespace teleport
 
 			ENetPeer* peer = nullptr;
 
-			std::atomic_bool receivedHandshake = false;				//Whether we've received the handshake from the client.
+			std::atomic<bool> receivedHandshake{ false };			//Whether we've received the handshake from the client; read by the client's streaming worker.
 
 			std::vector<avs::uid> nodesEnteredBounds;	//Stores nodes client needs to know have entered streaming bounds.
 			std::vector<avs::uid> nodesLeftBounds;		//Stores nodes client needs to know have left streaming bounds.
 
 			core::Input latestInputStateAndEvents; //Latest input state received from the client.
 
+			avs::uid originNodeID = 0;					//The client's origin node, which node movements are quantised relative to.
+			core::MovementEncoder movementEncoder;
+			std::vector<core::MovementPacket> movementPackets;
+			core::SequenceWindow poseSequences;		//So that poses which arrive late can be dropped.
+
 			// Seconds
 			static constexpr float startSessionTimeout = 3;
+			// Bytes of movement per packet, leaving room within ENet's default MTU of 1400 for the headers.
+			static constexpr size_t maxMovementPayloadSize = 1200;
 		};
 	}
 }
\ No newline at end of file
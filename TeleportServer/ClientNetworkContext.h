@@ -1,6 +1,9 @@
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 
 #include "libavstream/common.hpp"
 #include "libavstream/queue.hpp"
@@ -15,6 +18,32 @@ namespace teleport
 {
 	namespace server
 	{
+		//! Wakes the client's streaming worker when there is something for it to do: data written to a sending queue,
+		//! the handshake arriving, or the worker being stopped.
+		struct StreamingSignal
+		{
+			void notify()
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					signalled = true;
+				}
+				condition.notify_one();
+			}
+			//! Waits until notified or the timeout passes, and clears the signal.
+			void waitFor(std::chrono::milliseconds timeout)
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait_for(lock, timeout, [this] { return signalled; });
+				signalled = false;
+			}
+
+		private:
+			std::mutex mutex;
+			std::condition_variable condition;
+			bool signalled = false;
+		};
+
 		//! Wrapper for the network pipeline objects for a given client.
 		struct ClientNetworkContext
 		{
@@ -24,6 +53,8 @@ namespace teleport
 			std::unique_ptr<avs::Queue> TagDataQueue;
 			std::unique_ptr<avs::Queue> GeometryQueue;
 			std::unique_ptr<avs::Queue> AudioQueue;
+			// Shared, so that the queues' write notifications and the context can be moved independently.
+			std::shared_ptr<StreamingSignal> streamingSignal = std::make_shared<StreamingSignal>();
 
 			// Receiving
 			std::unique_ptr<SourceNetworkPipeline> sourceNetworkPipeline;
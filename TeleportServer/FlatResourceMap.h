@@ -0,0 +1,224 @@
+#pragma once
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "libavstream/common.hpp"
+
+namespace teleport
+{
+	namespace server
+	{
+		//! A read-only view of a contiguous list of uids, such as the keys of a FlatResourceMap.
+		//! Nothing is copied, so the view is only valid for as long as the list it was made from is unchanged.
+		class UidSpan
+		{
+		public:
+			UidSpan() = default;
+			UidSpan(const avs::uid* d, size_t n)
+				: ids(d), count(n)
+			{}
+			UidSpan(const std::vector<avs::uid>& v)
+				: ids(v.data()), count(v.size())
+			{}
+			const avs::uid* data() const
+			{
+				return ids;
+			}
+			size_t size() const
+			{
+				return count;
+			}
+			bool empty() const
+			{
+				return count == 0;
+			}
+			avs::uid operator[](size_t i) const
+			{
+				return ids[i];
+			}
+			const avs::uid* begin() const
+			{
+				return ids;
+			}
+			const avs::uid* end() const
+			{
+				return ids + count;
+			}
+			//! Copy the uids, for a list that must outlive changes to the one viewed.
+			std::vector<avs::uid> toVector() const
+			{
+				return std::vector<avs::uid>(ids, ids + count);
+			}
+		private:
+			const avs::uid* ids = nullptr;
+			size_t count = 0;
+		};
+
+		//! A uid-keyed table with the resources stored contiguously, for fast lookup and iteration.
+		//! Lookup is through an open-addressed (linear-probing) index of slots into the contiguous storage.
+		//! Removing an entry moves the last entry into its place, and adding one can reallocate the storage, so pointers,
+		//! references, iterators and the list from getIDs() are only valid until the next insertion or removal:
+		//! look an entry up again rather than keeping a pointer to it, and copy the ids if they must outlive a change.
+		template<typename T> class FlatResourceMap
+		{
+		public:
+			typedef std::pair<avs::uid, T> value_type;
+			typedef typename std::vector<value_type>::iterator iterator;
+			typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+			//! Returns the resource with this uid, or nullptr if there is none.
+			T* find(avs::uid u)
+			{
+				size_t s = findSlot(u);
+				return (slots.size() && slots[s]) ? &entries[slots[s] - 1].second : nullptr;
+			}
+			const T* find(avs::uid u) const
+			{
+				size_t s = findSlot(u);
+				return (slots.size() && slots[s]) ? &entries[slots[s] - 1].second : nullptr;
+			}
+			bool contains(avs::uid u) const
+			{
+				return find(u) != nullptr;
+			}
+			//! Returns the resource with this uid, adding a default-constructed one if there is none.
+			T& operator[](avs::uid u)
+			{
+				if ((entries.size() + 1) * 2 > slots.size())
+					rehash(slots.size() ? slots.size() * 2 : 16);
+				size_t s = findSlot(u);
+				if (!slots[s])
+				{
+					entries.emplace_back(u, T());
+					ids.push_back(u);
+					slots[s] = (uint32_t)entries.size();
+				}
+				return entries[slots[s] - 1].second;
+			}
+			//! Removes the resource with this uid. Returns false if there was none.
+			bool erase(avs::uid u)
+			{
+				if (!slots.size())
+					return false;
+				size_t s = findSlot(u);
+				if (!slots[s])
+					return false;
+				size_t index = slots[s] - 1;
+				size_t last = entries.size() - 1;
+				removeSlot(s);
+				if (index != last)
+				{
+					// Move the last entry into the gap, and repoint its slot.
+					slots[findSlot(ids[last])] = (uint32_t)(index + 1);
+					entries[index] = std::move(entries[last]);
+					ids[index] = ids[last];
+				}
+				entries.pop_back();
+				ids.pop_back();
+				return true;
+			}
+			void clear()
+			{
+				entries.clear();
+				ids.clear();
+				slots.clear();
+			}
+			void reserve(size_t n)
+			{
+				entries.reserve(n);
+				ids.reserve(n);
+				size_t capacity = 16;
+				while (capacity < n * 2)
+					capacity *= 2;
+				if (capacity > slots.size())
+					rehash(capacity);
+			}
+			size_t size() const
+			{
+				return entries.size();
+			}
+			bool empty() const
+			{
+				return entries.empty();
+			}
+			//! The uids of all entries, in the same order as iteration. No copy is made, so the list changes with the map.
+			const std::vector<avs::uid>& getIDs() const
+			{
+				return ids;
+			}
+			iterator begin()
+			{
+				return entries.begin();
+			}
+			iterator end()
+			{
+				return entries.end();
+			}
+			const_iterator begin() const
+			{
+				return entries.begin();
+			}
+			const_iterator end() const
+			{
+				return entries.end();
+			}
+		private:
+			std::vector<value_type> entries;
+			std::vector<avs::uid> ids;
+			// Each slot is zero if empty, or one more than the index of its entry. The size is zero or a power of two.
+			std::vector<uint32_t> slots;
+
+			static size_t hash(avs::uid u)
+			{
+				// Uids are often sequential, so mix the bits before masking (splitmix64 finaliser).
+				uint64_t x = (uint64_t)u;
+				x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+				x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+				return (size_t)(x ^ (x >> 31));
+			}
+			//Returns the slot holding u, or the empty slot where it would go.
+			size_t findSlot(avs::uid u) const
+			{
+				if (!slots.size())
+					return 0;
+				size_t mask = slots.size() - 1;
+				size_t s = hash(u) & mask;
+				while (slots[s] && ids[slots[s] - 1] != u)
+					s = (s + 1) & mask;
+				return s;
+			}
+			//Empties slot s, shifting back any later entries in the same probe run so that they can still be found.
+			void removeSlot(size_t s)
+			{
+				size_t mask = slots.size() - 1;
+				size_t next = (s + 1) & mask;
+				while (slots[next])
+				{
+					size_t ideal = hash(ids[slots[next] - 1]) & mask;
+					// Can the entry at next move back to s? Only if s lies cyclically within [ideal,next).
+					if (((next - ideal) & mask) >= ((next - s) & mask))
+					{
+						slots[s] = slots[next];
+						s = next;
+					}
+					next = (next + 1) & mask;
+				}
+				slots[s] = 0;
+			}
+			void rehash(size_t capacity)
+			{
+				slots.assign(capacity, 0);
+				size_t mask = capacity - 1;
+				for (size_t i = 0; i < ids.size(); i++)
+				{
+					size_t s = hash(ids[i]) & mask;
+					while (slots[s])
+						s = (s + 1) & mask;
+					slots[s] = (uint32_t)(i + 1);
+				}
+			}
+		};
+	}
+}
@@ -1,6 +1,8 @@
 #include "GeometryEncoder.h"
 
 #include <algorithm>
+#include <memory>
+#include <mutex>
 #include <set>
 
 #include "libavstream/common.hpp"
@@ -10,6 +12,7 @@
 
 #include "TeleportCore/ErrorHandling.h"
 #include "TeleportCore/TextCanvas.h"
+#include "TeleportCore/ThreadPool.h"
 #include "GeometryStreamingService.h"
 #include "GeometryStore.h"
 
@@ -17,26 +20,29 @@
 using namespace teleport;
 using namespace server;
 
-//Clear a passed vector of UIDs that are believed to have already been sent to the client.
-//	outUIDs : Vector of all UIDs of resources that could potentially need to be sent across.
-//	req : Object that defines what needs to transfered across.
-//Returns the size of the vector after having UIDs of already sent resources removed, and puts the new UIDs in the outUIDs vector.
-size_t GetNewUIDs(std::vector<avs::uid>& outUIDs, avs::GeometryRequesterBackendInterface* req)
+// Encoding of independent payloads is spread over a pool shared by all clients' encoders.
+static std::mutex encodePoolMutex;
+static std::shared_ptr<core::ThreadPool> encodePool;
+static size_t encodeThreadCount = 0;
+
+static std::shared_ptr<core::ThreadPool> GetEncodePool()
 {
-	//Remove uids the requester has.
-	for (auto it = outUIDs.begin(); it != outUIDs.end();)
-	{
-		if (req->hasResource(*it))
-		{
-			it = outUIDs.erase(it);
-		}
-		else
-		{
-			++it;
-		}
-	}
+	std::lock_guard<std::mutex> lock(encodePoolMutex);
+	if (encodeThreadCount == 1)
+		return nullptr;
+	if (!encodePool)
+		encodePool = std::make_shared<core::ThreadPool>(encodeThreadCount ? encodeThreadCount - 1 : 0);
+	return encodePool;
+}
 
-	return outUIDs.size();
+void GeometryEncoder::SetEncodeThreadCount(size_t n)
+{
+	std::lock_guard<std::mutex> lock(encodePoolMutex);
+	if (n == encodeThreadCount)
+		return;
+	encodeThreadCount = n;
+	// Encoders that are mid-encode keep their reference to the old pool until they finish.
+	encodePool.reset();
 }
 
 GeometryEncoder::GeometryEncoder(const ServerSettings* settings, GeometryStreamingService* srv)
@@ -47,203 +53,273 @@ avs::Result GeometryEncoder::encode(uint64_t timestamp, avs::GeometryRequesterBa
 {
 	if (!geometryStreamingService || geometryStreamingService->getClientAxesStandard() == avs::AxesStandard::NotInitialized)
 		return avs::Result::Failed;
-	queuedBuffer.clear();
-	GeometryStore* geometryStore = &(GeometryStore::GetInstance());
+	queuedPayloads.clear();
+	queuedSize = 0;
 	// The source backend will give us the data to encode.
 	// What data it provides depends on the contents of the avs::GeometryRequesterBackendInterface object.
 
-	//Encode data onto buffer, and then move it onto queuedBuffer.
-	//Unless queueing the data would causes queuedBuffer to exceed the recommended buffer size, which will cause the data to stay in buffer until the next encode call.
+	//Encode each payload into its own buffer, and then queue it.
+	//Unless queueing the data would cause the queue to exceed the recommended buffer size, which will cause the data to stay pending until the next encode call.
 	//Data may still be queued, and exceed the recommeneded size, if not queueing the data may leave it empty.
 
 	//Queue what may have been left since last time, and keep queueing if there is still some space.
 	bool keepQueueing = attemptQueueData();
-	if (keepQueueing)
+	if (!keepQueueing)
+		return avs::Result::OK;
+
+	std::vector<EncodeJob> jobs;
+	gatherEncodeJobs(jobs);
+
+	// Jobs are encoded a batch at a time, then queued in order until the buffer is full.
+	// Jobs in a batch after the one that fills the buffer are discarded, and will be gathered again next time,
+	// so we keep the batches small enough that little work is thrown away.
+	std::shared_ptr<core::ThreadPool> pool = GetEncodePool();
+	size_t batchSize = pool ? (pool->getThreadCount() + 1) * 2 : 1;
+	for (size_t batchStart = 0; batchStart < jobs.size() && keepQueueing; batchStart += batchSize)
 	{
-		std::vector<avs::uid> nodeIDsToStream;
-		std::vector<avs::MeshNodeResources> meshNodeResources;
-		std::vector<avs::LightNodeResources> lightNodeResources;
-		std::vector<avs::uid> textCanvas_uids;
-		std::vector<avs::uid> font_uids;
-		std::set<avs::uid> genericTexturesToStream;
-
-		geometryStreamingService->getResourcesToStream(nodeIDsToStream, meshNodeResources, lightNodeResources, genericTexturesToStream
-			, textCanvas_uids, font_uids, minimumPriority);
-
-		for (avs::uid nodeID : nodeIDsToStream)
+		size_t batchCount = std::min(batchSize, jobs.size() - batchStart);
+		auto encodeOne = [this, &jobs, batchStart](size_t i)
 		{
-			if (!geometryStreamingService->hasResource(nodeID))
-			{
-				encodeNodes(geometryStreamingService, { nodeID });
-
-				keepQueueing = attemptQueueData();
-				if (!keepQueueing)
-				{
-					break;
-				}
-			}
-		}
-
-		//Encode mesh nodes first, as they should be sent before lighting data.
-		for (avs::MeshNodeResources meshResourceInfo : meshNodeResources)
+			encodeJob(jobs[batchStart + i]);
+		};
+		if (pool)
+			pool->parallelFor(batchCount, encodeOne);
+		else
+			encodeOne(0);
+		for (size_t i = 0; i < batchCount; i++)
 		{
-			if (!geometryStreamingService->hasResource(meshResourceInfo.mesh_uid))
-			{
-				encodeMeshes(geometryStreamingService, { meshResourceInfo.mesh_uid });
-
-				keepQueueing = attemptQueueData();
-				if (!keepQueueing)
-				{
-					break;
-				}
-			}
-			if (meshResourceInfo.skinID != 0)
-			{
-				if (!geometryStreamingService->hasResource(meshResourceInfo.skinID))
-				{
-					encodeSkin(geometryStreamingService, meshResourceInfo.skinID);
-
-					keepQueueing = attemptQueueData();
-					if (!keepQueueing)
-					{
-						break;
-					}
-				}
-			}
-
-			for (avs::uid animationID : meshResourceInfo.animationIDs)
+			EncodeJob& job = jobs[batchStart + i];
+			if (!job.payload || job.payload->empty())
+				continue;
+			pendingPayload = std::move(job.payload);
+			keepQueueing = attemptQueueData();
+			// Even if it did not fit, the data is now pending, and will be sent first next time.
+			for (avs::uid u : job.encodedUids)
 			{
-				if (!geometryStreamingService->hasResource(animationID))
-				{
-					encodeAnimation(geometryStreamingService, animationID);
-
-					keepQueueing = attemptQueueData();
-					if (!keepQueueing)
-					{
-						break;
-					}
-				}
+				geometryStreamingService->encodedResource(u);
 			}
 			if (!keepQueueing)
 			{
 				break;
 			}
+		}
+	}
 
-			for (avs::MaterialResources material : meshResourceInfo.materials)
-			{
-				if (!geometryStreamingService->hasResource(material.material_uid))
-				{
-					encodeMaterials(geometryStreamingService, { material.material_uid });
-					keepQueueing = attemptQueueData();
-					if (!keepQueueing)
-					{
-						break;
-					}
-				}
-				if (GetNewUIDs(material.texture_uids, geometryStreamingService) != 0)
-				{
-					for (avs::uid textureID : material.texture_uids)
-					{
-						encodeTextures(geometryStreamingService, { textureID });
-						keepQueueing = attemptQueueData();
-						if (!keepQueueing)
-						{
-							break;
-						}
-					}
-					if (!keepQueueing)
-					{
-						break;
-					}
-				}
-			}
-			if (!keepQueueing)
-			{
-				break;
-			}
+	return avs::Result::OK;
+}
 
-			if (!geometryStreamingService->hasResource(meshResourceInfo.node_uid))
-			{
-				encodeNodes(geometryStreamingService, { meshResourceInfo.node_uid });
+void GeometryEncoder::gatherEncodeJobs(std::vector<EncodeJob>& jobs) const
+{
+	GeometryStore* geometryStore = &(GeometryStore::GetInstance());
+	std::vector<avs::uid> nodeIDsToStream;
+	std::vector<avs::MeshNodeResources> meshNodeResources;
+	std::vector<avs::LightNodeResources> lightNodeResources;
+	std::vector<avs::uid> textCanvas_uids;
+	std::vector<avs::uid> font_uids;
+	std::set<avs::uid> genericTexturesToStream;
+
+	geometryStreamingService->getResourcesToStream(nodeIDsToStream, meshNodeResources, lightNodeResources, genericTexturesToStream
+		, textCanvas_uids, font_uids, minimumPriority);
+
+	// Each resource is encoded once, by the first job that needs it.
+	std::set<avs::uid> scheduled;
+	auto needs = [this, &scheduled](avs::uid u)
+	{
+		if (geometryStreamingService->hasResource(u))
+			return false;
+		return scheduled.insert(u).second;
+	};
+	auto addJob = [&jobs](avs::GeometryPayloadType t, avs::uid u)
+	{
+		EncodeJob job;
+		job.type = t;
+		job.uid = u;
+		jobs.push_back(std::move(job));
+	};
 
-				keepQueueing = attemptQueueData();
-				if (!keepQueueing)
-				{
-					break;
-				}
-			}
-		}
+	for (avs::uid nodeID : nodeIDsToStream)
+	{
+		if (needs(nodeID))
+			addJob(avs::GeometryPayloadType::Node, nodeID);
+	}
 
-		for (avs::LightNodeResources lightResourceInfo : lightNodeResources)
+	//Encode mesh nodes first, as they should be sent before lighting data.
+	for (const avs::MeshNodeResources& meshResourceInfo : meshNodeResources)
+	{
+		if (needs(meshResourceInfo.mesh_uid))
+			addJob(avs::GeometryPayloadType::Mesh, meshResourceInfo.mesh_uid);
+		if (meshResourceInfo.skinID != 0 && needs(meshResourceInfo.skinID))
+			addJob(avs::GeometryPayloadType::Skin, meshResourceInfo.skinID);
+		for (avs::uid animationID : meshResourceInfo.animationIDs)
+		{
+			if (needs(animationID))
+				addJob(avs::GeometryPayloadType::Animation, animationID);
+		}
+		for (const avs::MaterialResources& material : meshResourceInfo.materials)
 		{
-			if (lightResourceInfo.shadowmap_uid)
+			if (needs(material.material_uid))
 			{
-				if (!geometryStreamingService->hasResource(lightResourceInfo.shadowmap_uid))
+				const avs::Material* m = geometryStore->getMaterial(material.material_uid);
+				if (m)
 				{
-					encodeTextures(geometryStreamingService, { lightResourceInfo.shadowmap_uid });
-
-					keepQueueing = attemptQueueData();
-					if (!keepQueueing)
+					addJob(avs::GeometryPayloadType::Material, material.material_uid);
+					//UIDs used by textures in material.
+					std::vector<avs::uid> materialTexture_uids = m->GetTextureUids();
+					//Array needs to be sorted for std::unique; we won't have many elements anyway.
+					std::sort(materialTexture_uids.begin(), materialTexture_uids.end());
+					//Shift data over duplicates, and erase.
+					materialTexture_uids.erase(std::unique(materialTexture_uids.begin(), materialTexture_uids.end()), materialTexture_uids.end());
+					//Shift data over 0s, and erase.
+					materialTexture_uids.erase(std::remove(materialTexture_uids.begin(), materialTexture_uids.end(), 0), materialTexture_uids.end());
+					//Only send textures that we have not already sent to the client.
+					for (avs::uid textureID : materialTexture_uids)
 					{
-						break;
+						if (needs(textureID))
+							jobs.back().textureUids.push_back(textureID);
 					}
 				}
 			}
-
-			if (!geometryStreamingService->hasResource(lightResourceInfo.node_uid))
+			for (avs::uid textureID : material.texture_uids)
 			{
-				encodeNodes(geometryStreamingService, { lightResourceInfo.node_uid });
-
-				keepQueueing = attemptQueueData();
-				if (!keepQueueing)
-				{
-					break;
-				}
+				if (needs(textureID))
+					addJob(avs::GeometryPayloadType::Texture, textureID);
 			}
 		}
+		if (needs(meshResourceInfo.node_uid))
+			addJob(avs::GeometryPayloadType::Node, meshResourceInfo.node_uid);
+	}
 
-		//Encode mesh nodes first, as they should be sent before lighting data.
-		for (avs::uid texture_uid : genericTexturesToStream)
-		{
-			if (geometryStreamingService->hasResource(texture_uid))
-				continue;
-			encodeTextures(geometryStreamingService, { texture_uid });
-			keepQueueing = attemptQueueData();
-			if (!keepQueueing)
-			{
-				break;
-			}
-		}
-		for (avs::uid font_uid : font_uids)
+	for (const avs::LightNodeResources& lightResourceInfo : lightNodeResources)
+	{
+		if (lightResourceInfo.shadowmap_uid && needs(lightResourceInfo.shadowmap_uid))
+			addJob(avs::GeometryPayloadType::Texture, lightResourceInfo.shadowmap_uid);
+		if (needs(lightResourceInfo.node_uid))
+			addJob(avs::GeometryPayloadType::Node, lightResourceInfo.node_uid);
+	}
+
+	for (avs::uid texture_uid : genericTexturesToStream)
+	{
+		if (needs(texture_uid))
+			addJob(avs::GeometryPayloadType::Texture, texture_uid);
+	}
+	for (avs::uid font_uid : font_uids)
+	{
+		if (needs(font_uid))
+			addJob(avs::GeometryPayloadType::FontAtlas, font_uid);
+	}
+	for (avs::uid canvas_uid : textCanvas_uids)
+	{
+		if (needs(canvas_uid))
+			addJob(avs::GeometryPayloadType::TextCanvas, canvas_uid);
+	}
+}
+
+void GeometryEncoder::encodeJob(EncodeJob& job) const
+{
+	// Meshes, textures and nodes encode the same way for every client with the same axes standard,
+	// as do materials when no textures are packaged with them. These payloads are shared through the GeometryStore.
+	GeometryStore* geometryStore = &(GeometryStore::GetInstance());
+	avs::AxesStandard axesStandard = geometryStreamingService->getClientAxesStandard();	//Only used as part of the shared payload's key.
+	uint8_t featureMask = 0;
+	uint64_t sourceStamp = 0;
+	bool shareable = false;
+	switch (job.type)
+	{
+	case avs::GeometryPayloadType::Texture:
+		// Textures are the same whatever the axes standard.
+		axesStandard = avs::AxesStandard::NotInitialized;
+		shareable = true;
+		break;
+	case avs::GeometryPayloadType::Mesh:
+		shareable = true;
+		break;
+	case avs::GeometryPayloadType::Node:
+		// The node's payload includes its transforms, which change every time it moves.
+		sourceStamp = geometryStore->getNodeTransformStamp(job.uid);
+		shareable = true;
+		break;
+	case avs::GeometryPayloadType::Material:
 		{
-			if (geometryStreamingService->hasResource(font_uid))
-				continue;
-			encodeFontAtlas(font_uid);
-			keepQueueing = attemptQueueData();
-			if (!keepQueueing)
-			{
-				break;
-			}
+			auto renderingFeatures = geometryStreamingService->getClientRenderingFeatures();
+			featureMask = (renderingFeatures.normals ? 1 : 0) | (renderingFeatures.ambientOcclusion ? 2 : 0);
+			shareable = job.textureUids.empty();
 		}
-		for (avs::uid canvas_uid : textCanvas_uids)
+		break;
+	default:
+		break;
+	}
+	uint64_t generation = 0;
+	if (shareable)
+	{
+		// A cached payload is shared as it is, not copied.
+		job.payload = geometryStore->getEncodedResource(job.uid, axesStandard, featureMask, sourceStamp);
+		if (job.payload)
 		{
-			if (geometryStreamingService->hasResource(canvas_uid))
-				continue;
-			encodeTextCanvas(canvas_uid);
-			keepQueueing = attemptQueueData();
-			if (!keepQueueing)
-			{
-				break;
-			}
+			job.encodedUids = { job.uid };
+			return;
 		}
-
+		generation = geometryStore->getEncodedResourceGeneration();
+	}
+	// Each job has its own encoder, so that jobs share no buffers and can run on any thread.
+	GeometryEncoder jobEncoder(settings, geometryStreamingService);
+	avs::Result result = avs::Result::OK;
+	switch (job.type)
+	{
+	case avs::GeometryPayloadType::Node:
+		result = jobEncoder.encodeNodes(geometryStreamingService, { job.uid });
+		break;
+	case avs::GeometryPayloadType::Mesh:
+		result = jobEncoder.encodeMeshes(geometryStreamingService, { job.uid });
+		break;
+	case avs::GeometryPayloadType::Skin:
+		result = jobEncoder.encodeSkin(geometryStreamingService, job.uid);
+		break;
+	case avs::GeometryPayloadType::Animation:
+		result = jobEncoder.encodeAnimation(geometryStreamingService, job.uid);
+		break;
+	case avs::GeometryPayloadType::Material:
+		result = jobEncoder.encodeMaterial(job.uid, job.textureUids);
+		break;
+	case avs::GeometryPayloadType::Texture:
+		result = jobEncoder.encodeTextures(geometryStreamingService, { job.uid });
+		break;
+	case avs::GeometryPayloadType::FontAtlas:
+		result = jobEncoder.encodeFontAtlas(job.uid);
+		break;
+	case avs::GeometryPayloadType::TextCanvas:
+		result = jobEncoder.encodeTextCanvas(job.uid);
+		break;
+	default:
+		TELEPORT_CERR << "Unsupported payload type " << avs::stringOf(job.type) << " for encoding.\n";
+		return;
+	}
+	// A failed payload may be incomplete, so it must not be sent.
+	if (result != avs::Result::OK)
+		return;
+	job.payload = std::make_shared<const std::vector<char>>(std::move(jobEncoder.buffer));
+	job.encodedUids = std::move(jobEncoder.encodedUids);
+	// Only complete payloads for exactly this resource are shared.
+	if (shareable && job.encodedUids.size() == 1 && job.encodedUids[0] == job.uid)
+	{
+		geometryStore->storeEncodedResource(job.uid, axesStandard, featureMask, generation, job.payload, sourceStamp);
 	}
-
-	return avs::Result::OK;
 }
 
 avs::Result GeometryEncoder::mapOutputBuffer(void*& bufferPtr, size_t& bufferSizeInBytes)
 {
+	// A single payload is handed to the pipeline as it is; only several need joining into one buffer.
+	if (queuedPayloads.size() == 1)
+	{
+		bufferSizeInBytes = queuedPayloads[0]->size();
+		bufferPtr = (void*)queuedPayloads[0]->data();
+		return avs::Result::OK;
+	}
+	queuedBuffer.clear();
+	queuedBuffer.reserve(queuedSize);
+	for (const Payload& payload : queuedPayloads)
+	{
+		queuedBuffer.insert(queuedBuffer.end(), payload->begin(), payload->end());
+	}
 	bufferSizeInBytes = queuedBuffer.size();
 	bufferPtr = queuedBuffer.data();
 	return avs::Result::OK;
@@ -251,6 +327,8 @@ avs::Result GeometryEncoder::mapOutputBuffer(void*& bufferPtr, size_t& bufferSiz
 
 avs::Result GeometryEncoder::unmapOutputBuffer()
 {
+	queuedPayloads.clear();
+	queuedSize = 0;
 	queuedBuffer.clear();
 	return avs::Result::OK;
 }
@@ -379,7 +457,7 @@ avs::Result GeometryEncoder::encodeMeshes(avs::GeometryRequesterBackendInterface
 		// Actual size is now known so update payload size
 		putPayloadSize();
 
-		geometryStreamingService->encodedResource(uid);
+		encodedResource(uid);
 	}
 	return avs::Result::OK;
 }
@@ -389,21 +467,26 @@ avs::Result GeometryEncoder::encodeNodes(avs::GeometryRequesterBackendInterface*
 	GeometryStore* geometryStore = &GeometryStore::GetInstance();
 	//Place payload type onto the buffer.
 	putPayload(avs::GeometryPayloadType::Node);
+	// Copied, as the main thread may add, remove or move nodes while this runs on an encoder thread.
+	std::vector<avs::Node> nodeCopies;
+	nodeCopies.reserve(missingUIDs.size());
 	for (int i = 0; i < missingUIDs.size(); i++)
 	{
 		avs::uid uid = missingUIDs[i];
-		avs::Node* node = geometryStore->getNode(uid);
-		if (!node)
+		nodeCopies.emplace_back();
+		if (!geometryStore->getNodeCopy(uid, nodeCopies.back()))
 		{
 			TELEPORT_CERR << "PipelineNode encoding error! Node_" << uid << " does not exist!\n";
+			nodeCopies.pop_back();
 			missingUIDs.erase(missingUIDs.begin() + i);
 			i--;
 		}
 	}
 	put(missingUIDs.size());
-	for (const avs::uid& uid : missingUIDs)
+	for (size_t n = 0; n < missingUIDs.size(); n++)
 	{
-		avs::Node* node = geometryStore->getNode(uid);
+		const avs::uid uid = missingUIDs[n];
+		const avs::Node* node = &nodeCopies[n];
 		put(uid);
 
 		//Push name length.
@@ -477,7 +560,7 @@ avs::Result GeometryEncoder::encodeNodes(avs::GeometryRequesterBackendInterface*
 			put(id);
 		}
 
-		geometryStreamingService->encodedResource(uid);
+		encodedResource(uid);
 	}
 
 	// Actual size is now known so update payload size
@@ -530,7 +613,9 @@ avs::Result GeometryEncoder::encodeSkin(avs::GeometryRequesterBackendInterface*,
 		put(skin->boneIDs.size());
 		for (int i = 0; i < skin->boneIDs.size(); i++)
 		{
-			avs::Node* node = geometryStore->getNode(skin->boneIDs[i]);
+			avs::Node bone;
+			geometryStore->getNodeCopy(skin->boneIDs[i], bone);
+			const avs::Node* node = &bone;
 			avs::Transform localTransform = node->localTransform;
 			avs::ConvertTransform(settings->serverAxesStandard, geometryStreamingService->getClientAxesStandard(), localTransform);
 			//put(skin->boneIDs[i]);
@@ -553,7 +638,7 @@ avs::Result GeometryEncoder::encodeSkin(avs::GeometryRequesterBackendInterface*,
 		put(skin->skinTransform);
 
 		putPayloadSize();
-		geometryStreamingService->encodedResource(skinID);
+		encodedResource(skinID);
 	}
 
 	return avs::Result::OK;
@@ -584,7 +669,7 @@ avs::Result GeometryEncoder::encodeAnimation(avs::GeometryRequesterBackendInterf
 		}
 
 		putPayloadSize();
-		geometryStreamingService->encodedResource(animationID);
+		encodedResource(animationID);
 	}
 
 	return avs::Result::OK;
@@ -617,6 +702,12 @@ void GeometryEncoder::putPayloadSize()
 	prevBufferSize = 0;
 }
 
+void GeometryEncoder::encodedResource(avs::uid uid)
+{
+	// The streaming service is only told once the data is actually queued, see encode().
+	encodedUids.push_back(uid);
+}
+
 avs::Result GeometryEncoder::encodeFontAtlas(avs::uid uid)
 {
 	GeometryStore* geometryStore = &(GeometryStore::GetInstance());
@@ -653,7 +744,7 @@ avs::Result GeometryEncoder::encodeFontAtlas(avs::uid uid)
 	// Actual size is now known so update payload size
 	putPayloadSize();
 	//Flag we have encoded the material.
-	geometryStreamingService->encodedResource(uid);
+	encodedResource(uid);
 	return avs::Result::OK;
 }
 
@@ -677,7 +768,7 @@ avs::Result GeometryEncoder::encodeTextCanvas(avs::uid uid)
 	// Actual size is now known so update payload size
 	putPayloadSize();
 	//Flag we have encoded the material.
-	geometryStreamingService->encodedResource(uid);
+	encodedResource(uid);
 	return avs::Result::OK;
 }
 
@@ -690,127 +781,107 @@ avs::Result GeometryEncoder::encodeTextures(avs::GeometryRequesterBackendInterfa
 	return avs::Result::OK;
 }
 
-avs::Result GeometryEncoder::encodeMaterials(avs::GeometryRequesterBackendInterface*
-	, std::vector<avs::uid> missingUIDs)
+avs::Result GeometryEncoder::encodeMaterial(avs::uid uid, const std::vector<avs::uid>& materialTexture_uids)
 {
 	GeometryStore* geometryStore = &(GeometryStore::GetInstance());
 	auto renderingFeatures = geometryStreamingService->getClientRenderingFeatures();
-	//Push amount of materials.
-	for (avs::uid uid : missingUIDs)
+	avs::Material* material = geometryStore->getMaterial(uid);
+	if (!material)
+		return avs::Result::OK;
+	for (auto u : materialTexture_uids)
 	{
-		avs::Material* material = geometryStore->getMaterial(uid);
-
-		if (material)
+		if (!geometryStore->getTexture(u))
 		{
-			//UIDs used by textures in material.
-			std::vector<avs::uid> materialTexture_uids = material->GetTextureUids();
-			for (auto u : materialTexture_uids)
-			{
-				if (!geometryStore->getTexture(u))
-				{
-					TELEPORT_CERR << "Material " << material->name.c_str() << " points to " << u << " which is not a texture.\n";
-					continue;
-				}
-			}
-			putPayload(avs::GeometryPayloadType::Material);
-			put((size_t)1);
-			put(uid);
-
-			size_t nameLength = material->name.length();
-
-			//Push name length.
-			put(nameLength);
-			//Push name.
-			put((uint8_t*)material->name.data(), nameLength);
-
-			put(material->materialMode);
-
-			//Push base colour, and factor.
-			put(material->pbrMetallicRoughness.baseColorTexture.index);
-			put(material->pbrMetallicRoughness.baseColorTexture.texCoord);
-			put(material->pbrMetallicRoughness.baseColorTexture.tiling.x);
-			put(material->pbrMetallicRoughness.baseColorTexture.tiling.y);
-			put(material->pbrMetallicRoughness.baseColorFactor.x);
-			put(material->pbrMetallicRoughness.baseColorFactor.y);
-			put(material->pbrMetallicRoughness.baseColorFactor.z);
-			put(material->pbrMetallicRoughness.baseColorFactor.w);
-
-			//Push metallic roughness, and factors.
-			put(material->pbrMetallicRoughness.metallicRoughnessTexture.index);
-			put(material->pbrMetallicRoughness.metallicRoughnessTexture.texCoord);
-			put(material->pbrMetallicRoughness.metallicRoughnessTexture.tiling.x);
-			put(material->pbrMetallicRoughness.metallicRoughnessTexture.tiling.y);
-			put(material->pbrMetallicRoughness.metallicFactor);
-			put(material->pbrMetallicRoughness.roughnessMultiplier);
-			put(material->pbrMetallicRoughness.roughnessOffset);
-
-			//Push normal map, and scale.
-			// TODO Note: correspondence between these handshake feature checks and those at GeometryStreamingService::GetMeshNodeResources!
-			if (renderingFeatures.normals)
-				put(material->normalTexture.index);
-			else
-				put(avs::uid(0));
-			put(material->normalTexture.texCoord);
-			put(material->normalTexture.tiling.x);
-			put(material->normalTexture.tiling.y);
-			put(material->normalTexture.scale);
-
-			//Push occlusion texture, and strength.
-			// Note, if AO is not supported, we MUST put a zero, or the client will request a missing texture that never arrives.
-			if (renderingFeatures.ambientOcclusion)
-				put(material->occlusionTexture.index);
-			else
-				put(avs::uid(0));
-			put(material->occlusionTexture.texCoord);
-			put(material->occlusionTexture.tiling.x);
-			put(material->occlusionTexture.tiling.y);
-			put(material->occlusionTexture.strength);
-
-			//Push emissive texture, and factor.
-			put(material->emissiveTexture.index);
-			put(material->emissiveTexture.texCoord);
-			put(material->emissiveTexture.tiling.x);
-			put(material->emissiveTexture.tiling.y);
-			put(material->emissiveFactor.x);
-			put(material->emissiveFactor.y);
-			put(material->emissiveFactor.z);
-
-			//Push extension amount.
-			put(material->extensions.size());
-			//Push extensions.
-			for (const auto& extensionPair : material->extensions)
-			{
-				extensionPair.second->serialise(buffer);
-			}
-
-
-			//Array needs to be sorted for std::unique; we won't have many elements anyway.
-			std::sort(materialTexture_uids.begin(), materialTexture_uids.end());
-			//Shift data over duplicates, and erase.
-			materialTexture_uids.erase(std::unique(materialTexture_uids.begin(), materialTexture_uids.end()), materialTexture_uids.end());
-			//Shift data over 0s, and erase.
-			materialTexture_uids.erase(std::remove(materialTexture_uids.begin(), materialTexture_uids.end(), 0), materialTexture_uids.end());
-
-			//Only send textures that we have not already sent to the client.
-			GetNewUIDs(materialTexture_uids, geometryStreamingService);
+			TELEPORT_CERR << "Material " << material->name.c_str() << " points to " << u << " which is not a texture.\n";
+			continue;
+		}
+	}
+	putPayload(avs::GeometryPayloadType::Material);
+	put((size_t)1);
+	put(uid);
 
-			//Push amount of textures we are sending.
-			put(materialTexture_uids.size());
+	size_t nameLength = material->name.length();
+
+	//Push name length.
+	put(nameLength);
+	//Push name.
+	put((uint8_t*)material->name.data(), nameLength);
+
+	put(material->materialMode);
+
+	//Push base colour, and factor.
+	put(material->pbrMetallicRoughness.baseColorTexture.index);
+	put(material->pbrMetallicRoughness.baseColorTexture.texCoord);
+	put(material->pbrMetallicRoughness.baseColorTexture.tiling.x);
+	put(material->pbrMetallicRoughness.baseColorTexture.tiling.y);
+	put(material->pbrMetallicRoughness.baseColorFactor.x);
+	put(material->pbrMetallicRoughness.baseColorFactor.y);
+	put(material->pbrMetallicRoughness.baseColorFactor.z);
+	put(material->pbrMetallicRoughness.baseColorFactor.w);
+
+	//Push metallic roughness, and factors.
+	put(material->pbrMetallicRoughness.metallicRoughnessTexture.index);
+	put(material->pbrMetallicRoughness.metallicRoughnessTexture.texCoord);
+	put(material->pbrMetallicRoughness.metallicRoughnessTexture.tiling.x);
+	put(material->pbrMetallicRoughness.metallicRoughnessTexture.tiling.y);
+	put(material->pbrMetallicRoughness.metallicFactor);
+	put(material->pbrMetallicRoughness.roughnessMultiplier);
+	put(material->pbrMetallicRoughness.roughnessOffset);
+
+	//Push normal map, and scale.
+	// TODO Note: correspondence between these handshake feature checks and those at GeometryStreamingService::GetMeshNodeResources!
+	if (renderingFeatures.normals)
+		put(material->normalTexture.index);
+	else
+		put(avs::uid(0));
+	put(material->normalTexture.texCoord);
+	put(material->normalTexture.tiling.x);
+	put(material->normalTexture.tiling.y);
+	put(material->normalTexture.scale);
+
+	//Push occlusion texture, and strength.
+	// Note, if AO is not supported, we MUST put a zero, or the client will request a missing texture that never arrives.
+	if (renderingFeatures.ambientOcclusion)
+		put(material->occlusionTexture.index);
+	else
+		put(avs::uid(0));
+	put(material->occlusionTexture.texCoord);
+	put(material->occlusionTexture.tiling.x);
+	put(material->occlusionTexture.tiling.y);
+	put(material->occlusionTexture.strength);
+
+	//Push emissive texture, and factor.
+	put(material->emissiveTexture.index);
+	put(material->emissiveTexture.texCoord);
+	put(material->emissiveTexture.tiling.x);
+	put(material->emissiveTexture.tiling.y);
+	put(material->emissiveFactor.x);
+	put(material->emissiveFactor.y);
+	put(material->emissiveFactor.z);
+
+	//Push extension amount.
+	put(material->extensions.size());
+	//Push extensions.
+	for (const auto& extensionPair : material->extensions)
+	{
+		extensionPair.second->serialise(buffer);
+	}
 
-			// Actual size is now known so update payload size
-			putPayloadSize();
+	//Push amount of textures we are sending.
+	put(materialTexture_uids.size());
 
-			if (materialTexture_uids.size() != 0)
-			{
-				//Push textures.
-				encodeTexturesBackend(geometryStreamingService, materialTexture_uids);
-			}
+	// Actual size is now known so update payload size
+	putPayloadSize();
 
-			//Flag we have encoded the material.
-			geometryStreamingService->encodedResource(uid);
-		}
+	if (materialTexture_uids.size() != 0)
+	{
+		//Push textures.
+		encodeTexturesBackend(geometryStreamingService, materialTexture_uids);
 	}
 
+	//Flag we have encoded the material.
+	encodedResource(uid);
+
 	return avs::Result::OK;
 }
 
@@ -882,7 +953,7 @@ avs::Result GeometryEncoder::encodeTexturesBackend(avs::GeometryRequesterBackend
 			putPayloadSize();
 
 			//Flag we have encoded the texture.
-			geometryStreamingService->encodedResource(uid);
+			encodedResource(uid);
 		}
 		else
 		{
@@ -944,28 +1015,25 @@ size_t GeometryEncoder::put(const uint8_t* data, size_t count)
 
 bool GeometryEncoder::attemptQueueData()
 {
-	//If queueing the data will cause the queuedBuffer to exceed the cutoff size.
-	if (buffer.size() + queuedBuffer.size() > settings->geometryBufferCutoffSize)
+	if (!pendingPayload)
+		return true;
+	size_t pendingSize = pendingPayload->size();
+	//If queueing the data will cause the queue to exceed the cutoff size.
+	if (pendingSize + queuedSize > settings->geometryBufferCutoffSize)
 	{
-		//Never leave queuedBuffer empty, if there is something to queue up (even if it is too large).
-		if (queuedBuffer.size() == 0)
+		//Never leave the queue empty, if there is something to queue up (even if it is too large).
+		if (queuedPayloads.empty())
 		{
-			size_t position = queuedBuffer.size();
-			queuedBuffer.resize(queuedBuffer.size() + buffer.size());
-
-			memcpy(queuedBuffer.data() + position, buffer.data(), buffer.size());
-			buffer.clear();
+			queuedPayloads.push_back(std::move(pendingPayload));
+			queuedSize += pendingSize;
 		}
 
 		return false;
 	}
 	else
 	{
-		size_t position = queuedBuffer.size();
-		queuedBuffer.resize(queuedBuffer.size() + buffer.size());
-
-		memcpy(queuedBuffer.data() + position, buffer.data(), buffer.size());
-		buffer.clear();
+		queuedPayloads.push_back(std::move(pendingPayload));
+		queuedSize += pendingSize;
 
 		return true;
 	}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include "libavstream/geometry/mesh_interface.hpp"
 
 namespace avs
@@ -29,9 +32,17 @@ namespace teleport
 			avs::Result mapOutputBuffer(void*& bufferPtr, size_t& bufferSizeInBytes) override;
 			avs::Result unmapOutputBuffer() override;
 			void setMinimumPriority(int32_t) override;
+
+			//! Set the number of threads that encode payloads concurrently, shared by all clients' encoders.
+			//! 1 encodes on the streaming thread only; 0 uses the default for this machine.
+			static void SetEncodeThreadCount(size_t n);
 		protected:
+			typedef std::shared_ptr<const std::vector<char>> Payload;
 			std::vector<char> buffer;			//Buffer used to encode data before checking it can be sent.
-			std::vector<char> queuedBuffer;		//Buffer given to the pipeline to be sent to the client.
+			Payload pendingPayload;				//Payload that did not fit last time, to be queued first next time.
+			std::vector<Payload> queuedPayloads;	//Payloads to be given to the pipeline to be sent to the client, in order.
+			size_t queuedSize = 0;				//Total size of queuedPayloads in bytes.
+			std::vector<char> queuedBuffer;		//Only used to join queuedPayloads when there is more than one.
 			template<typename T> size_t put(const T& data)
 			{
 				size_t pos = buffer.size();
@@ -48,15 +59,33 @@ namespace teleport
 			const struct ServerSettings* settings;
 			size_t prevBufferSize;
 			int32_t minimumPriority = 0;
+			//! One resource payload to encode. Jobs are gathered in the order the client needs them (e.g. mesh before node,
+			//! material before its textures), encoded independently of each other, then queued in that same order.
+			struct EncodeJob
+			{
+				avs::GeometryPayloadType type = avs::GeometryPayloadType::Invalid;
+				avs::uid uid = 0;
+				std::vector<avs::uid> textureUids;	//For materials: the textures to package along with the material.
+				Payload payload;					//The encoded payload(s), which may be shared with the encoded-resource cache.
+				std::vector<avs::uid> encodedUids;	//Resources this job encoded, to be flagged once it is queued.
+			};
+			//Resources encoded into buffer since the last call to encodeJob.
+			std::vector<avs::uid> encodedUids;
 			void putPayload(avs::GeometryPayloadType t);
 			void putPayloadSize();
+			void encodedResource(avs::uid uid);
+
+			//Lists, in dependency order, the resources that the client needs and has not yet been sent.
+			void gatherEncodeJobs(std::vector<EncodeJob>& jobs) const;
+			//Encodes a single job into its own buffer. Safe to call concurrently for different jobs.
+			void encodeJob(EncodeJob& job) const;
 
 			//Following functions push the data from the source onto the buffer, depending on what the requester needs.
 			//	src : Source we are taking the data from.
 			//	req : Object that defines what needs to transfered across.
 			//Returns a code to determine how the encoding went.
 			avs::Result encodeAnimation(avs::GeometryRequesterBackendInterface* req, avs::uid animationID);
-			avs::Result encodeMaterials(avs::GeometryRequesterBackendInterface* req, std::vector<avs::uid> missingUIDs);
+			avs::Result encodeMaterial(avs::uid uid, const std::vector<avs::uid>& materialTexture_uids);
 			avs::Result encodeMeshes(avs::GeometryRequesterBackendInterface* req, std::vector<avs::uid> missingUIDs);
 			avs::Result encodeNodes(avs::GeometryRequesterBackendInterface* req, std::vector<avs::uid> missingUIDs);
 			avs::Result encodeShadowMaps(avs::GeometryRequesterBackendInterface* req, std::vector<avs::uid> missingUIDs);
@@ -72,9 +101,9 @@ namespace teleport
 
 			avs::Result encodeFontAtlas(avs::uid u);
 			avs::Result encodeTextCanvas(avs::uid u);
-			//Moves the data from buffer into queuedBuffer; keeping in mind the recommended buffer cutoff size.
+			//Moves pendingPayload onto queuedPayloads; keeping in mind the recommended buffer cutoff size.
 			//Data will usually not be queued if it would cause it to exceed the recommended size, but the data may have been queued anyway.
-			//This happens when not queueing it would have left queuedBuffer empty.
+			//This happens when not queueing it would have left queuedPayloads empty.
 			//Returns whether the queue attempt did not exceed the recommended buffer size.
 			bool attemptQueueData();
 		};
@@ -4,8 +4,11 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 #include <algorithm>
+#include <tuple>
+#include <unordered_set>
 
 #if defined ( _WIN32 )
 #include <sys/stat.h>
@@ -22,6 +25,8 @@
 
 #include "Platform/Shaders/SL/CppSl.sl"
 #include "Font.h"
+#include "ResourcePack.h"
+#include "TeleportCore/ThreadPool.h"
 #include "UnityPlugin/InteropStructures.h"
 
 using namespace std::string_literals;
@@ -70,30 +75,15 @@ static std::string guid_to_bstr(const avs::guid &g)
 	return b;
 }
 
-template<class T>
-std::vector<avs::uid> getVectorOfIDs(const std::map<avs::uid, T>& resourceMap)
+template<class T> T* getResource(FlatResourceMap<T>& resourceMap, avs::uid id)
 {
-	std::vector<avs::uid> ids(resourceMap.size());
-
-	size_t i = 0;
-	for(const auto& it : resourceMap)
-	{
-		ids[i++] = it.first;
-	}
-	return ids;
-}
-
-template<class T> T* getResource(std::map<avs::uid, T>& resourceMap, avs::uid id)
-{
-	auto resource = resourceMap.find(id);
-	return (resource != resourceMap.end()) ? &resource->second : nullptr;
+	return resourceMap.find(id);
 }
 
 //Const version.
-template<class T> const T* getResource(const std::map<avs::uid, T>& resourceMap, avs::uid id)
+template<class T> const T* getResource(const FlatResourceMap<T>& resourceMap, avs::uid id)
 {
-	auto resource = resourceMap.find(id);
-	return (resource != resourceMap.end()) ? &resource->second : nullptr;
+	return resourceMap.find(id);
 }
 
 std::time_t GetFileWriteTime(const std::filesystem::path& filename)
@@ -141,10 +131,16 @@ GeometryStore::GeometryStore()
 	
 	uid_to_path[0]=".";
 	path_to_uid["."]=0;
+	encodedResourceStats.maxBytes = 256 * 1024 * 1024;
+	// Each texture's compression is itself multithreaded, so a few textures at a time is enough to keep the cores busy.
+	textureCompressionThreadCount = std::max(core::ThreadPool::GetDefaultThreadCount() / 4, (size_t)1);
 }
 
 GeometryStore::~GeometryStore()
 {
+	// Stop the compression workers before the queue they take from is destroyed.
+	setTextureCompressionThreadCount(0);
+	meshCompressionPool.reset();
 }
  GeometryStore &GeometryStore::GetInstance()
  {
@@ -154,14 +150,15 @@ GeometryStore::~GeometryStore()
 
 bool GeometryStore::saveToDisk() const
 {
-	if(!saveResources(cachePath + "/" , textures))
+	if(!savePack(cachePath + "/textures.pack" , textures))
 		return false;
-	if(!saveResources(cachePath + "/" , materials))
+	if(!savePack(cachePath + "/materials.pack" , materials))
 		return false;
-	if(!saveResources(cachePath + "/engineering/" , meshes.at(avs::AxesStandard::EngineeringStyle)))
+	if(!savePack(cachePath + "/engineering/meshes.pack" , meshes.at(avs::AxesStandard::EngineeringStyle)))
 		return false;
-	if(!saveResources(cachePath + "/gl/" , meshes.at(avs::AxesStandard::GlStyle)))
+	if(!savePack(cachePath + "/gl/meshes.pack" , meshes.at(avs::AxesStandard::GlStyle)))
 		return false;
+	unsavedResources.clear();
 	return true;
 }
 
@@ -185,10 +182,16 @@ void GeometryStore::loadFromDisk(size_t& numMeshes
 	,LoadedResource*& loadedMaterials)
 {
 	// Load in order of non-dependent to dependent resources, so that we can apply dependencies.
-	loadResources(cachePath + "/" , textures);
-	loadResources(cachePath + "/" , materials);
-	loadResources(cachePath + "/engineering/" , meshes.at(avs::AxesStandard::EngineeringStyle));
-	loadResources(cachePath + "/gl/", meshes.at(avs::AxesStandard::GlStyle));
+	// Caches saved before resource packs were used have one file per resource; these are packed on the next save.
+	core::ThreadPool loadThreadPool;
+	if(!loadPack(loadThreadPool, cachePath + "/textures.pack" , textures))
+		loadResources(cachePath + "/" , textures);
+	if(!loadPack(loadThreadPool, cachePath + "/materials.pack" , materials))
+		loadResources(cachePath + "/" , materials);
+	if(!loadPack(loadThreadPool, cachePath + "/engineering/meshes.pack" , meshes.at(avs::AxesStandard::EngineeringStyle)))
+		loadResources(cachePath + "/engineering/" , meshes.at(avs::AxesStandard::EngineeringStyle));
+	if(!loadPack(loadThreadPool, cachePath + "/gl/meshes.pack" , meshes.at(avs::AxesStandard::GlStyle)))
+		loadResources(cachePath + "/gl/", meshes.at(avs::AxesStandard::GlStyle));
 	
 	// Now fill in the return values.
 	numMeshes = meshes.at(avs::AxesStandard::EngineeringStyle).size();
@@ -241,6 +244,14 @@ void GeometryStore::loadFromDisk(size_t& numMeshes
 
 void GeometryStore::clear(bool freeMeshBuffers)
 {
+	// Mesh compression reads the mesh buffers, so it must finish before they are freed. Its results are discarded.
+	{
+		std::unique_lock<std::mutex> lock(meshCompressionMutex);
+		meshCompressionGeneration++;
+		meshCompressionCondition.wait(lock, [this]() { return meshCompressionJobsInProgress == 0; });
+		compressedMeshes.clear();
+	}
+	meshStoreSequences.clear();
 	//Free memory for primitive attributes and geometry buffers.
 	for(auto& standardPair : meshes)
 	{
@@ -275,7 +286,10 @@ void GeometryStore::clear(bool freeMeshBuffers)
 	}
 
 	//Clear lookup tables; we want to clear the resources inside them, not their structure.
-	nodes.clear();
+	{
+		std::lock_guard<std::mutex> lock(nodeMutex);
+		nodes.clear();
+	}
 	skins[avs::AxesStandard::EngineeringStyle].clear();
 	skins[avs::AxesStandard::GlStyle].clear();
 	animations[avs::AxesStandard::EngineeringStyle].clear();
@@ -286,8 +300,18 @@ void GeometryStore::clear(bool freeMeshBuffers)
 	textures.clear();
 	shadowMaps.clear();
 
-	texturesToCompress.clear();
+	{
+		// Textures being compressed now are discarded when they finish.
+		std::lock_guard<std::mutex> lock(textureCompressionMutex);
+		texturesToCompress.clear();
+		texturesWaitedFor.clear();
+		compressedTextures.clear();
+		numTexturesToCompress=0;
+		textureCompressionGeneration++;
+	}
 	lightNodes.clear();
+	clearEncodedResources();
+	unsavedResources.clear();
 	std::filesystem::path p(cachePath);
 	for (auto const& dir_entry : std::filesystem::directory_iterator(p))
 	{
@@ -306,9 +330,9 @@ const char* GeometryStore::getNodeName(avs::uid nodeID) const
 	return node ? node->name.c_str() : "NULL";
 }
 
-std::vector<avs::uid> GeometryStore::getNodeIDs() const
+UidSpan GeometryStore::getNodeIDs() const
 {
-	return getVectorOfIDs(nodes);
+	return nodes.getIDs();
 }
 
 avs::Node* GeometryStore::getNode(avs::uid nodeID)
@@ -321,7 +345,7 @@ const avs::Node* GeometryStore::getNode(avs::uid nodeID) const
 	return getResource(nodes, nodeID);
 }
 
-const std::map<avs::uid, avs::Node>& GeometryStore::getNodes() const
+const FlatResourceMap<avs::Node>& GeometryStore::getNodes() const
 {
 	return nodes;
 }
@@ -346,10 +370,10 @@ const avs::Animation* GeometryStore::getAnimation(avs::uid id, avs::AxesStandard
 	return getResource(animations.at(standard), id);
 }
 
-std::vector<avs::uid> GeometryStore::getMeshIDs() const
+UidSpan GeometryStore::getMeshIDs() const
 {
 	//Every mesh map should be identical, so we just use the engineering style.
-	return getVectorOfIDs(meshes.at(avs::AxesStandard::EngineeringStyle));
+	return meshes.at(avs::AxesStandard::EngineeringStyle).getIDs();
 }
 const ExtractedMesh* GeometryStore::getExtractedMesh(avs::uid meshID, avs::AxesStandard standard) const
 {
@@ -375,9 +399,9 @@ const avs::Mesh* GeometryStore::getMesh(avs::uid meshID, avs::AxesStandard stand
 	return (meshData ? &meshData->mesh : nullptr);
 }
 
-std::vector<avs::uid> GeometryStore::getTextureIDs() const
+UidSpan GeometryStore::getTextureIDs() const
 {
-	return getVectorOfIDs(textures);
+	return textures.getIDs();
 }
 
 avs::Texture* GeometryStore::getTexture(avs::uid textureID)
@@ -392,9 +416,9 @@ const avs::Texture* GeometryStore::getTexture(avs::uid textureID) const
 	return (textureData ? &textureData->texture : nullptr);
 }
 
-std::vector<avs::uid> GeometryStore::getMaterialIDs() const
+UidSpan GeometryStore::getMaterialIDs() const
 {
-	return getVectorOfIDs(materials);
+	return materials.getIDs();
 }
 
 avs::Material* GeometryStore::getMaterial(avs::uid materialID)
@@ -409,9 +433,9 @@ const avs::Material* GeometryStore::getMaterial(avs::uid materialID) const
 	return materialData ? &materialData->material : nullptr;
 }
 
-std::vector<avs::uid> GeometryStore::getShadowMapIDs() const
+UidSpan GeometryStore::getShadowMapIDs() const
 {
-	return getVectorOfIDs(shadowMaps);
+	return shadowMaps.getIDs();
 }
 
 avs::Texture* GeometryStore::getShadowMap(avs::uid shadowID)
@@ -449,53 +473,68 @@ const std::map<avs::uid,avs::LightNodeResources>& GeometryStore::getLightNodes()
 
 bool GeometryStore::hasNode(avs::uid id) const
 {
-	return nodes.find(id) != nodes.end();
+	return nodes.contains(id);
 }
 
 bool GeometryStore::hasMesh(avs::uid id) const
 {
-	return meshes.at(avs::AxesStandard::EngineeringStyle).find(id) != meshes.at(avs::AxesStandard::EngineeringStyle).end();
+	return meshes.at(avs::AxesStandard::EngineeringStyle).contains(id);
 }
 
 bool GeometryStore::hasMaterial(avs::uid id) const
 {
-	return materials.find(id) != materials.end();
+	return materials.contains(id);
 }
 
 bool GeometryStore::hasTexture(avs::uid id) const
 {
-	return textures.find(id) != textures.end();
+	return textures.contains(id);
 }
 
 bool GeometryStore::hasShadowMap(avs::uid id) const
 {
-	return shadowMaps.find(id) != shadowMaps.end();
+	return shadowMaps.contains(id);
 }
 
 void GeometryStore::storeNode(avs::uid id, avs::Node& newNode)
 {
-	nodes[id] = newNode;
-	if (newNode.parentID != 0)
+	// The parent and children are linked under the lock too, as the encoder threads copy their lists of children.
+	std::vector<avs::uid> relinked;
 	{
-		avs::Node* parent = getNode(newNode.parentID);
-		if (parent)
+		std::lock_guard<std::mutex> lock(nodeMutex);
+		nodes[id] = newNode;
+		if (newNode.parentID != 0)
 		{
-			if (std::find(parent->childrenIDs.begin(), parent->childrenIDs.end(),id) == parent->childrenIDs.end())
-				parent->childrenIDs.push_back(id);
+			avs::Node* parent = nodes.find(newNode.parentID);
+			if (parent)
+			{
+				if (std::find(parent->childrenIDs.begin(), parent->childrenIDs.end(),id) == parent->childrenIDs.end())
+				{
+					parent->childrenIDs.push_back(id);
+					relinked.push_back(newNode.parentID);
+				}
+			}
 		}
-	}
-	for(auto c:newNode.childrenIDs)
-	{
-		avs::Node* child = getNode(c);
-		if (child)
+		for(auto c:newNode.childrenIDs)
 		{
-			if (child->parentID != 0 && child->parentID != id)
+			avs::Node* child = nodes.find(c);
+			if (child)
 			{
-				TELEPORT_CERR << "Changing parent of " << child->name.c_str() << " to " << newNode.name.c_str() << "\n";
+				if (child->parentID != 0 && child->parentID != id)
+				{
+					TELEPORT_CERR << "Changing parent of " << child->name.c_str() << " to " << newNode.name.c_str() << "\n";
+				}
+				if (child->parentID != id)
+				{
+					child->parentID = id;
+					relinked.push_back(c);
+				}
 			}
-			child->parentID = id;
 		}
 	}
+	invalidateEncodedResource(id);
+	for(avs::uid u:relinked)
+		invalidateEncodedResource(u);
 	if(newNode.data_type == avs::NodeDataType::Light)
 	{
 		lightNodes[id]=avs::LightNodeResources{id, newNode.data_uid};
@@ -570,11 +609,8 @@ draco::GeometryAttribute::Type ToDracoGeometryAttribute(avs::AttributeSemantic a
 	return draco::GeometryAttribute::Type::INVALID;
 }
 
-static bool CompressMesh(avs::CompressedMesh &compressedMesh,avs::Mesh &sourceMesh)
+static void SetDracoEncoderOptions(draco::Encoder &dracoEncoder)
 {
-	compressedMesh.meshCompressionType = avs::MeshCompressionType::NONE;
-	compressedMesh.name=sourceMesh.name;
-	draco::Encoder dracoEncoder;
 	static int encode_speed=3, decode_speed =7;
 	static int pos_quantization=11;
 	static int normal_quantization = 8;
@@ -592,127 +628,144 @@ static bool CompressMesh(avs::CompressedMesh &compressedMesh,avs::Mesh &sourceMe
 		dracoEncoder.SetEncodingMethod(draco::MESH_EDGEBREAKER_ENCODING);
 	else
 		dracoEncoder.SetEncodingMethod(draco::MESH_SEQUENTIAL_ENCODING);
-	size_t sourceSize=0;
-	size_t compressedSize = 0;
-	// create zero-based material indices:
-	compressedMesh.subMeshes.resize(sourceMesh.primitiveArrays.size());
-	// Primitive array elements in each mesh.
-	draco::FaceIndex face_index(0);
+}
+
+// Work out what each primitive needs to be compressed independently of the others:
+// the semantics of the attribute accessors seen up to and including that primitive, and the index of its first face,
+// which carries on from the previous primitive.
+// Fails if two primitives use the same accessor with different semantics.
+static bool PrepareMeshCompression(const avs::Mesh &sourceMesh,std::vector<std::map<avs::uid, avs::AttributeSemantic>> &primitiveSemantics,std::vector<uint32_t> &primitiveFirstFace)
+{
+	primitiveSemantics.resize(sourceMesh.primitiveArrays.size());
+	primitiveFirstFace.resize(sourceMesh.primitiveArrays.size());
 	std::map<avs::uid, avs::AttributeSemantic> attributeSemantics;
+	uint32_t face_index=0;
 	for (size_t i=0;i<sourceMesh.primitiveArrays.size();i++)
 	{
 		const auto& primitive = sourceMesh.primitiveArrays[i];
-		auto &subMesh= compressedMesh.subMeshes[i];
-		const avs::Accessor& indices_accessor = sourceMesh.accessors[primitive.indices_accessor];
-		
-		subMesh.material=primitive.material;
-		subMesh.indices_accessor=primitive.indices_accessor;
-		subMesh.first_index= 0;
-		subMesh.num_indices = (uint32_t)indices_accessor.count;
-		size_t numTriangles = indices_accessor.count / 3;
-	
-		draco::Mesh dracoMesh;
-		draco::EncoderBuffer dracoEncoderBuffer;
-		size_t numVertices = 0;
+		auto indices_accessor = sourceMesh.accessors.find(primitive.indices_accessor);
+		if(indices_accessor==sourceMesh.accessors.end())
+		{
+			TELEPORT_CERR<<"Missing index accessor, can't compress this: "<<sourceMesh.name.c_str()<<"\n";
+			return false;
+		}
 		for (size_t j = 0; j < primitive.attributeCount; j++)
 		{
 			const avs::Attribute& attrib = primitive.attributes[j];
-			const auto &attrib_accessor=sourceMesh.accessors[attrib.accessor];
-			numVertices=std::max(numVertices, attrib_accessor.count);
 			auto s=attributeSemantics.find(attrib.accessor);
 			if(s==attributeSemantics.end())
 				attributeSemantics[attrib.accessor]=attrib.semantic;
-			 if(attrib.semantic!= attributeSemantics[attrib.accessor])
+			else if(attrib.semantic!=s->second)
 			{
 				TELEPORT_CERR<<"Different attributes for submeshes, can't compress this: "<<sourceMesh.name.c_str()<<"\n";
 				return false;
 			}
 		}
-		dracoMesh.set_num_points((uint32_t)numVertices);
-		dracoMesh.SetNumFaces(numTriangles);
-		for (const auto& a : sourceMesh.accessors)
-		{
-			const auto &accessor=a.second;
-			draco::DataType dracoDataType = ToDracoDataType(accessor.componentType);
-			auto s = attributeSemantics.find(a.first);
-			if (s == attributeSemantics.end())
-				continue;	// not an attribute.
-			auto semantic=s->second;
-			draco::GeometryAttribute::Type dracoGeometryAttributeType = ToDracoGeometryAttribute(semantic);
-			
-			avs::BufferView& bufferView = sourceMesh.bufferViews[accessor.bufferView];
-			avs::GeometryBuffer& geometryBuffer = sourceMesh.buffers[bufferView.buffer];
-			const uint8_t* data = geometryBuffer.data + bufferView.byteOffset;
-			// Naively convert enum to integer.
-			int8_t num_components = (int8_t)accessor.type;	
-			int att_id = -1;
-			draco::PointAttribute* attr = nullptr;
-			draco::GeometryAttribute dracoGeometryAttribute;
-			size_t stride = draco::DataTypeLength(dracoDataType) * num_components;
-			dracoGeometryAttribute.Init(dracoGeometryAttributeType, nullptr, num_components, dracoDataType, semantic == avs::AttributeSemantic::NORMAL, stride, 0);
-			att_id = dracoMesh.AddAttribute(dracoGeometryAttribute, true, (uint32_t)(geometryBuffer.byteLength / stride));
-			subMesh.attributeSemantics[att_id]=semantic;
-			attr = dracoMesh.attribute(att_id);
-			for (size_t j = 0; j < accessor.count; j++)
-			{
-				attr->SetAttributeValue(draco::AttributeValueIndex((uint32_t)j), data + j * bufferView.byteStride);
-			}
-			sourceSize += bufferView.byteLength;
-		}
-		//Indices
-		const avs::BufferView& indicesBufferView = sourceMesh.bufferViews[indices_accessor.bufferView];
-		sourceSize += indicesBufferView.byteLength;
-		const avs::GeometryBuffer& indicesBuffer = sourceMesh.buffers[indicesBufferView.buffer];
-		size_t componentSize = avs::GetComponentSize(indices_accessor.componentType);
-		size_t triangleCount= indices_accessor.count / 3;
-		if(indicesBufferView.byteStride==4)
-		{
-			uint32_t* data=(uint32_t*)(indicesBuffer.data + indicesBufferView.byteOffset+ indices_accessor.byteOffset);
-			for(size_t j=0;j< triangleCount;j++)
-			{
-				draco::Mesh::Face dracoMeshFace;
-				for(int k=0;k<3;k++)
-					dracoMeshFace[k]= data[j*3+k];
-				dracoMesh.SetFace(face_index,dracoMeshFace);
-				++face_index;
-			}
-		}
-		else if (indicesBufferView.byteStride == 2)
+		primitiveSemantics[i]=attributeSemantics;
+		primitiveFirstFace[i]=face_index;
+		face_index+=(uint32_t)(indices_accessor->second.count / 3);
+	}
+	return true;
+}
+
+// Compress primitive i of the mesh with Draco. Primitives can be compressed concurrently, as the source mesh is only read.
+static bool CompressMeshPrimitive(const avs::Mesh &sourceMesh,size_t i,const std::map<avs::uid, avs::AttributeSemantic> &attributeSemantics,uint32_t firstFace,avs::CompressedSubMesh &subMesh,size_t &sourceSize)
+{
+	draco::Encoder dracoEncoder;
+	SetDracoEncoderOptions(dracoEncoder);
+	const auto& primitive = sourceMesh.primitiveArrays[i];
+	const avs::Accessor& indices_accessor = sourceMesh.accessors.at(primitive.indices_accessor);
+	
+	subMesh.material=primitive.material;
+	subMesh.indices_accessor=primitive.indices_accessor;
+	subMesh.first_index= 0;
+	subMesh.num_indices = (uint32_t)indices_accessor.count;
+	size_t numTriangles = indices_accessor.count / 3;
+
+	draco::Mesh dracoMesh;
+	draco::EncoderBuffer dracoEncoderBuffer;
+	draco::FaceIndex face_index(firstFace);
+	size_t numVertices = 0;
+	for (size_t j = 0; j < primitive.attributeCount; j++)
+	{
+		const avs::Attribute& attrib = primitive.attributes[j];
+		const auto &attrib_accessor=sourceMesh.accessors.at(attrib.accessor);
+		numVertices=std::max(numVertices, attrib_accessor.count);
+	}
+	dracoMesh.set_num_points((uint32_t)numVertices);
+	dracoMesh.SetNumFaces(numTriangles);
+	for (const auto& a : sourceMesh.accessors)
+	{
+		const auto &accessor=a.second;
+		draco::DataType dracoDataType = ToDracoDataType(accessor.componentType);
+		auto s = attributeSemantics.find(a.first);
+		if (s == attributeSemantics.end())
+			continue;	// not an attribute.
+		auto semantic=s->second;
+		draco::GeometryAttribute::Type dracoGeometryAttributeType = ToDracoGeometryAttribute(semantic);
+		
+		const avs::BufferView& bufferView = sourceMesh.bufferViews.at(accessor.bufferView);
+		const avs::GeometryBuffer& geometryBuffer = sourceMesh.buffers.at(bufferView.buffer);
+		const uint8_t* data = geometryBuffer.data + bufferView.byteOffset;
+		// Naively convert enum to integer.
+		int8_t num_components = (int8_t)accessor.type;	
+		int att_id = -1;
+		draco::PointAttribute* attr = nullptr;
+		draco::GeometryAttribute dracoGeometryAttribute;
+		size_t stride = draco::DataTypeLength(dracoDataType) * num_components;
+		dracoGeometryAttribute.Init(dracoGeometryAttributeType, nullptr, num_components, dracoDataType, semantic == avs::AttributeSemantic::NORMAL, stride, 0);
+		att_id = dracoMesh.AddAttribute(dracoGeometryAttribute, true, (uint32_t)(geometryBuffer.byteLength / stride));
+		subMesh.attributeSemantics[att_id]=semantic;
+		attr = dracoMesh.attribute(att_id);
+		for (size_t j = 0; j < accessor.count; j++)
 		{
-			uint16_t* data = (uint16_t*)(indicesBuffer.data + indicesBufferView.byteOffset + indices_accessor.byteOffset);
-			for (size_t j = 0; j < triangleCount; j++)
-			{
-				draco::Mesh::Face dracoMeshFace;
-				for (int k = 0; k < 3; k++)
-					dracoMeshFace[k] = data[j * 3 + k];
-				dracoMesh.SetFace(face_index, dracoMeshFace);
-				++face_index;
-			}
+			attr->SetAttributeValue(draco::AttributeValueIndex((uint32_t)j), data + j * bufferView.byteStride);
 		}
-		else
+		sourceSize += bufferView.byteLength;
+	}
+	//Indices
+	const avs::BufferView& indicesBufferView = sourceMesh.bufferViews.at(indices_accessor.bufferView);
+	sourceSize += indicesBufferView.byteLength;
+	const avs::GeometryBuffer& indicesBuffer = sourceMesh.buffers.at(indicesBufferView.buffer);
+	size_t triangleCount= indices_accessor.count / 3;
+	if(indicesBufferView.byteStride==4)
+	{
+		uint32_t* data=(uint32_t*)(indicesBuffer.data + indicesBufferView.byteOffset+ indices_accessor.byteOffset);
+		for(size_t j=0;j< triangleCount;j++)
 		{
-			TELEPORT_ASSERT(false);
+			draco::Mesh::Face dracoMeshFace;
+			for(int k=0;k<3;k++)
+				dracoMeshFace[k]= data[j*3+k];
+			dracoMesh.SetFace(face_index,dracoMeshFace);
+			++face_index;
 		}
-		//dracoMesh.DeduplicateAttributeValues();
-		//dracoMesh.DeduplicatePointIds();
-		draco::Status status= dracoEncoder.EncodeMeshToBuffer(dracoMesh,&dracoEncoderBuffer);
-		if(!status.ok())
+	}
+	else if (indicesBufferView.byteStride == 2)
+	{
+		uint16_t* data = (uint16_t*)(indicesBuffer.data + indicesBufferView.byteOffset + indices_accessor.byteOffset);
+		for (size_t j = 0; j < triangleCount; j++)
 		{
-			TELEPORT_INTERNAL_LOG_UNSAFE("dracoEncoder failed\n");
-			return false;
+			draco::Mesh::Face dracoMeshFace;
+			for (int k = 0; k < 3; k++)
+				dracoMeshFace[k] = data[j * 3 + k];
+			dracoMesh.SetFace(face_index, dracoMeshFace);
+			++face_index;
 		}
-		subMesh.buffer.resize(dracoEncoderBuffer.size());
-		memcpy(subMesh.buffer.data(), dracoEncoderBuffer.data(), subMesh.buffer.size());
-		compressedSize+= subMesh.buffer.size();
-	}
-	TELEPORT_INTERNAL_COUT("Compressed {0} from {1} to {2}\n",sourceMesh.name.c_str(),(sourceSize+1023)/1024,(compressedSize +1023)/1024);
-	compressedMesh.meshCompressionType=avs::MeshCompressionType::DRACO;
-/*
-	draco::Decoder dracoDecoder;
-	draco::DecoderBuffer dracoDecoderBuffer;
-	dracoDecoderBuffer.Init((const char*)dracoEncoderBuffer.data(), dracoEncoderBuffer.size());
-	draco::Mesh dracoMesh2;
-	dracoDecoder.DecodeBufferToGeometry(&dracoDecoderBuffer,&dracoMesh2);*/
+	}
+	else
+	{
+		TELEPORT_ASSERT(false);
+	}
+	//dracoMesh.DeduplicateAttributeValues();
+	//dracoMesh.DeduplicatePointIds();
+	draco::Status status= dracoEncoder.EncodeMeshToBuffer(dracoMesh,&dracoEncoderBuffer);
+	if(!status.ok())
+	{
+		TELEPORT_INTERNAL_LOG_UNSAFE("dracoEncoder failed\n");
+		return false;
+	}
+	subMesh.buffer.resize(dracoEncoderBuffer.size());
+	memcpy(subMesh.buffer.data(), dracoEncoderBuffer.data(), subMesh.buffer.size());
 	return true;
 }
 
@@ -770,11 +823,10 @@ template<int n> bool IntCompare(const int*a,const int*b)
 	return true;
 }
 
-static bool VerifyCompressedMesh(avs::CompressedMesh& compressedMesh,const avs::Mesh& sourceMesh)
+// Decode compressed submesh i, and compare it with primitive i of the source mesh.
+static bool VerifyCompressedSubMesh(avs::CompressedSubMesh& subMesh,const avs::Mesh& sourceMesh,size_t i)
 {
-	for(int i=0;i<compressedMesh.subMeshes.size();i++)
 	{
-		auto &subMesh=compressedMesh.subMeshes[i];
 		draco::Decoder dracoDecoder;
 		draco::DecoderBuffer dracoDecoderBuffer;
 		dracoDecoderBuffer.Init((const char*)subMesh.buffer.data(), subMesh.buffer.size());
@@ -968,11 +1020,90 @@ public:
 	}
 };
 
+// Serializes a resource to memory, in the same form as resource_ofstream writes to a file.
+class resource_owstringstream:public std::wostringstream
+{
+protected:
+	std::function<std::string(avs::uid)> uid_to_path;
+public:
+	resource_owstringstream(std::function<std::string(avs::uid)> f)
+		:std::wostringstream(std::wostringstream::out | std::wostringstream::binary)
+		,uid_to_path(f)
+	{
+	}
+	friend resource_owstringstream& operator<<(resource_owstringstream& stream, avs::uid u)
+	{
+		if(!u)
+		{
+			stream<<L". ";
+		}
+		else
+		{
+			std::string p=stream.uid_to_path(u);
+			std::replace(p.begin(),p.end(),' ','%');
+			std::replace(p.begin(),p.end(),'\\','/');
+			std::wstring w=StringToWString(p);
+			stream<<w.c_str()<<L" ";
+		}
+		return stream;
+	}
+};
+
 void standardize_path(std::string &p)
 {
 	std::replace(p.begin(),p.end(),' ','%');
 }
 
+// Widens each byte of a memory block to a wchar_t as it is read, as the default codecvt of a resource_ifstream does.
+class widening_streambuf:public std::wstreambuf
+{
+	const uint8_t *next;
+	const uint8_t *end;
+	wchar_t buffer[4096];
+protected:
+	int_type underflow() override
+	{
+		if(next>=end)
+			return traits_type::eof();
+		size_t n=std::min((size_t)(end-next),sizeof(buffer)/sizeof(wchar_t));
+		for(size_t i=0;i<n;i++)
+			buffer[i]=(wchar_t)next[i];
+		next+=n;
+		setg(buffer,buffer,buffer+n);
+		return traits_type::to_int_type(buffer[0]);
+	}
+public:
+	widening_streambuf(const uint8_t *data,size_t size)
+		:next(data),end(data+size)
+	{
+	}
+};
+
+// Reads a resource from memory, such as a record in a mapped resource pack.
+class resource_imemstream:public std::wistream
+{
+protected:
+	widening_streambuf buffer;
+	std::function<avs::uid(std::string)> path_to_uid;
+public:
+	resource_imemstream(const uint8_t *data,size_t size,std::function<avs::uid(std::string)> f)
+		:std::wistream(nullptr)
+		,buffer(data,size)
+		,path_to_uid(f)
+	{
+		rdbuf(&buffer);
+	}
+	friend resource_imemstream& operator>>(resource_imemstream& stream, avs::uid &u)
+	{
+		std::wstring w;
+		stream>>w;
+		std::string p = WStringToString(w);
+		standardize_path(p);
+		u=stream.path_to_uid(p);
+		return stream;
+	}
+};
+
 class resource_ifstream:public std::wifstream
 {
 protected:
@@ -1001,25 +1132,141 @@ void GeometryStore::storeMesh(avs::uid id, std::string guid, std::string path,st
 	uid_to_path[id]=p;
 	path_to_uid[p]=id;
 	auto &mesh=meshes[standard][id] = ExtractedMesh{guid, path, lastModified, newMesh};
+	// Until compression finishes, the mesh is sent uncompressed.
+	mesh.compressedMesh.meshCompressionType = avs::MeshCompressionType::NONE;
+	mesh.compressedMesh.name = newMesh.name;
+	// Compression of any earlier version of this mesh is now out of date.
+	uint64_t storeSequence = ++meshStoreSequence;
+	meshStoreSequences[{standard, id}] = storeSequence;
+	invalidateEncodedResource(id);
+	unsavedResources.insert(id);
 	if(compress)
+		compressMeshAsync(id, standard, mesh.mesh, storeSequence, verify);
+}
+
+void GeometryStore::storeMeshes(const std::vector<avs::uid>& ids, const std::vector<std::string>& guids, const std::vector<std::string>& paths, const std::vector<std::time_t>& lastModified, std::vector<avs::Mesh>& newMeshes, avs::AxesStandard standard, bool compress, bool verify)
+{
+	size_t count = std::min({ids.size(), guids.size(), paths.size(), lastModified.size(), newMeshes.size()});
+	meshes[standard].reserve(meshes[standard].size() + count);
+	// Each mesh's primitives are queued for compression as it is stored, so all of them are compressed together across the workers.
+	for(size_t i = 0; i < count; i++)
+		storeMesh(ids[i], guids[i], paths[i], lastModified[i], newMeshes[i], standard, compress, verify);
+}
+
+void GeometryStore::compressMeshAsync(avs::uid id, avs::AxesStandard standard, const avs::Mesh& mesh, uint64_t storeSequence, bool verify)
+{
+	auto job = std::make_shared<MeshCompressionJob>();
+	job->uid = id;
+	job->standard = standard;
+	job->storeSequence = storeSequence;
+	job->verify = verify;
+	job->sourceMesh = mesh;
+	if(!PrepareMeshCompression(job->sourceMesh, job->primitiveSemantics, job->primitiveFirstFace))
+		return;
+	size_t numPrimitives = job->sourceMesh.primitiveArrays.size();
+	job->compressedMesh.meshCompressionType = avs::MeshCompressionType::NONE;
+	job->compressedMesh.name = mesh.name;
+	job->compressedMesh.subMeshes.resize(numPrimitives);
+	job->primitiveSucceeded.resize(numPrimitives, 0);
+	job->primitiveSourceSizes.resize(numPrimitives, 0);
+	job->primitivesRemaining = numPrimitives;
+	if(!numPrimitives)
+		return;
+	std::lock_guard<std::mutex> lock(meshCompressionMutex);
+	job->generation = meshCompressionGeneration;
+	meshCompressionJobsInProgress++;
+	if(!meshCompressionPool)
+		meshCompressionPool = std::make_unique<core::ThreadPool>();
+	// One task per primitive, rather than per mesh, so that a mesh with many primitives is spread across the workers too.
+	for(size_t i = 0; i < numPrimitives; i++)
 	{
-		CompressMesh(mesh.compressedMesh,mesh.mesh);
-		if(verify)
+		meshCompressionPool->push([this, job, i]()
 		{
-			//Save data to new file.
-			{
-				auto f=std::bind(&GeometryStore::UidToPath,this,std::placeholders::_1);
-				resource_ofstream saveFile("verify.mesh", f);
-				saveFile << mesh << "\n";
-				saveFile.close();
-			}
-			resource_ifstream loadFile("verify.mesh", std::bind(&GeometryStore::PathToUid,this,std::placeholders::_1));
-		
-			ExtractedMesh testMesh;
-			loadFile >> testMesh;
-			VerifyCompressedMesh(testMesh.compressedMesh, testMesh.mesh);
+			compressMeshPrimitive(job, i);
+		});
+	}
+}
+
+void GeometryStore::compressMeshPrimitive(std::shared_ptr<MeshCompressionJob> job, size_t index)
+{
+	bool succeeded = false;
+	try
+	{
+		avs::CompressedSubMesh& subMesh = job->compressedMesh.subMeshes[index];
+		succeeded = CompressMeshPrimitive(job->sourceMesh, index, job->primitiveSemantics[index], job->primitiveFirstFace[index], subMesh, job->primitiveSourceSizes[index]);
+		if(succeeded && job->verify && !VerifyCompressedSubMesh(subMesh, job->sourceMesh, index))
+		{
+			TELEPORT_CERR << "Verification of compressed mesh " << job->sourceMesh.name.c_str() << " failed.\n";
+			succeeded = false;
 		}
 	}
+	catch(...)
+	{
+		succeeded = false;
+	}
+	job->primitiveSucceeded[index] = succeeded ? 1 : 0;
+	// The last primitive to finish completes the job.
+	if(--job->primitivesRemaining > 0)
+		return;
+	bool allSucceeded = std::all_of(job->primitiveSucceeded.begin(), job->primitiveSucceeded.end(), [](uint8_t s) { return s != 0; });
+	if(allSucceeded)
+	{
+		job->compressedMesh.meshCompressionType = avs::MeshCompressionType::DRACO;
+		size_t sourceSize = 0;
+		size_t compressedSize = 0;
+		for(size_t i = 0; i < job->compressedMesh.subMeshes.size(); i++)
+		{
+			sourceSize += job->primitiveSourceSizes[i];
+			compressedSize += job->compressedMesh.subMeshes[i].buffer.size();
+		}
+		TELEPORT_INTERNAL_COUT("Compressed {0} from {1} to {2}\n",job->sourceMesh.name.c_str(),(sourceSize+1023)/1024,(compressedSize +1023)/1024);
+	}
+	{
+		std::lock_guard<std::mutex> lock(meshCompressionMutex);
+		meshCompressionJobsInProgress--;
+		if(allSucceeded && job->generation == meshCompressionGeneration)
+			compressedMeshes.push_back(job);
+	}
+	meshCompressionCondition.notify_all();
+}
+
+void GeometryStore::applyCompressedMeshes()
+{
+	std::vector<std::shared_ptr<MeshCompressionJob>> completed;
+	{
+		std::lock_guard<std::mutex> lock(meshCompressionMutex);
+		if(compressedMeshes.empty())
+			return;
+		completed.swap(compressedMeshes);
+	}
+	for(auto& job : completed)
+	{
+		// If the mesh was stored again since, this is out of date.
+		auto s = meshStoreSequences.find({job->standard, job->uid});
+		if(s == meshStoreSequences.end() || s->second != job->storeSequence)
+			continue;
+		ExtractedMesh* mesh = meshes[job->standard].find(job->uid);
+		if(!mesh)
+			continue;
+		mesh->compressedMesh = std::move(job->compressedMesh);
+		invalidateEncodedResource(job->uid);
+		unsavedResources.insert(job->uid);
+	}
+}
+
+void GeometryStore::finishMeshCompression()
+{
+	{
+		std::unique_lock<std::mutex> lock(meshCompressionMutex);
+		meshCompressionCondition.wait(lock, [this]() { return meshCompressionJobsInProgress == 0; });
+	}
+	applyCompressedMeshes();
+}
+
+size_t GeometryStore::getNumberOfMeshesWaitingForCompression() const
+{
+	std::lock_guard<std::mutex> lock(meshCompressionMutex);
+	return meshCompressionJobsInProgress + compressedMeshes.size();
 }
 
 template<typename ExtractedResource> std::string MakeResourceFilename(ExtractedResource& resource)
@@ -1036,6 +1283,8 @@ void GeometryStore::storeMaterial(avs::uid id, std::string guid,std::string path
 	uid_to_path[id]=p;
 	path_to_uid[p]=id;
  	materials[id] = ExtractedMaterial{guid, path, lastModified, newMaterial};
+	invalidateEncodedResource(id);
+	unsavedResources.insert(id);
 }
 
 void GeometryStore::storeTexture(avs::uid id, std::string guid,std::string path, std::time_t lastModified, avs::Texture& newTexture, std::string cacheFilePath, bool genMips
@@ -1095,6 +1344,12 @@ void GeometryStore::storeTexture(avs::uid id, std::string guid,std::string path,
 			pct.genMips=genMips;
 			pct.highQualityUASTC=highQualityUASTC;
 			pct.textureCompression=newTexture.compression;
+			pct.name=newTexture.name;
+			pct.width=newTexture.width;
+			pct.height=newTexture.height;
+			pct.cubemap=newTexture.cubemap;
+			pct.compressionStrength=compressionStrength;
+			pct.compressionQuality=compressionQuality;
 			for(size_t i=0;i<imageSizes.size();i++)
 			{
 				size_t offset=(size_t)imageOffsets[i];
@@ -1109,7 +1364,12 @@ void GeometryStore::storeTexture(avs::uid id, std::string guid,std::string path,
  			newTexture.data = nullptr;
 			newTexture.dataSize=0;
 			
-			texturesToCompress.emplace(id, pct);
+			std::lock_guard<std::mutex> lock(textureCompressionMutex);
+			bool alreadyQueued=texturesToCompress.find(id)!=texturesToCompress.end();
+			texturesToCompress[id]=std::move(pct);
+			numTexturesToCompress=texturesToCompress.size();
+			if(!alreadyQueued)
+				scheduleTextureCompression();
 		}
 	}
 	else
@@ -1126,6 +1386,8 @@ void GeometryStore::storeTexture(avs::uid id, std::string guid,std::string path,
 	}
 
 	textures[id] = ExtractedTexture{ guid, path, lastModified, newTexture };
+	invalidateEncodedResource(id);
+	unsavedResources.insert(id);
 }
 
 avs::uid GeometryStore::storeFont(std::string ttf_path_utf8,std::string relative_asset_path_utf8,std::time_t lastModified,int size)
@@ -1173,200 +1435,588 @@ avs::uid GeometryStore::storeTextCanvas( std::string relative_asset_path, const
 void GeometryStore::storeShadowMap(avs::uid id, std::string guid,std::string path, std::time_t lastModified, avs::Texture& newShadowMap)
 {
 	shadowMaps[id] = ExtractedTexture{ guid,path, lastModified, newShadowMap};
+	invalidateEncodedResource(id);
 }
 
 void GeometryStore::removeNode(avs::uid id)
 {
-	nodes.erase(id);
+	{
+		std::lock_guard<std::mutex> lock(nodeMutex);
+		nodes.erase(id);
+	}
 	lightNodes.erase(id);
+	invalidateEncodedResource(id);
 }
 
 void GeometryStore::updateNodeTransform(avs::uid id, avs::Transform& newLocalTransform, avs::Transform& newGlobalTransform)
 {
-	auto nodeIt = nodes.find(id);
-	if(nodeIt == nodes.end())
+	std::lock_guard<std::mutex> lock(nodeMutex);
+	avs::Node* node = nodes.find(id);
+	if(!node)
 		return;
 
-	nodeIt->second.localTransform = newLocalTransform;
-	nodeIt->second.globalTransform= newGlobalTransform;
+	node->localTransform = newLocalTransform;
+	node->globalTransform= newGlobalTransform;
+	// No need to invalidate the node's encoded payload here: it is checked against getNodeTransformStamp when it is used.
+}
+
+bool GeometryStore::getNodeCopy(avs::uid id, avs::Node& node) const
+{
+	std::lock_guard<std::mutex> lock(nodeMutex);
+	const avs::Node* n = nodes.find(id);
+	if(!n)
+		return false;
+	node = *n;
+	return true;
 }
 
 size_t GeometryStore::getNumberOfTexturesWaitingForCompression() const
 {
-	return texturesToCompress.size();
+	std::lock_guard<std::mutex> lock(textureCompressionMutex);
+	return texturesToCompress.size() + texturesInProgress.size() + compressedTextures.size();
 }
 
 const avs::Texture* GeometryStore::getNextTextureToCompress() const
 {
+	avs::uid uid = 0;
+	{
+		std::lock_guard<std::mutex> lock(textureCompressionMutex);
+		for(avs::uid u : texturesWaitedFor)
+		{
+			if(texturesToCompress.find(u) != texturesToCompress.end())
+			{
+				uid = u;
+				break;
+			}
+		}
+		if(!uid && texturesToCompress.size())
+			uid = texturesToCompress.begin()->first;
+		// If the workers have taken everything from the queue, report one that is being compressed.
+		if(!uid && texturesInProgress.size())
+			uid = *texturesInProgress.begin();
+	}
 	//No textures to compress.
-	if(texturesToCompress.size() == 0)
+	if(!uid)
 		return nullptr;
-	auto compressionPair = texturesToCompress.begin();
-	auto foundTexture = textures.find(compressionPair->first);
-	assert(foundTexture != textures.end());
+	const ExtractedTexture* foundTexture = textures.find(uid);
+	assert(foundTexture);
 
-	return &foundTexture->second.texture;
+	return &foundTexture->texture;
 }
 
 void GeometryStore::compressNextTexture()
 {
-	//No textures to compress.
-	if(texturesToCompress.size() == 0)
-		return;
-	auto compressionPair = texturesToCompress.begin();
-	auto& foundTexture = textures.find(compressionPair->first);
-	assert(foundTexture != textures.end());
-
-	avs::Texture& newTexture = foundTexture->second.texture;
-	PrecompressedTexture& compressionData = compressionPair->second;
-	if (compressionData.textureCompression == avs::TextureCompression::BASIS_COMPRESSED)
-	{
-		basisu::basis_compressor_params basisCompressorParams; //Parameters for basis compressor.
-		basisCompressorParams.m_source_images.clear();
-		// Basis stores mip 0 in m_source_images, and subsequent mips in m_source_mipmap_images.
-		// They MUST have equal sizes.
-		if(compressionData.numMips<1)
-		{
-			TELEPORT_CERR<<"Bad mipcount "<<compressionData.numMips<<"\n";
-			texturesToCompress.erase(texturesToCompress.begin());
-			return;
-		}
-		size_t imagesPerMip=compressionData.images.size()/compressionData.numMips;
-		if(imagesPerMip*compressionData.numMips!=compressionData.images.size())
-		{
-			TELEPORT_CERR<<"Bad image count "<<compressionData.images.size()<<" for "<<compressionData.numMips<<" mips.\n";
-			texturesToCompress.erase(texturesToCompress.begin());
-			return;
-		}
-		size_t n=0;
-		int w=newTexture.width;
-		int h=newTexture.height;
-		//compressionData.numMips=std::min((size_t)2,compressionData.numMips);
-		for(size_t m=0;m<compressionData.numMips;m++)
+	bool background = false;
+	uint64_t epoch = 0;
+	{
+		std::unique_lock<std::mutex> lock(textureCompressionMutex);
+		background = textureCompressionPool != nullptr;
+		epoch = textureCompressionEpoch;
+		if(background)
 		{
-			for(size_t i=0;i<imagesPerMip;i++)
+			textureCompressionCondition.wait(lock, [this]()
 			{
-				if(m>0&&basisCompressorParams.m_source_mipmap_images.size()<imagesPerMip)
-					basisCompressorParams.m_source_mipmap_images.push_back(basisu::vector<basisu::image>());
-				basisu::image image(w, h);
-				// TODO: This ONLY works for 8-bit rgba.
-				basisu::color_rgba_vec& imageData = image.get_pixels();
-				std::vector<uint8_t> &img=compressionData.images[n];
-				if(img.size()>4*imageData.size())
-				{
-					TELEPORT_CERR<<"Image data size mismatch.\n";
-					return;
-				}
-				if(img.size()<4*imageData.size())
-				{
-					TELEPORT_CERR<<"Image data size mismatch.\n";
-				}
-				memcpy(imageData.data(),img.data(),img.size());
-				if(m==0)
-					basisCompressorParams.m_source_images.push_back(std::move(image));
-				else
-					basisCompressorParams.m_source_mipmap_images[i].push_back(std::move(image));
-				n++;
-			}
-			w=(w+1)/2;
-			h=(h+1)/2;
+				return compressedTextures.size() || (texturesToCompress.empty() && texturesInProgress.empty());
+			});
 		}
-		// TODO: This doesn't work for mips>0. So can't flip textures from Unity for example.
-		//basisCompressorParams.m_y_flip=true;
-		basisCompressorParams.m_quality_level = compressionQuality;
-		basisCompressorParams.m_compression_level = compressionStrength;
-
-		basisCompressorParams.m_write_output_basis_files = true;
-		basisCompressorParams.m_out_filename = compressionData.basisFilePath;
-		basisCompressorParams.m_uastc = compressionData.highQualityUASTC;
+	}
+	if(!background)
+		compressQueuedTexture(epoch);
+	applyCompressedTextures();
+}
 
-		uint32_t num_threads = 32;
-		if (compressionData.highQualityUASTC)
-		{
-			num_threads = 1;
-			// Write this to a different filename, it's just for testing.
-			auto ext_pos = basisCompressorParams.m_out_filename.find(".basis");
-			basisCompressorParams.m_out_filename = basisCompressorParams.m_out_filename.substr(0, ext_pos) + "-dll.basis";
+void GeometryStore::setTextureCompressionThreadCount(size_t n)
+{
+	std::unique_ptr<core::ThreadPool> oldPool;
+	{
+		std::lock_guard<std::mutex> lock(textureCompressionMutex);
+		if(n == textureCompressionThreadCount)
 			return;
+		textureCompressionThreadCount = n;
+		textureCompressionEpoch++;
+		oldPool = std::move(textureCompressionPool);
+		for(size_t i = 0; i < texturesToCompress.size(); i++)
+			scheduleTextureCompression();
+	}
+	// Tasks still queued for the old workers see that the epoch has changed, and return without compressing anything.
+	oldPool.reset();
+}
 
-			// we want the equivalent of:
-			// -uastc -uastc_rdo_m -no_multithreading -debug -stats -output_path "outputPath" "srcPng"
-			basisCompressorParams.m_rdo_uastc_multithreading = false;
-			basisCompressorParams.m_multithreading = false;
-			//basisCompressorParams.m_ktx2_uastc_supercompression = basist::KTX2_SS_NONE;//= basist::KTX2_SS_ZSTANDARD;
+void GeometryStore::prioritiseTextureCompression(const std::vector<avs::uid>& textureUids)
+{
+	if(!numTexturesToCompress)
+		return;
+	std::lock_guard<std::mutex> lock(textureCompressionMutex);
+	for(avs::uid u : textureUids)
+	{
+		if(texturesToCompress.find(u) != texturesToCompress.end())
+			texturesWaitedFor.insert(u);
+	}
+}
 
-			int uastc_level = std::clamp<int>(4, 0, 4);
+void GeometryStore::applyCompressedTextures()
+{
+	std::vector<CompressedTexture> completed;
+	{
+		std::lock_guard<std::mutex> lock(textureCompressionMutex);
+		if(compressedTextures.empty())
+			return;
+		completed.swap(compressedTextures);
+	}
+	for(CompressedTexture& compressedTexture : completed)
+	{
+		if(!compressedTexture.succeeded)
+			continue;
+		ExtractedTexture* foundTexture = textures.find(compressedTexture.uid);
+		// If the texture has since been stored with data that needs no compression, this is out of date.
+		if(!foundTexture || foundTexture->texture.data)
+			continue;
+		avs::Texture& newTexture = foundTexture->texture;
+		newTexture.dataSize = (uint32_t)compressedTexture.basisFile.size();
+		newTexture.data = new unsigned char[newTexture.dataSize];
+		memcpy(newTexture.data, compressedTexture.basisFile.data(), newTexture.dataSize);
+		invalidateEncodedResource(compressedTexture.uid);
+		unsavedResources.insert(compressedTexture.uid);
+	}
+}
 
-			//static const uint32_t s_level_flags[5] = { basisu::cPackUASTCLevelFastest, basisu::cPackUASTCLevelFaster, basisu::cPackUASTCLevelDefault, basisu::cPackUASTCLevelSlower, basisu::cPackUASTCLevelVerySlow };
+TextureCompressionStats GeometryStore::getTextureCompressionStats() const
+{
+	std::lock_guard<std::mutex> lock(textureCompressionMutex);
+	TextureCompressionStats stats = textureCompressionStats;
+	stats.queued = texturesToCompress.size();
+	stats.inProgress = texturesInProgress.size();
+	if(texturesInProgress.size())
+		stats.busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - textureCompressionBusyStart).count();
+	return stats;
+}
 
-			//basisCompressorParams.m_pack_uastc_flags &= ~basisu::cPackUASTCLevelMask;
-			//basisCompressorParams.m_pack_uastc_flags |= s_level_flags[uastc_level];
+void GeometryStore::scheduleTextureCompression()
+{
+	if(!textureCompressionThreadCount)
+		return;
+	if(!textureCompressionPool)
+		textureCompressionPool = std::make_unique<core::ThreadPool>(textureCompressionThreadCount);
+	uint64_t epoch = textureCompressionEpoch;
+	textureCompressionPool->push([this, epoch]()
+	{
+		compressQueuedTexture(epoch);
+	});
+}
 
-			//basisCompressorParams.m_rdo_uastc_dict_size = 32768;
-			//basisCompressorParams.m_check_for_alpha=true;
-			basisCompressorParams.m_debug = true;
-			basisCompressorParams.m_status_output = true;
-			basisCompressorParams.m_compute_stats = true;
-			//basisCompressorParams.m_perceptual=true;
-			//basisCompressorParams.m_validate=false;
-			basisCompressorParams.m_mip_srgb = true;
-			basisCompressorParams.m_quality_level = 128;
-		}
-		else
+void GeometryStore::compressQueuedTexture(uint64_t epoch)
+{
+	avs::uid uid = 0;
+	PrecompressedTexture compressionData;
+	bool waitedFor = false;
+	uint64_t generation = 0;
+	uint32_t numThreads = 1;
+	{
+		std::lock_guard<std::mutex> lock(textureCompressionMutex);
+		if(epoch != textureCompressionEpoch || texturesToCompress.empty())
+			return;
+		// Textures that a client is waiting for go first.
+		auto next = texturesToCompress.end();
+		while(texturesWaitedFor.size() && next == texturesToCompress.end())
 		{
-			basisCompressorParams.m_mip_gen = compressionData.genMips;
-			basisCompressorParams.m_mip_smallest_dimension = 4; // ???
+			auto w = texturesWaitedFor.begin();
+			next = texturesToCompress.find(*w);
+			waitedFor = next != texturesToCompress.end();
+			texturesWaitedFor.erase(w);
 		}
-		basisCompressorParams.m_tex_type = basist::basis_texture_type::cBASISTexType2D;
-		if(newTexture.cubemap)
+		if(next == texturesToCompress.end())
+			next = texturesToCompress.begin();
+		uid = next->first;
+		compressionData = std::move(next->second);
+		texturesToCompress.erase(next);
+		numTexturesToCompress = texturesToCompress.size();
+		if(texturesInProgress.empty())
+			textureCompressionBusyStart = std::chrono::steady_clock::now();
+		texturesInProgress.insert(uid);
+		generation = textureCompressionGeneration;
+		// Basis is multithreaded itself, so share the hardware threads between the textures being compressed at once.
+		numThreads = std::max(1u, std::thread::hardware_concurrency() / (uint32_t)std::max(textureCompressionThreadCount, (size_t)1));
+	}
+	auto startTime = std::chrono::steady_clock::now();
+	CompressedTexture compressedTexture;
+	compressedTexture.uid = uid;
+	compressedTexture.succeeded = CompressTexture(compressionData, numThreads, compressedTexture.basisFile);
+	auto endTime = std::chrono::steady_clock::now();
+	{
+		std::lock_guard<std::mutex> lock(textureCompressionMutex);
+		texturesInProgress.erase(texturesInProgress.find(uid));
+		if(texturesInProgress.empty())
+			textureCompressionStats.busySeconds += std::chrono::duration<double>(endTime - textureCompressionBusyStart).count();
+		// If the store was cleared while this was being compressed, the texture no longer exists.
+		if(generation == textureCompressionGeneration)
 		{
-			basisCompressorParams.m_tex_type = basist::basis_texture_type::cBASISTexTypeCubemapArray;
+			if(compressedTexture.succeeded)
+			{
+				textureCompressionStats.completed++;
+				if(waitedFor)
+					textureCompressionStats.prioritised++;
+				for(const auto& image : compressionData.images)
+					textureCompressionStats.sourceBytes += image.size();
+				textureCompressionStats.compressedBytes += compressedTexture.basisFile.size();
+			}
+			else
+			{
+				textureCompressionStats.failed++;
+			}
+			textureCompressionStats.compressSeconds += std::chrono::duration<double>(endTime - startTime).count();
+			compressedTextures.push_back(std::move(compressedTexture));
 		}
-		if (!basisCompressorParams.m_pJob_pool)
+	}
+	textureCompressionCondition.notify_all();
+}
+
+bool GeometryStore::CompressTexture(const PrecompressedTexture& compressionData, uint32_t numThreads, std::vector<uint8_t>& basisFile)
+{
+	if (compressionData.textureCompression != avs::TextureCompression::BASIS_COMPRESSED)
+	{
+		// TODO: just store?
+		TELEPORT_CERR << "Failed to compress texture \"" << compressionData.name << "\"!\n";
+		return false;
+	}
+	static std::once_flag basisInitialized;
+	std::call_once(basisInitialized, []()
+	{
+		basisu::basisu_encoder_init(false, false);
+		basisu::enable_debug_printf(true);
+	});
+	basisu::basis_compressor_params basisCompressorParams; //Parameters for basis compressor.
+	basisCompressorParams.m_source_images.clear();
+	// Basis stores mip 0 in m_source_images, and subsequent mips in m_source_mipmap_images.
+	// They MUST have equal sizes.
+	if(compressionData.numMips<1)
+	{
+		TELEPORT_CERR<<"Bad mipcount "<<compressionData.numMips<<"\n";
+		return false;
+	}
+	size_t imagesPerMip=compressionData.images.size()/compressionData.numMips;
+	if(imagesPerMip*compressionData.numMips!=compressionData.images.size())
+	{
+		TELEPORT_CERR<<"Bad image count "<<compressionData.images.size()<<" for "<<compressionData.numMips<<" mips.\n";
+		return false;
+	}
+	size_t n=0;
+	int w=compressionData.width;
+	int h=compressionData.height;
+	for(size_t m=0;m<compressionData.numMips;m++)
+	{
+		for(size_t i=0;i<imagesPerMip;i++)
 		{
-			basisCompressorParams.m_pJob_pool = new basisu::job_pool(num_threads);
+			if(m>0&&basisCompressorParams.m_source_mipmap_images.size()<imagesPerMip)
+				basisCompressorParams.m_source_mipmap_images.push_back(basisu::vector<basisu::image>());
+			basisu::image image(w, h);
+			// TODO: This ONLY works for 8-bit rgba.
+			basisu::color_rgba_vec& imageData = image.get_pixels();
+			const std::vector<uint8_t> &img=compressionData.images[n];
+			if(img.size()>4*imageData.size())
+			{
+				TELEPORT_CERR<<"Image data size mismatch.\n";
+				return false;
+			}
+			if(img.size()<4*imageData.size())
+			{
+				TELEPORT_CERR<<"Image data size mismatch.\n";
+			}
+			memcpy(imageData.data(),img.data(),img.size());
+			if(m==0)
+				basisCompressorParams.m_source_images.push_back(std::move(image));
+			else
+				basisCompressorParams.m_source_mipmap_images[i].push_back(std::move(image));
+			n++;
 		}
-		basisu::basis_compressor basisCompressor;
-		basisu::enable_debug_printf(true);
+		w=(w+1)/2;
+		h=(h+1)/2;
+	}
+	// TODO: This doesn't work for mips>0. So can't flip textures from Unity for example.
+	//basisCompressorParams.m_y_flip=true;
+	basisCompressorParams.m_quality_level = compressionData.compressionQuality;
+	basisCompressorParams.m_compression_level = compressionData.compressionStrength;
+
+	// The basis file is written below, so that a partly-written file is never left in the cache.
+	basisCompressorParams.m_write_output_basis_files = false;
+	basisCompressorParams.m_out_filename = compressionData.basisFilePath;
+	basisCompressorParams.m_uastc = compressionData.highQualityUASTC;
+
+	uint32_t num_threads = numThreads;
+	if (compressionData.highQualityUASTC)
+	{
+		num_threads = 1;
+		// Write this to a different filename, it's just for testing.
+		auto ext_pos = basisCompressorParams.m_out_filename.find(".basis");
+		basisCompressorParams.m_out_filename = basisCompressorParams.m_out_filename.substr(0, ext_pos) + "-dll.basis";
+		return false;
+
+		// we want the equivalent of:
+		// -uastc -uastc_rdo_m -no_multithreading -debug -stats -output_path "outputPath" "srcPng"
+		basisCompressorParams.m_rdo_uastc_multithreading = false;
+		basisCompressorParams.m_multithreading = false;
+		//basisCompressorParams.m_ktx2_uastc_supercompression = basist::KTX2_SS_NONE;//= basist::KTX2_SS_ZSTANDARD;
+
+		int uastc_level = std::clamp<int>(4, 0, 4);
+
+		//static const uint32_t s_level_flags[5] = { basisu::cPackUASTCLevelFastest, basisu::cPackUASTCLevelFaster, basisu::cPackUASTCLevelDefault, basisu::cPackUASTCLevelSlower, basisu::cPackUASTCLevelVerySlow };
+
+		//basisCompressorParams.m_pack_uastc_flags &= ~basisu::cPackUASTCLevelMask;
+		//basisCompressorParams.m_pack_uastc_flags |= s_level_flags[uastc_level];
+
+		//basisCompressorParams.m_rdo_uastc_dict_size = 32768;
+		//basisCompressorParams.m_check_for_alpha=true;
+		basisCompressorParams.m_debug = true;
+		basisCompressorParams.m_status_output = true;
+		basisCompressorParams.m_compute_stats = true;
+		//basisCompressorParams.m_perceptual=true;
+		//basisCompressorParams.m_validate=false;
+		basisCompressorParams.m_mip_srgb = true;
+		basisCompressorParams.m_quality_level = 128;
+	}
+	else
+	{
+		basisCompressorParams.m_mip_gen = compressionData.genMips;
+		basisCompressorParams.m_mip_smallest_dimension = 4; // ???
+	}
+	basisCompressorParams.m_tex_type = basist::basis_texture_type::cBASISTexType2D;
+	if(compressionData.cubemap)
+	{
+		basisCompressorParams.m_tex_type = basist::basis_texture_type::cBASISTexTypeCubemapArray;
+	}
+	basisu::job_pool jobPool(num_threads);
+	basisCompressorParams.m_pJob_pool = &jobPool;
+	basisu::basis_compressor basisCompressor;
 
-		bool ok = basisCompressor.init(basisCompressorParams);
-		if(!ok)
+	if (!basisCompressor.init(basisCompressorParams))
+	{
+		TELEPORT_CERR << "Failed to compress texture \"" << compressionData.name << "\"! Basis Universal compressor failed to initialise.\n";
+		return false;
+	}
+	basisu::basis_compressor::error_code result = basisCompressor.process();
+	if (result != basisu::basis_compressor::error_code::cECSuccess)
+	{
+		TELEPORT_CERR << "Failed to compress texture \"" << compressionData.name << "\"!\n";
+		return false;
+	}
+	const basisu::uint8_vec& basisTex = basisCompressor.get_output_basis_file();
+	basisFile.assign(basisTex.data(), basisTex.data() + basisTex.size());
+	// Write to a temporary file and rename it, so the cache never holds a partly-written basis file.
+	if(!compressionData.basisFilePath.empty())
+	{
+		std::string tempFilePath = compressionData.basisFilePath + ".tmp";
+		bool written = false;
 		{
-			basisu::basisu_encoder_init(false,false);
-			ok = basisCompressor.init(basisCompressorParams);
+			std::ofstream basisOut(tempFilePath.c_str(), std::ios::binary | std::ios::trunc);
+			basisOut.write((const char*)basisFile.data(), basisFile.size());
+			written = basisOut.good();
 		}
-		if (ok)
+		std::error_code ec;
+		if(written)
+			std::filesystem::rename(tempFilePath, compressionData.basisFilePath, ec);
+		if(!written || ec)
 		{
-			basisu::basis_compressor::error_code result = basisCompressor.process();
+			TELEPORT_CERR << "Failed to write basis file \"" << compressionData.basisFilePath.c_str() << "\": " << ec.message().c_str() << "\n";
+			std::filesystem::remove(tempFilePath, ec);
+		}
+	}
+	return true;
+}
 
-			if (result == basisu::basis_compressor::error_code::cECSuccess)
-			{
-				basisu::uint8_vec basisTex = basisCompressor.get_output_basis_file();
+bool GeometryStore::EncodedResourceKey::operator<(const EncodedResourceKey& k) const
+{
+	return std::tie(uid, axesStandard, featureMask, compressionStrength, compressionQuality)
+		< std::tie(k.uid, k.axesStandard, k.featureMask, k.compressionStrength, k.compressionQuality);
+}
 
-			//	delete[] newTexture.data;
+GeometryStore::EncodedResourceKey GeometryStore::makeEncodedResourceKey(avs::uid u, avs::AxesStandard standard, uint8_t featureMask) const
+{
+	EncodedResourceKey key;
+	key.uid = u;
+	key.axesStandard = standard;
+	key.featureMask = featureMask;
+	key.compressionStrength = compressionStrength;
+	key.compressionQuality = compressionQuality;
+	return key;
+}
 
-				newTexture.dataSize = basisCompressor.get_basis_file_size();
-				newTexture.data = new unsigned char[newTexture.dataSize];
-				memcpy(newTexture.data, basisTex.data(), newTexture.dataSize);
-			}
-			else
-			{
-				TELEPORT_CERR << "Failed to compress texture \"" << newTexture.name << "\"!\n";
-			}
-		}
-		else
+std::shared_ptr<const std::vector<char>> GeometryStore::getEncodedResource(avs::uid u, avs::AxesStandard standard, uint8_t featureMask, uint64_t sourceStamp) const
+{
+	EncodedResourceKey key = makeEncodedResourceKey(u, standard, featureMask);
+	std::lock_guard<std::mutex> lock(encodedResourceMutex);
+	auto e = encodedResources.find(key);
+	// An out-of-date payload is left to be replaced when the resource is encoded again.
+	if (e == encodedResources.end() || e->second->sourceStamp != sourceStamp)
+	{
+		encodedResourceStats.misses++;
+		return nullptr;
+	}
+	encodedResourceStats.hits++;
+	// Move to the front of the recency list.
+	encodedResourceLru.splice(encodedResourceLru.begin(), encodedResourceLru, e->second);
+	return e->second->payload;
+}
+
+void GeometryStore::storeEncodedResource(avs::uid u, avs::AxesStandard standard, uint8_t featureMask, uint64_t generation, std::shared_ptr<const std::vector<char>> payload, uint64_t sourceStamp)
+{
+	if (!payload)
+		return;
+	EncodedResourceKey key = makeEncodedResourceKey(u, standard, featureMask);
+	std::lock_guard<std::mutex> lock(encodedResourceMutex);
+	// The resource changed while this was being encoded, so the payload may be out of date.
+	if (generation < encodedResourceClearedAt)
+		return;
+	auto i = encodedResourceInvalidated.find(u);
+	if (i != encodedResourceInvalidated.end() && i->second > generation)
+		return;
+	if (payload->size() > encodedResourceStats.maxBytes)
+		return;
+	auto e = encodedResources.find(key);
+	if (e != encodedResources.end())
+	{
+		encodedResourceStats.residentBytes -= e->second->payload->size();
+		encodedResourceLru.erase(e->second);
+		encodedResources.erase(e);
+	}
+	encodedResourceLru.push_front(EncodedResource{ key, payload, sourceStamp });
+	encodedResources[key] = encodedResourceLru.begin();
+	encodedResourceStats.residentBytes += payload->size();
+	evictEncodedResources();
+}
+
+uint64_t GeometryStore::getEncodedResourceGeneration() const
+{
+	std::lock_guard<std::mutex> lock(encodedResourceMutex);
+	return encodedResourceGeneration;
+}
+
+void GeometryStore::setEncodedResourceCacheSize(size_t maxBytes)
+{
+	std::lock_guard<std::mutex> lock(encodedResourceMutex);
+	encodedResourceStats.maxBytes = maxBytes;
+	evictEncodedResources();
+}
+
+EncodedResourceCacheStats GeometryStore::getEncodedResourceCacheStats() const
+{
+	std::lock_guard<std::mutex> lock(encodedResourceMutex);
+	EncodedResourceCacheStats stats = encodedResourceStats;
+	stats.numEntries = encodedResources.size();
+	return stats;
+}
+
+//FNV-1a, continued from the hash so far.
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ull;
+	}
+	return hash;
+}
+
+uint64_t GeometryStore::getNodeTransformStamp(avs::uid u) const
+{
+	std::lock_guard<std::mutex> lock(nodeMutex);
+	const avs::Node* node = nodes.find(u);
+	if (!node)
+		return 0;
+	uint64_t hash = 0xCBF29CE484222325ull;
+	hash = hashBytes(hash, &node->localTransform, sizeof(node->localTransform));
+	hash = hashBytes(hash, &node->globalTransform, sizeof(node->globalTransform));
+	return hash;
+}
+
+//The decoded form depends on the source asset, on how it is compressed, and for meshes, on the client's axes.
+static uint64_t contentHash(avs::GeometryPayloadType type, const std::string& path, std::time_t lastModified, avs::AxesStandard standard, uint8_t compressionStrength, uint8_t compressionQuality)
+{
+	if (path.empty())
+		return 0;
+	uint64_t hash = 0xCBF29CE484222325ull;
+	hash = hashBytes(hash, &type, sizeof(type));
+	hash = hashBytes(hash, path.data(), path.size());
+	int64_t modified = lastModified;
+	hash = hashBytes(hash, &modified, sizeof(modified));
+	hash = hashBytes(hash, &standard, sizeof(standard));
+	hash = hashBytes(hash, &compressionStrength, sizeof(compressionStrength));
+	hash = hashBytes(hash, &compressionQuality, sizeof(compressionQuality));
+	// Zero means no hash.
+	return hash ? hash : 1;
+}
+
+uint64_t GeometryStore::getResourceContentHash(avs::uid u, avs::AxesStandard standard) const
+{
+	auto m = meshes.find(standard);
+	const ExtractedMesh* meshData = (m != meshes.end()) ? getResource(m->second, u) : nullptr;
+	if (meshData)
+		return contentHash(avs::GeometryPayloadType::Mesh, meshData->path, meshData->lastModified, standard, compressionStrength, compressionQuality);
+	const ExtractedTexture* textureData = getResource(textures, u);
+	if (textureData)
+		return contentHash(avs::GeometryPayloadType::Texture, textureData->path, textureData->lastModified, avs::AxesStandard::NotInitialized, compressionStrength, compressionQuality);
+	return 0;
+}
+
+void GeometryStore::findResourcesByContentHash(const std::vector<uint64_t>& hashes, avs::AxesStandard standard, std::vector<core::ResourceContentHash>& found) const
+{
+	if (hashes.empty())
+		return;
+	std::unordered_set<uint64_t> wanted(hashes.begin(), hashes.end());
+	auto m = meshes.find(standard);
+	if (m != meshes.end())
+	{
+		for (const auto& mesh : m->second)
 		{
-			TELEPORT_CERR << "Failed to compress texture \"" << newTexture.name << "\"! Basis Universal compressor failed to initialise.\n";
+			uint64_t hash = contentHash(avs::GeometryPayloadType::Mesh, mesh.second.path, mesh.second.lastModified, standard, compressionStrength, compressionQuality);
+			if (hash && wanted.count(hash))
+				found.push_back({mesh.first, hash});
 		}
-		delete basisCompressorParams.m_pJob_pool;
-		basisCompressorParams.m_pJob_pool = nullptr;
 	}
-	else
+	for (const auto& texture : textures)
 	{
-		// TODO: just store?
-		TELEPORT_CERR << "Failed to compress texture \"" << newTexture.name << "\"!\n";
+		uint64_t hash = contentHash(avs::GeometryPayloadType::Texture, texture.second.path, texture.second.lastModified, avs::AxesStandard::NotInitialized, compressionStrength, compressionQuality);
+		if (hash && wanted.count(hash))
+			found.push_back({texture.first, hash});
+	}
+}
+
+void GeometryStore::invalidateEncodedResource(avs::uid u)
+{
+	std::lock_guard<std::mutex> lock(encodedResourceMutex);
+	encodedResourceInvalidated[u] = ++encodedResourceGeneration;
+	EncodedResourceKey first;
+	first.uid = u;
+	auto e = encodedResources.lower_bound(first);
+	while (e != encodedResources.end() && e->first.uid == u)
+	{
+		encodedResourceStats.residentBytes -= e->second->payload->size();
+		encodedResourceLru.erase(e->second);
+		e = encodedResources.erase(e);
+	}
+}
+
+void GeometryStore::clearEncodedResources()
+{
+	std::lock_guard<std::mutex> lock(encodedResourceMutex);
+	// Anything still being encoded from the old data must not be stored.
+	encodedResourceGeneration++;
+	encodedResourceInvalidated.clear();
+	encodedResourceClearedAt = encodedResourceGeneration;
+	encodedResources.clear();
+	encodedResourceLru.clear();
+	encodedResourceStats.residentBytes = 0;
+}
+
+void GeometryStore::evictEncodedResources()
+{
+	while (encodedResourceStats.residentBytes > encodedResourceStats.maxBytes && !encodedResourceLru.empty())
+	{
+		const EncodedResource& oldest = encodedResourceLru.back();
+		encodedResourceStats.residentBytes -= oldest.payload->size();
+		encodedResources.erase(oldest.key);
+		encodedResourceLru.pop_back();
+		encodedResourceStats.evictions++;
 	}
-	texturesToCompress.erase(texturesToCompress.begin());
 }
 
 template<typename ExtractedResource> bool GeometryStore::saveResourceBinary(const std::string file_name, const ExtractedResource& resource) const
@@ -1502,7 +2152,7 @@ template<typename ExtractedResource> bool GeometryStore::saveResource(const std:
 }
 
 
-template<typename ExtractedResource> bool GeometryStore::saveResources(const std::string path, const std::map<avs::uid, ExtractedResource>& resourceMap) const
+template<typename ExtractedResource> bool GeometryStore::saveResources(const std::string path, const FlatResourceMap<ExtractedResource>& resourceMap) const
 {
 	const std::filesystem::path fspath{ path.c_str() };
 	std::filesystem::create_directories(fspath);
@@ -1516,7 +2166,7 @@ template<typename ExtractedResource> bool GeometryStore::saveResources(const std
 }
 
 
-template<typename ExtractedResource> avs::uid GeometryStore::loadResource(const std::string file_name,const std::string &path_root,std::map<avs::uid, ExtractedResource>& resourceMap)
+template<typename ExtractedResource> avs::uid GeometryStore::loadResource(const std::string file_name,const std::string &path_root,FlatResourceMap<ExtractedResource>& resourceMap)
 {
 	resource_ifstream resourceFile(file_name.c_str(), std::bind(&GeometryStore::PathToUid,this,std::placeholders::_1));
 	std::string p=StandardizePath(file_name,path_root);
@@ -1553,7 +2203,7 @@ template<typename ExtractedResource> avs::uid GeometryStore::loadResource(const
 	return newID;
 }
 
-template<typename ExtractedResource> void GeometryStore::loadResources(const std::string path, std::map<avs::uid, ExtractedResource>& resourceMap)
+template<typename ExtractedResource> void GeometryStore::loadResources(const std::string path, FlatResourceMap<ExtractedResource>& resourceMap)
 {
 	//Load resources if the file exists.
 	const std::filesystem::path fspath{ path.c_str() };
@@ -1571,6 +2221,130 @@ template<typename ExtractedResource> void GeometryStore::loadResources(const std
 	}
 }
 
+template<typename ExtractedResource> bool GeometryStore::serializeResource(const ExtractedResource& resource, std::string& bytes) const
+{
+	auto f=std::bind(&GeometryStore::UidToPath,this,std::placeholders::_1);
+	resource_owstringstream resourceStream(f);
+	try
+	{
+		resourceStream << resource;
+		resourceStream << "\n";
+	}
+	catch(...)
+	{
+		TELEPORT_CERR << "Failed to serialize \"" << resource.path.c_str() << "\"!\n";
+		return false;
+	}
+	// Every character was widened from a byte, so narrowing it again gives the same bytes a resource_ofstream would write.
+	std::wstring w=resourceStream.str();
+	bytes.resize(w.size());
+	for(size_t i=0;i<w.size();i++)
+	{
+		if((uint32_t)w[i]>0xFF)
+		{
+			TELEPORT_CERR << "Failed to serialize \"" << resource.path.c_str() << "\", it contains a character that can't be saved.\n";
+			return false;
+		}
+		bytes[i]=(char)w[i];
+	}
+	// verify:
+	{
+		resource_imemstream verifyStream((const uint8_t*)bytes.data(), bytes.size(), std::bind(&GeometryStore::PathToUid,this,std::placeholders::_1));
+		ExtractedResource verifyResource;
+		verifyStream>>verifyResource;
+		if(!resource.Verify(verifyResource))
+		{
+			TELEPORT_CERR<<"Verification failed for "<<resource.path.c_str()<<"\n";
+			teleport::DebugBreak();
+			return false;
+		}
+	}
+	return true;
+}
+
+template<typename ExtractedResource> bool GeometryStore::savePack(const std::string pack_file, const FlatResourceMap<ExtractedResource>& resourceMap) const
+{
+	const std::filesystem::path fspath{ pack_file.c_str() };
+	std::filesystem::create_directories(fspath.parent_path());
+	std::map<std::string, ResourcePack::Record> packedRecords;
+	{
+		ResourcePack pack;
+		if(pack.open(pack_file))
+			packedRecords=pack.getRecords();
+	}
+	std::map<std::string, std::string> records;
+	std::set<std::string> storedPaths;
+	for(const auto& resourceData : resourceMap)
+	{
+		std::string p=StandardizePath(resourceData.second.path,"");
+		storedPaths.insert(p);
+		if(packedRecords.find(p)!=packedRecords.end()&&unsavedResources.find(resourceData.first)==unsavedResources.end())
+			continue;
+		if(!serializeResource(resourceData.second,records[p]))
+			return false;
+	}
+	// Records of resources that are no longer in the store would otherwise be loaded again on every start.
+	std::set<std::string> removedPaths;
+	for(const auto& r : packedRecords)
+	{
+		if(storedPaths.find(r.first)==storedPaths.end())
+			removedPaths.insert(r.first);
+	}
+	return ResourcePack::Update(pack_file,records,removedPaths);
+}
+
+template<typename ExtractedResource> bool GeometryStore::loadPack(core::ThreadPool& threadPool, const std::string pack_file, FlatResourceMap<ExtractedResource>& resourceMap)
+{
+	ResourcePack pack;
+	if(!pack.open(pack_file))
+		return false;
+	std::vector<std::pair<std::string, ResourcePack::Record>> records(pack.getRecords().begin(), pack.getRecords().end());
+	std::vector<ExtractedResource> loadedResources(records.size());
+	std::vector<uint8_t> loaded(records.size(), 0);
+	// Parse the records straight out of the mapping. Resolving the paths of dependencies only reads path_to_uid,
+	// which is not modified until all the records are parsed.
+	auto f=std::bind(&GeometryStore::PathToUid,this,std::placeholders::_1);
+	threadPool.parallelFor(records.size(), [&](size_t i)
+	{
+		const ResourcePack::Record& record=records[i].second;
+		resource_imemstream resourceStream(pack.getRecordData(record), (size_t)record.size, f);
+		try
+		{
+			resourceStream >> loadedResources[i];
+			loaded[i]=resourceStream.bad()?0:1;
+		}
+		catch(...)
+		{
+			loaded[i]=0;
+		}
+	});
+	resourceMap.reserve(resourceMap.size()+records.size());
+	for(size_t i=0;i<records.size();i++)
+	{
+		if(!loaded[i])
+		{
+			TELEPORT_CERR<<"Failed to load "<<records[i].first.c_str()<<" from "<<pack_file.c_str()<<"\n";
+			continue;
+		}
+		std::string p=records[i].first;
+		standardize_path(p);
+		avs::uid newID=0;
+		auto u=path_to_uid.find(p);
+		if(u!=path_to_uid.end())
+		{
+			newID=u->second;
+		}
+		else
+		{
+			newID=avs::GenerateUid();
+		}
+		resourceMap[newID]=std::move(loadedResources[i]);
+		uid_to_path[newID]=p;
+		path_to_uid[p]=newID;
+	}
+	return true;
+}
+
 avs::uid GeometryStore::PathToUid(std::string p) const
 {
 	p=StandardizePath(p,"");
@@ -1600,7 +2374,7 @@ std::string GeometryStore::UidToPath(avs::uid u) const
 std::set<avs::uid> GeometryStore::GetClashingUids() const
 {
 	std::set<avs::uid> clash_uids;
-	for(auto m:meshes)
+	for(const auto &m:meshes)
 	{
 		std::set<avs::uid> mesh_uids;
 		std::map<avs::Accessor::ComponentType,std::set<avs::uid>> component_uids;
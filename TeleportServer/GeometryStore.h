@@ -1,13 +1,22 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <unordered_map>
 #include <vector>
 
 #include "basisu_comp.h"
 #include "libavstream/geometry/mesh_interface.hpp"
+#include "TeleportCore/CommonNetworking.h"
 
 #include "ExtractedTypes.h"
+#include "FlatResourceMap.h"
 struct InteropTextCanvas;
 
 namespace teleport
@@ -15,9 +24,42 @@ namespace teleport
 	namespace core
 	{
 		struct TextCanvas;
+		class ThreadPool;
 	}
 	namespace server
 	{
+		//! Usage counters for the cache of encoded resource payloads.
+		struct EncodedResourceCacheStats
+		{
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+			uint64_t evictions = 0;
+			size_t numEntries = 0;
+			size_t residentBytes = 0;
+			size_t maxBytes = 0;
+			float hitRate() const
+			{
+				uint64_t total = hits + misses;
+				return total ? float(hits) / float(total) : 0.0f;
+			}
+		};
+		//! Progress and throughput of texture compression.
+		struct TextureCompressionStats
+		{
+			uint64_t queued = 0;
+			uint64_t inProgress = 0;
+			uint64_t completed = 0;
+			uint64_t failed = 0;
+			uint64_t prioritised = 0;		// Completed textures that a client was waiting for.
+			uint64_t sourceBytes = 0;		// Uncompressed size of the completed textures.
+			uint64_t compressedBytes = 0;
+			double compressSeconds = 0.0;	// Time spent compressing, summed over the workers.
+			double busySeconds = 0.0;		// Time during which at least one texture was being compressed.
+			double texturesPerSecond() const
+			{
+				return busySeconds > 0.0 ? double(completed) / busySeconds : 0.0;
+			}
+		};
 		//! Singleton for storing geometry data and managing the geometry file cache.
 		class GeometryStore
 		{
@@ -31,8 +73,10 @@ namespace teleport
 			//Checks and sets the global cache path for the project. Returns true if path is valid.
 			bool SetCachePath(const char* path);
 			void verify();
+			//Save the textures, materials and meshes to resource packs in the cache path. Only resources that have changed since the last save or load are written.
+			//Records of resources that are no longer in the store are removed from the packs, so load from disk before saving.
 			bool saveToDisk() const;
-			//Load from disk.
+			//Load from disk. Uses the resource packs if present, otherwise the individual resource files of older caches.
 			//Parameters are used to return the meta data of the resources that were loaded back-in, so they can be confirmed.
 			void loadFromDisk(size_t& meshAmount, LoadedResource*& loadedMeshes, size_t& textureAmount, LoadedResource*& loadedTextures, size_t& materialAmount, LoadedResource*& loadedMaterials);
 
@@ -42,10 +86,13 @@ namespace teleport
 
 			const char* getNodeName(avs::uid nodeID) const;
 
-			std::vector<avs::uid> getNodeIDs() const;
+			//! The uids of the stored resources are viewed in place, without a copy, so each list from the get*IDs() functions
+			//! is only valid until resources of that type are next added or removed. Use UidSpan::toVector() to keep one for longer.
+			UidSpan getNodeIDs() const;
 			avs::Node* getNode(avs::uid nodeID);
 			const avs::Node* getNode(avs::uid nodeID) const;
-			const std::map<avs::uid, avs::Node>& getNodes() const;
+			//! Only valid until nodes are next added or removed, like the pointers returned by getNode().
+			const FlatResourceMap<avs::Node>& getNodes() const;
 
 			avs::Skin* getSkin(avs::uid skinID, avs::AxesStandard standard);
 			const avs::Skin* getSkin(avs::uid skinID, avs::AxesStandard standard) const;
@@ -53,23 +100,24 @@ namespace teleport
 			avs::Animation* getAnimation(avs::uid id, avs::AxesStandard standard);
 			const avs::Animation* getAnimation(avs::uid id, avs::AxesStandard standard) const;
 
-			std::vector<avs::uid> getMeshIDs() const;
+			UidSpan getMeshIDs() const;
 
 			const ExtractedMesh* getExtractedMesh(avs::uid meshID, avs::AxesStandard standard) const;
 
+			//! Has meshCompressionType NONE while the mesh is still being compressed, in which case the uncompressed mesh should be used.
 			const avs::CompressedMesh* getCompressedMesh(avs::uid meshID, avs::AxesStandard standard) const;
 			virtual avs::Mesh* getMesh(avs::uid meshID, avs::AxesStandard standard);
 			virtual const avs::Mesh* getMesh(avs::uid meshID, avs::AxesStandard standard) const;
 
-			virtual std::vector<avs::uid> getTextureIDs() const;
+			virtual UidSpan getTextureIDs() const;
 			virtual avs::Texture* getTexture(avs::uid textureID);
 			virtual const avs::Texture* getTexture(avs::uid textureID) const;
 
-			virtual std::vector<avs::uid> getMaterialIDs() const;
+			virtual UidSpan getMaterialIDs() const;
 			virtual avs::Material* getMaterial(avs::uid materialID);
 			virtual const avs::Material* getMaterial(avs::uid materialID) const;
 
-			virtual std::vector<avs::uid> getShadowMapIDs() const;
+			virtual UidSpan getShadowMapIDs() const;
 			virtual avs::Texture* getShadowMap(avs::uid shadowID);
 			virtual const avs::Texture* getShadowMap(avs::uid shadowID) const;
 
@@ -93,7 +141,16 @@ namespace teleport
 			void storeNode(avs::uid id, avs::Node& newNode);
 			void storeSkin(avs::uid id, avs::Skin& newSkin, avs::AxesStandard sourceStandard);
 			void storeAnimation(avs::uid id, avs::Animation& animation, avs::AxesStandard sourceStandard);
+			//! Store a mesh. With compress, the mesh is compressed in the background, and sent uncompressed until that finishes.
 			void storeMesh(avs::uid id, std::string guid, std::string path, std::time_t lastModified, avs::Mesh& newMesh, avs::AxesStandard standard, bool compress = false, bool verify = false);
+			//! Store a list of meshes at once. With compress, all of their primitives are compressed together across the workers.
+			void storeMeshes(const std::vector<avs::uid>& ids, const std::vector<std::string>& guids, const std::vector<std::string>& paths, const std::vector<std::time_t>& lastModified, std::vector<avs::Mesh>& newMeshes, avs::AxesStandard standard, bool compress = false, bool verify = false);
+			//! Put meshes that finished compressing in the background into the store. Call from the thread that stores resources.
+			void applyCompressedMeshes();
+			//! Wait for all mesh compression to finish, then apply the results.
+			void finishMeshCompression();
+			//! The number of meshes being compressed, or compressed but not yet applied.
+			size_t getNumberOfMeshesWaitingForCompression() const;
 			void storeMaterial(avs::uid id, std::string guid, std::string path, std::time_t lastModified, avs::Material& newMaterial);
 			void storeTexture(avs::uid id, std::string guid, std::string path, std::time_t lastModified, avs::Texture& newTexture, std::string basisFileLocation, bool genMips, bool highQualityUASTC, bool forceOverwrite);
 			avs::uid storeFont(std::string ttf_path_utf8, std::string relative_asset_path_utf8, std::time_t lastModified, int size = 32);
@@ -103,13 +160,45 @@ namespace teleport
 			void removeNode(avs::uid id);
 
 			void updateNodeTransform(avs::uid id, avs::Transform& newLTransform, avs::Transform& newGTransform);
+			//! Copy a node. Unlike reading it through getNode(), this is safe on the encoder threads while nodes are added, removed or moved.
+			//! Returns false if there is no such node.
+			bool getNodeCopy(avs::uid id, avs::Node& node) const;
 
-			//Returns amount of textures waiting to be compressed.
+			//Returns amount of textures waiting to be compressed, including those being compressed now.
 			size_t getNumberOfTexturesWaitingForCompression() const;
 			//Returns the texture that will be compressed next.
 			const avs::Texture* getNextTextureToCompress() const;
-			//Compresses the next texture to be compressed; does nothing if there are no more textures to compress.
+			//With no background workers, compresses the next texture to be compressed. Otherwise waits for a worker to finish one.
+			//Either way, the compressed textures are then applied. Does nothing if there are no more textures to compress.
 			void compressNextTexture();
+			//! Set the number of background threads that compress queued textures. With zero, textures are only compressed by compressNextTexture().
+			void setTextureCompressionThreadCount(size_t n);
+			//! Move these textures to the front of the compression queue, because a client is waiting for them.
+			void prioritiseTextureCompression(const std::vector<avs::uid>& textureUids);
+			//! Put textures that finished compressing in the background into the store. Call from the thread that stores resources.
+			void applyCompressedTextures();
+			TextureCompressionStats getTextureCompressionStats() const;
+
+			//! Get the encoded payload for a resource, if it has already been encoded for a client with the same axes standard and features.
+			//! The payload is shared, and must not be modified. A payload stored with a different sourceStamp is out of date, and is not returned.
+			std::shared_ptr<const std::vector<char>> getEncodedResource(avs::uid u, avs::AxesStandard standard, uint8_t featureMask, uint64_t sourceStamp = 0) const;
+			//! Keep an encoded payload for other clients to use. Ignored if the resource changed since generation was obtained.
+			void storeEncodedResource(avs::uid u, avs::AxesStandard standard, uint8_t featureMask, uint64_t generation, std::shared_ptr<const std::vector<char>> payload, uint64_t sourceStamp = 0);
+			//! The sourceStamp for a node's payload, which changes whenever the node's transforms do.
+			//! Moving nodes are checked against this when their payload is used, rather than invalidated on every move.
+			uint64_t getNodeTransformStamp(avs::uid u) const;
+			//! Obtain this before encoding a payload to be passed to storeEncodedResource.
+			uint64_t getEncodedResourceGeneration() const;
+			//! Set the memory budget for encoded payloads; least-recently-used payloads are evicted beyond this.
+			void setEncodedResourceCacheSize(size_t maxBytes);
+			EncodedResourceCacheStats getEncodedResourceCacheStats() const;
+
+			//! A hash of what a client decodes from this mesh or texture. Unlike the uid, it stays the same across sessions and server runs
+			//! while the source asset is unchanged, so clients can key their disk caches with it.
+			//! Returns zero for other resources, and for those with no source path.
+			uint64_t getResourceContentHash(avs::uid u, avs::AxesStandard standard) const;
+			//! Find the meshes and textures with these content hashes.
+			void findResourcesByContentHash(const std::vector<uint64_t>& hashes, avs::AxesStandard standard, std::vector<core::ResourceContentHash>& found) const;
 
 			/// Debug: check for clashing uid's: this should never return a non-empty set.
 			std::set<avs::uid> GetClashingUids() const;
@@ -135,28 +224,119 @@ namespace teleport
 				bool genMips;	// if false, numMips tells how many are in the data already.
 				bool highQualityUASTC;
 				avs::TextureCompression textureCompression = avs::TextureCompression::UNCOMPRESSED;
+
+				// Copied from the texture and store when queued, so that a worker need not access either.
+				std::string name;
+				uint32_t width = 0;
+				uint32_t height = 0;
+				bool cubemap = false;
+				uint8_t compressionStrength = 1;
+				uint8_t compressionQuality = 1;
+			};
+			struct CompressedTexture
+			{
+				avs::uid uid = 0;
+				bool succeeded = false;
+				std::vector<uint8_t> basisFile;
 			};
 
 			uint8_t compressionStrength = 1;
 			uint8_t compressionQuality = 1;
 
 			// Mutable, non-resource assets.
-			std::map<avs::uid, avs::Node> nodes;
+			FlatResourceMap<avs::Node> nodes;
+			//Held while nodes are added, removed, linked or moved, because the encoder threads read them, in getNodeCopy and getNodeTransformStamp.
+			mutable std::mutex nodeMutex;
 			std::map<avs::uid, core::TextCanvas> textCanvases;
 
 			// Static, resource assets.
-			std::map<avs::AxesStandard, std::map<avs::uid, avs::Skin>> skins;
-			std::map<avs::AxesStandard, std::map<avs::uid, avs::Animation>> animations;
-			std::map<avs::AxesStandard, std::map<avs::uid, ExtractedMesh>> meshes;
-			std::map<avs::uid, ExtractedMaterial> materials;
-			std::map<avs::uid, ExtractedTexture> textures;
-			std::map<avs::uid, ExtractedTexture> shadowMaps;
+			std::map<avs::AxesStandard, FlatResourceMap<avs::Skin>> skins;
+			std::map<avs::AxesStandard, FlatResourceMap<avs::Animation>> animations;
+			std::map<avs::AxesStandard, FlatResourceMap<ExtractedMesh>> meshes;
+			FlatResourceMap<ExtractedMaterial> materials;
+			FlatResourceMap<ExtractedTexture> textures;
+			FlatResourceMap<ExtractedTexture> shadowMaps;
 			std::map<avs::uid, ExtractedFontAtlas> fontAtlases;
 
 			std::map<avs::uid, PrecompressedTexture> texturesToCompress; //Map of textures that need compressing. <ID of the texture; file path to store the basis file>
+			std::set<avs::uid> texturesWaitedFor;				//Queued textures that a client is waiting for; these are compressed first.
+			std::multiset<avs::uid> texturesInProgress;
+			std::vector<CompressedTexture> compressedTextures;	//Compressed by a worker, but not yet applied to the texture.
+			mutable std::mutex textureCompressionMutex;
+			std::condition_variable textureCompressionCondition;
+			std::atomic<size_t> numTexturesToCompress = 0;
+			size_t textureCompressionThreadCount = 0;
+			uint64_t textureCompressionEpoch = 0;				//Changes when the workers are replaced; tasks for old workers do nothing.
+			uint64_t textureCompressionGeneration = 0;			//Changes when the store is cleared; textures compressed before then are discarded.
+			TextureCompressionStats textureCompressionStats;
+			std::chrono::steady_clock::time_point textureCompressionBusyStart;
+			std::unique_ptr<core::ThreadPool> textureCompressionPool;
+			//Queue a task on the workers to compress one texture. textureCompressionMutex must be locked.
+			void scheduleTextureCompression();
+			//Take the most urgent texture from the queue and compress it. Called by the workers, or by compressNextTexture.
+			void compressQueuedTexture(uint64_t epoch);
+			//Compress with Basis Universal, and write the basis file to the cache.
+			static bool CompressTexture(const PrecompressedTexture& compressionData, uint32_t numThreads, std::vector<uint8_t>& basisFile);
+
+			//A mesh being compressed with Draco, one task per primitive.
+			struct MeshCompressionJob
+			{
+				avs::uid uid = 0;
+				avs::AxesStandard standard = avs::AxesStandard::NotInitialized;
+				uint64_t storeSequence = 0;
+				uint64_t generation = 0;
+				bool verify = false;
+				avs::Mesh sourceMesh;	//A copy, because the stored mesh may move. Its buffers are shared with the store.
+				std::vector<std::map<avs::uid, avs::AttributeSemantic>> primitiveSemantics;
+				std::vector<uint32_t> primitiveFirstFace;
+				std::vector<size_t> primitiveSourceSizes;
+				std::vector<uint8_t> primitiveSucceeded;
+				std::atomic<size_t> primitivesRemaining = 0;
+				avs::CompressedMesh compressedMesh;
+			};
+			mutable std::mutex meshCompressionMutex;
+			std::condition_variable meshCompressionCondition;
+			size_t meshCompressionJobsInProgress = 0;
+			uint64_t meshCompressionGeneration = 0;					//Changes when the store is cleared; meshes compressed before then are discarded.
+			std::vector<std::shared_ptr<MeshCompressionJob>> compressedMeshes;	//Finished, but not yet applied to the mesh.
+			uint64_t meshStoreSequence = 0;
+			std::map<std::pair<avs::AxesStandard, avs::uid>, uint64_t> meshStoreSequences;	//When each mesh was last stored, to recognise out-of-date compression.
+			std::unique_ptr<core::ThreadPool> meshCompressionPool;
+			void compressMeshAsync(avs::uid id, avs::AxesStandard standard, const avs::Mesh& mesh, uint64_t storeSequence, bool verify);
+			void compressMeshPrimitive(std::shared_ptr<MeshCompressionJob> job, size_t index);
 
 			std::map<avs::uid, avs::LightNodeResources> lightNodes; //List of ALL light nodes; prevents having to search for them every geometry tick.
 
+			//Encoded payloads depend only on the resource and these properties of the client, so can be shared between clients.
+			struct EncodedResourceKey
+			{
+				avs::uid uid = 0;
+				avs::AxesStandard axesStandard = avs::AxesStandard::NotInitialized;
+				uint8_t featureMask = 0;
+				uint8_t compressionStrength = 0;
+				uint8_t compressionQuality = 0;
+				bool operator<(const EncodedResourceKey& k) const;
+			};
+			struct EncodedResource
+			{
+				EncodedResourceKey key;
+				std::shared_ptr<const std::vector<char>> payload;
+				uint64_t sourceStamp = 0;
+			};
+			mutable std::mutex encodedResourceMutex;
+			//Most-recently used at the front.
+			mutable std::list<EncodedResource> encodedResourceLru;
+			std::map<EncodedResourceKey, std::list<EncodedResource>::iterator> encodedResources;
+			mutable EncodedResourceCacheStats encodedResourceStats;
+			uint64_t encodedResourceGeneration = 0;
+			uint64_t encodedResourceClearedAt = 0;
+			std::unordered_map<avs::uid, uint64_t> encodedResourceInvalidated;	//Generation at which each resource last changed.
+			EncodedResourceKey makeEncodedResourceKey(avs::uid u, avs::AxesStandard standard, uint8_t featureMask) const;
+			//Remove any encoded payloads of this resource, because its source has changed.
+			void invalidateEncodedResource(avs::uid u);
+			void clearEncodedResources();
+			void evictEncodedResources();
+
 			template<typename ExtractedResource>
 			bool saveResourceBinary(const std::string file_name, const ExtractedResource& resource) const;
 			template<typename ExtractedResource>
@@ -165,13 +345,25 @@ namespace teleport
 			template<typename ExtractedResource>
 			bool saveResource(const std::string file_name, const ExtractedResource& resource) const;
 			template<typename ExtractedResource>
-			avs::uid loadResource(const std::string file_name, const std::string& path_root, std::map<avs::uid, ExtractedResource>& resourceMap);
+			avs::uid loadResource(const std::string file_name, const std::string& path_root, FlatResourceMap<ExtractedResource>& resourceMap);
+
+			template<typename ExtractedResource>
+			bool saveResources(const std::string file_name, const FlatResourceMap<ExtractedResource>& resourceMap) const;
 
 			template<typename ExtractedResource>
-			bool saveResources(const std::string file_name, const std::map<avs::uid, ExtractedResource>& resourceMap) const;
+			void loadResources(const std::string file_name, FlatResourceMap<ExtractedResource>& resourceMap);
 
+			//Resources that have changed since they were last saved to, or loaded from, the resource packs.
+			mutable std::set<avs::uid> unsavedResources;
+			template<typename ExtractedResource>
+			bool serializeResource(const ExtractedResource& resource, std::string& bytes) const;
+			//Write any resources that are unsaved, or missing from the pack, to the pack file, and remove those that are no longer stored.
+			template<typename ExtractedResource>
+			bool savePack(const std::string pack_file, const FlatResourceMap<ExtractedResource>& resourceMap) const;
+			//Load every resource in the pack file, parsing them in parallel. Returns false if there is no valid pack.
+			//The load is eager: every record is parsed into the store here, and the mapping is closed once they have been.
 			template<typename ExtractedResource>
-			void loadResources(const std::string file_name, std::map<avs::uid, ExtractedResource>& resourceMap);
+			bool loadPack(core::ThreadPool& threadPool, const std::string pack_file, FlatResourceMap<ExtractedResource>& resourceMap);
 
 
 			std::map<avs::uid, std::string> uid_to_path;
@@ -40,6 +40,9 @@ void GeometryStreamingService::encodedResource(avs::uid resource_uid)
 {
 	sentResources[resource_uid] = true;
 	unconfirmedResourceTimes[resource_uid] = 0;
+	uint64_t hash = geometryStore->getResourceContentHash(resource_uid, getClientAxesStandard());
+	if(hash)
+		contentHashesToSend.push_back({resource_uid, hash});
 }
 
 void GeometryStreamingService::requestResource(avs::uid resource_uid)
@@ -55,6 +58,35 @@ void GeometryStreamingService::confirmResource(avs::uid resource_uid)
 	sentResources[resource_uid] = true;
 }
 
+void GeometryStreamingService::confirmResources(const std::vector<avs::uid>& resourceIDs)
+{
+	//Grow the table once, rather than rehashing repeatedly as the ids are inserted.
+	sentResources.reserve(sentResources.size() + resourceIDs.size());
+	for(avs::uid resource_uid : resourceIDs)
+	{
+		sentResources[resource_uid] = true;
+	}
+	if(!unconfirmedResourceTimes.empty())
+	{
+		for(avs::uid resource_uid : resourceIDs)
+		{
+			unconfirmedResourceTimes.erase(resource_uid);
+		}
+	}
+}
+
+void GeometryStreamingService::confirmCachedResources(const std::vector<uint64_t>& contentHashes)
+{
+	size_t first = contentHashesToSend.size();
+	geometryStore->findResourcesByContentHash(contentHashes, getClientAxesStandard(), contentHashesToSend);
+	for(size_t i = first; i < contentHashesToSend.size(); i++)
+	{
+		avs::uid resource_uid = contentHashesToSend[i].uid;
+		sentResources[resource_uid] = true;
+		unconfirmedResourceTimes.erase(resource_uid);
+	}
+}
+
 void GeometryStreamingService::getResourcesToStream(std::vector<avs::uid>& outNodeIDs
 		,std::vector<avs::MeshNodeResources>& outMeshResources
 		,std::vector<avs::LightNodeResources>& outLightResources
@@ -240,6 +272,7 @@ void GeometryStreamingService::tick(float deltaTime)
 void GeometryStreamingService::reset()
 {
 	sentResources.clear();
+	contentHashesToSend.clear();
 
 	unconfirmedResourceTimes.clear();
 	streamedNodeIDs.clear();
@@ -318,6 +351,8 @@ void GeometryStreamingService::GetMeshNodeResources(avs::uid nodeID, const avs::
 			material.texture_uids.push_back(thisMaterial->occlusionTexture.index);
 
 		UniqueUIDsOnly(material.texture_uids);
+		// The client will be waiting for these, so compress them before any others that are queued.
+		geometryStore->prioritiseTextureCompression(material.texture_uids);
 
 		meshNode.materials.push_back(material);
 	}
@@ -29,6 +29,15 @@ namespace teleport
 			virtual void encodedResource(avs::uid resourceID) override;
 			virtual void requestResource(avs::uid resourceID) override;
 			virtual void confirmResource(avs::uid resourceID) override;
+			//! Confirm many resources at once, e.g. those a reconnecting client already holds.
+			void confirmResources(const std::vector<avs::uid>& resourceIDs);
+			//! Confirm the meshes and textures the client holds in its disk cache, which it lists by their content hashes.
+			void confirmCachedResources(const std::vector<uint64_t>& contentHashes);
+			//! Content hashes of the resources encoded or confirmed from the disk cache, that have yet to be sent to the client.
+			std::vector<core::ResourceContentHash>& getContentHashesToSend()
+			{
+				return contentHashesToSend;
+			}
 
 			void getResourcesToStream(std::vector<avs::uid>& outNodeIDs
 				, std::vector<avs::MeshNodeResources>& outMeshResources
@@ -83,6 +92,7 @@ namespace teleport
 
 			std::unordered_map<avs::uid, bool> sentResources; //Tracks the resources sent to the user; <resource identifier, doesClientHave>.
 			std::unordered_map<avs::uid, float> unconfirmedResourceTimes; //Tracks time since an unconfirmed resource was sent; <resource identifier, time since sent>.
+			std::vector<core::ResourceContentHash> contentHashesToSend;
 			std::set<avs::uid> streamedNodeIDs; //Nodes that the client needs to draw, and should be sent to them.
 			std::set<avs::uid> clientRenderingNodes; //Nodes that are currently rendered on this client.
 			std::set<avs::uid> streamedGenericTextureUids; // Textures that are not specifically specified in a material, e.g. lightmaps.
@@ -144,6 +144,7 @@ void NetworkPipeline::initialise(const CasterNetworkSettings& inNetworkSettings,
 	}
 
 	mPipeline->add(mNetworkSink.get());
+	mInputQueues = { videoQueue, tagDataQueue, audioQueue, geometryQueue };
 
 #if WITH_REMOTEPLAY_STATS
 	mLastTimestamp = avs::PlatformWindows::getTimestamp();
@@ -155,6 +156,7 @@ void NetworkPipeline::initialise(const CasterNetworkSettings& inNetworkSettings,
 void NetworkPipeline::release()
 {
 	mPipeline.reset();
+	mInputQueues.clear();
 	if (mNetworkSink)
 		mNetworkSink->deconfigure();
 	mNetworkSink.reset();
@@ -223,3 +225,20 @@ bool NetworkPipeline::isProcessingEnabled() const
 		return mNetworkSink->isProcessingEnabled();
 	return false;
 }
+
+bool NetworkPipeline::hasQueuedData() const
+{
+	for (avs::Queue* queue : mInputQueues)
+	{
+		if (!queue->empty())
+			return true;
+	}
+	return false;
+}
+
+bool NetworkPipeline::hasThrottledData() const
+{
+	if (mNetworkSink)
+		return mNetworkSink->hasThrottledData();
+	return false;
+}
@@ -34,11 +34,17 @@ namespace teleport
 			void setProcessingEnabled(bool enable);
 			bool isProcessingEnabled() const;
 
+			//! Whether any of the sending queues has data waiting. Call only from the thread that calls process().
+			bool hasQueuedData() const;
+			//! Whether the sink is holding back packets to keep within the bandwidth limit.
+			bool hasThrottledData() const;
+
 		private:
 			const ServerSettings* mSettings;
 
 			std::unique_ptr<avs::Pipeline> mPipeline;
 			std::unique_ptr<avs::NetworkSink> mNetworkSink;
+			std::vector<avs::Queue*> mInputQueues;
 			avs::Result mPrevProcResult;
 
 #if WITH_REMOTEPLAY_STATS
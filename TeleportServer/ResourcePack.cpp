@@ -0,0 +1,311 @@
+#include "ResourcePack.h"
+#include "TeleportCore/ErrorHandling.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace teleport;
+using namespace server;
+
+namespace
+{
+	const char packMagic[4] = {'T', 'P', 'A', 'K'};
+	const uint32_t packVersion = 1;
+
+	struct PackHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t indexOffset;
+		uint64_t indexSize;
+	};
+	static_assert(sizeof(PackHeader) == 24, "PackHeader must have no padding.");
+
+	bool IsValidHeader(const PackHeader& header, uint64_t fileSize)
+	{
+		if (memcmp(header.magic, packMagic, 4) != 0 || header.version != packVersion)
+			return false;
+		if (header.indexOffset < sizeof(PackHeader) || header.indexOffset > fileSize || header.indexSize > fileSize - header.indexOffset)
+			return false;
+		return true;
+	}
+
+	// Each index entry is {uint32 path length, path, uint64 offset, uint64 size}.
+	bool ParseIndex(const uint8_t* index, uint64_t indexSize, uint64_t fileSize, std::map<std::string, ResourcePack::Record>& records)
+	{
+		uint64_t pos = 0;
+		while (pos < indexSize)
+		{
+			uint32_t pathLength = 0;
+			if (indexSize - pos < sizeof(pathLength))
+				return false;
+			memcpy(&pathLength, index + pos, sizeof(pathLength));
+			pos += sizeof(pathLength);
+			if (indexSize - pos < (uint64_t)pathLength + 2 * sizeof(uint64_t))
+				return false;
+			std::string path((const char*)index + pos, pathLength);
+			pos += pathLength;
+			ResourcePack::Record record;
+			memcpy(&record.offset, index + pos, sizeof(uint64_t));
+			pos += sizeof(uint64_t);
+			memcpy(&record.size, index + pos, sizeof(uint64_t));
+			pos += sizeof(uint64_t);
+			if (record.offset < sizeof(PackHeader) || record.offset > fileSize || record.size > fileSize - record.offset)
+				return false;
+			records[path] = record;
+		}
+		return true;
+	}
+
+	std::string MakeIndex(const std::map<std::string, ResourcePack::Record>& records)
+	{
+		std::string index;
+		for (const auto& r : records)
+		{
+			uint32_t pathLength = (uint32_t)r.first.size();
+			index.append((const char*)&pathLength, sizeof(pathLength));
+			index.append(r.first);
+			index.append((const char*)&r.second.offset, sizeof(uint64_t));
+			index.append((const char*)&r.second.size, sizeof(uint64_t));
+		}
+		return index;
+	}
+
+	PackHeader MakeHeader(uint64_t indexOffset, uint64_t indexSize)
+	{
+		PackHeader header;
+		memcpy(header.magic, packMagic, 4);
+		header.version = packVersion;
+		header.indexOffset = indexOffset;
+		header.indexSize = indexSize;
+		return header;
+	}
+
+	// Read the index of an existing pack through ordinary file i/o, so that it can be extended.
+	bool ReadIndex(std::ifstream& in, uint64_t& fileSize, std::map<std::string, ResourcePack::Record>& records)
+	{
+		in.seekg(0, std::ios::end);
+		fileSize = (uint64_t)in.tellg();
+		if (!in || fileSize < sizeof(PackHeader))
+			return false;
+		in.seekg(0);
+		PackHeader header;
+		in.read((char*)&header, sizeof(header));
+		if (!in || !IsValidHeader(header, fileSize))
+			return false;
+		std::vector<uint8_t> index((size_t)header.indexSize);
+		in.seekg(header.indexOffset);
+		in.read((char*)index.data(), index.size());
+		if (!in)
+			return false;
+		return ParseIndex(index.data(), index.size(), fileSize, records);
+	}
+}
+
+ResourcePack::~ResourcePack()
+{
+	close();
+}
+
+bool ResourcePack::open(const std::string& filename)
+{
+	close();
+#if defined(_WIN32)
+	HANDLE file = CreateFileW(std::filesystem::path(filename).wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || (uint64_t)fileSize.QuadPart < sizeof(PackHeader))
+	{
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	fileHandle = file;
+	mappingHandle = mapping;
+	mapped = (const uint8_t*)view;
+	mappedSize = (size_t)fileSize.QuadPart;
+#else
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat fileInfo;
+	if (fstat(fd, &fileInfo) != 0 || (uint64_t)fileInfo.st_size < sizeof(PackHeader))
+	{
+		::close(fd);
+		return false;
+	}
+	void* view = mmap(nullptr, (size_t)fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (view == MAP_FAILED)
+	{
+		::close(fd);
+		return false;
+	}
+	fileDescriptor = fd;
+	mapped = (const uint8_t*)view;
+	mappedSize = (size_t)fileInfo.st_size;
+#endif
+	PackHeader header;
+	memcpy(&header, mapped, sizeof(header));
+	if (!IsValidHeader(header, mappedSize) || !ParseIndex(mapped + header.indexOffset, header.indexSize, mappedSize, records))
+	{
+		TELEPORT_CERR << "Resource pack " << filename.c_str() << " is not valid.\n";
+		close();
+		return false;
+	}
+	return true;
+}
+
+void ResourcePack::close()
+{
+	records.clear();
+	if (!mapped)
+		return;
+#if defined(_WIN32)
+	UnmapViewOfFile(mapped);
+	CloseHandle((HANDLE)mappingHandle);
+	CloseHandle((HANDLE)fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	munmap((void*)mapped, mappedSize);
+	::close(fileDescriptor);
+	fileDescriptor = -1;
+#endif
+	mapped = nullptr;
+	mappedSize = 0;
+}
+
+bool ResourcePack::Update(const std::string& filename, const std::map<std::string, std::string>& newRecords, const std::set<std::string>& removedPaths)
+{
+	std::map<std::string, Record> existingRecords;
+	uint64_t fileSize = 0;
+	bool existing = false;
+	{
+		std::ifstream in(filename.c_str(), std::ios::binary);
+		if (in)
+		{
+			existing = ReadIndex(in, fileSize, existingRecords);
+			if (!existing)
+				TELEPORT_CERR << "Resource pack " << filename.c_str() << " is not valid, it will be replaced.\n";
+		}
+	}
+	// Removed records are simply left out of the new index; their data is reclaimed when the pack is next compacted.
+	size_t numRemoved = 0;
+	for (const std::string& p : removedPaths)
+		numRemoved += existingRecords.erase(p);
+	if (!newRecords.size() && !numRemoved && existing)
+		return true;
+	// How much of the file would still be referenced after the update?
+	uint64_t liveSize = 0;
+	uint64_t newSize = 0;
+	for (const auto& r : existingRecords)
+	{
+		if (newRecords.find(r.first) == newRecords.end())
+			liveSize += r.second.size;
+	}
+	for (const auto& r : newRecords)
+		newSize += r.second.size();
+	bool compact = !existing || (fileSize + newSize) > 2 * (liveSize + newSize) + sizeof(PackHeader);
+	if (!compact)
+	{
+		// Append the new records and a new index after everything that is there now, then point the header at the new index.
+		std::fstream out(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		out.seekp(fileSize);
+		uint64_t offset = fileSize;
+		for (const auto& r : newRecords)
+		{
+			out.write(r.second.data(), r.second.size());
+			existingRecords[r.first] = {offset, (uint64_t)r.second.size()};
+			offset += r.second.size();
+		}
+		std::string index = MakeIndex(existingRecords);
+		out.write(index.data(), index.size());
+		out.flush();
+		PackHeader header = MakeHeader(offset, index.size());
+		out.seekp(0);
+		out.write((const char*)&header, sizeof(header));
+		out.flush();
+		if (!out)
+		{
+			TELEPORT_CERR << "Failed to update resource pack " << filename.c_str() << "\n";
+			return false;
+		}
+		return true;
+	}
+	// Rewrite the pack with only the live records, to a temporary file that then replaces the original.
+	std::string tempFilename = filename + ".tmp";
+	{
+		std::ifstream in;
+		if (existing)
+			in.open(filename.c_str(), std::ios::binary);
+		std::ofstream out(tempFilename.c_str(), std::ios::binary | std::ios::trunc);
+		PackHeader header = MakeHeader(0, 0);
+		out.write((const char*)&header, sizeof(header));
+		std::map<std::string, Record> records;
+		uint64_t offset = sizeof(PackHeader);
+		std::vector<char> buffer;
+		for (const auto& r : existingRecords)
+		{
+			if (newRecords.find(r.first) != newRecords.end())
+				continue;
+			buffer.resize((size_t)r.second.size);
+			in.seekg(r.second.offset);
+			in.read(buffer.data(), buffer.size());
+			out.write(buffer.data(), buffer.size());
+			records[r.first] = {offset, r.second.size};
+			offset += r.second.size;
+		}
+		for (const auto& r : newRecords)
+		{
+			out.write(r.second.data(), r.second.size());
+			records[r.first] = {offset, (uint64_t)r.second.size()};
+			offset += r.second.size();
+		}
+		std::string index = MakeIndex(records);
+		out.write(index.data(), index.size());
+		header = MakeHeader(offset, index.size());
+		out.seekp(0);
+		out.write((const char*)&header, sizeof(header));
+		out.flush();
+		if (!out || (existing && !in))
+		{
+			TELEPORT_CERR << "Failed to write resource pack " << filename.c_str() << "\n";
+			out.close();
+			std::filesystem::remove(tempFilename);
+			return false;
+		}
+	}
+	std::error_code ec;
+	std::filesystem::rename(tempFilename, filename, ec);
+	if (ec)
+	{
+		TELEPORT_CERR << "Failed to replace resource pack " << filename.c_str() << ": " << ec.message().c_str() << "\n";
+		std::filesystem::remove(tempFilename, ec);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+
+namespace teleport
+{
+	namespace server
+	{
+		//! A single file holding many serialized resources, indexed by path.
+		//! The file is memory-mapped for reading, so a cold start opens one file instead of one per resource,
+		//! and records are only read from disk as they are parsed.
+		//! Layout: a fixed header, then the records, then an index of {path, offset, size} at the end.
+		//! Updates append the new records and a new index after the existing data, and only then rewrite the header,
+		//! so an interrupted update leaves the previous contents intact.
+		class ResourcePack
+		{
+		public:
+			struct Record
+			{
+				uint64_t offset = 0;
+				uint64_t size = 0;
+			};
+			ResourcePack() = default;
+			ResourcePack(const ResourcePack&) = delete;
+			ResourcePack& operator=(const ResourcePack&) = delete;
+			~ResourcePack();
+
+			//! Map the pack at filename and read its index. Returns false if there is no valid pack there.
+			bool open(const std::string& filename);
+			void close();
+			bool isOpen() const
+			{
+				return mapped != nullptr;
+			}
+			//! The records in the open pack, by path.
+			const std::map<std::string, Record>& getRecords() const
+			{
+				return records;
+			}
+			//! The bytes of a record in the mapped file. Valid until close().
+			const uint8_t* getRecordData(const Record& record) const
+			{
+				return mapped + record.offset;
+			}
+
+			//! Add or replace records in the pack at filename, creating the file if necessary, and remove the records at removedPaths.
+			//! Other records are kept as they are, and not rewritten.
+			//! When more than half of the file is superseded or removed data, the whole pack is rewritten compactly instead.
+			//! The pack must not be open for reading while it is updated.
+			static bool Update(const std::string& filename, const std::map<std::string, std::string>& newRecords, const std::set<std::string>& removedPaths = {});
+
+		private:
+			const uint8_t* mapped = nullptr;
+			size_t mappedSize = 0;
+		#if defined(_WIN32)
+			void* fileHandle = nullptr;
+			void* mappingHandle = nullptr;
+		#else
+			int fileDescriptor = -1;
+		#endif
+			std::map<std::string, Record> records;
+		};
+	}
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <functional>
 #include <iostream>
 #include <queue>
@@ -127,6 +128,20 @@ struct InitialiseState
 	GetUnixTimestampFn getUnixTimestamp;
 };
 
+// The largest video frame the colour queue's ring takes: half a second of video at the highest configured bitrate, as an IDR frame
+// after a scene change can be many times the average. The ring holds two of these, so a second of video. Under constant-QP rate
+// control no bitrate is set, and 50 Mbps is assumed. A frame too large for the ring is dropped, and the encoder sends an IDR frame next.
+static size_t GetMaxVideoFrameSize(const ServerSettings& settings)
+{
+	const size_t defaultBitrate = 50 * 1000 * 1000;
+	size_t bitrate = (size_t)std::max(std::max(settings.maxBitrate, settings.averageBitrate), 0);
+	if (!bitrate)
+	{
+		bitrate = defaultBitrate;
+	}
+	return std::max(bitrate / 8 / 2, (size_t)1024 * 1024);
+}
+
 ///PLUGIN-INTERNAL START
 void RemoveClient(avs::uid clientID)
 {
@@ -410,10 +425,21 @@ TELEPORT_EXPORT bool Client_StartSession(avs::uid clientID, std::string clientIP
 	newClient.clientNetworkContext.GeometryQueue.reset(new avs::Queue);
 	newClient.clientNetworkContext.AudioQueue.reset(new avs::Queue);
 
-	newClient.clientNetworkContext.ColorQueue->configure(200000, 16,"ColorQueue");
-	newClient.clientNetworkContext.TagDataQueue->configure(200, 16, "TagDataQueue");
+	// Each of the video, tag data and audio queues is written by one encoder and read only by the client's streaming worker,
+	// so they are lock-free rings, which the network sink sends from in place. Geometry payloads can be of any size,
+	// so the geometry queue keeps the locking queue, which grows to fit. A ring can't grow, so its maximum buffer size must allow for the largest keyframe.
+	size_t maxVideoFrameSize = GetMaxVideoFrameSize(serverSettings);
+	newClient.clientNetworkContext.ColorQueue->configureSPSC(maxVideoFrameSize, 2 * maxVideoFrameSize, "ColorQueue");
+	newClient.clientNetworkContext.TagDataQueue->configureSPSC(4 * 1024, 64 * 1024, "TagDataQueue");
 	newClient.clientNetworkContext.GeometryQueue->configure(200000, 16, "GeometryQueue");
-	newClient.clientNetworkContext.AudioQueue->configure(8192, 120, "AudioQueue");
+	newClient.clientNetworkContext.AudioQueue->configureSPSC(64 * 1024, 1024 * 1024, "AudioQueue");
+	// The client's streaming worker sleeps until one of its queues is written to.
+	std::shared_ptr<StreamingSignal> streamingSignal = newClient.clientNetworkContext.streamingSignal;
+	auto wakeStreamingWorker = [streamingSignal]() { streamingSignal->notify(); };
+	newClient.clientNetworkContext.ColorQueue->setWriteNotification(wakeStreamingWorker);
+	newClient.clientNetworkContext.TagDataQueue->setWriteNotification(wakeStreamingWorker);
+	newClient.clientNetworkContext.GeometryQueue->setWriteNotification(wakeStreamingWorker);
+	newClient.clientNetworkContext.AudioQueue->setWriteNotification(wakeStreamingWorker);
 
 	// Receiving
 	if (serverSettings.isReceivingAudio)
@@ -630,6 +656,8 @@ TELEPORT_EXPORT void Tick(float deltaTime)
 	}
 	lostClients.clear();
 
+	GeometryStore::GetInstance().applyCompressedTextures();
+	GeometryStore::GetInstance().applyCompressedMeshes();
 	clientManager.tick(deltaTime);
 
 	for(auto& clientPair : clientServices)
@@ -654,6 +682,8 @@ TELEPORT_EXPORT void Tick(float deltaTime)
 
 TELEPORT_EXPORT void EditorTick()
 {
+	GeometryStore::GetInstance().applyCompressedTextures();
+	GeometryStore::GetInstance().applyCompressedMeshes();
 	PipeOutMessages();
 }
 
@@ -1340,6 +1370,8 @@ TELEPORT_EXPORT bool Client_GetClientVideoEncoderStats(avs::uid clientID, avs::E
 ///GeometryStore START
 TELEPORT_EXPORT void SaveGeometryStore()
 {
+	// Save the meshes compressed, rather than as they are sent while compression is still going on.
+	GeometryStore::GetInstance().finishMeshCompression();
 	GeometryStore::GetInstance().saveToDisk();
 	GeometryStore::GetInstance().verify();
 }
@@ -1369,6 +1401,21 @@ TELEPORT_EXPORT void SetCompressionLevels(uint8_t compressionStrength, uint8_t c
 	GeometryStore::GetInstance().setCompressionLevels(compressionStrength, compressionQuality);
 }
 
+TELEPORT_EXPORT void SetGeometryEncodeThreadCount(int32_t threadCount)
+{
+	GeometryEncoder::SetEncodeThreadCount((size_t)std::max(threadCount, 0));
+}
+
+TELEPORT_EXPORT void SetEncodedResourceCacheSize(uint64_t maxBytes)
+{
+	GeometryStore::GetInstance().setEncodedResourceCacheSize((size_t)maxBytes);
+}
+
+TELEPORT_EXPORT void GetEncodedResourceCacheStats(EncodedResourceCacheStats& stats)
+{
+	stats = GeometryStore::GetInstance().getEncodedResourceCacheStats();
+}
+
 TELEPORT_EXPORT void StoreNode(avs::uid id, InteropNode node)
 {
 	GeometryStore::GetInstance().storeNode(id, avs::Node(node));
@@ -1389,6 +1436,22 @@ TELEPORT_EXPORT void StoreMesh(avs::uid id, BSTR guid, BSTR path, std::time_t la
 	GeometryStore::GetInstance().storeMesh(id, WStringToString(guid), WStringToString(path), lastModified, avs::Mesh(*mesh), extractToStandard,compress,verify);
 }
 
+TELEPORT_EXPORT void StoreMeshes(int32_t count, const avs::uid* ids, BSTR* guids, BSTR* paths, const std::time_t* lastModified, const InteropMesh* interopMeshes, avs::AxesStandard extractToStandard, bool compress, bool verify)
+{
+	std::vector<avs::uid> meshIDs(ids, ids + count);
+	std::vector<std::string> meshGuids(count), meshPaths(count);
+	std::vector<std::time_t> meshLastModified(lastModified, lastModified + count);
+	std::vector<avs::Mesh> meshes;
+	meshes.reserve(count);
+	for(int32_t i = 0; i < count; i++)
+	{
+		meshGuids[i] = WStringToString(guids[i]);
+		meshPaths[i] = WStringToString(paths[i]);
+		meshes.push_back(avs::Mesh(interopMeshes[i]));
+	}
+	GeometryStore::GetInstance().storeMeshes(meshIDs, meshGuids, meshPaths, meshLastModified, meshes, extractToStandard, compress, verify);
+}
+
 TELEPORT_EXPORT void StoreMaterial(avs::uid id, BSTR guid, BSTR path, std::time_t lastModified, InteropMaterial material)
 {
 	GeometryStore::GetInstance().storeMaterial(id, WStringToString(guid), WStringToString(path), lastModified, avs::Material(material));
@@ -1491,6 +1554,9 @@ TELEPORT_EXPORT uint64_t GetNumberOfTexturesWaitingForCompression()
 TELEPORT_EXPORT BSTR GetMessageForNextCompressedTexture(uint64_t textureIndex, uint64_t totalTextures)
 {
 	const avs::Texture* texture = GeometryStore::GetInstance().getNextTextureToCompress();
+	// Everything may already be compressed, and only waiting to be applied.
+	if(!texture)
+		return SysAllocString(L"");
 
 	std::wstringstream messageStream;
 	//Write compression message to wide string stream.
@@ -1504,6 +1570,16 @@ TELEPORT_EXPORT void CompressNextTexture()
 {
 	GeometryStore::GetInstance().compressNextTexture();
 }
+
+TELEPORT_EXPORT void SetTextureCompressionThreadCount(int32_t threadCount)
+{
+	GeometryStore::GetInstance().setTextureCompressionThreadCount((size_t)std::max(threadCount, 0));
+}
+
+TELEPORT_EXPORT void GetTextureCompressionStats(TextureCompressionStats& stats)
+{
+	stats = GeometryStore::GetInstance().getTextureCompressionStats();
+}
 ///GeometryStore END
 
 TELEPORT_EXPORT size_t SizeOf(const char *str)
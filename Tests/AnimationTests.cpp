@@ -0,0 +1,107 @@
+#include "Check.h"
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "ClientRender/Animation.h"
+#include "ClientRender/Bone.h"
+
+using namespace clientrender;
+
+namespace teleport
+{
+	namespace tests
+	{
+		static bool Near(float a, float b)
+		{
+			return std::fabs(a - b) < 0.0001f;
+		}
+
+		static float TranslationX(const std::shared_ptr<Bone>& bone)
+		{
+			return bone->GetLocalTransform().m_Translation.x;
+		}
+
+		// A track whose x position is the keyframe's index, at the given times.
+		static BoneKeyframeList MakeTrack(size_t boneIndex, const std::vector<float>& times)
+		{
+			BoneKeyframeList track;
+			track.boneIndex = boneIndex;
+			for (size_t k = 0; k < times.size(); k++)
+				track.positionKeyframes.push_back({times[k], avs::vec3((float)k, 0.0f, 0.0f)});
+			return track;
+		}
+
+		void RunAnimationTests()
+		{
+			std::vector<float> times;
+			for (int k = 0; k <= 20; k++)
+				times.push_back(k * 0.5f);
+			std::vector<BoneKeyframeList> tracks = { MakeTrack(0, times), MakeTrack(1, {2.0f}), MakeTrack(2, {}) };
+			// Turns a quarter turn about z, then another, with the half turn given as its negative.
+			tracks[2].rotationKeyframes.push_back({0.0f, avs::vec4(0.0f, 0.0f, 0.0f, 1.0f)});
+			tracks[2].rotationKeyframes.push_back({1.0f, avs::vec4(0.0f, 0.0f, std::sqrt(0.5f), std::sqrt(0.5f))});
+			tracks[2].rotationKeyframes.push_back({2.0f, avs::vec4(0.0f, 0.0f, -1.0f, 0.0f)});
+			// Moves a bone that the skeleton doesn't have.
+			tracks.push_back(MakeTrack(10, times));
+			Animation animation("test", tracks);
+			TELEPORT_CHECK(Near(animation.getAnimationLengthSeconds(), 10.0f));
+			TELEPORT_CHECK(animation.getTrackCount() == 4);
+			TELEPORT_CHECK(animation.getPositionKeyframeCount(0) == 21);
+			TELEPORT_CHECK(animation.getRotationKeyframeCount(2) == 3);
+
+			std::vector<std::shared_ptr<Bone>> bones;
+			for (avs::uid u = 1; u <= 3; u++)
+				bones.push_back(std::make_shared<Bone>(u, "bone"));
+			Transform untouched = bones[2]->GetLocalTransform();
+			untouched.m_Translation = avs::vec3(5.0f, 6.0f, 7.0f);
+			bones[2]->SetLocalTransform(untouched);
+
+			// On a keyframe, and between two.
+			AnimationCursor cursor;
+			animation.seekTime(cursor, bones, 1.0f);
+			TELEPORT_CHECK(Near(TranslationX(bones[0]), 2.0f));
+			TELEPORT_CHECK(cursor.positionKeyframes[0] == 2);
+			animation.seekTime(cursor, bones, 1.25f);
+			TELEPORT_CHECK(Near(TranslationX(bones[0]), 2.5f));
+			TELEPORT_CHECK(cursor.positionKeyframes[0] == 2);
+
+			// A single keyframe holds at all times; a track without positions leaves the bone where it was.
+			TELEPORT_CHECK(Near(TranslationX(bones[1]), 0.0f));
+			TELEPORT_CHECK(Near(TranslationX(bones[2]), 5.0f));
+
+			// Further on than the cursor steps, backwards, and beyond either end.
+			animation.seekTime(cursor, bones, 8.75f);
+			TELEPORT_CHECK(Near(TranslationX(bones[0]), 17.5f));
+			TELEPORT_CHECK(cursor.positionKeyframes[0] == 17);
+			animation.seekTime(cursor, bones, 0.75f);
+			TELEPORT_CHECK(Near(TranslationX(bones[0]), 1.5f));
+			TELEPORT_CHECK(cursor.positionKeyframes[0] == 1);
+			animation.seekTime(cursor, bones, -1.0f);
+			TELEPORT_CHECK(Near(TranslationX(bones[0]), 0.0f));
+			animation.seekTime(cursor, bones, 12.0f);
+			TELEPORT_CHECK(Near(TranslationX(bones[0]), 20.0f));
+			TELEPORT_CHECK(cursor.positionKeyframes[0] == 20);
+
+			// A cursor from a different animation is out of range, and is reset rather than used.
+			AnimationCursor stale;
+			stale.positionKeyframes.assign(4, 1000);
+			stale.rotationKeyframes.assign(4, 1000);
+			animation.seekTime(stale, bones, 3.0f);
+			TELEPORT_CHECK(Near(TranslationX(bones[0]), 6.0f));
+
+			// Rotations blend the shorter way round, and stay normalised.
+			animation.seekTime(cursor, bones, 0.5f);
+			quat q = bones[2]->GetLocalTransform().m_Rotation;
+			float angle = 3.1415926535f / 8.0f;
+			TELEPORT_CHECK(Near(q.k, std::sin(angle)) && Near(q.s, std::cos(angle)));
+			animation.seekTime(cursor, bones, 1.5f);
+			q = bones[2]->GetLocalTransform().m_Rotation;
+			// Halfway from a quarter turn to a half turn is three eighths, not back the long way round.
+			angle = 3.0f * 3.1415926535f / 8.0f;
+			TELEPORT_CHECK(Near(q.k, std::sin(angle)) && Near(q.s, std::cos(angle)));
+			TELEPORT_CHECK(Near(q.i * q.i + q.j * q.j + q.k * q.k + q.s * q.s, 1.0f));
+		}
+	}
+}
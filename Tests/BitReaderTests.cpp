@@ -0,0 +1,134 @@
+#include "Check.h"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "ClientRender/AVParser/BitReader.h"
+
+namespace teleport
+{
+	namespace tests
+	{
+		// Packs bits most significant first, as they are in a NAL unit.
+		struct BitPacker
+		{
+			std::vector<uint8_t> bytes;
+			size_t bitCount = 0;
+			void put(uint32_t value, size_t count)
+			{
+				for (size_t i = count; i > 0; i--)
+				{
+					if (bitCount % 8 == 0)
+						bytes.push_back(0);
+					if ((value >> (i - 1)) & 1)
+						bytes.back() |= uint8_t(0x80 >> (bitCount % 8));
+					bitCount++;
+				}
+			}
+			void putGolombU(uint32_t value)
+			{
+				uint64_t code = uint64_t(value) + 1;
+				size_t length = 0;
+				while ((code >> length) > 1)
+					length++;
+				put(0, length);
+				put(uint32_t(code), length + 1);
+			}
+		};
+
+		// Insert an emulation-prevention byte wherever two zeros are followed by a byte of 3 or less.
+		static std::vector<uint8_t> Escape(const std::vector<uint8_t>& rbsp)
+		{
+			std::vector<uint8_t> escaped;
+			int zeros = 0;
+			for (uint8_t b : rbsp)
+			{
+				if (zeros >= 2 && b <= 3)
+				{
+					escaped.push_back(3);
+					zeros = 0;
+				}
+				escaped.push_back(b);
+				zeros = b == 0 ? zeros + 1 : 0;
+			}
+			return escaped;
+		}
+
+		void RunBitReaderTests()
+		{
+			const uint8_t bits[] = { 0xA5, 0x0F, 0x12, 0x34, 0x56, 0x78, 0x9A };
+			BitReader reader(bits, sizeof(bits));
+			TELEPORT_CHECK(reader.getBitsRemaining() == 56);
+			TELEPORT_CHECK(reader.getBits(4) == 0xA);
+			TELEPORT_CHECK(!reader.getBit());
+			TELEPORT_CHECK(reader.getBit());
+			TELEPORT_CHECK(reader.getBits(2) == 1);
+			TELEPORT_CHECK(reader.getBitsRead() == 8);
+			TELEPORT_CHECK(reader.getBits(32) == 0x0F123456);
+			TELEPORT_CHECK(reader.getBits(0) == 0);
+			reader.skipBits(4);
+			TELEPORT_CHECK(reader.getByteIndex() == 5);
+			TELEPORT_CHECK(reader.getBytesRead() == 6);
+			TELEPORT_CHECK(reader.getBits(12) == 0x89A);
+			TELEPORT_CHECK(reader.getBitsRemaining() == 0);
+			// Reading past the end gives zeros.
+			TELEPORT_CHECK(reader.getBits(8) == 0);
+
+			// Exp-Golomb codes, unsigned then signed, including ones that cross the 64-bit cache.
+			BitPacker packer;
+			const uint32_t unsignedValues[] = { 0, 1, 2, 3, 6, 7, 255, 1000000, 0xFFFFFFFE };
+			for (uint32_t v : unsignedValues)
+				packer.putGolombU(v);
+			const int32_t signedValues[] = { 0, 1, -1, 2, -2, 1000, -1000 };
+			for (int32_t v : signedValues)
+				packer.putGolombU(v > 0 ? uint32_t(v) * 2 - 1 : uint32_t(-v) * 2);
+			packer.put(1, 1);
+			reader.start(packer.bytes.data(), packer.bytes.size());
+			for (uint32_t v : unsignedValues)
+				TELEPORT_CHECK(reader.getGolombU() == v);
+			for (int32_t v : signedValues)
+				TELEPORT_CHECK(reader.getGolombS() == v);
+			TELEPORT_CHECK(reader.getBit());
+
+			// Emulation-prevention bytes are skipped, but counted in the byte positions.
+			const uint8_t escaped[] = { 0x00, 0x00, 0x03, 0x01, 0x00, 0x00, 0x03, 0x00, 0xFF };
+			reader.start(escaped, sizeof(escaped));
+			TELEPORT_CHECK(reader.getBitsRemaining() == 7 * 8);
+			TELEPORT_CHECK(reader.getBits(24) == 0x000001);
+			TELEPORT_CHECK(reader.getBitsRead() == 24);
+			TELEPORT_CHECK(reader.getBytesRead() == 4);
+			TELEPORT_CHECK(reader.getBits(24) == 0);
+			TELEPORT_CHECK(reader.getByteIndex() == 8);
+			TELEPORT_CHECK(reader.getBits(8) == 0xFF);
+			TELEPORT_CHECK(reader.getBytesRead() == sizeof(escaped));
+
+			// Long random runs with many zeros, escaped, then read back in pieces of every size.
+			std::mt19937 random(1);
+			for (int n = 0; n < 20; n++)
+			{
+				std::vector<uint8_t> rbsp(1000 + random() % 1000);
+				for (uint8_t& b : rbsp)
+					b = random() % 3 ? 0 : uint8_t(random());
+				std::vector<uint8_t> data = Escape(rbsp);
+				reader.start(data.data(), data.size());
+				TELEPORT_CHECK(reader.getBitsRemaining() == rbsp.size() * 8);
+				size_t bit = 0;
+				bool matches = true;
+				while (bit + 32 <= rbsp.size() * 8)
+				{
+					size_t count = 1 + random() % 32;
+					uint32_t expected = 0;
+					for (size_t i = 0; i < count; i++, bit++)
+						expected = (expected << 1) | ((rbsp[bit / 8] >> (7 - bit % 8)) & 1);
+					if (random() % 4 == 0)
+						reader.skipBits(count);
+					else
+						matches = reader.getBits(count) == expected && matches;
+					matches = reader.getBitsRead() == bit && matches;
+				}
+				TELEPORT_CHECK(matches);
+			}
+		}
+	}
+}
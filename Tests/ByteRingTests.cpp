@@ -0,0 +1,162 @@
+#include "Check.h"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "libavstream/src/util/bytering.hpp"
+
+using namespace avs;
+
+namespace teleport
+{
+	namespace tests
+	{
+		// Pop the front buffer and check that it holds size bytes, counting up from first.
+		static bool PopSequence(ByteRing& ring, size_t size, uint8_t first)
+		{
+			std::vector<uint8_t> buffer(size + 8);
+			size_t bufferSize = buffer.size();
+			size_t bytesRead = 0;
+			if (!ring.pop(buffer.data(), bufferSize, bytesRead) || bytesRead != size)
+				return false;
+			for (size_t i = 0; i < size; i++)
+			{
+				if (buffer[i] != (uint8_t)(first + i))
+					return false;
+			}
+			return true;
+		}
+
+		static bool PushSequence(ByteRing& ring, size_t size, uint8_t first)
+		{
+			std::vector<uint8_t> buffer(size);
+			for (size_t i = 0; i < size; i++)
+				buffer[i] = (uint8_t)(first + i);
+			return ring.push(buffer.data(), size);
+		}
+
+		void RunByteRingTests()
+		{
+			ByteRing ring;
+			ring.configure(250);
+			TELEPORT_CHECK(ring.capacity() == 256);
+			TELEPORT_CHECK(ring.empty());
+			TELEPORT_CHECK(ring.maxBufferSize() == 120);
+			size_t size = 0;
+			TELEPORT_CHECK(ring.front(size) == nullptr);
+
+			// Buffers come out in the order they went in, with their own sizes, including empty ones.
+			TELEPORT_CHECK(PushSequence(ring, 5, 1));
+			TELEPORT_CHECK(PushSequence(ring, 0, 0));
+			TELEPORT_CHECK(PushSequence(ring, 16, 100));
+			TELEPORT_CHECK(!ring.empty());
+			TELEPORT_CHECK(PopSequence(ring, 5, 1));
+			TELEPORT_CHECK(PopSequence(ring, 0, 0));
+			TELEPORT_CHECK(PopSequence(ring, 16, 100));
+			TELEPORT_CHECK(ring.empty());
+
+			// Too big ever to fit.
+			TELEPORT_CHECK(!PushSequence(ring, ring.maxBufferSize() + 1, 0));
+			TELEPORT_CHECK(ring.reserve(ring.maxBufferSize() + 1) == nullptr);
+
+			// A buffer too small to pop into is told the size it needs, and the ring is left as it was.
+			TELEPORT_CHECK(PushSequence(ring, 20, 7));
+			uint8_t small[4];
+			size_t smallSize = sizeof(small);
+			size_t bytesRead = 1;
+			TELEPORT_CHECK(!ring.pop(small, smallSize, bytesRead));
+			TELEPORT_CHECK(smallSize == 20 && bytesRead == 0);
+			TELEPORT_CHECK(PopSequence(ring, 20, 7));
+
+			// A reservation can be committed smaller, but not larger, than was asked for.
+			uint8_t* dst = ring.reserve(64);
+			TELEPORT_CHECK(dst != nullptr);
+			if (dst)
+			{
+				for (uint8_t i = 0; i < 10; i++)
+					dst[i] = (uint8_t)(50 + i);
+			}
+			TELEPORT_CHECK(!ring.commit(65));
+			TELEPORT_CHECK(ring.empty());
+			TELEPORT_CHECK(ring.commit(10));
+			TELEPORT_CHECK(!ring.commit(10));
+			TELEPORT_CHECK(PopSequence(ring, 10, 50));
+
+			// Fill the ring until it refuses, then drain it: nothing is lost or overwritten.
+			// Starting from empty, records of 32 bytes fill the memory exactly.
+			ring.configure(256);
+			int pushed = 0;
+			while (PushSequence(ring, 24, (uint8_t)pushed))
+				pushed++;
+			TELEPORT_CHECK(pushed == 256 / 32);
+			for (int i = 0; i < pushed; i++)
+				TELEPORT_CHECK(PopSequence(ring, 24, (uint8_t)i));
+			TELEPORT_CHECK(ring.empty());
+
+			// Sizes that don't divide the capacity make buffers wrap around the end of memory.
+			for (int i = 0; i < 200; i++)
+			{
+				size_t s = (size_t)(i * 37) % (ring.maxBufferSize() + 1);
+				TELEPORT_CHECK(PushSequence(ring, s, (uint8_t)i));
+				TELEPORT_CHECK(PopSequence(ring, s, (uint8_t)i));
+			}
+			TELEPORT_CHECK(ring.empty());
+
+			// clear() drops everything committed.
+			TELEPORT_CHECK(PushSequence(ring, 8, 0));
+			TELEPORT_CHECK(PushSequence(ring, 8, 0));
+			ring.clear();
+			TELEPORT_CHECK(ring.empty());
+
+			// A ring sized for a maximum buffer takes a buffer of that size wherever the ring happens to be,
+			// including the largest video frame that the queues are configured for.
+			const size_t maxSizes[] = { 1, 100, 1000, 16 * 1024 * 1024 };
+			for (size_t maxSize : maxSizes)
+			{
+				ring.configure(ByteRing::capacityFor(maxSize));
+				TELEPORT_CHECK(ring.maxBufferSize() >= maxSize);
+				bool fits = true;
+				for (int i = 0; i < 8; i++)
+				{
+					// Move the ring on by an uneven amount, then write the largest buffer.
+					fits = PushSequence(ring, (size_t)(i * 13) % (maxSize + 1), 0) && fits;
+					fits = PopSequence(ring, (size_t)(i * 13) % (maxSize + 1), 0) && fits;
+					fits = PushSequence(ring, maxSize, (uint8_t)i) && fits;
+					fits = PopSequence(ring, maxSize, (uint8_t)i) && fits;
+				}
+				TELEPORT_CHECK(fits);
+				TELEPORT_CHECK(ring.empty());
+			}
+
+			// One producer and one consumer thread: every buffer arrives, in order, intact.
+			ring.configure(1024);
+			const int count = 100000;
+			std::thread producer([&ring, count]()
+				{
+					for (int i = 0; i < count; i++)
+					{
+						size_t s = (size_t)(i * 13) % 97;
+						while (!PushSequence(ring, s, (uint8_t)i))
+							std::this_thread::yield();
+					}
+				});
+			int received = 0;
+			bool intact = true;
+			while (received < count)
+			{
+				if (ring.empty())
+				{
+					std::this_thread::yield();
+					continue;
+				}
+				size_t s = (size_t)(received * 13) % 97;
+				intact = PopSequence(ring, s, (uint8_t)received) && intact;
+				received++;
+			}
+			producer.join();
+			TELEPORT_CHECK(intact);
+			TELEPORT_CHECK(ring.empty());
+		}
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <iostream>
+
+namespace teleport
+{
+	namespace tests
+	{
+		//! The number of checks that have failed so far in this run.
+		int& FailureCount();
+	}
+}
+
+//! Report, but carry on past, a condition that does not hold.
+#define TELEPORT_CHECK(x) \
+	if (!(x)) \
+	{ \
+		std::cerr << __FILE__ << "(" << __LINE__ << "): check failed: " << #x << "\n"; \
+		teleport::tests::FailureCount()++; \
+	}
@@ -0,0 +1,101 @@
+#include "Check.h"
+
+#include <algorithm>
+#include <map>
+
+#include "TeleportServer/FlatResourceMap.h"
+
+using namespace teleport::server;
+
+namespace teleport
+{
+	namespace tests
+	{
+		// Every entry of the reference is found in the map with the same value, and nothing else is.
+		static bool Matches(const FlatResourceMap<int>& map, const std::map<avs::uid, int>& reference)
+		{
+			if (map.size() != reference.size())
+				return false;
+			for (const auto& r : reference)
+			{
+				const int* value = map.find(r.first);
+				if (!value || *value != r.second)
+					return false;
+			}
+			std::vector<avs::uid> ids = map.getIDs();
+			std::sort(ids.begin(), ids.end());
+			return std::adjacent_find(ids.begin(), ids.end()) == ids.end();
+		}
+
+		void RunFlatResourceMapTests()
+		{
+			FlatResourceMap<int> map;
+			TELEPORT_CHECK(map.empty());
+			TELEPORT_CHECK(!map.find(1));
+			TELEPORT_CHECK(!map.erase(1));
+
+			// Sequential uids, as the server allocates them, through several rehashes.
+			std::map<avs::uid, int> reference;
+			for (avs::uid u = 1; u <= 1000; u++)
+			{
+				map[u] = (int)u * 3;
+				reference[u] = (int)u * 3;
+			}
+			TELEPORT_CHECK(Matches(map, reference));
+
+			// Iteration visits each entry once, in the order of getIDs().
+			size_t index = 0;
+			for (const auto& entry : map)
+			{
+				TELEPORT_CHECK(entry.first == map.getIDs()[index]);
+				index++;
+			}
+			TELEPORT_CHECK(index == map.size());
+
+			// A span views the ids in place, in the same order.
+			UidSpan span = map.getIDs();
+			TELEPORT_CHECK(span.data() == map.getIDs().data() && span.size() == map.size());
+			TELEPORT_CHECK(std::equal(span.begin(), span.end(), map.getIDs().begin()));
+			TELEPORT_CHECK(span.toVector() == map.getIDs());
+			TELEPORT_CHECK(UidSpan().empty());
+
+			// Removing entries moves others into their places, and their probe runs must still lead to them.
+			for (avs::uid u = 1; u <= 1000; u += 3)
+			{
+				TELEPORT_CHECK(map.erase(u));
+				reference.erase(u);
+			}
+			TELEPORT_CHECK(!map.erase(1));
+			TELEPORT_CHECK(Matches(map, reference));
+
+			// Indexing a uid that is already present gives its entry, rather than adding another.
+			map[2] = 7;
+			reference[2] = 7;
+			TELEPORT_CHECK(Matches(map, reference));
+
+			// Widely spread uids, removed in a different order to the one they were added in.
+			FlatResourceMap<int> spread;
+			spread.reserve(64);
+			std::map<avs::uid, int> spreadReference;
+			for (int i = 0; i < 64; i++)
+			{
+				avs::uid u = (avs::uid)i * 0x9E3779B97F4A7C15ULL + 1;
+				spread[u] = i;
+				spreadReference[u] = i;
+			}
+			for (int i = 63; i >= 0; i -= 2)
+			{
+				avs::uid u = (avs::uid)i * 0x9E3779B97F4A7C15ULL + 1;
+				TELEPORT_CHECK(spread.erase(u));
+				spreadReference.erase(u);
+			}
+			TELEPORT_CHECK(Matches(spread, spreadReference));
+
+			spread.clear();
+			TELEPORT_CHECK(spread.empty());
+			TELEPORT_CHECK(!spread.find(1));
+			spread[5] = 1;
+			TELEPORT_CHECK(spread.find(5) && *spread.find(5) == 1);
+		}
+	}
+}
@@ -0,0 +1,315 @@
+#include "Check.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "TeleportCore/MovementCodec.h"
+
+using namespace teleport::core;
+
+namespace teleport
+{
+	namespace tests
+	{
+		static MovementUpdate MakeMovement(avs::uid nodeID, const avs::vec3& position)
+		{
+			MovementUpdate update;
+			update.nodeID = nodeID;
+			update.timestamp = 1000;
+			update.position = position;
+			update.rotation = {0, 0, 0, 1.0f};
+			update.scale = {1.0f, 1.0f, 1.0f};
+			return update;
+		}
+
+		static float Distance(const avs::vec3& a, const avs::vec3& b)
+		{
+			avs::vec3 d = a - b;
+			return std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+		}
+
+		// Decode every packet in turn, failing if any is rejected.
+		static bool DecodeAll(MovementDecoder& decoder, const std::vector<MovementPacket>& packets, size_t packetCount, std::vector<MovementUpdate>& updates)
+		{
+			bool complete = true;
+			for (size_t p = 0; p < packetCount; p++)
+				complete &= decoder.decode(packets[p].command, packets[p].payload.data(), packets[p].payload.size(), updates);
+			return complete;
+		}
+
+		static void Acknowledge(MovementEncoder& encoder, const MovementDecoder& decoder)
+		{
+			encoder.acknowledge(decoder.getSequences().getLatest(), decoder.getSequences().getMask());
+		}
+
+		// The smallest three components are quantised in steps of 2/sqrt(2) over 15 bits; the largest is worked out from them.
+		static void RunRotationTests()
+		{
+			const float componentStep = 2.0f * 0.70710678f / 32767.0f;
+			std::mt19937 random(3);
+			std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+			std::vector<avs::vec4> rotations = {
+				{0, 0, 0, 1.0f}, {0, 0, 0, -1.0f}, {1.0f, 0, 0, 0}, {0, -1.0f, 0, 0},
+				// Two components of the same size, and all four.
+				{0.70710678f, 0, 0, -0.70710678f}, {0.5f, 0.5f, 0.5f, -0.5f}, {-0.5f, -0.5f, -0.5f, -0.5f}
+			};
+			for (int i = 0; i < 10000; i++)
+			{
+				avs::vec4 q = {component(random), component(random), component(random), component(random)};
+				float length = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+				if (length > 0.01f)
+					rotations.push_back({q.x / length, q.y / length, q.z / length, q.w / length});
+			}
+			float worstSmallError = 0.0f, worstLargestError = 0.0f;
+			bool flipped = true;
+			for (const avs::vec4& q : rotations)
+			{
+				avs::vec4 u = UnpackRotation(PackRotation(q));
+				float in[4] = {q.x, q.y, q.z, q.w};
+				float out[4] = {u.x, u.y, u.z, u.w};
+				int largest = 0;
+				for (int c = 1; c < 4; c++)
+				{
+					if (std::abs(out[c]) > std::abs(out[largest]))
+						largest = c;
+				}
+				// q and -q are the same rotation; the unpacked one always has its largest component positive.
+				float sign = in[largest] < 0.0f ? -1.0f : 1.0f;
+				flipped &= out[largest] >= 0.0f;
+				for (int c = 0; c < 4; c++)
+				{
+					float error = std::abs(out[c] - sign * in[c]);
+					if (c == largest)
+						worstLargestError = std::max(worstLargestError, error);
+					else
+						worstSmallError = std::max(worstSmallError, error);
+				}
+			}
+			TELEPORT_CHECK(flipped);
+			TELEPORT_CHECK(worstSmallError <= 0.5f * componentStep + 1e-6f);
+			// The largest component is at least 1/2, so the errors in the other three change it by no more than a few steps.
+			TELEPORT_CHECK(worstLargestError <= 3.0f * componentStep);
+
+			// A zero quaternion is sent as no rotation.
+			avs::vec4 identity = UnpackRotation(PackRotation({0, 0, 0, 0}));
+			TELEPORT_CHECK(std::abs(identity.x) <= componentStep && std::abs(identity.y) <= componentStep && std::abs(identity.z) <= componentStep);
+			TELEPORT_CHECK(identity.w > 0.99999f);
+		}
+
+		// Values are sent as zigzag varints of their difference from the baseline, so try differences of every size and sign.
+		static void RunDeltaTests()
+		{
+			MovementEncoder encoder;
+			MovementDecoder decoder;
+			std::vector<MovementPacket> packets;
+			const float positions[] = {0.0f, 1.0f / 1024.0f, -1.0f / 1024.0f, 0.1f, -0.1f, 100.0f, -100.0f, 2000000.0f, -2000000.0f, 0.0f};
+			const float velocities[] = {0.0f, 1.0f / 256.0f, -1.0f / 256.0f, 50.0f, -50.0f, 8000000.0f, -8000000.0f, 0.0f, 1.0f, -1.0f};
+			for (size_t i = 0; i < std::size(positions); i++)
+			{
+				MovementUpdate update = MakeMovement(7, avs::vec3(positions[i], -positions[i], 0.5f * positions[i]));
+				update.velocity = avs::vec3(velocities[i], -velocities[i], 0.0f);
+				update.angularVelocityAxis = avs::vec3(0, 1.0f, 0);
+				update.angularVelocityAngle = std::abs(velocities[i]) > 100.0f ? 10.0f : std::abs(velocities[i]);
+				size_t packetCount = encoder.encode({update}, 0, 1000, packets);
+				TELEPORT_CHECK(packetCount == 1);
+				std::vector<MovementUpdate> decoded;
+				TELEPORT_CHECK(DecodeAll(decoder, packets, packetCount, decoded));
+				TELEPORT_CHECK(decoded.size() == 1);
+				if (decoded.size() != 1)
+					continue;
+				TELEPORT_CHECK(decoded[0].nodeID == 7);
+				TELEPORT_CHECK(decoded[0].timestamp == update.timestamp);
+				TELEPORT_CHECK(Distance(decoded[0].position, update.position) <= movementPositionStep);
+				TELEPORT_CHECK(Distance(decoded[0].velocity, update.velocity) <= movementVelocityStep);
+				TELEPORT_CHECK(std::abs(decoded[0].angularVelocityAngle - update.angularVelocityAngle) <= movementAngularVelocityStep);
+				Acknowledge(encoder, decoder);
+			}
+		}
+
+		static void RunUnchangedTests()
+		{
+			MovementEncoder encoder;
+			MovementDecoder decoder;
+			std::vector<MovementPacket> packets;
+			std::vector<MovementUpdate> updates;
+			for (avs::uid id = 1; id <= 10; id++)
+				updates.push_back(MakeMovement(id * 3, avs::vec3(float(id), 0, 0)));
+			size_t packetCount = encoder.encode(updates, 0, 1000, packets);
+			std::vector<MovementUpdate> decoded;
+			TELEPORT_CHECK(DecodeAll(decoder, packets, packetCount, decoded));
+			TELEPORT_CHECK(decoded.size() == updates.size());
+
+			// Until the client acknowledges them, unchanged nodes are sent again.
+			packetCount = encoder.encode(updates, 0, 1000, packets);
+			TELEPORT_CHECK(packetCount == 1 && packets[0].command.updatesCount == updates.size());
+			decoded.clear();
+			TELEPORT_CHECK(DecodeAll(decoder, packets, packetCount, decoded));
+			Acknowledge(encoder, decoder);
+
+			// Once they are acknowledged, only the node that moved is sent.
+			TELEPORT_CHECK(encoder.encode(updates, 0, 1000, packets) == 0);
+			updates[4].position.y = 2.0f;
+			packetCount = encoder.encode(updates, 0, 1000, packets);
+			TELEPORT_CHECK(packetCount == 1 && packets[0].command.updatesCount == 1);
+			decoded.clear();
+			TELEPORT_CHECK(DecodeAll(decoder, packets, packetCount, decoded));
+			TELEPORT_CHECK(decoded.size() == 1 && decoded[0].nodeID == updates[4].nodeID);
+			if (decoded.size() == 1)
+				TELEPORT_CHECK(Distance(decoded[0].position, updates[4].position) <= movementPositionStep);
+		}
+
+		// Acknowledgements take a round trip, so the movements sent since the last one acknowledged are still outstanding.
+		static void RunLateAcknowledgementTests()
+		{
+			MovementEncoder encoder;
+			MovementDecoder decoder;
+			std::vector<MovementPacket> packets;
+			std::vector<MovementUpdate> decoded;
+			MovementUpdate still = MakeMovement(2, avs::vec3(1.0f, 0, 0));
+			MovementUpdate moving = MakeMovement(4, avs::vec3(2.0f, 0, 0));
+			size_t packetCount = encoder.encode({still, moving}, 0, 1000, packets);
+			DecodeAll(decoder, packets, packetCount, decoded);
+			uint32_t firstLatest = decoder.getSequences().getLatest();
+			uint64_t firstMask = decoder.getSequences().getMask();
+
+			// Sent again before the first is acknowledged, and received.
+			moving.position.x = 3.0f;
+			packetCount = encoder.encode({still, moving}, 0, 1000, packets);
+			TELEPORT_CHECK(packetCount == 1 && packets[0].command.updatesCount == 2);
+			DecodeAll(decoder, packets, packetCount, decoded);
+
+			// Only the first has been acknowledged. The still node was the same in both, so the client has it whichever it
+			// applied; the other must be sent again, even though it is back where it was when the first was sent.
+			encoder.acknowledge(firstLatest, firstMask);
+			moving.position.x = 2.0f;
+			packetCount = encoder.encode({still, moving}, 0, 1000, packets);
+			TELEPORT_CHECK(packetCount == 1 && packets[0].command.updatesCount == 1);
+			decoded.clear();
+			TELEPORT_CHECK(DecodeAll(decoder, packets, packetCount, decoded));
+			TELEPORT_CHECK(decoded.size() == 1 && decoded[0].nodeID == moving.nodeID);
+			if (decoded.size() == 1)
+				TELEPORT_CHECK(Distance(decoded[0].position, moving.position) <= movementPositionStep);
+		}
+
+		static void RunBaselineTests()
+		{
+			MovementEncoder encoder;
+			MovementDecoder decoder;
+			std::vector<MovementPacket> packets;
+			MovementUpdate update = MakeMovement(5, avs::vec3(10.0f, 0, 0));
+			size_t packetCount = encoder.encode({update}, 0, 1000, packets);
+			size_t fullSize = packets[0].payload.size();
+			std::vector<MovementUpdate> decoded;
+			TELEPORT_CHECK(DecodeAll(decoder, packets, packetCount, decoded));
+			Acknowledge(encoder, decoder);
+
+			// Sent as a small difference from the acknowledged movement.
+			update.position.x += 0.01f;
+			packetCount = encoder.encode({update}, 0, 1000, packets);
+			TELEPORT_CHECK(packets[0].payload.size() < fullSize);
+			std::vector<MovementPacket> lost = packets;
+
+			// That packet is lost, so the next is still a difference from the first, which the client has.
+			update.position.x += 0.01f;
+			packetCount = encoder.encode({update}, 0, 1000, packets);
+			decoded.clear();
+			TELEPORT_CHECK(DecodeAll(decoder, packets, packetCount, decoded));
+			TELEPORT_CHECK(decoded.size() == 1);
+			if (decoded.size() == 1)
+				TELEPORT_CHECK(Distance(decoded[0].position, update.position) <= movementPositionStep);
+			Acknowledge(encoder, decoder);
+
+			// The lost packet turns up late: it is older than what was applied, so it is dropped, but still acknowledged.
+			decoded.clear();
+			TELEPORT_CHECK(DecodeAll(decoder, lost, 1, decoded));
+			TELEPORT_CHECK(decoded.empty());
+
+			// A client that has lost its history can't read a difference, so doesn't acknowledge it.
+			update.position.x += 0.01f;
+			packetCount = encoder.encode({update}, 0, 1000, packets);
+			MovementDecoder freshDecoder;
+			decoded.clear();
+			TELEPORT_CHECK(!DecodeAll(freshDecoder, packets, packetCount, decoded));
+			TELEPORT_CHECK(decoded.empty());
+			TELEPORT_CHECK(!freshDecoder.getSequences().isAcknowledged(packets[0].command.sequence));
+
+			// Once every acknowledged movement has left the encoder's history, the node is sent in full again,
+			// which even a client with no history can read.
+			for (uint32_t i = 0; i < movementHistoryLength; i++)
+			{
+				update.position.x += 0.01f;
+				packetCount = encoder.encode({update}, 0, 1000, packets);
+			}
+			TELEPORT_CHECK(packets[0].payload.size() == fullSize);
+			decoded.clear();
+			TELEPORT_CHECK(DecodeAll(freshDecoder, packets, packetCount, decoded));
+			TELEPORT_CHECK(decoded.size() == 1);
+			if (decoded.size() == 1)
+				TELEPORT_CHECK(Distance(decoded[0].position, update.position) <= movementPositionStep);
+
+			// A new origin means new deltas, so everything is sent in full again.
+			Acknowledge(encoder, freshDecoder);
+			TELEPORT_CHECK(encoder.encode({update}, 0, 1000, packets) == 0);
+			MovementUpdate origin = MakeMovement(1, avs::vec3(5.0f, 0, 0));
+			packetCount = encoder.encode({origin, update}, origin.nodeID, 1000, packets);
+			TELEPORT_CHECK(packetCount == 1 && packets[0].command.updatesCount == 2);
+			MovementDecoder originDecoder;
+			decoded.clear();
+			TELEPORT_CHECK(DecodeAll(originDecoder, packets, packetCount, decoded));
+			TELEPORT_CHECK(decoded.size() == 2);
+			if (decoded.size() == 2)
+				TELEPORT_CHECK(Distance(decoded[1].position, update.position) <= movementPositionStep);
+		}
+
+		// Packets delayed on the way arrive after newer ones. However many turn up late, the client must keep the movement the
+		// server knows it has, as the server goes on sending differences from it.
+		static void RunReorderedTests()
+		{
+			MovementEncoder encoder;
+			MovementDecoder decoder;
+			std::vector<MovementPacket> packets;
+			std::vector<MovementPacket> delayed;
+			std::vector<MovementUpdate> decoded;
+			MovementUpdate update = MakeMovement(6, avs::vec3(10.0f, 0, 0));
+			for (uint32_t i = 0; i < movementHistoryLength; i++)
+			{
+				update.position.x += 0.01f;
+				size_t packetCount = encoder.encode({update}, 0, 1000, packets);
+				TELEPORT_CHECK(packetCount == 1);
+				delayed.push_back(packets[0]);
+			}
+
+			// Overtakes the others, and is acknowledged.
+			update.position.x += 0.01f;
+			size_t packetCount = encoder.encode({update}, 0, 1000, packets);
+			TELEPORT_CHECK(DecodeAll(decoder, packets, packetCount, decoded));
+			Acknowledge(encoder, decoder);
+
+			// More late movements than the client's history holds: none is applied, and none pushes out the one acknowledged.
+			decoded.clear();
+			TELEPORT_CHECK(DecodeAll(decoder, delayed, delayed.size(), decoded));
+			TELEPORT_CHECK(decoded.empty());
+			Acknowledge(encoder, decoder);
+
+			update.position.x += 0.01f;
+			packetCount = encoder.encode({update}, 0, 1000, packets);
+			TELEPORT_CHECK(packetCount == 1 && packets[0].payload.size() < delayed[0].payload.size());
+			decoded.clear();
+			TELEPORT_CHECK(DecodeAll(decoder, packets, packetCount, decoded));
+			TELEPORT_CHECK(decoded.size() == 1);
+			if (decoded.size() == 1)
+				TELEPORT_CHECK(Distance(decoded[0].position, update.position) <= movementPositionStep);
+		}
+
+		void RunMovementCodecTests()
+		{
+			RunRotationTests();
+			RunDeltaTests();
+			RunUnchangedTests();
+			RunLateAcknowledgementTests();
+			RunBaselineTests();
+			RunReorderedTests();
+		}
+	}
+}
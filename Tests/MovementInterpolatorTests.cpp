@@ -0,0 +1,87 @@
+#include "Check.h"
+
+#include <cmath>
+#include <memory>
+
+#include "ClientRender/MovementInterpolator.h"
+#include "ClientRender/Node.h"
+
+using namespace clientrender;
+
+namespace teleport
+{
+	namespace tests
+	{
+		// The server moves the node along x at a metre per second, and sends its movement at this rate.
+		static teleport::core::MovementUpdate MakeMovement(int64_t timestamp)
+		{
+			teleport::core::MovementUpdate update;
+			update.timestamp = timestamp;
+			update.isGlobal = false;
+			update.nodeID = 1;
+			update.position = avs::vec3((float)timestamp / 1000.0f, 0.0f, 0.0f);
+			update.rotation = {0.0f, 0.0f, 0.0f, 1.0f};
+			update.scale = avs::vec3(1.0f, 1.0f, 1.0f);
+			update.velocity = avs::vec3(1.0f, 0.0f, 0.0f);
+			return update;
+		}
+
+		static void RunSnapshotHistoryTests()
+		{
+			const float history_ms = 100.0f;
+			MovementSnapshots snapshots;
+			for (int64_t t = 0; t <= 1000; t += 10)
+				snapshots.Add(MakeMovement(t), history_ms);
+			// Those within the history, and the one before them.
+			TELEPORT_CHECK(snapshots.Count() == 11);
+			TELEPORT_CHECK(snapshots.snapshots.front().timestamp == 900);
+			TELEPORT_CHECK(snapshots.snapshots.back().timestamp == 1000);
+			// A late update goes in order, if it is still needed.
+			snapshots.Add(MakeMovement(1020), history_ms);
+			snapshots.Add(MakeMovement(1015), history_ms);
+			TELEPORT_CHECK(snapshots.snapshots.back().timestamp == 1020);
+			TELEPORT_CHECK(snapshots.snapshots[snapshots.Count() - 2].timestamp == 1015);
+			TELEPORT_CHECK(snapshots.snapshots.front().timestamp == 920);
+			snapshots.Add(MakeMovement(500), history_ms);
+			TELEPORT_CHECK(snapshots.snapshots.front().timestamp == 920);
+		}
+
+		// Updates at 90 Hz, rendered at 90 Hz out of step with them, 100 ms behind: the node should move as evenly as the server moved it,
+		// never holding on an old update for want of history.
+		static void RunContinuityTests()
+		{
+			const float delay_ms = 100.0f;
+			const double sendInterval_ms = 1000.0 / 90.0;
+			std::shared_ptr<Node> node = std::make_shared<Node>(1, "moving");
+			MovementInterpolator interpolator;
+			size_t sent = 0;
+			double previousX = 0.0;
+			bool started = false;
+			for (int frame = 0; frame < 900; frame++)
+			{
+				double now_ms = 1000.0 + frame * sendInterval_ms + 3.7;
+				while (sent * sendInterval_ms <= now_ms)
+				{
+					node->SetLastMovement(MakeMovement((int64_t)(sent * sendInterval_ms)), delay_ms);
+					interpolator.Add(node.get());
+					sent++;
+				}
+				double renderTime_ms = now_ms - delay_ms;
+				interpolator.Update(renderTime_ms, 250.0f);
+				double x = node->GetLocalPosition().x;
+				TELEPORT_CHECK(std::fabs(x - renderTime_ms / 1000.0) < 0.0005);
+				if (started)
+					TELEPORT_CHECK(std::fabs(x - previousX - sendInterval_ms / 1000.0) < 0.0005);
+				previousX = x;
+				started = true;
+				TELEPORT_CHECK(node->GetMovementSnapshots().Count() <= size_t(delay_ms / sendInterval_ms) + 2);
+			}
+		}
+
+		void RunMovementInterpolatorTests()
+		{
+			RunSnapshotHistoryTests();
+			RunContinuityTests();
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#include "Check.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "TeleportCore/ResourceInventory.h"
+
+using namespace teleport::core;
+
+namespace teleport
+{
+	namespace tests
+	{
+		static bool Decode(const std::vector<uint8_t>& inventory, uint64_t count, std::vector<avs::uid>& ids)
+		{
+			return DecodeResourceInventory(inventory.data(), inventory.size(), count, ids);
+		}
+
+		void RunResourceInventoryTests()
+		{
+			std::vector<uint8_t> inventory;
+			std::vector<avs::uid> decoded;
+			TELEPORT_CHECK(EncodeResourceInventory({}, inventory) == 0);
+			TELEPORT_CHECK(inventory.empty());
+			TELEPORT_CHECK(Decode(inventory, 0, decoded) && decoded.empty());
+
+			// Unsorted, with duplicates, gaps, and both ends of the range.
+			std::vector<avs::uid> ids = { 7, 3, 3, 0, 1000000, 8, UINT64_MAX, 1ull << 63, 129, 7 };
+			size_t count = EncodeResourceInventory(ids, inventory);
+			std::sort(ids.begin(), ids.end());
+			ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+			TELEPORT_CHECK(count == ids.size());
+			TELEPORT_CHECK(Decode(inventory, count, decoded) && decoded == ids);
+
+			// Ids are appended to those already in the list.
+			std::vector<avs::uid> appended = { 42 };
+			TELEPORT_CHECK(Decode(inventory, count, appended));
+			TELEPORT_CHECK(appended.size() == ids.size() + 1 && appended[0] == 42 && appended[1] == 0);
+
+			// Ids given out in sequence take a byte each.
+			std::vector<avs::uid> sequence;
+			for (avs::uid u = 1; u <= 1000; u++)
+				sequence.push_back(u);
+			TELEPORT_CHECK(EncodeResourceInventory(sequence, inventory) == 1000);
+			TELEPORT_CHECK(inventory.size() == 1000);
+			decoded.clear();
+			TELEPORT_CHECK(Decode(inventory, 1000, decoded) && decoded == sequence);
+
+			// The wrong count, whether too many or too few.
+			decoded.clear();
+			TELEPORT_CHECK(!Decode(inventory, 1001, decoded));
+			decoded.clear();
+			TELEPORT_CHECK(!Decode(inventory, 999, decoded));
+
+			// Cut off part way through a varint.
+			EncodeResourceInventory({ 300 }, inventory);
+			TELEPORT_CHECK(inventory.size() == 2);
+			inventory.pop_back();
+			decoded.clear();
+			TELEPORT_CHECK(!Decode(inventory, 1, decoded));
+
+			// The largest id takes ten bytes, the last of which may only be 1.
+			EncodeResourceInventory({ UINT64_MAX }, inventory);
+			TELEPORT_CHECK(inventory.size() == 10 && inventory.back() == 1);
+			decoded.clear();
+			TELEPORT_CHECK(Decode(inventory, 1, decoded) && decoded[0] == UINT64_MAX);
+			inventory.back() = 2;
+			decoded.clear();
+			TELEPORT_CHECK(!Decode(inventory, 1, decoded));
+			inventory.back() = 0x81;
+			inventory.push_back(0);
+			decoded.clear();
+			TELEPORT_CHECK(!Decode(inventory, 1, decoded));
+
+			// A delta that would take the id past the largest.
+			EncodeResourceInventory({ UINT64_MAX }, inventory);
+			inventory.push_back(1);
+			decoded.clear();
+			TELEPORT_CHECK(!Decode(inventory, 2, decoded));
+		}
+	}
+}
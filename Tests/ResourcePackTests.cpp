@@ -0,0 +1,61 @@
+#include "Check.h"
+
+#include <filesystem>
+#include <map>
+#include <string>
+
+#include "TeleportServer/ResourcePack.h"
+
+using namespace teleport::server;
+
+namespace teleport
+{
+	namespace tests
+	{
+		// The records of the pack at filename, read back through its mapping.
+		static std::map<std::string, std::string> ReadPack(const std::string& filename)
+		{
+			std::map<std::string, std::string> contents;
+			ResourcePack pack;
+			if (!pack.open(filename))
+				return contents;
+			for (const auto& r : pack.getRecords())
+				contents[r.first] = std::string((const char*)pack.getRecordData(r.second), (size_t)r.second.size);
+			return contents;
+		}
+
+		void RunResourcePackTests()
+		{
+			std::string filename = (std::filesystem::temp_directory_path() / "teleport_resource_pack_test.pack").string();
+			std::error_code ec;
+			std::filesystem::remove(filename, ec);
+
+			ResourcePack missing;
+			TELEPORT_CHECK(!missing.open(filename));
+
+			std::map<std::string, std::string> expected = { {"a", "first"}, {"b", "second"}, {"c", std::string(1000, 'c')} };
+			TELEPORT_CHECK(ResourcePack::Update(filename, expected));
+			TELEPORT_CHECK(ReadPack(filename) == expected);
+
+			// Replacing one record and adding another appends them, leaving the rest where they are.
+			TELEPORT_CHECK(ResourcePack::Update(filename, { {"a", "replaced"}, {"d", "fourth"} }));
+			expected["a"] = "replaced";
+			expected["d"] = "fourth";
+			TELEPORT_CHECK(ReadPack(filename) == expected);
+
+			// Removed records are no longer listed, even with nothing new to write.
+			TELEPORT_CHECK(ResourcePack::Update(filename, {}, { "b", "not in the pack" }));
+			expected.erase("b");
+			TELEPORT_CHECK(ReadPack(filename) == expected);
+
+			// Once most of the file is removed data, the pack is rewritten without it.
+			uintmax_t sizeBefore = std::filesystem::file_size(filename);
+			TELEPORT_CHECK(ResourcePack::Update(filename, {}, { "c" }));
+			expected.erase("c");
+			TELEPORT_CHECK(ReadPack(filename) == expected);
+			TELEPORT_CHECK(std::filesystem::file_size(filename) + 1000 <= sizeBefore);
+
+			std::filesystem::remove(filename, ec);
+		}
+	}
+}
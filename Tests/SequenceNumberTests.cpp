@@ -0,0 +1,106 @@
+#include "Check.h"
+
+#include <cstdint>
+
+#include "TeleportCore/SequenceNumber.h"
+
+using namespace teleport::core;
+
+namespace teleport
+{
+	namespace tests
+	{
+		static void RunNewerTests()
+		{
+			TELEPORT_CHECK(IsSequenceNewer(2, 1));
+			TELEPORT_CHECK(!IsSequenceNewer(1, 2));
+			TELEPORT_CHECK(!IsSequenceNewer(7, 7));
+			// Across the wrap, and up to half the range either way.
+			TELEPORT_CHECK(IsSequenceNewer(0, UINT32_MAX));
+			TELEPORT_CHECK(IsSequenceNewer(5, UINT32_MAX - 5));
+			TELEPORT_CHECK(!IsSequenceNewer(UINT32_MAX, 0));
+			TELEPORT_CHECK(IsSequenceNewer(0x80000000u - 1, 0));
+			TELEPORT_CHECK(!IsSequenceNewer(0x80000000u + 1, 0));
+		}
+
+		static void RunReceiveTests()
+		{
+			SequenceWindow window;
+			TELEPORT_CHECK(window.receive(10));
+			TELEPORT_CHECK(window.receive(12));
+			// Older than the newest, or the same: stale, whether late or duplicated.
+			TELEPORT_CHECK(!window.receive(11));
+			TELEPORT_CHECK(!window.receive(12));
+			TELEPORT_CHECK(!window.receive(10));
+			TELEPORT_CHECK(window.getLatest() == 12);
+
+			// Through the wrap, packets in order are all new, and one from before it is stale.
+			window.reset();
+			uint32_t sequence = UINT32_MAX - 2;
+			for (int i = 0; i < 6; i++)
+				TELEPORT_CHECK(window.receive(sequence++));
+			TELEPORT_CHECK(window.getLatest() == 2);
+			TELEPORT_CHECK(!window.receive(UINT32_MAX));
+			TELEPORT_CHECK(!window.receive(UINT32_MAX - 40));
+			TELEPORT_CHECK(window.receive(3));
+
+			// Out of order across the wrap: 0 arrives before UINT32_MAX, which is then dropped.
+			window.reset();
+			TELEPORT_CHECK(window.receive(UINT32_MAX - 1));
+			TELEPORT_CHECK(window.receive(0));
+			TELEPORT_CHECK(!window.receive(UINT32_MAX));
+			TELEPORT_CHECK(window.getLatest() == 0);
+		}
+
+		static void RunAcknowledgeTests()
+		{
+			// The receiver acknowledges the packets it used, across the wrap.
+			SequenceWindow receiver;
+			const uint32_t first = UINT32_MAX - 3;
+			for (uint32_t i = 0; i < 9; i++)
+			{
+				uint32_t sequence = first + i;
+				// Every third packet is lost.
+				if (i % 3 == 1)
+					continue;
+				if (receiver.receive(sequence))
+					receiver.acknowledge(sequence);
+			}
+			TELEPORT_CHECK(receiver.getLatest() == first + 8);
+			for (uint32_t i = 0; i < 9; i++)
+				TELEPORT_CHECK(receiver.isAcknowledged(first + i) == (i % 3 != 1));
+			TELEPORT_CHECK(!receiver.isAcknowledged(first + 9));
+
+			// The sender merges reports, whatever order they arrive in.
+			SequenceWindow sender;
+			SequenceWindow earlier;
+			earlier.acknowledge(first);
+			earlier.acknowledge(first + 2);
+			sender.acknowledge(receiver.getLatest(), receiver.getMask());
+			sender.acknowledge(earlier.getLatest(), earlier.getMask());
+			for (uint32_t i = 0; i < 9; i++)
+				TELEPORT_CHECK(sender.isAcknowledged(first + i) == receiver.isAcknowledged(first + i));
+
+			// Only the last windowSize packets are remembered.
+			SequenceWindow window;
+			window.acknowledge(100);
+			TELEPORT_CHECK(window.isAcknowledged(100));
+			window.acknowledge(100 + SequenceWindow::windowSize - 1);
+			TELEPORT_CHECK(window.isAcknowledged(100));
+			window.acknowledge(100 + SequenceWindow::windowSize);
+			TELEPORT_CHECK(!window.isAcknowledged(100));
+			TELEPORT_CHECK(window.isAcknowledged(100 + SequenceWindow::windowSize - 1));
+			// A jump of more than the window forgets everything before it.
+			window.receive(1000);
+			TELEPORT_CHECK(window.getMask() == 0);
+			TELEPORT_CHECK(!window.isAcknowledged(100 + SequenceWindow::windowSize));
+		}
+
+		void RunSequenceNumberTests()
+		{
+			RunNewerTests();
+			RunReceiveTests();
+			RunAcknowledgeTests();
+		}
+	}
+}
@@ -0,0 +1,73 @@
+#include "Check.h"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "libavstream/src/util/startcode.hpp"
+
+using namespace avs;
+
+namespace teleport
+{
+	namespace tests
+	{
+		// The same search, a byte at a time.
+		static size_t FindStartCodeReference(const uint8_t* data, size_t from, size_t size)
+		{
+			for (size_t i = from; i + 2 < size; i++)
+			{
+				if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1)
+					return i + 2;
+			}
+			return size;
+		}
+
+		void RunStartCodeTests()
+		{
+			TELEPORT_CHECK(findStartCode(nullptr, 0, 0) == 0);
+			const uint8_t code[] = { 0, 0, 1 };
+			TELEPORT_CHECK(findStartCode(code, 0, 3) == 2);
+			TELEPORT_CHECK(findStartCode(code, 1, 3) == 3);
+			TELEPORT_CHECK(findStartCode(code, 0, 2) == 2);
+			// A four-byte start code is found by its last three bytes.
+			const uint8_t longCode[] = { 0x65, 0, 0, 0, 1, 0x40 };
+			TELEPORT_CHECK(findStartCode(longCode, 0, 6) == 4);
+
+			// A start code at every offset in buffers long enough for whole blocks, so that each lies
+			// within a block, across two blocks, and in the bytes after the last block.
+			std::vector<uint8_t> data(100, 0xFF);
+			for (size_t at = 0; at + 3 <= data.size(); at++)
+			{
+				data[at] = 0;
+				data[at + 1] = 0;
+				data[at + 2] = 1;
+				TELEPORT_CHECK(findStartCode(data.data(), 0, data.size()) == at + 2);
+				// Not found once the search starts past its first byte.
+				TELEPORT_CHECK(findStartCode(data.data(), at + 1, data.size()) == data.size());
+				// Nor if the buffer ends before its last byte.
+				TELEPORT_CHECK(findStartCode(data.data(), 0, at + 2) == at + 2);
+				data[at] = data[at + 1] = data[at + 2] = 0xFF;
+			}
+
+			// Bytes that are mostly 0 and 1 give many near misses; every search must agree with the reference.
+			std::mt19937 random(1);
+			std::uniform_int_distribution<int> byte(0, 3);
+			for (int n = 0; n < 200; n++)
+			{
+				data.resize(random() % 200);
+				for (uint8_t& b : data)
+					b = (uint8_t)byte(random);
+				size_t from = 0;
+				while (true)
+				{
+					size_t found = findStartCode(data.data(), from, data.size());
+					TELEPORT_CHECK(found == FindStartCodeReference(data.data(), from, data.size()));
+					if (found >= data.size())
+						break;
+					from = found + 1;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,51 @@
+#include "Check.h"
+
+namespace teleport
+{
+	namespace tests
+	{
+		void RunByteRingTests();
+		void RunFlatResourceMapTests();
+		void RunResourceInventoryTests();
+		void RunResourcePackTests();
+		void RunStartCodeTests();
+		void RunMovementCodecTests();
+		void RunSequenceNumberTests();
+#if TELEPORT_TESTS_CLIENT
+		void RunAnimationTests();
+		void RunBitReaderTests();
+		void RunMovementInterpolatorTests();
+#endif
+
+		int& FailureCount()
+		{
+			static int failureCount = 0;
+			return failureCount;
+		}
+	}
+}
+
+using namespace teleport::tests;
+
+int main(int, char**)
+{
+	RunByteRingTests();
+	RunFlatResourceMapTests();
+	RunResourceInventoryTests();
+	RunResourcePackTests();
+	RunStartCodeTests();
+	RunMovementCodecTests();
+	RunSequenceNumberTests();
+#if TELEPORT_TESTS_CLIENT
+	RunAnimationTests();
+	RunBitReaderTests();
+	RunMovementInterpolatorTests();
+#endif
+	if (FailureCount())
+	{
+		std::cerr << FailureCount() << " checks failed.\n";
+		return 1;
+	}
+	std::cout << "All checks passed.\n";
+	return 0;
+}
@@ -1425,7 +1425,7 @@ void ClientRenderer::DrawOSD(OVRFW::ovrRendererOutput& res)
 		{
 			std::ostringstream sstr;
 			std::setprecision(5);
-			const std::vector<uid> texture_uids=geometryCache.mTextureManager.GetAllIDs();
+			const std::vector<uid> texture_uids=*geometryCache.mTextureManager.GetAllIDs();
 			if(osd_selection>=texture_uids.size())
 				osd_selection=0;
 			sstr << "Textures\n\n" << std::setw(4);
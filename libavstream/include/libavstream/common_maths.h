@@ -87,7 +87,7 @@ namespace avs
 
 		float Length() const
 		{
-			return std::sqrtf(x * x + y * y);
+			return std::sqrt(x * x + y * y);
 		}
 
 		vec2 Normalised() const
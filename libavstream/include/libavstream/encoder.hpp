@@ -29,6 +29,8 @@ struct EncoderStats
 	size_t framesEncoded = 0;
 	/*! Number of frames encoded per second in the current session. */
 	float framesEncodedPerSec = 0;
+	/*! Number of encoded frames the output could not take, each followed by an IDR frame. */
+	size_t framesDropped = 0;
 };
 
 /*!
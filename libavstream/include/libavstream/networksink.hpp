@@ -133,7 +133,13 @@ namespace avs
 		void setEstimatedDecodingFrequency(uint8_t estimatedDecodingFrequency);	
 		void setProcessingEnabled(bool enable);
 		bool isProcessingEnabled() const;
+		/*!
+		 * Whether packets are held back by throttling, to be sent by a later call to process().
+		 * Call only from the thread that calls process().
+		 */
+		bool hasThrottledData() const;
 	protected:
+		Result sendInput(uint32_t inputNodeIndex, const uint8_t* buffer, size_t bufferSize);
 		Result packData(const uint8_t* buffer, size_t bufferSize, uint32_t inputNodeIndex);
 		void sendData(const std::vector<uint8_t>& subPacket);
 		void closeConnection();
@@ -5,6 +5,7 @@
 
 #include <libavstream/common.hpp>
 #include <libavstream/node.hpp>
+#include <functional>
 #include <vector>
 
 namespace avs
@@ -14,6 +15,11 @@ namespace avs
  *
  * A thread-safe, nonblocking, producer-consumer queue of byte buffers.
  *
+ * By default the queue is guarded by a mutex, and grows when it is full.
+ * Configured with configureSPSC() it is instead a fixed-size lock-free ring, which is only safe with
+ * exactly one thread writing and one thread reading; the writer can then use reserve() and commit()
+ * to build a buffer in place rather than copying it in with write().
+ *
  * \note Sharing an instance of this node is the recommended way to link two pipelines running on different threads.
  */
 	class AVSTREAM_API Queue final : public PipelineNode
@@ -39,6 +45,7 @@ namespace avs
 		const void* frontp(size_t& bufferSize) const;
 		void push(const void* buffer, size_t bufferSize);
 		void pop();
+		void notifyWrite();
 	public:
 		Queue();
 
@@ -60,6 +67,19 @@ namespace avs
 		 */
 		Result configure(size_t maxBufferSize, size_t maxBuffers, const char *name);
 
+		/*!
+		 * Configure queue as a lock-free single-producer, single-consumer ring of variable-size buffers.
+		 * Unlike the locking queue, the ring can't grow, so a larger buffer than maxBufferSize is refused.
+		 * \param maxBufferSize Maximum size of a buffer in the queue.
+		 * \param capacity Total size in bytes of the ring. Each buffer takes its size rounded up to 8 bytes, plus 8,
+		 *                 and a buffer can be at most half the capacity, so the ring is made larger if needed to hold maxBufferSize.
+		 * \warning Reconfiguring an already configured Queue performs an implicit flush.
+		 * \return
+		 *  - Result::OK on success.
+		 *  - Result::Node_InvalidConfiguration if maxBufferSize or capacity is zero.
+		 */
+		Result configureSPSC(size_t maxBufferSize, size_t capacity, const char *name);
+
 		/*!
 		 * Flush & deconfigure queue.
 		 * \return Always returns Result::OK.
@@ -68,6 +88,7 @@ namespace avs
 
 		/*!
 		 * Flush queue.
+		 * \note In SPSC mode, this must be called from the reading thread.
 		 */
 		void flush();
 
@@ -92,6 +113,50 @@ namespace avs
 		 */
 		Result write(PipelineNode*, const void* buffer, size_t bufferSize, size_t& bytesWritten) override;
 
+		/*!
+		 * Get the buffer at the front of the queue without copying it. SPSC mode only, and only from the reading thread.
+		 * The buffer stays valid, and in the queue, until discardFront() is called.
+		 * \return
+		 *  - Result::OK on success.
+		 *  - Result::IO_Empty if the queue is empty.
+		 *  - Result::Node_NotSupported if the queue is not in SPSC mode: use read() instead.
+		 */
+		Result peek(const void** buffer, size_t& bufferSize);
+
+		/*!
+		 * Remove the buffer at the front of the queue, after peek(). SPSC mode only.
+		 */
+		void discardFront();
+
+		/*!
+		 * Get space at the back of the queue to write a buffer of up to maxBufferSize bytes directly. SPSC mode only.
+		 * \return
+		 *  - Result::OK on success, with the space written to buffer.
+		 *  - Result::IO_Full if there is not room for the buffer until more has been read.
+		 *  - Result::IO_InvalidArgument if the buffer is larger than half the capacity, so could never fit.
+		 *  - Result::Node_NotConfigured if the queue is not in SPSC mode.
+		 */
+		Result reserve(size_t maxBufferSize, void** buffer);
+
+		/*!
+		 * Make the reserved buffer available to the reader, with its actual size. SPSC mode only.
+		 * \return
+		 *  - Result::OK on success.
+		 *  - Result::IO_InvalidArgument if nothing was reserved, or bufferSize is larger than the reservation.
+		 */
+		Result commit(size_t bufferSize);
+
+		/*!
+		 * Whether the queue has no buffers to read. In SPSC mode, this must be called from the reading thread.
+		 */
+		bool empty();
+
+		/*!
+		 * Set a function to be called on the writing thread after each buffer is added, so that the reader can wait
+		 * for data rather than polling. Set it before the queue is shared between threads.
+		 */
+		void setWriteNotification(std::function<void()> notification);
+
 	
 		/*!
 		 * Get node display name (for reporting & profiling).
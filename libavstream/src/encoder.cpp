@@ -167,10 +167,15 @@ Result Encoder::process(uint64_t timestamp, uint64_t deltaTime)
 
 	// Next tell the backend encoder to actually encode a frame.
 	assert(d().m_backend);
-	Result result = d().m_backend->encodeFrame(timestamp, d().m_forceIDR);
+	bool frameDropped = d().m_frameDropped.exchange(false);
+	Result result = d().m_backend->encodeFrame(timestamp, d().m_forceIDR || frameDropped);
 
 	if (!result)
 	{
+		if (frameDropped)
+		{
+			d().m_frameDropped = true;
+		}
 		return result;
 	}
 
@@ -212,12 +217,18 @@ Result Encoder::writeOutput()
 	}
 
 	result = d().writeOutput(outputNode, mappedBuffer, mappedBufferSize);
+	Result unmapResult = d().m_backend->unmapOutputBuffer();
 	if (!result)
 	{
+		// The output is full, or the frame is larger than it can ever hold. Drop the frame, and start again from an IDR frame.
+		AVSLOG(Warning) << "Encoder: Dropped a video frame of " << mappedBufferSize << " bytes; the next frame will be an IDR frame";
+		d().m_frameDropped = true;
+		std::lock_guard<std::mutex> lock(d().m_statsMutex);
+		++d().m_stats.framesDropped;
 		return result;
 	}
 
-	return d().m_backend->unmapOutputBuffer();
+	return unmapResult;
 }
 
 void Encoder::writeOutputAsync()
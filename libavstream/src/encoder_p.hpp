@@ -32,6 +32,8 @@ namespace avs
 		bool m_surfaceRegistered = false;
 		bool m_outputPending = false;
 		bool m_forceIDR = false;
+		// Set when the output could not take a frame: the client can't decode those that follow it until the next IDR frame.
+		std::atomic_bool m_frameDropped{false};
 
 		Result writeOutput(IOInterface* outputNode, const void* mappedBuffer, size_t mappedBufferSize);
 		Result ConfigureTagDataQueue();
@@ -5,6 +5,7 @@
 #include <network/packetformat.hpp>
 
 #include <util/srtutil.h>
+#include <libavstream/queue.hpp>
 
 #include <iostream>
 #include <cmath>
@@ -145,6 +146,7 @@ Result NetworkSink::deconfigure()
 	{
 		m_data->m_dataQueue.pop();
 	}
+	m_data->m_spareBuffers.clear();
 
 	m_data->m_EFPSender.reset();
 	m_data->m_parsers.clear();
@@ -197,9 +199,10 @@ Result NetworkSink::process(uint64_t timestamp, uint64_t deltaTime)
 	SRTSOCKET srtrwfds[4] = { SRT_INVALID_SOCK, SRT_INVALID_SOCK, SRT_INVALID_SOCK, SRT_INVALID_SOCK };
 	int sysrfdslen = 2;
 	SYSSOCKET sysrfds[2];
+	// Wait for a connection, but once connected only poll: the caller waits for data to send.
 	if (srt_epoll_wait(m_data->pollid,
 		&srtrwfds[0], &srtrfdslen, &srtrwfds[2], &srtwfdslen,
-		100,
+		m_data->bConnected ? 0 : 100,
 		&sysrfds[0], &sysrfdslen, 0, 0) >= 0)
 	{
 		for (size_t i = 0; i < sizeof(srtrwfds) / sizeof(SRTSOCKET); i++)
@@ -343,10 +346,37 @@ Result NetworkSink::process(uint64_t timestamp, uint64_t deltaTime)
 			while (!m_data->m_dataQueue.empty() && m_data->m_packetsSent < m_data->m_maxPacketsAllowed)
 			{
 				sendData(m_data->m_dataQueue.front());
+				// Keep the storage to hold a later packet, rather than freeing and reallocating it.
+				if (m_data->m_spareBuffers.size() < m_data->m_maxSpareBuffers)
+				{
+					m_data->m_spareBuffers.push_back(std::move(m_data->m_dataQueue.front()));
+				}
 				m_data->m_dataQueue.pop();
 			}
 		}
 
+		// A lock-free queue can be read in place: its buffer is packed and sent straight from the queue's memory.
+		if (Queue* queue = dynamic_cast<Queue*>(getInput(i)))
+		{
+			const void* inPlaceBuffer = nullptr;
+			size_t inPlaceSize = 0;
+			Result peekResult = queue->peek(&inPlaceBuffer, inPlaceSize);
+			if (peekResult != Result::Node_NotSupported)
+			{
+				if (peekResult != Result::OK)
+				{
+					continue;
+				}
+				Result res = inPlaceSize ? sendInput(i, (const uint8_t*)inPlaceBuffer, inPlaceSize) : Result::OK;
+				queue->discardFront();
+				if (!res)
+				{
+					return res;
+				}
+				continue;
+			}
+		}
+
 		size_t numBytesRead = 0;
 		try
 		{
@@ -368,15 +398,7 @@ Result NetworkSink::process(uint64_t timestamp, uint64_t deltaTime)
 		{
 			continue;
 		}
-		Result res = Result::OK;
-		if (stream.useParser && m_data->m_parsers.find(i) != m_data->m_parsers.end())
-		{
-			res = m_data->m_parsers[i]->parse((const char*)stream.buffer.data(), numBytesRead);
-		}
-		else
-		{
-			res = packData(stream.buffer.data(), numBytesRead, i);
-		}
+		Result res = sendInput(i, stream.buffer.data(), numBytesRead);
 		if (!res)
 		{
 			return res;
@@ -388,6 +410,16 @@ Result NetworkSink::process(uint64_t timestamp, uint64_t deltaTime)
 	return Result::OK;
 }
 
+Result NetworkSink::sendInput(uint32_t inputNodeIndex, const uint8_t* buffer, size_t bufferSize)
+{
+	const NetworkSinkStream& stream = m_data->m_streams[inputNodeIndex];
+	if (stream.useParser && m_data->m_parsers.find(inputNodeIndex) != m_data->m_parsers.end())
+	{
+		return m_data->m_parsers[inputNodeIndex]->parse((const char*)buffer, bufferSize);
+	}
+	return packData(buffer, bufferSize, inputNodeIndex);
+}
+
 void NetworkSink::setProcessingEnabled(bool enable)
 {
 	m_data->m_processingEnabled = enable;
@@ -398,6 +430,11 @@ bool NetworkSink::isProcessingEnabled() const
 	return m_data->m_processingEnabled;
 }
 
+bool NetworkSink::hasThrottledData() const
+{
+	return !m_data->m_dataQueue.empty();
+}
+
 
 void NetworkSink::updateCounters(uint64_t timestamp, uint32_t deltaTime)
 {
@@ -502,7 +539,14 @@ void NetworkSink::sendOrCacheData(const std::vector<uint8_t>& subPacket)
 
 	if (stream.isDataLimitPerFrame && m_data->m_packetsSent >= m_data->m_maxPacketsAllowed)
 	{
-		m_data->m_dataQueue.push(subPacket);
+		std::vector<uint8_t> cached;
+		if (!m_data->m_spareBuffers.empty())
+		{
+			cached = std::move(m_data->m_spareBuffers.back());
+			m_data->m_spareBuffers.pop_back();
+		}
+		cached.assign(subPacket.begin(), subPacket.end());
+		m_data->m_dataQueue.push(std::move(cached));
 		return;
 	}
 
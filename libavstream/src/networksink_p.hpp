@@ -61,6 +61,9 @@ namespace avs
 		std::unordered_map<int, uint32_t> m_streamIndices;
 		NetworkSinkParams m_params;
 		std::queue<std::vector<uint8_t>> m_dataQueue;
+		/** Storage of packets already sent from m_dataQueue, reused for packets that are queued later. */
+		std::vector<std::vector<uint8_t>> m_spareBuffers;
+		size_t m_maxSpareBuffers = 256;
 		size_t m_maxPacketsAllowedPerSecond;
 		size_t m_maxPacketsAllowed;
 		/** Packets sent this frame */
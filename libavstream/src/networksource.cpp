@@ -126,20 +126,13 @@ Result NetworkSource::configure(std::vector<NetworkSourceStream>&& streams, cons
 		}
 
 		size_t bufferSize = sizeof(StreamPayloadInfo) + rPacket->mFrameSize;
-		if (bufferSize > m_data->m_tempBuffer.size())
-		{
-			m_data->m_tempBuffer.resize(bufferSize);
-		}
-		
+
 		StreamPayloadInfo frameInfo;
 		frameInfo.frameID = rPacket->mPts;
 		frameInfo.dataSize = rPacket->mFrameSize;
 		frameInfo.connectionTime = TimerUtil::GetElapsedTimeS();
 		frameInfo.broken = rPacket->mBroken;
 
-		memcpy(m_data->m_tempBuffer.data(), &frameInfo, sizeof(StreamPayloadInfo));
-		memcpy(&m_data->m_tempBuffer[sizeof(StreamPayloadInfo)], rPacket->pFrameData, rPacket->mFrameSize);
-
 		int nodeIndex = m_data->m_streamNodeMap[rPacket->mStreamID];
 
 		auto outputNode = dynamic_cast<Queue*>(getOutput(nodeIndex));
@@ -149,6 +142,29 @@ Result NetworkSource::configure(std::vector<NetworkSourceStream>&& streams, cons
 			return;
 		}
 
+		// A lock-free queue gives us its own memory to build the frame in, so it is copied only once.
+		void* dst = nullptr;
+		Result reserveResult = outputNode->reserve(bufferSize, &dst);
+		if (reserveResult != Result::Node_NotConfigured)
+		{
+			if (!reserveResult)
+			{
+				AVSLOG(Warning) << "NetworkSource EFP Callback: No room in output node for frame of size " << unsigned(bufferSize) << ".";
+				return;
+			}
+			memcpy(dst, &frameInfo, sizeof(StreamPayloadInfo));
+			memcpy((uint8_t*)dst + sizeof(StreamPayloadInfo), rPacket->pFrameData, rPacket->mFrameSize);
+			outputNode->commit(bufferSize);
+			return;
+		}
+
+		if (bufferSize > m_data->m_tempBuffer.size())
+		{
+			m_data->m_tempBuffer.resize(bufferSize);
+		}
+		memcpy(m_data->m_tempBuffer.data(), &frameInfo, sizeof(StreamPayloadInfo));
+		memcpy(&m_data->m_tempBuffer[sizeof(StreamPayloadInfo)], rPacket->pFrameData, rPacket->mFrameSize);
+
 		size_t numBytesWrittenToOutput;
 		auto result = outputNode->write(m_data->q_ptr(), m_data->m_tempBuffer.data(), bufferSize, numBytesWrittenToOutput);
 
@@ -30,6 +30,8 @@ namespace avs
 		name=n;
 		std::lock_guard<std::mutex> lock(m_mutex);
 		flushInternal();
+		data->m_spsc = false;
+		data->m_ring.deconfigure();
 		m_originalMaxBufferSize = maxBufferSize;
 		m_originalMaxBuffers = maxBuffers;
 		m_maxBufferSize = maxBufferSize;
@@ -45,10 +47,32 @@ namespace avs
 		return Result::OK;
 	}
 
+	Result Queue::configureSPSC(size_t maxBufferSize, size_t capacity, const char *n)
+	{
+		if (maxBufferSize == 0 || capacity == 0)
+		{
+			return Result::Node_InvalidConfiguration;
+		}
+		name=n;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		flushInternal();
+		m_originalMaxBufferSize = 0;
+		m_originalMaxBuffers = 0;
+		m_maxBufferSize = 0;
+		m_maxBuffers = 0;
+		m_numElements = 0;
+		m_front = -1;
+		data->m_ring.configure(std::max(capacity, ByteRing::capacityFor(maxBufferSize)));
+		data->m_spsc = true;
+		return Result::OK;
+	}
+
 	Result Queue::deconfigure()
 	{
 		std::lock_guard<std::mutex> lock(m_mutex);
 		flushInternal();
+		data->m_spsc = false;
+		data->m_ring.deconfigure();
 		m_originalMaxBufferSize = 0;
 		m_originalMaxBuffers = 0;
 		m_maxBufferSize = 0;
@@ -60,6 +84,11 @@ namespace avs
 
 	void Queue::flush()
 	{
+		if (data->m_spsc)
+		{
+			data->m_ring.clear();
+			return;
+		}
 		std::lock_guard<std::mutex> lock(m_mutex);
 		flushInternal();
 	}
@@ -67,6 +96,24 @@ namespace avs
 	Result Queue::read(PipelineNode*, void* buffer, size_t& bufferSize, size_t& bytesRead)
 	{
 		bytesRead = 0;
+		if (data->m_spsc)
+		{
+			size_t frontSize = 0;
+			const uint8_t* front = data->m_ring.front(frontSize);
+			if (!front)
+			{
+				return Result::IO_Empty;
+			}
+			if (!buffer || bufferSize < frontSize)
+			{
+				bufferSize = frontSize;
+				return Result::IO_Retry;
+			}
+			std::memcpy(buffer, front, frontSize);
+			bytesRead = frontSize;
+			data->m_ring.pop();
+			return Result::OK;
+		}
 		std::lock_guard<std::mutex> lock(m_mutex);
 		if (m_numElements == 0)
 		{
@@ -90,23 +137,123 @@ namespace avs
 
 	Result Queue::write(PipelineNode*, const void* buffer, size_t bufferSize, size_t& bytesWritten)
 	{
-		std::lock_guard<std::mutex> lock(m_mutex);
-		if (m_numElements == m_maxBuffers)
+		if (data->m_spsc)
 		{
-			auto oldsize=m_maxBuffers;
-			increaseBufferCount();
-			std::cerr << name.c_str()<<" Queue::write: Max buffers "<<oldsize<<" reached. Increasing max to "<<m_maxBuffers<<".\n";
+			// The ring has a fixed size: rather than growing, it reports full until the reader catches up.
+			bytesWritten = 0;
+			void* dst = nullptr;
+			Result result = reserve(bufferSize, &dst);
+			if (!result)
+			{
+				return result;
+			}
+			std::memcpy(dst, buffer, bufferSize);
+			data->m_ring.commit(bufferSize);
+			bytesWritten = bufferSize;
+			notifyWrite();
+			return Result::OK;
 		}
-		if (bufferSize > m_maxBufferSize)
 		{
-			increaseBufferSize(bufferSize);
-			std::cerr << name.c_str() << " Queue::write: Buffer size is "<<bufferSize<<" exceeding max. Increasing max to "<<m_maxBufferSize<<" Have "<<m_numElements<<" buffers.\n";
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_numElements == m_maxBuffers)
+			{
+				auto oldsize=m_maxBuffers;
+				increaseBufferCount();
+				std::cerr << name.c_str()<<" Queue::write: Max buffers "<<oldsize<<" reached. Increasing max to "<<m_maxBuffers<<".\n";
+			}
+			if (bufferSize > m_maxBufferSize)
+			{
+				increaseBufferSize(bufferSize);
+				std::cerr << name.c_str() << " Queue::write: Buffer size is "<<bufferSize<<" exceeding max. Increasing max to "<<m_maxBufferSize<<" Have "<<m_numElements<<" buffers.\n";
+			}
+			
+			push(buffer, bufferSize);
 		}
-		
-		push(buffer, bufferSize);
 
 		bytesWritten = bufferSize;
+		notifyWrite();
+
+		return Result::OK;
+	}
+
+	bool Queue::empty()
+	{
+		if (data->m_spsc)
+		{
+			return data->m_ring.empty();
+		}
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_numElements == 0;
+	}
+
+	void Queue::setWriteNotification(std::function<void()> notification)
+	{
+		data->m_writeNotification = std::move(notification);
+	}
+
+	void Queue::notifyWrite()
+	{
+		if (data->m_writeNotification)
+		{
+			data->m_writeNotification();
+		}
+	}
 
+	Result Queue::peek(const void** buffer, size_t& bufferSize)
+	{
+		if (!data->m_spsc)
+		{
+			return Result::Node_NotSupported;
+		}
+		const uint8_t* front = data->m_ring.front(bufferSize);
+		if (!front)
+		{
+			return Result::IO_Empty;
+		}
+		*buffer = front;
+		return Result::OK;
+	}
+
+	void Queue::discardFront()
+	{
+		size_t frontSize = 0;
+		if (data->m_spsc && data->m_ring.front(frontSize))
+		{
+			data->m_ring.pop();
+		}
+	}
+
+	Result Queue::reserve(size_t maxBufferSize, void** buffer)
+	{
+		if (!data->m_spsc)
+		{
+			return Result::Node_NotConfigured;
+		}
+		if (maxBufferSize > data->m_ring.maxBufferSize())
+		{
+			std::cerr << name.c_str() << " Queue::reserve: Buffer size " << maxBufferSize << " exceeds maximum of " << data->m_ring.maxBufferSize() << ".\n";
+			return Result::IO_InvalidArgument;
+		}
+		uint8_t* dst = data->m_ring.reserve(maxBufferSize);
+		if (!dst)
+		{
+			return Result::IO_Full;
+		}
+		*buffer = dst;
+		return Result::OK;
+	}
+
+	Result Queue::commit(size_t bufferSize)
+	{
+		if (!data->m_spsc)
+		{
+			return Result::Node_NotConfigured;
+		}
+		if (!data->m_ring.commit(bufferSize))
+		{
+			return Result::IO_InvalidArgument;
+		}
+		notifyWrite();
 		return Result::OK;
 	}
 
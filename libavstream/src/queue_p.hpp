@@ -3,10 +3,12 @@
 
 #pragma once
 
+#include <functional>
 #include <mutex>
 
 #include "common_p.hpp"
 #include "node_p.hpp"
+#include "util/bytering.hpp"
 #include <libavstream/queue.hpp>
 
 namespace avs
@@ -15,6 +17,11 @@ namespace avs
 	struct Queue::Private final : public PipelineNode::Private
 	{
 		AVSTREAM_PRIVATEINTERFACE(Queue, PipelineNode)
+		// Set only by configuration, before the reading and writing threads use the queue.
+		bool m_spsc = false;
+		ByteRing m_ring;
+		// Called on the writing thread after each buffer is added.
+		std::function<void()> m_writeNotification;
 	};
 
 } // avs
\ No newline at end of file
@@ -6,6 +6,7 @@
 
 #include <parsers/nalu_parser_h264.hpp>
 #include <parsers/nalu_parser_h265.hpp>
+#include <util/startcode.hpp>
 
 namespace avs
 {
@@ -43,53 +44,30 @@ namespace avs
 	{
 		flush();
 
-		size_t parseOffset = 0;
-		
-		for (; parseOffset < bufferSize; ++parseOffset)
+		const uint8_t* data = (const uint8_t*)buffer;
+		size_t startCodeEnd = findStartCode(data, 0, bufferSize);
+		// Nothing before the first start code is sent.
+		size_t firstOffset = startCodeEnd < bufferSize ? startCodeEnd + 1 : bufferSize;
+
+		// We are at buffer[firstOffset]. We accumulate until EITHER we hit bufferSize OR we get another NAL block.
+		while ((startCodeEnd = findStartCode(data, firstOffset, bufferSize)) < bufferSize)
 		{
-			if (m_aluCodeAccumulator.push(buffer[parseOffset]))
-			{
-				++parseOffset;
-				break;
-			}
-		}
+			bool isLastPayload = (bufferSize - startCodeEnd <= startCodeSize);
+			size_t dataSize = startCodeEnd - startCodeSize - firstOffset + 1;
+			Result callbackResult = m_callback(m_node, m_inputNodeIndex, buffer, dataSize, firstOffset, isLastPayload);
 
-		size_t firstOffset = parseOffset;
+			firstOffset = startCodeEnd + 1;
 
-		// We are at buffer[parseOffset]. We accumulate until EITHER we hit bufferSize OR we get another NAL block.
-		for (; parseOffset < bufferSize; ++parseOffset)
-		{
-			const char byte = buffer[parseOffset];
-			if (m_aluCodeAccumulator.push(byte))
-			{ 
-				Result callbackResult = Result::OK;
-				
-				bool isLastPayload;
-				if (bufferSize - parseOffset <= m_aluCodeAccumulator.m_buffer.size())
-				{
-					isLastPayload = true;
-				}
-				else
-				{
-					isLastPayload = false;
-				}
-
-				size_t dataSize = parseOffset - m_aluCodeAccumulator.m_buffer.size() - firstOffset + 1;
-				callbackResult = m_callback(m_node, m_inputNodeIndex, buffer, dataSize, firstOffset, isLastPayload);
-
-				firstOffset = parseOffset + 1;
-
-				if (!callbackResult)
-				{
-					return callbackResult;
-				}
+			if (!callbackResult)
+			{
+				return callbackResult;
 			}
 		}
 
 		Result result = Result::OK;
-		if (parseOffset > firstOffset)
+		if (bufferSize > firstOffset)
 		{
-			result = m_callback(m_node, m_inputNodeIndex, buffer, parseOffset - firstOffset, firstOffset, true);
+			result = m_callback(m_node, m_inputNodeIndex, buffer, bufferSize - firstOffset, firstOffset, true);
 		}
 
 		return result;
@@ -97,8 +75,6 @@ namespace avs
 
 	Result StreamParserAVC::flush()
 	{
-		m_aluCodeAccumulator.reset();
-
 		return Result::OK;
 	}
 
@@ -24,26 +24,6 @@ namespace avs
 		Result flush() override;
 
 	private:
-		struct ALUCodeAccumulator
-		{
-			inline bool push(char byte)
-			{
-				m_buffer[0] = m_buffer[1];
-				m_buffer[1] = m_buffer[2];
-				m_buffer[2] = byte;
-				return m_buffer[0] == 0 && m_buffer[1] == 0 && m_buffer[2] == 1;
-			}
-			inline void reset()
-			{
-				m_buffer[0] = 0xFF;
-				m_buffer[1] = 0xFF;
-				m_buffer[2] = 0xFF;
-			}
-			std::array<unsigned char, 3> m_buffer = { 0xFF, 0xFF, 0xFF };
-		};
-
-		ALUCodeAccumulator m_aluCodeAccumulator;
-		
 		PipelineNode* m_node;
 		OnPacketFn m_callback;
 		uint32_t m_inputNodeIndex;
@@ -0,0 +1,186 @@
+// libavstream
+// (c) Copyright 2018-2022 Simul Software Ltd
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace avs
+{
+	/*!
+	 * Lock-free ring of variable-size byte buffers, for exactly one producer thread and one consumer thread.
+	 *
+	 * Each buffer is stored as an 8-byte size header followed by its data, padded to a multiple of 8 bytes.
+	 * A buffer that would run past the end of the memory starts again at the beginning, after a marker header.
+	 * The producer reserves space, writes into it directly, then commits it; only then does the consumer see it.
+	 */
+	class ByteRing
+	{
+	public:
+		void configure(size_t capacity)
+		{
+			m_capacity = align(capacity);
+			m_mem.assign(m_capacity, 0);
+			m_head.store(0, std::memory_order_relaxed);
+			m_tail.store(0, std::memory_order_relaxed);
+			m_reserved = false;
+		}
+		void deconfigure()
+		{
+			m_capacity = 0;
+			m_mem.clear();
+			m_mem.shrink_to_fit();
+			m_head.store(0, std::memory_order_relaxed);
+			m_tail.store(0, std::memory_order_relaxed);
+			m_reserved = false;
+		}
+		size_t capacity() const
+		{
+			return m_capacity;
+		}
+		//! The largest buffer that can be written.
+		size_t maxBufferSize() const
+		{
+			return m_capacity / 2 > headerSize ? ((m_capacity / 2) & ~size_t(7)) - headerSize : 0;
+		}
+		//! The smallest capacity that can take a buffer of maxBufferSize bytes.
+		static size_t capacityFor(size_t maxBufferSize)
+		{
+			return 2 * (size_t)recordSize(maxBufferSize);
+		}
+
+		//! Producer: get space for a buffer of up to maxSize bytes. Returns nullptr if there is not enough free space.
+		//! A buffer can take at most half the capacity: anything larger might never fit, wherever the ring happens to be.
+		uint8_t* reserve(size_t maxSize)
+		{
+			const uint64_t need = recordSize(maxSize);
+			if (need > m_capacity / 2)
+				return nullptr;
+			const uint64_t head = m_head.load(std::memory_order_relaxed);
+			const size_t offset = (size_t)(head % m_capacity);
+			// If the buffer won't fit before the end of memory, skip to the start.
+			const uint64_t skip = (m_capacity - offset < need) ? m_capacity - offset : 0;
+			if (head + skip + need - m_tail.load(std::memory_order_acquire) > m_capacity)
+				return nullptr;
+			if (skip)
+				writeHeader(offset, wrapMarker);
+			m_reservedStart = head + skip;
+			m_reservedSize = maxSize;
+			m_reserved = true;
+			return &m_mem[(size_t)(m_reservedStart % m_capacity) + headerSize];
+		}
+		//! Producer: publish the reserved buffer, with its actual size, which may be less than was reserved.
+		bool commit(size_t size)
+		{
+			if (!m_reserved || size > m_reservedSize)
+				return false;
+			writeHeader((size_t)(m_reservedStart % m_capacity), size);
+			m_reserved = false;
+			m_head.store(m_reservedStart + recordSize(size), std::memory_order_release);
+			return true;
+		}
+		//! Producer: copy a buffer in. Returns false if there is not enough free space.
+		bool push(const void* buffer, size_t size)
+		{
+			uint8_t* dst = reserve(size);
+			if (!dst)
+				return false;
+			if (size)
+				memcpy(dst, buffer, size);
+			return commit(size);
+		}
+
+		//! Consumer: get the buffer at the front without removing it. Returns nullptr if the ring is empty.
+		const uint8_t* front(size_t& size)
+		{
+			uint64_t tail = m_tail.load(std::memory_order_relaxed);
+			const uint64_t head = m_head.load(std::memory_order_acquire);
+			if (tail == head)
+				return nullptr;
+			size_t offset = (size_t)(tail % m_capacity);
+			uint64_t header = readHeader(offset);
+			if (header == wrapMarker)
+			{
+				// Nothing else is in the space that was skipped, so it can be released straight away.
+				tail += m_capacity - offset;
+				m_tail.store(tail, std::memory_order_release);
+				offset = 0;
+				header = readHeader(offset);
+			}
+			size = (size_t)header;
+			return &m_mem[offset + headerSize];
+		}
+		//! Consumer: remove the buffer at the front, which must have been found with front().
+		void pop()
+		{
+			const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+			const uint64_t header = readHeader((size_t)(tail % m_capacity));
+			m_tail.store(tail + recordSize((size_t)header), std::memory_order_release);
+		}
+		//! Consumer: copy the front buffer out and remove it. Returns false if empty, or if bufferSize is too small,
+		//! in which case bufferSize is set to the size that is needed.
+		bool pop(void* buffer, size_t& bufferSize, size_t& bytesRead)
+		{
+			bytesRead = 0;
+			size_t size = 0;
+			const uint8_t* src = front(size);
+			if (!src)
+				return false;
+			if (!buffer || bufferSize < size)
+			{
+				bufferSize = size;
+				return false;
+			}
+			if (size)
+				memcpy(buffer, src, size);
+			bytesRead = size;
+			pop();
+			return true;
+		}
+		//! Consumer: discard everything that has been committed.
+		void clear()
+		{
+			m_tail.store(m_head.load(std::memory_order_acquire), std::memory_order_release);
+		}
+		bool empty() const
+		{
+			return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_acquire);
+		}
+
+	private:
+		static constexpr size_t headerSize = sizeof(uint64_t);
+		static constexpr uint64_t wrapMarker = ~uint64_t(0);
+		static size_t align(size_t n)
+		{
+			return (n + 7) & ~size_t(7);
+		}
+		static uint64_t recordSize(size_t size)
+		{
+			return headerSize + align(size);
+		}
+		void writeHeader(size_t offset, uint64_t header)
+		{
+			memcpy(&m_mem[offset], &header, headerSize);
+		}
+		uint64_t readHeader(size_t offset) const
+		{
+			uint64_t header;
+			memcpy(&header, &m_mem[offset], headerSize);
+			return header;
+		}
+
+		std::vector<uint8_t> m_mem;
+		size_t m_capacity = 0;
+		// Positions are counts of bytes ever written and read, so they never wrap; the offset in memory is the position modulo capacity.
+		// Each is written by only one side, and kept on its own cache line so the two threads don't contend for it.
+		alignas(64) std::atomic<uint64_t> m_head = 0;
+		alignas(64) std::atomic<uint64_t> m_tail = 0;
+		// Producer-only state.
+		alignas(64) uint64_t m_reservedStart = 0;
+		size_t m_reservedSize = 0;
+		bool m_reserved = false;
+	};
+} // avs
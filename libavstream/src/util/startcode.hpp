@@ -0,0 +1,100 @@
+// libavstream
+// (c) Copyright 2018-2022 Simul Software Ltd
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AVS_START_CODE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define AVS_START_CODE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace avs
+{
+	//! The size of an Annex B start code, 00 00 01.
+	constexpr size_t startCodeSize = 3;
+
+#if defined(_MSC_VER)
+	inline uint32_t lowestBit(uint32_t mask)
+	{
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return (uint32_t)index;
+	}
+#else
+	inline uint32_t lowestBit(uint32_t mask)
+	{
+		return (uint32_t)__builtin_ctz(mask);
+	}
+#endif
+
+	/*!
+	 * Find the next Annex B start code (00 00 01) lying entirely at or after data[from].
+	 * \return The index of the start code's final 01 byte, or size if there is none.
+	 *
+	 * Blocks of bytes are tested at once: a start code ends at i+2 wherever data[i]==0, data[i+1]==0 and data[i+2]==1,
+	 * so three overlapping loads compared against 0, 0 and 1 give every candidate in the block as one mask.
+	 */
+	inline size_t findStartCode(const uint8_t* data, size_t from, size_t size)
+	{
+		size_t i = from;
+#if defined(__AVX2__)
+		const __m256i zero32 = _mm256_setzero_si256();
+		const __m256i one32 = _mm256_set1_epi8(1);
+		for (; i + 32 + 2 <= size; i += 32)
+		{
+			__m256i b0 = _mm256_loadu_si256((const __m256i*)(data + i));
+			__m256i b1 = _mm256_loadu_si256((const __m256i*)(data + i + 1));
+			__m256i b2 = _mm256_loadu_si256((const __m256i*)(data + i + 2));
+			__m256i match = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(b0, zero32), _mm256_cmpeq_epi8(b1, zero32)), _mm256_cmpeq_epi8(b2, one32));
+			uint32_t mask = (uint32_t)_mm256_movemask_epi8(match);
+			if (mask)
+				return i + lowestBit(mask) + 2;
+		}
+#endif
+#if defined(AVS_START_CODE_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i one = _mm_set1_epi8(1);
+		for (; i + 16 + 2 <= size; i += 16)
+		{
+			__m128i b0 = _mm_loadu_si128((const __m128i*)(data + i));
+			__m128i b1 = _mm_loadu_si128((const __m128i*)(data + i + 1));
+			__m128i b2 = _mm_loadu_si128((const __m128i*)(data + i + 2));
+			__m128i match = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)), _mm_cmpeq_epi8(b2, one));
+			uint32_t mask = (uint32_t)_mm_movemask_epi8(match);
+			if (mask)
+				return i + lowestBit(mask) + 2;
+		}
+#elif defined(AVS_START_CODE_NEON)
+		const uint8x16_t zero = vdupq_n_u8(0);
+		const uint8x16_t one = vdupq_n_u8(1);
+		for (; i + 16 + 2 <= size; i += 16)
+		{
+			uint8x16_t b0 = vld1q_u8(data + i);
+			uint8x16_t b1 = vld1q_u8(data + i + 1);
+			uint8x16_t b2 = vld1q_u8(data + i + 2);
+			uint8x16_t match = vandq_u8(vandq_u8(vceqq_u8(b0, zero), vceqq_u8(b1, zero)), vceqq_u8(b2, one));
+			// NEON has no movemask; test for any match, then find it in the block with the scalar loop.
+			if (vmaxvq_u8(match))
+				break;
+		}
+#endif
+		for (; i + 2 < size; ++i)
+		{
+			if (data[i + 2] == 1 && data[i + 1] == 0 && data[i] == 0)
+				return i + 2;
+		}
+		return size;
+	}
+} // avs